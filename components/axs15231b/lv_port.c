@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_err.h"
@@ -71,6 +72,9 @@ typedef struct {
 static lvgl_port_ctx_t lvgl_port_ctx;
 static int lvgl_port_timer_period_ms = 5;
 
+/* Side of the square blocks 90/270 degree rotation works in */
+#define LVGL_PORT_ROTATE_TILE 16
+
 /*******************************************************************************
 * Function definitions
 *******************************************************************************/
@@ -428,6 +432,33 @@ static bool lvgl_port_flush_ready_callback(esp_lcd_panel_io_handle_t panel_io, e
 }
 #endif
 
+/*
+ * Rotate a width x height block of from (row stride from_stride) by 90 or 270 degrees into to,
+ * which ends up height pixels wide. Each tile reads a run of one cache line per source row and
+ * writes a tile's worth of short destination runs, so neither side strides across the frame.
+ */
+static void lvgl_port_rotate_tiled(lv_color_t *to, const lv_color_t *from, int from_stride,
+                                   int width, int height, lv_disp_rot_t rotate)
+{
+    const int step = (LV_DISP_ROT_90 == rotate) ? height : -height;
+
+    for (int ty = 0; ty < height; ty += LVGL_PORT_ROTATE_TILE) {
+        const int tile_h = LV_MIN(LVGL_PORT_ROTATE_TILE, height - ty);
+        for (int tx = 0; tx < width; tx += LVGL_PORT_ROTATE_TILE) {
+            const int tile_w = LV_MIN(LVGL_PORT_ROTATE_TILE, width - tx);
+            for (int y = ty; y < ty + tile_h; y++) {
+                const lv_color_t *src = from + y * from_stride + tx;
+                lv_color_t *dst = (LV_DISP_ROT_90 == rotate) ? to + tx * height + (height - y - 1)
+                                                             : to + (width - tx - 1) * height + y;
+                for (int x = 0; x < tile_w; x++) {
+                    *dst = src[x];
+                    dst += step;
+                }
+            }
+        }
+    }
+}
+
 static void lvgl_port_flush_callback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
     assert(drv != NULL);
@@ -501,22 +532,14 @@ static void lvgl_port_flush_callback(lv_disp_drv_t *drv, const lv_area_t *area,
 
             switch (rotate) {
             case LV_DISP_ROT_90:
-                for (int y = 0; y < height; y++) {
-                    for (int x = 0; x < trans_width; x++) {
-                        *(to + x * height + (height - y - 1)) = *(from + y * width + x_start_tmp + x);
-                    }
-                }
+                lvgl_port_rotate_tiled(to, from + x_start_tmp, width, trans_width, height, rotate);
                 x_draw_start = drv->ver_res - y_end - 1;
                 x_draw_end = drv->ver_res - y_start - 1;
                 y_draw_start = x_start_tmp;
                 y_draw_end = x_end_tmp;
                 break;
             case LV_DISP_ROT_270:
-                for (int y = 0; y < height; y++) {
-                    for (int x = 0; x < trans_width; x++) {
-                        *(to + (trans_width - x - 1) * height + y) = *(from + y * width + x_start_tmp + x);
-                    }
-                }
+                lvgl_port_rotate_tiled(to, from + x_start_tmp, width, trans_width, height, rotate);
                 x_draw_start = y_start;
                 x_draw_end = y_end;
                 y_draw_start = drv->hor_res - x_end_tmp - 1;
@@ -534,11 +557,7 @@ static void lvgl_port_flush_callback(lv_disp_drv_t *drv, const lv_area_t *area,
                 y_draw_end = drv->ver_res - y_start_tmp - 1;
                 break;
             case LV_DISP_ROT_NONE:
-                for (int y = 0; y < trans_height; y++) {
-                    for (int x = 0; x < width; x++) {
-                        *(to + y * (width) + x) = *(from + y_start_tmp * width + y * (width) + x);
-                    }
-                }
+                memcpy(to, from + y_start_tmp * width, trans_height * width * sizeof(lv_color_t));
                 x_draw_start = x_start;
                 x_draw_end = x_end;
                 y_draw_start = y_start_tmp;
@@ -0,0 +1,235 @@
+// ble_adv_parse.h
+
+#ifndef BLE_ADV_PARSE_H
+#define BLE_ADV_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Single-pass parser for legacy BLE advertising data. The scanner fills one
+// ble_adv_record_t per report and hands the same record to every handler, so
+// handlers never walk the AD structures themselves. Every structure is checked
+// against the report length, a truncated structure ends the walk.
+
+#define BLE_ADV_MAX_UUID16 10
+#define BLE_ADV_MAX_UUID32 5
+#define BLE_ADV_MAX_UUID128 3
+#define BLE_ADV_MAX_NAME 32
+
+#define BLE_AD_TYPE_FLAGS 0x01
+#define BLE_AD_TYPE_INCOMP_UUIDS16 0x02
+#define BLE_AD_TYPE_COMP_UUIDS16 0x03
+#define BLE_AD_TYPE_INCOMP_UUIDS32 0x04
+#define BLE_AD_TYPE_COMP_UUIDS32 0x05
+#define BLE_AD_TYPE_INCOMP_UUIDS128 0x06
+#define BLE_AD_TYPE_COMP_UUIDS128 0x07
+#define BLE_AD_TYPE_SHORT_NAME 0x08
+#define BLE_AD_TYPE_COMP_NAME 0x09
+#define BLE_AD_TYPE_TX_POWER 0x0A
+#define BLE_AD_TYPE_MFG_DATA 0xFF
+
+#define BLE_COMPANY_APPLE 0x004C
+
+// Address types as reported in the advertising report
+#define BLE_ADV_ADDR_PUBLIC 0
+#define BLE_ADV_ADDR_RANDOM 1
+
+typedef struct {
+  uint8_t addr[6];
+  uint8_t addr_type;
+  int8_t rssi;
+
+  const uint8_t *data; // Raw advertising data, owned by the caller
+  uint8_t data_len;
+
+  bool has_flags;
+  uint8_t flags;
+
+  bool has_tx_power;
+  int8_t tx_power;
+
+  uint16_t uuid16[BLE_ADV_MAX_UUID16];
+  uint8_t uuid16_count;
+  uint32_t uuid32[BLE_ADV_MAX_UUID32];
+  uint8_t uuid32_count;
+  // Little-endian, as carried over the air
+  uint8_t uuid128[BLE_ADV_MAX_UUID128][16];
+  uint8_t uuid128_count;
+
+  // Manufacturer specific data including the two company ID bytes
+  const uint8_t *mfg_data;
+  uint8_t mfg_len;
+  bool has_company_id;
+  uint16_t company_id;
+
+  char name[BLE_ADV_MAX_NAME];
+  uint8_t name_len;
+  bool name_complete;
+
+  // FNV-1a over the (type, length) of each AD structure. Spoofed floods
+  // randomise contents but tend to keep the same layout.
+  uint32_t layout_hash;
+} ble_adv_record_t;
+
+static inline uint16_t ble_adv_get_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t ble_adv_get_le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+// Fills the record from one advertising report. Address and RSSI are copied
+// in by the caller since they come from the HCI report, not the AD payload.
+// Returns false if the payload ended inside an AD structure; whatever was
+// parsed before that point is still valid.
+static inline bool ble_adv_parse(const uint8_t *data, size_t len,
+                                 ble_adv_record_t *rec) {
+  rec->data = data;
+  rec->data_len = (uint8_t)(len > 255 ? 255 : len);
+  rec->has_flags = false;
+  rec->has_tx_power = false;
+  rec->uuid16_count = 0;
+  rec->uuid32_count = 0;
+  rec->uuid128_count = 0;
+  rec->mfg_data = NULL;
+  rec->mfg_len = 0;
+  rec->has_company_id = false;
+  rec->company_id = 0;
+  rec->name[0] = '\0';
+  rec->name_len = 0;
+  rec->name_complete = false;
+  rec->layout_hash = 2166136261u;
+
+  if (!data) {
+    return len == 0;
+  }
+
+  size_t pos = 0;
+  while (pos < len) {
+    uint8_t field_len = data[pos];
+    if (field_len == 0) {
+      // Early terminator, the remainder is padding
+      return true;
+    }
+    if (pos + 1 + field_len > len) {
+      return false;
+    }
+
+    uint8_t type = data[pos + 1];
+    const uint8_t *val = &data[pos + 2];
+    uint8_t val_len = field_len - 1;
+
+    rec->layout_hash = (rec->layout_hash ^ type) * 16777619u;
+    rec->layout_hash = (rec->layout_hash ^ field_len) * 16777619u;
+
+    switch (type) {
+    case BLE_AD_TYPE_FLAGS:
+      if (val_len >= 1) {
+        rec->has_flags = true;
+        rec->flags = val[0];
+      }
+      break;
+
+    case BLE_AD_TYPE_TX_POWER:
+      if (val_len >= 1) {
+        rec->has_tx_power = true;
+        rec->tx_power = (int8_t)val[0];
+      }
+      break;
+
+    case BLE_AD_TYPE_INCOMP_UUIDS16:
+    case BLE_AD_TYPE_COMP_UUIDS16:
+      for (uint8_t i = 0; i + 2 <= val_len && rec->uuid16_count < BLE_ADV_MAX_UUID16;
+           i += 2) {
+        rec->uuid16[rec->uuid16_count++] = ble_adv_get_le16(&val[i]);
+      }
+      break;
+
+    case BLE_AD_TYPE_INCOMP_UUIDS32:
+    case BLE_AD_TYPE_COMP_UUIDS32:
+      for (uint8_t i = 0; i + 4 <= val_len && rec->uuid32_count < BLE_ADV_MAX_UUID32;
+           i += 4) {
+        rec->uuid32[rec->uuid32_count++] = ble_adv_get_le32(&val[i]);
+      }
+      break;
+
+    case BLE_AD_TYPE_INCOMP_UUIDS128:
+    case BLE_AD_TYPE_COMP_UUIDS128:
+      for (uint8_t i = 0;
+           i + 16 <= val_len && rec->uuid128_count < BLE_ADV_MAX_UUID128; i += 16) {
+        memcpy(rec->uuid128[rec->uuid128_count++], &val[i], 16);
+      }
+      break;
+
+    case BLE_AD_TYPE_SHORT_NAME:
+    case BLE_AD_TYPE_COMP_NAME:
+      // Prefer the complete name if both are present
+      if (rec->name_len == 0 || type == BLE_AD_TYPE_COMP_NAME) {
+        uint8_t n = val_len < BLE_ADV_MAX_NAME - 1 ? val_len : BLE_ADV_MAX_NAME - 1;
+        memcpy(rec->name, val, n);
+        rec->name[n] = '\0';
+        rec->name_len = n;
+        rec->name_complete = (type == BLE_AD_TYPE_COMP_NAME);
+      }
+      break;
+
+    case BLE_AD_TYPE_MFG_DATA:
+      if (!rec->mfg_data) {
+        rec->mfg_data = val;
+        rec->mfg_len = val_len;
+        if (val_len >= 2) {
+          rec->has_company_id = true;
+          rec->company_id = ble_adv_get_le16(val);
+        }
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    pos += 1 + field_len;
+  }
+
+  return true;
+}
+
+// 128-bit UUIDs built on the Bluetooth base UUID
+// (0000xxxx-0000-1000-8000-00805F9B34FB) are aliases of 16/32-bit UUIDs.
+static inline bool ble_adv_uuid128_short(const uint8_t *uuid, uint32_t *out) {
+  static const uint8_t base[12] = {0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00,
+                                   0x00, 0x80, 0x00, 0x10, 0x00, 0x00};
+  if (memcmp(uuid, base, sizeof(base)) != 0) {
+    return false;
+  }
+  *out = ble_adv_get_le32(&uuid[12]);
+  return true;
+}
+
+// True if the advert lists the 16-bit service UUID in any of its UUID forms
+static inline bool ble_adv_has_uuid16(const ble_adv_record_t *rec,
+                                      uint16_t uuid) {
+  for (uint8_t i = 0; i < rec->uuid16_count; i++) {
+    if (rec->uuid16[i] == uuid) {
+      return true;
+    }
+  }
+  for (uint8_t i = 0; i < rec->uuid32_count; i++) {
+    if (rec->uuid32[i] == uuid) {
+      return true;
+    }
+  }
+  for (uint8_t i = 0; i < rec->uuid128_count; i++) {
+    uint32_t alias;
+    if (ble_adv_uuid128_short(rec->uuid128[i], &alias) && alias == uuid) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif // BLE_ADV_PARSE_H
@@ -8,41 +8,113 @@
 #include <time.h>
 // nimble
 #ifndef CONFIG_IDF_TARGET_ESP32S2
+#include "core/ble_adv_parse.h"
 #include "host/ble_gap.h"
 #endif
 
-#define MAX_PINEAP_NETWORKS 20
-#define MAX_SSIDS_PER_BSSID 10
+#define PINEAP_TABLE_SIZE 64   // BSSIDs tracked at once
+#define PINEAP_BUCKET_COUNT 32 // Hash buckets, must be a power of two
+#define PINEAP_SSID_SET_SIZE 16 // SSID hash slots per BSSID, power of two
+#define MAX_SSIDS_PER_BSSID 12  // Keep the SSID set below full load
 #define RECENT_SSID_COUNT 5
+#define PINEAP_QUEUE_LENGTH 8
 
 // PineAP detection structures
 typedef struct {
   uint8_t bssid[6];
   uint8_t ssid_count;
   bool is_pineap;
-  time_t first_seen;
-  uint32_t ssid_hashes[MAX_SSIDS_PER_BSSID];
+  int64_t first_seen_us;
+  int64_t last_seen_us;
+  int64_t last_report_us;
+  // Open-addressed set of djb2 SSID hashes, 0 marks an empty slot
+  uint32_t ssid_set[PINEAP_SSID_SET_SIZE];
+  uint32_t first_ssid_hash;
   // Circular buffer for recent SSIDs
   char recent_ssids[RECENT_SSID_COUNT][33];
   uint8_t recent_ssid_index;
-  TaskHandle_t log_task_handle;
   int8_t last_channel;
   int8_t last_rssi;
+  int16_t next; // Bucket chain or free list link, -1 terminates
 } pineap_network_t;
 
-// Structure for passing data to logging task
+// Snapshot handed from the sniffer callback to the reporter task
 typedef struct {
   uint8_t bssid[6];
   char recent_ssids[RECENT_SSID_COUNT][33];
-  int ssid_count;
+  uint8_t ssid_count;
   int8_t channel;
   int8_t rssi;
-  struct pineap_network_t *network; // Add network pointer
-} pineap_log_data_t;
+  bool has_twin;
+  uint8_t twin_bssid[6];
+  int64_t detected_us;
+} pineap_detection_t;
+
+typedef struct {
+  uint32_t detections;
+  uint32_t reports;
+  uint32_t dropped_reports;
+  uint32_t evictions;
+  uint32_t max_report_latency_ms;
+  int tracked_networks;
+} pineap_stats_t;
 
 // PineAP detection control functions
 void start_pineap_detection(void);
 void stop_pineap_detection(void);
+void pineap_get_stats(pineap_stats_t *stats);
+
+#define SKIMMER_QUEUE_LENGTH 16
+#define SKIMMER_MAX_CANDIDATES 8
+#define SKIMMER_UPDATE_INTERVAL_MS 2000 // Proximity updates per candidate
+#define SKIMMER_STALE_MS 30000          // Unseen this long, report as new
+#define SKIMMER_TREND_DB 3              // Fast/slow RSSI gap that counts as a trend
+
+typedef enum {
+  SKIMMER_TREND_STEADY = 0,
+  SKIMMER_TREND_APPROACHING,
+  SKIMMER_TREND_RECEDING
+} skimmer_trend_t;
+
+// Snapshot handed from the NimBLE callback to the skimmer worker
+typedef struct {
+  uint8_t addr[6];
+  uint8_t addr_type;
+  uint8_t event_type;
+  int8_t rssi;
+  uint8_t pattern; // Index of the matched suspicious name
+  uint8_t data[31];
+  uint8_t data_len;
+  int64_t detected_us;
+} skimmer_detection_t;
+
+// Per-device RSSI trend, owned by the worker. Two EWMAs in 1/16 dB steps:
+// the fast one follows the latest samples, the slow one the recent past.
+typedef struct {
+  bool in_use;
+  uint8_t addr[6];
+  uint8_t pattern;
+  int16_t rssi_fast;
+  int16_t rssi_slow;
+  uint32_t samples;
+  int64_t first_seen_us;
+  int64_t last_seen_us;
+  int64_t last_report_us;
+  skimmer_trend_t trend;
+} skimmer_candidate_t;
+
+typedef struct {
+  uint32_t adverts_checked;
+  uint32_t matches;
+  uint32_t dropped_reports;
+  uint32_t candidates;
+  uint32_t max_report_latency_ms;
+} skimmer_stats_t;
+
+// Skimmer detection control functions
+void skimmer_detection_start(void);
+void skimmer_detection_stop(void);
+void skimmer_get_stats(skimmer_stats_t *stats);
 
 // Forward declarations of callback functions
 void wifi_pineap_detector_callback(void *buf, wifi_promiscuous_pkt_type_t type);
@@ -54,8 +126,12 @@ void wifi_probe_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type);
 void wifi_raw_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type);
 void wifi_eapol_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type);
 void wardriving_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type);
-void ble_wardriving_callback(struct ble_gap_event *event, void *arg);
-void ble_skimmer_scan_callback(struct ble_gap_event *event, void *arg);
+#ifndef CONFIG_IDF_TARGET_ESP32S2
+void ble_wardriving_callback(struct ble_gap_event *event,
+                             const ble_adv_record_t *adv);
+void ble_skimmer_scan_callback(struct ble_gap_event *event,
+                               const ble_adv_record_t *adv);
+#endif
 void gps_event_handler(void *event_handler_arg, esp_event_base_t event_base,
                        int32_t event_id, void *event_data);
 void wifi_stations_sniffer_callback(void *buf,
@@ -67,13 +143,53 @@ typedef enum {
   WPS_MODE_PIN       // PIN method (Display or Keypad)
 } wps_modes_t;
 
+// WPS attribute IDs (Wi-Fi Simple Configuration TLVs)
+#define WPS_ATTR_VERSION 0x104A
+#define WPS_ATTR_STATE 0x1044
+#define WPS_ATTR_AP_SETUP_LOCKED 0x1057
+#define WPS_ATTR_CONFIG_METHODS 0x1008
+#define WPS_ATTR_SELECTED_REGISTRAR 0x1041
+#define WPS_ATTR_SELECTED_REG_CONFIG_METHODS 0x1053
+
+typedef struct {
+  uint8_t version;                      // 0x10 for WPS 1.0
+  uint8_t state;                        // 1 = unconfigured, 2 = configured
+  bool ap_setup_locked;                 // AP refuses PIN attempts
+  bool selected_registrar;              // Registrar currently active
+  bool has_config_methods;
+  uint16_t config_methods;
+  uint16_t selected_reg_config_methods;
+} wps_info_t;
+
 typedef struct {
   char ssid[33];        // SSID (max 32 characters + null terminator)
   uint8_t bssid[6];     // BSSID (MAC address)
   bool wps_enabled;     // True if WPS is enabled
   wps_modes_t wps_mode; // WPS mode (PIN or PBC)
+  wps_info_t info;      // Parsed WPS attributes
 } wps_network_t;
 
+// BSSIDs remembered by the WPS detector, in 8-way sets. A busy area shows
+// a few hundred APs across all channels, past that entries are recycled.
+#define WPS_SEEN_SETS 64
+#define WPS_SEEN_WAYS 8
+
+// In replacement order, APs already reported go last
+typedef enum {
+  WPS_SEEN_EMPTY = 0,
+  WPS_SEEN_NO_WPS,
+  WPS_SEEN_WPS_PENDING, // WPS without Config Methods yet, still parsed
+  WPS_SEEN_WPS
+} wps_seen_state_t;
+
+typedef struct {
+  uint8_t bssid[6];
+  uint8_t state;      // wps_seen_state_t
+  uint8_t referenced; // Seen since the last replacement sweep of its set
+} wps_seen_entry_t;
+
+void wps_detection_reset(void);
+
 extern gps_t *gps;
 extern wps_network_t detected_wps_networks[MAX_WPS_NETWORKS];
 extern int detected_network_count;
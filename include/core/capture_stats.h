@@ -0,0 +1,79 @@
+// capture_stats.h
+
+#ifndef CAPTURE_STATS_H
+#define CAPTURE_STATS_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPTURE_STATS_SAMPLE_MS 1000
+#define CAPTURE_STATS_WINDOW 10    // Samples in the long rate window
+#define CAPTURE_STATS_REPORT_S 10  // Seconds between terminal summaries
+#define CAPTURE_STATS_STALL_MS 100 // A flush slower than this is a stall
+
+typedef enum {
+  CAPTURE_MODE_NONE = 0,
+  CAPTURE_MODE_PROBE,
+  CAPTURE_MODE_DEAUTH,
+  CAPTURE_MODE_BEACON,
+  CAPTURE_MODE_RAW,
+  CAPTURE_MODE_EAPOL,
+  CAPTURE_MODE_PWN,
+  CAPTURE_MODE_WPS,
+  CAPTURE_MODE_PINEAP,
+  CAPTURE_MODE_BLE,
+  CAPTURE_MODE_SKIMMER,
+  CAPTURE_MODE_COUNT
+} capture_mode_t;
+
+typedef struct {
+  uint32_t frames;        // Delivered to the capture callback
+  uint32_t written;       // Appended to the PCAP buffer
+  uint32_t bytes;         // Payload bytes appended
+  uint32_t dropped;       // Meant for the PCAP but not written
+  uint32_t lock_timeouts; // Part of dropped, buffer busy flushing
+  uint32_t flushes;       // Buffer flushes to SD or serial
+  uint32_t stalls;        // Flushes over CAPTURE_STATS_STALL_MS
+  uint32_t flush_max_ms;
+} capture_counters_t;
+
+// Per second rates, the long window is an average
+typedef struct {
+  uint32_t frames;
+  uint32_t written;
+  uint32_t bytes;
+  uint32_t dropped;
+} capture_rate_t;
+
+typedef struct {
+  capture_mode_t mode;
+  bool active;
+  uint32_t elapsed_s;
+  capture_counters_t counters;
+  capture_rate_t rate_1s;
+  capture_rate_t rate_10s;
+} capture_stats_summary_t;
+
+// Resets the mode's counters and makes it the one summarized and timed.
+// Call once the capture file is open.
+void capture_stats_start(capture_mode_t mode);
+// Prints the final summary, counters stay readable until the mode restarts
+void capture_stats_stop(void);
+capture_mode_t capture_stats_active(void);
+
+// Called from the capture callbacks, lock free
+void capture_stats_frame(capture_mode_t mode);
+// Records the outcome of a PCAP write for a frame already counted
+void capture_stats_result(capture_mode_t mode, size_t bytes, esp_err_t ret);
+// Called by the PCAP writer for every buffer flush, counts toward the
+// active mode
+void capture_stats_flush(size_t bytes, uint32_t elapsed_us);
+
+// False if the mode never ran
+bool capture_stats_get(capture_mode_t mode, capture_stats_summary_t *summary);
+void capture_stats_print(void);
+const char *capture_stats_mode_name(capture_mode_t mode);
+
+#endif // CAPTURE_STATS_H
@@ -11,7 +11,7 @@ extern "C" {
 #endif
 
 #ifndef DNS_SERVER_MAX_ITEMS
-#define DNS_SERVER_MAX_ITEMS 1
+#define DNS_SERVER_MAX_ITEMS 8
 #endif
 
 #define DNS_SERVER_CONFIG_SINGLE(queried_name, netif_key)                      \
@@ -30,8 +30,10 @@ extern "C" {
  * and `if_key`
  */
 typedef struct dns_entry_pair {
-  const char
-      *name; /**<! Exact match of the name field of the DNS query to answer */
+  const char *name; /**<! Name of the DNS query to answer, compared without
+                       case. "*" answers every name and "*.example.com" any
+                       name below example.com. The first matching entry
+                       answers. */
   const char *if_key; /**<! Use this network interface IP to answer, only if
                          NULL, use the static IP below */
   esp_ip4_addr_t
@@ -63,6 +65,19 @@ typedef struct dns_server_config {
  */
 typedef struct dns_server_handle *dns_server_handle_t;
 
+/**
+ * @brief Counters kept by a running DNS server
+ */
+typedef struct dns_server_stats {
+  uint32_t queries;    /**<! Packets received */
+  uint32_t answered;   /**<! Replies carrying an A record */
+  uint32_t not_found;  /**<! Names no entry matched, answered NXDOMAIN */
+  uint32_t cache_hits; /**<! Replies taken from the response cache */
+  uint32_t malformed;  /**<! Dropped, or answered FORMERR */
+  uint32_t queries_per_sec;      /**<! Packets in the last full second */
+  uint32_t peak_queries_per_sec; /**<! Highest queries_per_sec seen */
+} dns_server_stats_t;
+
 /**
  * @brief Set ups and starts a simple DNS server that will respond to all A
  * queries (IPv4) based on configured rules, pairs of name and either IPv4
@@ -74,6 +89,14 @@ typedef struct dns_server_handle *dns_server_handle_t;
  */
 dns_server_handle_t start_dns_server(dns_server_config_t *config);
 
+/**
+ * @brief Copies the server's counters
+ * @param handle DNS server's handle
+ * @param stats Filled with the counters
+ */
+void dns_server_get_stats(dns_server_handle_t handle,
+                          dns_server_stats_t *stats);
+
 /**
  * @brief Stops and destroys DNS server's task and structs
  * @param handle DNS server's handle to destroy
@@ -0,0 +1,26 @@
+// file_index.h
+
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+// Captures and logs are named <dir>/<prefix>_<index>.<ext>. The next index
+// of every prefix is kept in memory and in a state file on the card, so
+// starting a capture no longer lists a directory of thousands of files.
+#define FILE_INDEX_STATE_PATH "/mnt/ghostesp/.file_index"
+#define FILE_INDEX_MAX_DIRS 6
+#define FILE_INDEX_MAX_ENTRIES 32
+#define FILE_INDEX_DIR_LEN 32
+#define FILE_INDEX_PREFIX_LEN 24
+#define FILE_INDEX_EXT_LEN 6
+
+// Call once the card is mounted. Loads the saved indexes and reconciles
+// them with the capture directories from a background task.
+void file_index_init(void);
+// Forget everything, the card is gone
+void file_index_reset(void);
+
+// Reserves and returns the next free index, -1 if dir can't be read.
+// Blocks while dir is still being scanned.
+int file_index_next(const char *dir, const char *prefix, const char *ext);
+
+#endif // FILE_INDEX_H
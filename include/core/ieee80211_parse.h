@@ -0,0 +1,373 @@
+// ieee80211_parse.h
+
+#ifndef IEEE80211_PARSE_H
+#define IEEE80211_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Zero-copy 802.11 frame views. Everything here takes the frame length
+// (rx_ctrl.sig_len for promiscuous packets) and never reads past it, so
+// callbacks can use the results without repeating their own offset checks.
+
+#define IEEE80211_MGMT_HDR_LEN 24
+#define IEEE80211_BEACON_FIXED_LEN 12 // Timestamp(8) + Interval(2) + Capability(2)
+
+#define IEEE80211_TYPE_MGMT 0
+#define IEEE80211_TYPE_CTRL 1
+#define IEEE80211_TYPE_DATA 2
+
+#define IEEE80211_SUBTYPE_ASSOC_REQ 0x0
+#define IEEE80211_SUBTYPE_ASSOC_RESP 0x1
+#define IEEE80211_SUBTYPE_REASSOC_REQ 0x2
+#define IEEE80211_SUBTYPE_REASSOC_RESP 0x3
+#define IEEE80211_SUBTYPE_PROBE_REQ 0x4
+#define IEEE80211_SUBTYPE_PROBE_RESP 0x5
+#define IEEE80211_SUBTYPE_BEACON 0x8
+#define IEEE80211_SUBTYPE_DISASSOC 0xA
+#define IEEE80211_SUBTYPE_AUTH 0xB
+#define IEEE80211_SUBTYPE_DEAUTH 0xC
+#define IEEE80211_SUBTYPE_ACTION 0xD
+
+#define IEEE80211_IE_SSID 0
+#define IEEE80211_IE_RSN 48
+#define IEEE80211_IE_VENDOR 221
+
+#define IEEE80211_OUI_MICROSOFT 0x0050f2
+
+// Single information element, data points into the original frame
+typedef struct {
+  uint8_t id;
+  uint8_t len;
+  const uint8_t *data;
+} ieee80211_ie_t;
+
+// Walks the tagged parameters of a frame without copying. Every element is
+// checked against the frame length before it is handed out, a truncated
+// element ends the walk.
+typedef struct {
+  const uint8_t *frame;
+  size_t len;
+  size_t pos;
+} ieee80211_ie_iter_t;
+
+// Parsed MAC header. Address pointers are NULL when the frame type does not
+// carry that address or the frame is too short to hold it.
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+  uint16_t frame_ctrl;
+  uint8_t type;
+  uint8_t subtype;
+  bool to_ds;
+  bool from_ds;
+  bool protected_frame;
+  bool has_qos;
+  bool has_ht_ctrl;
+  uint16_t qos_ctrl;
+  const uint8_t *addr1;
+  const uint8_t *addr2;
+  const uint8_t *addr3;
+  const uint8_t *addr4;
+  size_t hdr_len;
+  const uint8_t *body;
+  size_t body_len;
+} ieee80211_frame_t;
+
+static inline uint16_t ieee80211_get_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint16_t ieee80211_get_be16(const uint8_t *p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// Fills f from the first len bytes of data. Returns false when the frame is
+// too short for the header its frame control field announces.
+static inline bool ieee80211_frame_parse(const uint8_t *data, size_t len,
+                                         ieee80211_frame_t *f) {
+  memset(f, 0, sizeof(*f));
+  if (data == NULL || len < 10) {
+    return false;
+  }
+
+  f->data = data;
+  f->len = len;
+  f->frame_ctrl = ieee80211_get_le16(data);
+  f->type = (f->frame_ctrl >> 2) & 0x3;
+  f->subtype = (f->frame_ctrl >> 4) & 0xF;
+  f->to_ds = (f->frame_ctrl >> 8) & 0x1;
+  f->from_ds = (f->frame_ctrl >> 9) & 0x1;
+  f->protected_frame = (f->frame_ctrl >> 14) & 0x1;
+  bool order = (f->frame_ctrl >> 15) & 0x1;
+
+  f->addr1 = &data[4];
+  size_t hdr_len;
+
+  switch (f->type) {
+  case IEEE80211_TYPE_CTRL:
+    // CTS and ACK only carry the receiver address
+    if (f->subtype == 0xC || f->subtype == 0xD) {
+      hdr_len = 10;
+    } else {
+      hdr_len = 16;
+      if (len < hdr_len) {
+        return false;
+      }
+      f->addr2 = &data[10];
+    }
+    break;
+
+  case IEEE80211_TYPE_MGMT:
+    hdr_len = IEEE80211_MGMT_HDR_LEN;
+    if (len < hdr_len) {
+      return false;
+    }
+    f->addr2 = &data[10];
+    f->addr3 = &data[16];
+    if (order) {
+      f->has_ht_ctrl = true;
+      hdr_len += 4;
+    }
+    break;
+
+  case IEEE80211_TYPE_DATA:
+    hdr_len = 24;
+    if (len < hdr_len) {
+      return false;
+    }
+    f->addr2 = &data[10];
+    f->addr3 = &data[16];
+    if (f->to_ds && f->from_ds) {
+      if (len < 30) {
+        return false;
+      }
+      f->addr4 = &data[24];
+      hdr_len = 30;
+    }
+    if (f->subtype & 0x8) {
+      if (len < hdr_len + 2) {
+        return false;
+      }
+      f->has_qos = true;
+      f->qos_ctrl = ieee80211_get_le16(&data[hdr_len]);
+      hdr_len += 2;
+      if (order) {
+        f->has_ht_ctrl = true;
+        hdr_len += 4;
+      }
+    }
+    break;
+
+  default:
+    return false;
+  }
+
+  if (len < hdr_len) {
+    return false;
+  }
+
+  f->hdr_len = hdr_len;
+  f->body = &data[hdr_len];
+  f->body_len = len - hdr_len;
+  return true;
+}
+
+static inline bool ieee80211_frame_is_mgmt(const ieee80211_frame_t *f,
+                                           uint8_t subtype) {
+  return f->type == IEEE80211_TYPE_MGMT && f->subtype == subtype;
+}
+
+// BSSID according to the To/From DS bits, NULL for WDS and control frames
+static inline const uint8_t *ieee80211_frame_bssid(const ieee80211_frame_t *f) {
+  if (f->type == IEEE80211_TYPE_CTRL) {
+    return NULL;
+  }
+  if (!f->to_ds && !f->from_ds) {
+    return f->addr3;
+  }
+  if (f->to_ds && !f->from_ds) {
+    return f->addr1;
+  }
+  if (!f->to_ds && f->from_ds) {
+    return f->addr2;
+  }
+  return NULL;
+}
+
+// Fixed parameters that precede the tagged parameters of a management frame
+static inline size_t ieee80211_mgmt_fixed_len(uint8_t subtype) {
+  switch (subtype) {
+  case IEEE80211_SUBTYPE_ASSOC_REQ:
+    return 4;
+  case IEEE80211_SUBTYPE_ASSOC_RESP:
+  case IEEE80211_SUBTYPE_REASSOC_RESP:
+    return 6;
+  case IEEE80211_SUBTYPE_REASSOC_REQ:
+    return 10;
+  case IEEE80211_SUBTYPE_PROBE_RESP:
+  case IEEE80211_SUBTYPE_BEACON:
+    return IEEE80211_BEACON_FIXED_LEN;
+  case IEEE80211_SUBTYPE_AUTH:
+    return 6;
+  case IEEE80211_SUBTYPE_DISASSOC:
+  case IEEE80211_SUBTYPE_DEAUTH:
+    return 2;
+  case IEEE80211_SUBTYPE_ACTION:
+    return 1; // Category, the rest depends on the action
+  default:
+    return 0;
+  }
+}
+
+static inline void ieee80211_ie_iter_init(ieee80211_ie_iter_t *it,
+                                          const uint8_t *frame, size_t len,
+                                          size_t offset) {
+  it->frame = frame;
+  it->len = len;
+  it->pos = offset;
+}
+
+// Starts an IE walk after the fixed parameters of a management frame.
+// Returns false for non-management frames or when there is no IE area.
+static inline bool ieee80211_frame_ie_iter(const ieee80211_frame_t *f,
+                                           ieee80211_ie_iter_t *it) {
+  if (f->type != IEEE80211_TYPE_MGMT) {
+    return false;
+  }
+  size_t offset = f->hdr_len + ieee80211_mgmt_fixed_len(f->subtype);
+  if (offset > f->len) {
+    return false;
+  }
+  ieee80211_ie_iter_init(it, f->data, f->len, offset);
+  return true;
+}
+
+static inline bool ieee80211_ie_next(ieee80211_ie_iter_t *it,
+                                     ieee80211_ie_t *ie) {
+  if (it->pos + 2 > it->len) {
+    return false;
+  }
+
+  uint8_t ie_len = it->frame[it->pos + 1];
+  if (it->pos + 2 + ie_len > it->len) {
+    it->pos = it->len;
+    return false;
+  }
+
+  ie->id = it->frame[it->pos];
+  ie->len = ie_len;
+  ie->data = &it->frame[it->pos + 2];
+  it->pos += 2 + ie_len;
+  return true;
+}
+
+// Vendor specific element with the given OUI (24 bit) and OUI type
+static inline bool ieee80211_ie_is_vendor(const ieee80211_ie_t *ie,
+                                          uint32_t oui, uint8_t oui_type) {
+  if (ie->id != IEEE80211_IE_VENDOR || ie->len < 4) {
+    return false;
+  }
+  uint32_t ie_oui = ((uint32_t)ie->data[0] << 16) |
+                    ((uint32_t)ie->data[1] << 8) | ie->data[2];
+  return ie_oui == oui && ie->data[3] == oui_type;
+}
+
+// First element with the given ID, or false if the walk ends first
+static inline bool ieee80211_frame_find_ie(const ieee80211_frame_t *f,
+                                           uint8_t id, ieee80211_ie_t *ie) {
+  ieee80211_ie_iter_t it;
+  if (!ieee80211_frame_ie_iter(f, &it)) {
+    return false;
+  }
+  while (ieee80211_ie_next(&it, ie)) {
+    if (ie->id == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Rejects element lengths that the standard does not allow for known IDs.
+// Used to find where garbage starts in frames with a corrupted tail.
+static inline bool ieee80211_ie_length_valid(uint8_t id, uint8_t len) {
+  switch (id) {
+  case 9: // Hopping Pattern Table
+    return len >= 4;
+  case 32: // Power Constraint
+    return len == 1;
+  case 33: // Power Capability
+  case 35: // TPC Report
+    return len == 2;
+  case 36: // Channels
+  case 38: // Measurement Request
+  case 39: // Measurement Report
+  case 51: // AP Channel Report
+  case 142: // Page Slice
+    return len >= 3;
+  case 37: // Channel Switch Announcement
+    return len == 3;
+  case 41: // IBSS DFS
+  case 235: // S1G Beacon Compatibility
+    return len >= 7;
+  case 42: // ERP Information
+  case 62: // Secondary Channel Offset
+    return len == 1;
+  case 45: // HT Capabilities
+    return len == 26;
+  case 47: // HT Operation (pre-standard)
+  case 61: // HT Operation
+    return len >= 22;
+  case 48: // RSN
+  case 195: // VHT Transmit Power Envelope
+    return len >= 2;
+  case 50: // Extended Supported Rates
+  case 107: // Interworking
+  case 127: // Extended Capabilities
+  case 255: // Extended tag
+    return len >= 1;
+  case 74: // Overlapping BSS Scan Parameters
+    return len == 14;
+  case 93: // WNM-Sleep Mode
+  case 216: // Target Wake Time
+    return len >= 4;
+  case 191: // VHT Capabilities
+    return len == 12;
+  case 192: // VHT Operation
+  case 232: // DMG Operation
+    return len >= 5;
+  case 221: // Vendor Specific
+    return len >= 3;
+  default:
+    return true;
+  }
+}
+
+// LLC/SNAP header carrying EtherType 0x888E in an unprotected data frame
+static inline bool ieee80211_frame_is_eapol(const ieee80211_frame_t *f) {
+  static const uint8_t llc_snap_eapol[8] = {0xAA, 0xAA, 0x03, 0x00,
+                                            0x00, 0x00, 0x88, 0x8E};
+  if (f->type != IEEE80211_TYPE_DATA || f->protected_frame ||
+      f->body_len < sizeof(llc_snap_eapol)) {
+    return false;
+  }
+  return memcmp(f->body, llc_snap_eapol, sizeof(llc_snap_eapol)) == 0;
+}
+
+static inline bool ieee80211_mac_is_multicast(const uint8_t *mac) {
+  return (mac[0] & 0x01) != 0;
+}
+
+// FNV-1a over a MAC address, for indexing per-BSSID or per-station tables
+static inline uint32_t ieee80211_mac_hash(const uint8_t *mac) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < 6; i++) {
+    hash ^= mac[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+#endif // IEEE80211_PARSE_H
@@ -0,0 +1,69 @@
+// multipart.h
+
+#ifndef MULTIPART_H
+#define MULTIPART_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming multipart/form-data parser. The body is fed in whatever pieces
+// it arrives in, a delimiter split across two pieces is still found. Part
+// data is passed on without copying except for the few bytes that might
+// start a delimiter at the end of a piece.
+
+#define MULTIPART_BOUNDARY_MAX 70 // RFC 2046
+#define MULTIPART_LINE_MAX 512    // One part header line
+#define MULTIPART_NAME_MAX 64
+#define MULTIPART_FILENAME_MAX 128
+
+typedef enum {
+  MULTIPART_PREAMBLE,
+  MULTIPART_DELIM_TAIL, // After a delimiter, "--" or CRLF follows
+  MULTIPART_DELIM_LF,
+  MULTIPART_FINAL_DASH,
+  MULTIPART_HEADERS,
+  MULTIPART_BODY,
+  MULTIPART_EPILOGUE, // After the closing delimiter, ignored
+  MULTIPART_ERROR,
+} multipart_state_t;
+
+typedef struct {
+  // A part's headers were read. Returning false stops the parser.
+  bool (*on_part)(const char *name, const char *filename, void *ctx);
+  // Part data in order, in pieces of any size
+  bool (*on_data)(const uint8_t *data, size_t len, void *ctx);
+  // The part ended, every byte of it was passed to on_data
+  bool (*on_part_end)(void *ctx);
+  void *ctx;
+} multipart_callbacks_t;
+
+typedef struct {
+  multipart_state_t state;
+  multipart_callbacks_t cb;
+  char delim[MULTIPART_BOUNDARY_MAX + 5]; // "\r\n--" boundary
+  size_t delim_len;
+  size_t match; // Delimiter bytes matched and held back from on_data
+  char line[MULTIPART_LINE_MAX];
+  size_t line_len;
+  char name[MULTIPART_NAME_MAX];
+  char filename[MULTIPART_FILENAME_MAX];
+} multipart_parser_t;
+
+// Copies the boundary out of a Content-Type header value, quoted or not.
+// False if there is none or it is longer than MULTIPART_BOUNDARY_MAX.
+bool multipart_get_boundary(const char *content_type, char *out,
+                            size_t out_len);
+
+// False if boundary is empty, too long or contains CR or LF
+bool multipart_init(multipart_parser_t *p, const char *boundary,
+                    const multipart_callbacks_t *cb);
+
+// Parses the next piece of the body. False on malformed input or when a
+// callback stopped it, the parser then stays stopped.
+bool multipart_feed(multipart_parser_t *p, const uint8_t *data, size_t len);
+
+// True once the closing delimiter was seen
+bool multipart_complete(const multipart_parser_t *p);
+
+#endif // MULTIPART_H
@@ -0,0 +1,95 @@
+// sys_stats.h
+
+#ifndef SYS_STATS_H
+#define SYS_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYS_STATS_MAX_TASKS 24
+#define SYS_STATS_SAMPLE_MS 5000
+// A task is flagged when its stack never had more than this much free
+#define SYS_STATS_STACK_WARN_BYTES 512
+#define SYS_STATS_STACK_WARN_PCT 10
+
+// Subsystems that allocate through sys_stats_malloc()
+typedef enum {
+  SYS_STATS_TAG_OTHER = 0,
+  SYS_STATS_TAG_WEB,
+  SYS_STATS_TAG_WIFI,
+  SYS_STATS_TAG_BLE,
+  SYS_STATS_TAG_SD,
+  SYS_STATS_TAG_GPS,
+  SYS_STATS_TAG_DISPLAY,
+  SYS_STATS_TAG_COUNT
+} sys_stats_tag_t;
+
+typedef enum {
+  SYS_STATS_HEAP_INTERNAL = 0,
+  SYS_STATS_HEAP_DMA,
+  SYS_STATS_HEAP_SPIRAM,
+  SYS_STATS_HEAP_COUNT
+} sys_stats_heap_t;
+
+typedef struct {
+  bool present; // SPIRAM is absent on most boards
+  uint32_t free_bytes;
+  uint32_t min_free_bytes; // Low-water mark since boot
+  uint32_t largest_block;
+  uint32_t total_bytes;
+} sys_stats_heap_info_t;
+
+typedef struct {
+  char name[16];
+  uint32_t stack_size;
+  uint32_t stack_free;     // Latest high-water mark, bytes never used
+  uint32_t stack_free_min; // Lowest high-water mark over all samples
+  bool running;            // Task existed at the last sample
+} sys_stats_task_info_t;
+
+typedef struct {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t failures;
+  uint32_t live_bytes;
+  uint32_t peak_bytes;
+} sys_stats_tag_info_t;
+
+typedef struct {
+  uint32_t uptime_s;
+  uint32_t samples;
+  sys_stats_heap_info_t heap[SYS_STATS_HEAP_COUNT];
+  sys_stats_task_info_t tasks[SYS_STATS_MAX_TASKS];
+  uint8_t task_count;
+  sys_stats_tag_info_t tags[SYS_STATS_TAG_COUNT];
+  uint32_t failed_allocs; // Every failed heap_caps allocation system wide
+  uint32_t last_failed_size;
+  uint32_t last_failed_caps;
+} sys_stats_snapshot_t;
+
+// Installs the failed allocation hook and starts the sampler task. Call
+// before other subsystems start so their tasks can be watched.
+void sys_stats_init(void);
+
+// Adds a task to the stack watch list by name. The task is looked up at
+// every sample, so it may come and go without being unwatched.
+void sys_stats_watch_task(const char *name, uint32_t stack_size);
+
+// Takes a sample now instead of waiting for the sampler
+void sys_stats_sample(void);
+void sys_stats_get_snapshot(sys_stats_snapshot_t *snapshot);
+void sys_stats_print(void);
+
+// True if the task's stack came within the warning margin
+bool sys_stats_task_low(const sys_stats_task_info_t *task);
+const char *sys_stats_tag_name(sys_stats_tag_t tag);
+const char *sys_stats_heap_name(sys_stats_heap_t heap);
+
+// Counted allocations. Blocks carry their tag and size, so they must be
+// released with sys_stats_free() and never with free().
+void *sys_stats_malloc(sys_stats_tag_t tag, size_t size);
+void *sys_stats_calloc(sys_stats_tag_t tag, size_t count, size_t size);
+void sys_stats_free(void *ptr);
+
+#endif // SYS_STATS_H
@@ -6,25 +6,57 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#define SYSTEM_MANAGER_MAX_TASKS 32
+#define SYSTEM_MANAGER_BUCKETS 16 // Must be a power of two
+
+// The profiler samples FreeRTOS run-time counters every interval and reports
+// CPU use over the last SYSTEM_PROFILE_WINDOW samples
+#define SYSTEM_PROFILE_INTERVAL_MS 1000
+#define SYSTEM_PROFILE_WINDOW 10
+#define SYSTEM_PROFILE_MAX_TASKS 48 // Every task in the system, not just ours
 
 typedef struct ManagedTask {
   TaskHandle_t task_handle;
   char task_name[16];
   UBaseType_t priority;
+  uint32_t stack_size;
+  bool in_use;
   void (*on_task_complete)(
       const char *task_name); // Callback when task completes
-  struct ManagedTask *next;
+  struct ManagedTask *next;   // Bucket chain, or free list when unused
 } ManagedTask;
 
+typedef struct {
+  char name[16];
+  eTaskState state;
+  UBaseType_t priority;
+  uint32_t stack_free;    // High-water mark in bytes
+  uint16_t cpu_permille;  // Share of all cores over the window
+  bool managed;           // Created through the system manager
+} system_task_profile_t;
+
 // Initialize the System Manager
 void system_manager_init();
 
-// Create a new task
+// Create a new task and track it by name. Names are unique among running
+// tasks; a task that already exited or was deleted frees its name.
+// handle_out may be NULL.
 bool system_manager_create_task(void (*task_function)(void *),
                                 const char *task_name, uint32_t stack_size,
-                                UBaseType_t priority,
+                                void *arg, UBaseType_t priority,
+                                TaskHandle_t *handle_out,
                                 void (*on_task_complete)(const char *));
 
+// Track a task that had to be created elsewhere (static or vendor tasks)
+bool system_manager_register_task(TaskHandle_t task_handle,
+                                  const char *task_name, uint32_t stack_size,
+                                  UBaseType_t priority);
+
+// Handle of a running managed task, NULL if none
+TaskHandle_t system_manager_get_task(const char *task_name);
+
 // Remove an existing task by name
 bool system_manager_remove_task(const char *task_name);
 
@@ -41,4 +73,15 @@ bool system_manager_set_task_priority(const char *task_name,
 // Print the list of all tasks
 void system_manager_list_tasks();
 
-#endif // SYSTEM_MANAGER_H
\ No newline at end of file
+// CPU profiler, needs CONFIG_GHOST_TASK_PROFILER
+bool system_manager_profiler_start(void);
+void system_manager_profiler_stop(void);
+bool system_manager_profiler_running(void);
+// Fills up to max entries sorted by CPU use, returns how many were filled.
+// *window_ms is the span the percentages cover, 0 until two samples exist.
+int system_manager_profile(system_task_profile_t *out, int max,
+                           uint32_t *window_ms);
+// Top-style table of every task
+void system_manager_print_top(void);
+
+#endif // SYSTEM_MANAGER_H
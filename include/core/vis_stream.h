@@ -0,0 +1,92 @@
+// vis_stream.h
+
+#ifndef VIS_STREAM_H
+#define VIS_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary audio visualizer packets sent to UDP port 6677 by the scripts in
+// scripts/Audio Visualizers. All fields are little-endian:
+//
+//   0  'G' 'V'        magic
+//   2  u8  version    VIS_PROTO_VERSION
+//   3  u8  flags      VIS_FLAG_*
+//   4  u16 seq        wraps
+//   6  u8  bands      band count, at most VIS_MAX_BANDS
+//   7  u8  reserved   0
+//   8  u32 ts_ms      sender clock
+//  12  u8  band[bands]
+//      then with VIS_FLAG_META: u8 len, track, u8 len, artist
+//
+// Packets are played out from a short jitter buffer in sequence order at
+// the sender's pace, so reordered or bursty packets no longer flicker.
+
+#define VIS_PROTO_VERSION 1
+#define VIS_HEADER_LEN 12
+#define VIS_MAX_BANDS 32
+#define VIS_MAX_NAME 32
+#define VIS_FLAG_META 0x01
+
+#define VIS_JITTER_SLOTS 8
+#define VIS_JITTER_DELAY_MS 60
+// A stream silent this long, or jumping this far in sequence, is restarted
+// by the next packet, the sender was most likely restarted
+#define VIS_STREAM_TIMEOUT_MS 2000
+#define VIS_STREAM_RESYNC 256
+// The clock offset is the lowest transit seen over the last one to two of
+// these, so it follows a sender clock drifting either way
+#define VIS_OFFSET_WINDOW_MS 2000
+
+typedef struct {
+  uint16_t seq;
+  uint32_t ts_ms;
+  uint8_t band_count;
+  uint8_t bands[VIS_MAX_BANDS];
+  bool has_meta;
+  char track[VIS_MAX_NAME + 1];
+  char artist[VIS_MAX_NAME + 1];
+} vis_packet_t;
+
+typedef struct {
+  uint32_t received;
+  uint32_t played;
+  uint32_t reordered; // Arrived after a later packet but still in time
+  uint32_t late;      // Arrived after its slot was played or skipped
+  uint32_t duplicates;
+  uint32_t lost;    // Skipped over, never played
+  uint32_t invalid; // Failed to parse
+} vis_jitter_stats_t;
+
+typedef struct {
+  vis_packet_t slots[VIS_JITTER_SLOTS];
+  bool used[VIS_JITTER_SLOTS];
+  bool started;
+  uint16_t next_seq;    // Next sequence number to play
+  uint16_t highest_seq; // Highest received
+  int32_t offset_ms;    // Local minus sender clock, lowest recently seen
+  int32_t offset_prev;  // Lowest in the previous offset window
+  int32_t offset_cur;   // Lowest in the current offset window
+  uint32_t offset_window_ms; // When the current offset window started
+  uint32_t last_rx_ms;
+  uint32_t delay_ms;
+  vis_jitter_stats_t stats;
+} vis_jitter_t;
+
+// False if buf is not a complete packet of this version
+bool vis_packet_parse(const uint8_t *buf, size_t len, vis_packet_t *pkt);
+
+void vis_jitter_init(vis_jitter_t *jb, uint32_t delay_ms);
+// Queues a packet received at now_ms, false if it was late or a duplicate
+bool vis_jitter_push(vis_jitter_t *jb, const vis_packet_t *pkt,
+                     uint32_t now_ms);
+// Takes the next packet due at now_ms, skipping missing ones whose slot
+// has passed. Call until it returns false.
+bool vis_jitter_pop(vis_jitter_t *jb, uint32_t now_ms, vis_packet_t *out);
+
+// Maps bands onto out_count bars, each bar the loudest band it covers
+void vis_resample_bands(const uint8_t *bands, uint8_t count, uint8_t *out,
+                        uint8_t out_count);
+
+#endif // VIS_STREAM_H
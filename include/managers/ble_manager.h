@@ -1,35 +1,69 @@
 #ifndef BLE_MANAGER_H
 #define BLE_MANAGER_H
 
+#include "core/ble_adv_parse.h"
 #include "esp_err.h"
 #include <stddef.h>
 #include <stdint.h>
 
-#define MAX_UUID16 10
-#define MAX_UUID32 5
-#define MAX_UUID128 3
-#define MAX_PAYLOADS                                                           \
-  10 // Maximum number of similar payloads to consider as spam
-#define PAYLOAD_COMPARE_LEN                                                    \
-  20 // Length of the payload to compare for similarity
-#define TIME_WINDOW_MS 3000
-
 #ifndef CONFIG_IDF_TARGET_ESP32S2
 
-typedef void (*ble_data_handler_t)(struct ble_gap_event *event, size_t len);
+// Handlers receive the advertisement already parsed; the record and the
+// event are only valid for the duration of the call.
+typedef void (*ble_data_handler_t)(struct ble_gap_event *event,
+                                   const ble_adv_record_t *adv);
+
+#define BLE_FILTER_MAX_UUIDS 4
+
+// Which fields of ble_adv_filter_t are checked, unset fields match anything
+#define BLE_FILTER_COMPANY_ID (1 << 0) // Manufacturer data with company_id
+#define BLE_FILTER_UUID16 (1 << 1)     // Any of uuid16[] in any UUID list
+#define BLE_FILTER_ADDR_TYPE (1 << 2)  // Address type bit set in addr_types
+#define BLE_FILTER_HAS_MFG (1 << 3)    // Any manufacturer data
+#define BLE_FILTER_HAS_NAME (1 << 4)   // Short or complete local name
 
 typedef struct {
-  uint16_t uuid16[MAX_UUID16];
-  int uuid16_count;
+  uint8_t match;
+  uint16_t company_id;
+  uint16_t uuid16[BLE_FILTER_MAX_UUIDS];
+  uint8_t uuid16_count;
+  uint8_t addr_types; // Bitmask of (1 << BLE_ADV_ADDR_*)
+} ble_adv_filter_t;
 
-  uint32_t uuid32[MAX_UUID32];
-  int uuid32_count;
+// Scan timing per mode. Interval and window are in 0.625 ms units.
+typedef enum {
+  BLE_SCAN_PROFILE_GENERAL = 0,
+  BLE_SCAN_PROFILE_DISCOVERY, // Wardriving, finders: most unique devices
+  BLE_SCAN_PROFILE_TRACKING,  // Skimmers, selected Flipper: repeated RSSI
+  BLE_SCAN_PROFILE_CAPTURE,   // PCAP and raw dumps: every advertisement
+  BLE_SCAN_PROFILE_SPAM,      // Spam detector: every advertisement, quiet
+  BLE_SCAN_PROFILE_COUNT,
+} ble_scan_profile_id_t;
 
-  char uuid128[MAX_UUID128][37];
-  int uuid128_count;
-} ble_service_uuids_t;
+typedef struct {
+  const char *name;
+  uint16_t itvl;
+  uint16_t window;
+  bool passive;
+  bool filter_duplicates;
+} ble_scan_profile_t;
+
+typedef struct {
+  const char *profile;
+  uint8_t duty_pct;
+  uint32_t elapsed_ms;
+  uint32_t adverts_total;
+  uint32_t adverts_last_sec;
+  uint32_t unique_last_sec;
+  uint32_t peak_unique_per_sec;
+  uint32_t unique_total; // Estimated, saturates around BLE_SCAN_UNIQUE_BITS
+} ble_scan_stats_t;
 
+// Registers a handler that sees every advertisement
 esp_err_t ble_register_handler(ble_data_handler_t handler);
+// Registers a handler that is only called for advertisements matching filter
+esp_err_t ble_register_handler_filtered(ble_data_handler_t handler,
+                                        const ble_adv_filter_t *filter);
 esp_err_t ble_unregister_handler(ble_data_handler_t handler);
 void ble_init(void);
 void ble_start_find_flippers(void);
@@ -40,6 +74,9 @@ void ble_start_raw_ble_packetscan(void);
 void ble_start_blespam_detector(void);
 void ble_start_capture(void);
 void ble_start_scanning(void);
+void ble_start_scanning_profile(ble_scan_profile_id_t profile);
+void ble_get_scan_stats(ble_scan_stats_t *stats);
+void ble_print_scan_stats(void);
 void ble_start_skimmer_detection(void);
 void ble_stop_skimmer_detection(void);
 
@@ -0,0 +1,103 @@
+#ifndef BLE_REGISTRY_H
+#define BLE_REGISTRY_H
+
+#include "core/ble_adv_parse.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_REGISTRY_CAPACITY 64      // Devices tracked per registry
+#define BLE_REGISTRY_BUCKETS 32       // Hash buckets, must be a power of two
+#define BLE_REGISTRY_RSSI_HISTORY 8   // RSSI samples kept per device
+#define BLE_REGISTRY_MAX_UUIDS 4      // 16-bit service UUIDs kept per device
+#define BLE_REGISTRY_MAX_PAYLOAD 31   // Legacy advertising payload
+#define BLE_REGISTRY_AGE_INTERVAL_MS 1000
+// A resolvable private address that reappears under a new address is only
+// folded into the old entry if the old address went quiet for this long,
+// so two identical devices advertising side by side stay separate.
+#define BLE_REGISTRY_ROTATION_QUIET_MS 2000
+
+typedef struct {
+  bool in_use;
+  uint8_t addr[6];
+  uint8_t addr_type;
+  uint8_t kind;       // Caller defined, e.g. Flipper colour
+  uint16_t rotations; // Address changes folded into this entry
+
+  uint32_t first_seen_ms;
+  uint32_t last_seen_ms;
+  uint32_t payload_hash;
+  uint32_t identity_hash; // Stable across address rotation, 0 if unknown
+
+  int8_t rssi_history[BLE_REGISTRY_RSSI_HISTORY];
+  uint8_t rssi_head;
+  uint8_t rssi_count;
+
+  uint16_t uuid16[BLE_REGISTRY_MAX_UUIDS];
+  uint8_t uuid16_count;
+
+  char name[BLE_ADV_MAX_NAME];
+  uint8_t payload[BLE_REGISTRY_MAX_PAYLOAD];
+  uint8_t payload_len;
+
+  int16_t next;    // Address bucket chain, or free list
+  int16_t id_next; // Identity bucket chain
+} ble_registry_entry_t;
+
+typedef struct {
+  uint32_t lookups;
+  uint32_t probes;
+  uint32_t inserts;
+  uint32_t rotations;
+  uint32_t aged_out;
+  uint32_t evicted;
+} ble_registry_stats_t;
+
+// Fixed-size device table keyed by address. Entries live in a preallocated
+// pool chained from hash buckets, stale entries are aged out and the least
+// recently seen device is evicted when the pool is full.
+typedef struct {
+  ble_registry_entry_t entries[BLE_REGISTRY_CAPACITY];
+  int16_t buckets[BLE_REGISTRY_BUCKETS];
+  int16_t id_buckets[BLE_REGISTRY_BUCKETS];
+  int16_t free_head;
+  uint16_t count;
+  uint32_t stale_ms;
+  uint32_t last_age_ms;
+  ble_registry_stats_t stats;
+  SemaphoreHandle_t lock;
+} ble_registry_t;
+
+void ble_registry_init(ble_registry_t *reg, uint32_t stale_ms);
+void ble_registry_clear(ble_registry_t *reg);
+
+// Entry pointers are only valid while the registry is locked
+void ble_registry_lock(ble_registry_t *reg);
+void ble_registry_unlock(ble_registry_t *reg);
+
+// Records a sighting and returns its entry (never NULL). identity_hash links
+// rotating private addresses of the same device, pass 0 when the advert has
+// nothing stable to key on. *is_new is set when the device was not known.
+ble_registry_entry_t *ble_registry_observe(ble_registry_t *reg,
+                                           const ble_adv_record_t *adv,
+                                           uint32_t identity_hash,
+                                           bool *is_new);
+ble_registry_entry_t *ble_registry_find(ble_registry_t *reg,
+                                        const uint8_t *addr);
+// Slot based access for list/select commands, NULL for unused slots
+ble_registry_entry_t *ble_registry_get(ble_registry_t *reg, int index);
+int ble_registry_index(const ble_registry_t *reg,
+                       const ble_registry_entry_t *entry);
+
+// Drops entries not seen for stale_ms, returns how many were removed
+size_t ble_registry_age(ble_registry_t *reg, uint32_t now_ms);
+
+int8_t ble_registry_rssi_latest(const ble_registry_entry_t *entry);
+int8_t ble_registry_rssi_average(const ble_registry_entry_t *entry);
+
+uint32_t ble_registry_hash(const uint8_t *data, size_t len, uint32_t seed);
+uint32_t ble_registry_now_ms(void);
+
+#endif // BLE_REGISTRY_H
@@ -0,0 +1,65 @@
+#ifndef BLE_SPAM_DETECTOR_H
+#define BLE_SPAM_DETECTOR_H
+
+#include "core/ble_adv_parse.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sliding window made of BLE_SPAM_SLOTS slots of BLE_SPAM_SLOT_MS each
+#define BLE_SPAM_SLOT_MS 500
+#define BLE_SPAM_SLOTS 6 // 3 second window
+// Count-min sketch shape, width must be a power of two
+#define BLE_SPAM_SKETCH_DEPTH 3
+#define BLE_SPAM_SKETCH_WIDTH 32
+// Bits per slot for the (key, address) seen filter used to count senders.
+// Every slot indexes the same bit space, so the window holds at most this
+// many pairs. New senders that land on a bit already set are made up for
+// by weighting the ones that don't (linear counting). Sized so a 1500
+// adverts/s flood, about the most a scan receives, leaves a tenth free.
+#define BLE_SPAM_SEEN_BITS 4096
+#define BLE_SPAM_MAX_ALERTS 8
+#define BLE_SPAM_REPORT_INTERVAL_MS 5000
+
+// Thresholds are distinct senders within one window. Spoofing tools use a
+// fresh address for nearly every advert, while real devices repeat theirs,
+// so a key only counts as flooding when most of its adverts come from new
+// addresses. A single chatty device is one sender and never trips this.
+#define BLE_SPAM_MIN_CHURN_PCT 50
+#define BLE_SPAM_LOW_SENDERS 10
+#define BLE_SPAM_MEDIUM_SENDERS 25
+#define BLE_SPAM_HIGH_SENDERS 60
+
+typedef enum {
+  BLE_SPAM_NONE = 0,
+  BLE_SPAM_LOW,
+  BLE_SPAM_MEDIUM,
+  BLE_SPAM_HIGH,
+} ble_spam_severity_t;
+
+typedef struct {
+  ble_spam_severity_t severity;
+  bool by_layout;   // Flagged on the payload layout rather than company ID
+  bool has_company; // company_id is valid
+  uint16_t company_id;
+  uint32_t rate;    // Adverts in the window
+  uint32_t senders; // Distinct addresses in the window
+} ble_spam_verdict_t;
+
+typedef struct {
+  uint32_t adverts;
+  uint32_t reports;
+  ble_spam_severity_t peak;
+} ble_spam_stats_t;
+
+void ble_spam_detector_reset(void);
+
+// Feeds one advert into the window. Returns true when a verdict should be
+// reported: the key crossed into a higher severity or is still flooding
+// after BLE_SPAM_REPORT_INTERVAL_MS.
+bool ble_spam_detector_observe(const ble_adv_record_t *adv, uint32_t now_ms,
+                               ble_spam_verdict_t *verdict);
+
+void ble_spam_detector_get_stats(ble_spam_stats_t *stats);
+const char *ble_spam_severity_name(ble_spam_severity_t severity);
+
+#endif // BLE_SPAM_DETECTOR_H
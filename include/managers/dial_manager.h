@@ -29,6 +29,8 @@ const char *get_app_path(DIALAppType app);
 
 bool launch_app(DIALManager *manager, DIALAppType app, const char *appUrl);
 
+// Discovers devices, probes them in parallel on a few reused HTTP clients,
+// then casts a video to each one with YouTube running
 void explore_network(DIALManager *manager);
 
 char *get_dial_application_url(const char *location_url);
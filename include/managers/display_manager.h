@@ -79,8 +79,32 @@ void lvgl_tick_task(void *arg);
 
 void hardware_input_task(void *pvParameters);
 
+/**
+ * @brief Declare the static background of the active screen. Views draw on
+ * transparent containers over it, so it is only repainted under what they
+ * invalidate, and setting the same color again invalidates nothing.
+ */
 void display_manager_fill_screen(lv_color_t color);
 
+// Two dirty areas are flushed as one when their bounding box costs at most
+// this many pixels more than the two areas alone
+#define DISPLAY_MERGE_SLACK_PX 1024
+
+typedef struct {
+  uint32_t frames;      // Refreshes that drew something
+  uint32_t areas;       // Invalidated areas before joining
+  uint32_t merged;      // Areas folded into a neighbour by the merge pass
+  uint64_t px_rendered; // Pixels rendered and flushed
+  uint32_t render_ms;   // Time spent in refreshes
+  uint32_t since_ms;    // Tick the counters were reset at
+} display_render_stats_t;
+
+void display_manager_get_render_stats(display_render_stats_t *stats);
+void display_manager_reset_render_stats(void);
+// Prints every invalidated area per frame to the serial console
+void display_manager_set_render_trace(bool enabled);
+void display_manager_print_render_stats(void);
+
 lv_color_t hex_to_lv_color(const char *hex_str);
 
 // Status Bar Functions
@@ -0,0 +1,67 @@
+// printer_manager.h
+
+#ifndef PRINTER_MANAGER_H
+#define PRINTER_MANAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PRINTER_PORT 9100
+#define PRINTER_QUEUE_LENGTH 8
+#define PRINTER_CONNECT_TIMEOUT_MS 3000
+#define PRINTER_SEND_TIMEOUT_MS 5000
+// The connection is kept open for jobs that follow and closed once the
+// queue has been empty this long
+#define PRINTER_IDLE_CLOSE_MS 10000
+// Jobs queued for the same printer are sent as one stream, up to this many
+#define PRINTER_BATCH_MAX 4
+#define PRINTER_STREAM_LEN 4096
+#define PRINTER_MAX_TEXT 256
+
+typedef enum { PRINTER_JOB_TEXT, PRINTER_JOB_EJECT } printer_job_type_t;
+
+typedef struct {
+  uint32_t id; // Set by the manager
+  printer_job_type_t type;
+  char ip[16];
+  char text[PRINTER_MAX_TEXT + 1];
+  char alignment[16];
+  int font_px;
+  int pages; // Blank pages to eject
+} printer_job_t;
+
+typedef enum {
+  PRINTER_JOB_SENT,           // Every byte was accepted by the printer
+  PRINTER_JOB_CONNECT_FAILED, // No connection within the timeout
+  PRINTER_JOB_SEND_FAILED,    // Connection dropped and the retry failed
+} printer_job_status_t;
+
+// Called from the printer task once per job
+typedef void (*printer_job_cb_t)(const printer_job_t *job,
+                                 printer_job_status_t status, void *ctx);
+
+typedef struct {
+  uint32_t queued;
+  uint32_t sent;
+  uint32_t failed;
+  uint32_t connects; // Connections opened, the rest reused one
+  uint32_t batches;  // Streams sent, one or more jobs each
+  uint32_t bytes;
+} printer_manager_stats_t;
+
+// Call once at boot, before anything submits
+void printer_manager_init(void);
+
+// Queues a job for the printer task, started on first use. Returns the job
+// id, or 0 if the queue is full. Status is reported to the terminal and the
+// callback once the job was sent or failed.
+uint32_t printer_manager_submit(const printer_job_t *job);
+
+// Replaces the status callback, NULL for terminal output only
+void printer_manager_set_callback(printer_job_cb_t cb, void *ctx);
+
+void printer_manager_get_stats(printer_manager_stats_t *stats);
+
+const char *printer_job_status_name(printer_job_status_t status);
+
+#endif // PRINTER_MANAGER_H
@@ -5,6 +5,18 @@
 #include "driver/sdmmc_types.h"
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+// Mount allows the append cache handles plus PCAP/GPS/portal files
+#define SD_CARD_MAX_OPEN_FILES 8
+
+// Append cache tuning
+#define SD_IO_MAX_HANDLES 4
+#define SD_IO_MAX_PATH_LEN 128
+#define SD_IO_BUFFER_SIZE 2048
+#define SD_IO_FLUSH_INTERVAL_MS 500
+#define SD_IO_FLUSH_AGE_MS 2000
+#define SD_IO_IDLE_CLOSE_MS 30000
 
 typedef struct {
   sdmmc_card_t *card;
@@ -23,11 +35,33 @@ typedef struct {
   int spi_clk_pin;
 } sd_card_manager_t;
 
+typedef struct {
+  uint32_t append_calls;
+  uint32_t handle_hits;
+  uint32_t handle_misses;
+  uint32_t evictions;
+  uint32_t physical_writes;
+  uint32_t size_flushes;
+  uint32_t age_flushes;
+  uint32_t sync_flushes;
+  uint32_t write_errors;
+  uint64_t bytes_appended;
+  uint64_t bytes_written;
+} sd_io_stats_t;
+
 extern sd_card_manager_t sd_card_manager;
 
 esp_err_t sd_card_init();
 void sd_card_unmount(void);
 esp_err_t sd_card_append_file(const char *path, const void *data, size_t size);
+// Flush buffered appends for path (or every cached file when path is NULL)
+// and fsync them, so they survive a power cut once this returns ESP_OK
+esp_err_t sd_card_sync(const char *path);
+// Flush and close the cached handle for path (or all when path is NULL)
+esp_err_t sd_card_close_cached(const char *path);
+void sd_card_get_io_stats(sd_io_stats_t *stats);
+void sd_card_reset_io_stats(void);
+void sd_card_print_io_stats(void);
 esp_err_t sd_card_write_file(const char *path, const void *data, size_t size);
 esp_err_t sd_card_read_file(const char *path);
 esp_err_t sd_card_create_directory(const char *path);
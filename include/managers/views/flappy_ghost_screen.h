@@ -8,7 +8,6 @@ void flappy_bird_view_destroy(void);
 void flappy_bird_view_hardwareinput_callback(InputEvent *event);
 void flappy_bird_view_get_hardwareinput_callback(void **callback);
 void flappy_bird_game_loop(lv_timer_t *timer);
-int flappy_bird_check_collision(lv_obj_t *bird, lv_obj_t *pipe);
 void flappy_bird_game_over();
 void flappy_bird_restart();
 
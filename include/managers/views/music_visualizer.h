@@ -9,7 +9,7 @@
 typedef struct {
   lv_obj_t *track_label;
   lv_obj_t *artist_label;
-  lv_obj_t *bars[NUM_BARS];
+  lv_obj_t *bars; // Draws every bar
 } MusicVisualizerView;
 
 void music_visualizer_view_create();
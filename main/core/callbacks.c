@@ -1,4 +1,7 @@
 #include "core/callbacks.h"
+#include "core/capture_stats.h"
+#include "core/ieee80211_parse.h"
+#include "core/system_manager.h"
 #include "esp_wifi.h"
 #include "managers/gps_manager.h"
 #include "managers/rgb_manager.h"
@@ -26,23 +29,15 @@
 #define WIFI_PKT_EAPOL 0x80
 #define ESP_WIFI_VENDOR_METADATA_LEN 8 // Channel(1) + RSSI(1) + Rate(1) + Timestamp(4) + Noise(1)
 #define MIN_SSIDS_FOR_DETECTION 2 // Minimum SSIDs needed to flag as PineAP
-#define MAX_PINEAP_NETWORKS 20
-#define MAX_SSIDS_PER_BSSID 10
 #define MAX_WIFI_CHANNEL 13
 #define CHANNEL_HOP_INTERVAL_MS 200
-#define RECENT_SSID_COUNT 5
-#define LOG_DELAY_MS 5000
-static pineap_network_t pineap_networks[MAX_PINEAP_NETWORKS];
-static int pineap_network_count = 0;
+#define PINEAP_REPORT_INTERVAL_MS 30000 // Re-report a known PineAP at most this often
 static bool pineap_detection_active = false;
 static uint8_t current_channel = 1;
 static esp_timer_handle_t channel_hop_timer = NULL;
-static uint32_t hash_ssid(const char *ssid);
-static bool ssid_hash_exists(pineap_network_t *network, uint32_t hash);
 static void trim_trailing(char *str);
 static bool compare_bssid(const uint8_t *bssid1, const uint8_t *bssid2);
 static bool is_beacon_packet(const wifi_promiscuous_pkt_t *pkt);
-static const char *SKIMMER_TAG STORE_STR_ATTR = "SKIMMER_DETECT";
 static const char *suspicious_names[] STORE_DATA_ATTR = {
     "HC-03", "HC-05", "HC-06",  "HC-08",    "BT-HC05", "JDY-31",
     "AT-09", "HM-10", "CC41-A", "MLT-BT05", "SPP-CA",  "FFD0"};
@@ -53,59 +48,6 @@ esp_timer_handle_t stop_timer;
 int should_store_wps = 1;
 gps_t *gps = NULL;
 extern RGBManager_t rgb_manager;
-typedef struct {
-    uint8_t bssid[6];
-    time_t detection_time;
-    time_t last_update_time;
-} blacklisted_ap_t;
-
-static blacklisted_ap_t blacklist[MAX_PINEAP_NETWORKS];
-static int blacklist_count = 0;
-
-static bool is_blacklisted(const uint8_t *bssid) {
-    for (int i = 0; i < blacklist_count; i++) {
-        if (memcmp(blacklist[i].bssid, bssid, 6) == 0) {
-            return true;
-        }
-    }
-    return false;
-}
-
-static bool should_update_blacklisted(const uint8_t *bssid) {
-    for (int i = 0; i < blacklist_count; i++) {
-        if (memcmp(blacklist[i].bssid, bssid, 6) == 0) {
-            time_t current_time = time(NULL);
-            // Allow updates every 30 seconds
-            if (current_time - blacklist[i].last_update_time >= 30) {
-                blacklist[i].last_update_time = current_time;
-                return true;
-            }
-            return false;
-        }
-    }
-    return false;
-}
-
-static void add_to_blacklist(const uint8_t *bssid) {
-    time_t current_time = time(NULL);
-
-    // First check if BSSID exists
-    for (int i = 0; i < blacklist_count; i++) {
-        if (memcmp(blacklist[i].bssid, bssid, 6) == 0) {
-            blacklist[i].last_update_time = current_time;
-            return;
-        }
-    }
-
-    // If not found and we have space, add new entry
-    if (blacklist_count < MAX_PINEAP_NETWORKS) {
-        memcpy(blacklist[blacklist_count].bssid, bssid, 6);
-        blacklist[blacklist_count].detection_time = current_time;
-        blacklist[blacklist_count].last_update_time = current_time;
-        blacklist_count++;
-    }
-}
-
 
 static void channel_hop_timer_callback(void *arg) {
     if (!pineap_detection_active)
@@ -134,54 +76,162 @@ static void stop_channel_hopping(void) {
     }
 }
 
-static pineap_network_t *find_or_create_network(const uint8_t *bssid) {
-    for (int i = 0; i < pineap_network_count; i++) {
-        if (compare_bssid(pineap_networks[i].bssid, bssid)) {
-            return &pineap_networks[i];
+// BSSID-keyed table: entries come from a fixed pool and are chained from
+// PINEAP_BUCKET_COUNT buckets, so a lookup only touches the few entries that
+// share a bucket instead of scanning every tracked network.
+static pineap_network_t pineap_pool[PINEAP_TABLE_SIZE];
+static int16_t pineap_buckets[PINEAP_BUCKET_COUNT];
+static int16_t pineap_free_head = -1;
+static int pineap_network_count = 0;
+
+static QueueHandle_t pineap_report_queue = NULL;
+static TaskHandle_t pineap_reporter_handle = NULL;
+static pineap_stats_t pineap_stats;
+
+static uint32_t hash_bssid(const uint8_t *bssid) {
+    return ieee80211_mac_hash(bssid) & (PINEAP_BUCKET_COUNT - 1);
+}
+
+static void pineap_table_reset(void) {
+    memset(pineap_pool, 0, sizeof(pineap_pool));
+    for (int i = 0; i < PINEAP_BUCKET_COUNT; i++) {
+        pineap_buckets[i] = -1;
+    }
+    for (int i = 0; i < PINEAP_TABLE_SIZE; i++) {
+        pineap_pool[i].next = (i + 1 < PINEAP_TABLE_SIZE) ? i + 1 : -1;
+    }
+    pineap_free_head = 0;
+    pineap_network_count = 0;
+}
+
+static void pineap_table_unlink(int16_t index) {
+    int16_t *link = &pineap_buckets[hash_bssid(pineap_pool[index].bssid)];
+    while (*link != -1) {
+        if (*link == index) {
+            *link = pineap_pool[index].next;
+            break;
+        }
+        link = &pineap_pool[*link].next;
+    }
+    pineap_pool[index].ssid_count = 0;
+    pineap_pool[index].is_pineap = false;
+    pineap_pool[index].next = pineap_free_head;
+    pineap_free_head = index;
+    pineap_network_count--;
+}
+
+// Pool exhausted: recycle the entry seen least recently, preferring ones
+// that were never flagged so confirmed PineAPs keep their SSID history.
+static void pineap_table_evict(void) {
+    int16_t victim = -1;
+    bool victim_flagged = true;
+
+    for (int16_t i = 0; i < PINEAP_TABLE_SIZE; i++) {
+        pineap_network_t *entry = &pineap_pool[i];
+        if (victim == -1 || (victim_flagged && !entry->is_pineap) ||
+            (entry->is_pineap == victim_flagged &&
+             entry->last_seen_us < pineap_pool[victim].last_seen_us)) {
+            victim = i;
+            victim_flagged = entry->is_pineap;
         }
     }
 
-    // If not found and we have space, create new entry
-    if (pineap_network_count < MAX_PINEAP_NETWORKS) {
-        pineap_network_t *network = &pineap_networks[pineap_network_count++];
-        memcpy(network->bssid, bssid, 6);
-        network->ssid_count = 0;
-        network->is_pineap = false;
-        network->first_seen = time(NULL);
-        return network;
+    if (victim != -1) {
+        pineap_table_unlink(victim);
+        pineap_stats.evictions++;
     }
+}
 
-    return NULL;
+static pineap_network_t *find_or_create_network(const uint8_t *bssid, int64_t now) {
+    uint32_t bucket = hash_bssid(bssid);
+
+    for (int16_t i = pineap_buckets[bucket]; i != -1; i = pineap_pool[i].next) {
+        if (compare_bssid(pineap_pool[i].bssid, bssid)) {
+            return &pineap_pool[i];
+        }
+    }
+
+    if (pineap_free_head == -1) {
+        pineap_table_evict();
+        if (pineap_free_head == -1) {
+            return NULL;
+        }
+    }
+
+    int16_t index = pineap_free_head;
+    pineap_network_t *network = &pineap_pool[index];
+    pineap_free_head = network->next;
+
+    memset(network, 0, sizeof(*network));
+    memcpy(network->bssid, bssid, 6);
+    network->first_seen_us = now;
+    network->next = pineap_buckets[bucket];
+    pineap_buckets[bucket] = index;
+    pineap_network_count++;
+    return network;
 }
 
+// djb2 over the lowercased SSID so case variants count as one network name.
+// Zero marks an empty slot in the SSID set, so it is never returned.
 static uint32_t hash_ssid(const char *ssid) {
     uint32_t hash = 5381;
     int c;
-    while ((c = *ssid++))
-        hash = ((hash << 5) + hash) + c; // hash * 33 + c
-    return hash;
+    while ((c = (unsigned char)*ssid++))
+        hash = ((hash << 5) + hash) + tolower(c); // hash * 33 + c
+    return hash ? hash : 1;
 }
 
-static bool ssid_hash_exists(pineap_network_t *network, uint32_t hash) {
-    for (int i = 0; i < network->ssid_count; i++) {
-        if (network->ssid_hashes[i] == hash) {
+// Inserts hash into the BSSID's open-addressed SSID set. Returns true only
+// when the hash was not present and there was room for it.
+static bool ssid_set_insert(pineap_network_t *network, uint32_t hash) {
+    if (network->ssid_count >= MAX_SSIDS_PER_BSSID) {
+        return false;
+    }
+
+    uint32_t slot = hash & (PINEAP_SSID_SET_SIZE - 1);
+    for (int probe = 0; probe < PINEAP_SSID_SET_SIZE; probe++) {
+        if (network->ssid_set[slot] == hash) {
+            return false;
+        }
+        if (network->ssid_set[slot] == 0) {
+            network->ssid_set[slot] = hash;
+            network->ssid_count++;
             return true;
         }
+        slot = (slot + 1) & (PINEAP_SSID_SET_SIZE - 1);
     }
     return false;
 }
 
-void start_pineap_detection(void) {
-    pineap_detection_active = true;
-    pineap_network_count = 0;
-    memset(pineap_networks, 0, sizeof(pineap_networks));
-    current_channel = 1;
-    start_channel_hopping();
+static bool ssid_set_contains(const pineap_network_t *network, uint32_t hash) {
+    uint32_t slot = hash & (PINEAP_SSID_SET_SIZE - 1);
+    for (int probe = 0; probe < PINEAP_SSID_SET_SIZE; probe++) {
+        if (network->ssid_set[slot] == hash) {
+            return true;
+        }
+        if (network->ssid_set[slot] == 0) {
+            return false;
+        }
+        slot = (slot + 1) & (PINEAP_SSID_SET_SIZE - 1);
+    }
+    return false;
 }
 
-void stop_pineap_detection(void) {
-    pineap_detection_active = false;
-    stop_channel_hopping();
+// Evil twin: another BSSID that has advertised the same first SSID
+static const pineap_network_t *find_evil_twin(const pineap_network_t *network) {
+    if (network->first_ssid_hash == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < PINEAP_TABLE_SIZE; i++) {
+        const pineap_network_t *other = &pineap_pool[i];
+        if (other == network || other->ssid_count == 0) {
+            continue;
+        }
+        if (ssid_set_contains(other, network->first_ssid_hash)) {
+            return other;
+        }
+    }
+    return NULL;
 }
 
 #define IRAM_PRINTF(fmt, ...) do { \
@@ -189,209 +239,220 @@ void stop_pineap_detection(void) {
     esp_rom_printf(flash_fmt, ##__VA_ARGS__); \
 } while(0)
 
-void log_pineap_detection(void *arg) {
-    pineap_log_data_t *log_data = (pineap_log_data_t *)arg;
-    pineap_network_t *network = log_data->network;
-
-    vTaskDelay(pdMS_TO_TICKS(5000));
-
+static void pineap_report_detection(const pineap_detection_t *detection) {
     char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x", log_data->bssid[0],
-             log_data->bssid[1], log_data->bssid[2], log_data->bssid[3], log_data->bssid[4],
-             log_data->bssid[5]);
+    snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x", detection->bssid[0],
+             detection->bssid[1], detection->bssid[2], detection->bssid[3], detection->bssid[4],
+             detection->bssid[5]);
 
     // Build SSIDs string, filtering out empty SSIDs
     char ssids_str[256] = {0};
     int valid_ssid_count = 0;
 
-    // Use the most up-to-date SSIDs from the network structure
-    for (int i = 0; i < network->ssid_count && i < RECENT_SSID_COUNT; i++) {
-        if (strlen(network->recent_ssids[i]) > 0) {
+    for (int i = 0; i < RECENT_SSID_COUNT; i++) {
+        if (detection->recent_ssids[i][0] != '\0') {
             if (valid_ssid_count > 0)
-                strcat(ssids_str, ", ");
-            strcat(ssids_str, network->recent_ssids[i]);
+                strncat(ssids_str, ", ", sizeof(ssids_str) - strlen(ssids_str) - 1);
+            strncat(ssids_str, detection->recent_ssids[i],
+                    sizeof(ssids_str) - strlen(ssids_str) - 1);
             valid_ssid_count++;
         }
     }
 
-    // Only log if we have valid SSIDs
-    if (valid_ssid_count >= MIN_SSIDS_FOR_DETECTION) {
-        // Pulse RGB purple (red + blue) to indicate Pineapple detection
-        pulse_once(&rgb_manager, 255, 0, 255);
-
-        IRAM_PRINTF("\nPineapple detected!\nBSSID: %02x:%02x:%02x:%02x:%02x:%02x\n", 
-                   log_data->bssid[0], log_data->bssid[1], log_data->bssid[2],
-                   log_data->bssid[3], log_data->bssid[4], log_data->bssid[5]);
-        IRAM_PRINTF("Channel: %d\n", network->last_channel);
-        IRAM_PRINTF("RSSI: %d\n", network->last_rssi);
-        IRAM_PRINTF("SSIDs (%d): %s\n", valid_ssid_count, ssids_str);
-
-        // Evil Twin Detection: Check for same SSID from different BSSIDs
-        for (int i = 0; i < pineap_network_count; i++) {
-            if (i != (network - pineap_networks) && // Skip self
-                strcasecmp(network->recent_ssids[0], pineap_networks[i].recent_ssids[0]) == 0) {
-                IRAM_PRINTF("Evil Twin:\nSSID '%.100s'\nBSSID %.17s vs %.100s\n",
-                           network->recent_ssids[0], mac_str, pineap_networks[i].bssid);
-                TERMINAL_VIEW_ADD_TEXT(
-                    "Evil Twin Detected:\nSame SSID '%.100s'\nfrom BSSID %.17s and\n%.100s\n",
-                    network->recent_ssids[0], mac_str, pineap_networks[i].bssid);
-            }
-        }
+    if (valid_ssid_count < MIN_SSIDS_FOR_DETECTION)
+        return;
 
-        TERMINAL_VIEW_ADD_TEXT("\nPineapple detected!\n");
-        TERMINAL_VIEW_ADD_TEXT("BSSID: %s\n", mac_str);
-        TERMINAL_VIEW_ADD_TEXT("Channel: %d\n", network->last_channel);
-        TERMINAL_VIEW_ADD_TEXT("RSSI: %d\n", network->last_rssi);
-        TERMINAL_VIEW_ADD_TEXT("SSIDs (%d): %s\n", valid_ssid_count, ssids_str);
+    // Pulse RGB purple (red + blue) to indicate Pineapple detection
+    pulse_once(&rgb_manager, 255, 0, 255);
+
+    IRAM_PRINTF("\nPineapple detected!\nBSSID: %s\n", mac_str);
+    IRAM_PRINTF("Channel: %d\n", detection->channel);
+    IRAM_PRINTF("RSSI: %d\n", detection->rssi);
+    IRAM_PRINTF("SSIDs (%d total): %s\n", detection->ssid_count, ssids_str);
+
+    if (detection->has_twin) {
+        char twin_str[18];
+        snprintf(twin_str, sizeof(twin_str), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 detection->twin_bssid[0], detection->twin_bssid[1], detection->twin_bssid[2],
+                 detection->twin_bssid[3], detection->twin_bssid[4], detection->twin_bssid[5]);
+        IRAM_PRINTF("Evil Twin:\nSSID '%.100s'\nBSSID %.17s vs %.17s\n",
+                    detection->recent_ssids[0], mac_str, twin_str);
+        TERMINAL_VIEW_ADD_TEXT("Evil Twin Detected:\nSame SSID '%.100s'\nfrom BSSID %.17s and\n%.17s\n",
+                               detection->recent_ssids[0], mac_str, twin_str);
     }
 
-    free(log_data);
-    network->log_task_handle = NULL; // Clear handle before deletion
-    vTaskDelete(NULL);
+    TERMINAL_VIEW_ADD_TEXT("\nPineapple detected!\n");
+    TERMINAL_VIEW_ADD_TEXT("BSSID: %s\n", mac_str);
+    TERMINAL_VIEW_ADD_TEXT("Channel: %d\n", detection->channel);
+    TERMINAL_VIEW_ADD_TEXT("RSSI: %d\n", detection->rssi);
+    TERMINAL_VIEW_ADD_TEXT("SSIDs (%d total): %s\n", detection->ssid_count, ssids_str);
 }
 
-static void start_log_task(pineap_network_t *network, const char *new_ssid, int8_t channel,
-                           int8_t rssi) {
-    // Check if a task is already running
-    if (network->log_task_handle != NULL) {
-        TaskHandle_t existing_handle = network->log_task_handle;
-        network->log_task_handle = NULL; // Clear it first to avoid race conditions
-        vTaskDelete(existing_handle);    // Clean up existing task
+// Single long-lived task that owns all detection output, so the sniffer
+// callback only has to copy a snapshot into the queue.
+static void pineap_reporter_task(void *arg) {
+    pineap_detection_t detection;
+
+    while (1) {
+        if (xQueueReceive(pineap_report_queue, &detection, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        uint32_t latency_ms = (uint32_t)((esp_timer_get_time() - detection.detected_us) / 1000);
+        if (latency_ms > pineap_stats.max_report_latency_ms)
+            pineap_stats.max_report_latency_ms = latency_ms;
+        pineap_stats.reports++;
+
+        pineap_report_detection(&detection);
     }
+}
 
-    pineap_log_data_t *log_data = malloc(sizeof(pineap_log_data_t));
-    if (!log_data)
+static void queue_detection(pineap_network_t *network, int64_t now) {
+    if (pineap_report_queue == NULL)
         return;
 
-    // Copy network data
-    memcpy(log_data->bssid, network->bssid, 6);
-    memcpy(log_data->recent_ssids, network->recent_ssids, sizeof(network->recent_ssids));
-    log_data->ssid_count = network->ssid_count;
-    log_data->channel = channel;
-    log_data->rssi = rssi;
-    log_data->network = network;
-    BaseType_t result = xTaskCreate(log_pineap_detection, "pineap_log", 4096, log_data, 1,
-                                    &network->log_task_handle);
-    if (result != pdPASS) {
-        free(log_data);
-        network->log_task_handle = NULL;
-    }
-}
-
-// Helper function to check if SSID is valid and unique
-static bool is_valid_unique_ssid(const char *new_ssid, pineap_network_t *network) {
-    // Check if SSID is empty or just whitespace
-    if (strlen(new_ssid) == 0)
-        return false;
+    pineap_detection_t detection = {0};
+    memcpy(detection.bssid, network->bssid, 6);
+    memcpy(detection.recent_ssids, network->recent_ssids, sizeof(detection.recent_ssids));
+    detection.ssid_count = network->ssid_count;
+    detection.channel = network->last_channel;
+    detection.rssi = network->last_rssi;
+    detection.detected_us = now;
+
+    const pineap_network_t *twin = find_evil_twin(network);
+    if (twin) {
+        detection.has_twin = true;
+        memcpy(detection.twin_bssid, twin->bssid, 6);
+    }
 
-    bool all_whitespace = true;
-    for (const char *p = new_ssid; *p; p++) {
-        if (!isspace((unsigned char)*p)) {
-            all_whitespace = false;
-            break;
-        }
+    if (xQueueSend(pineap_report_queue, &detection, 0) != pdTRUE) {
+        pineap_stats.dropped_reports++;
     }
-    if (all_whitespace)
-        return false;
+}
 
-    // Check if this SSID is already in our recent list
-    for (int i = 0; i < network->ssid_count && i < RECENT_SSID_COUNT; i++) {
-        if (strcasecmp(network->recent_ssids[i], new_ssid) == 0) {
-            return false; // SSID already exists (case insensitive)
-        }
+void start_pineap_detection(void) {
+    pineap_table_reset();
+    memset(&pineap_stats, 0, sizeof(pineap_stats));
+
+    if (pineap_report_queue == NULL) {
+        pineap_report_queue = xQueueCreate(PINEAP_QUEUE_LENGTH, sizeof(pineap_detection_t));
+    }
+    if (pineap_report_queue != NULL && pineap_reporter_handle == NULL) {
+        system_manager_create_task(pineap_reporter_task, "pineap_report", 4096, NULL, 1,
+                                   &pineap_reporter_handle, NULL);
     }
 
-    return true;
+    pineap_detection_active = true;
+    current_channel = 1;
+    start_channel_hopping();
 }
 
-void wifi_pineap_detector_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
-    if (!pineap_detection_active || type != WIFI_PKT_MGMT)
-        return;
-
-    const wifi_promiscuous_pkt_t *ppkt = (wifi_promiscuous_pkt_t *)buf;
-    const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)ppkt->payload;
-    const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;
+void stop_pineap_detection(void) {
+    pineap_detection_active = false;
+    stop_channel_hopping();
 
-    // Only process beacon frames
-    if (!is_beacon_packet(ppkt))
-        return;
+    if (pineap_stats.detections > 0) {
+        printf("PineAP: %lu detections, %lu reported (max latency %lu ms), %lu dropped, "
+               "%d BSSIDs tracked, %lu evicted\n",
+               (unsigned long)pineap_stats.detections, (unsigned long)pineap_stats.reports,
+               (unsigned long)pineap_stats.max_report_latency_ms,
+               (unsigned long)pineap_stats.dropped_reports, pineap_network_count,
+               (unsigned long)pineap_stats.evictions);
+    }
+}
 
-    // Find or create network
-    pineap_network_t *network = find_or_create_network(hdr->addr3);
-    if (!network)
+void pineap_get_stats(pineap_stats_t *stats) {
+    if (stats == NULL)
         return;
+    *stats = pineap_stats;
+    stats->tracked_networks = pineap_network_count;
+}
 
-    // Update channel and RSSI
-    network->last_channel = ppkt->rx_ctrl.channel;
-    network->last_rssi = ppkt->rx_ctrl.rssi;
+// Counts the frame against its capture mode, so the stats see exactly what
+// the PCAP writer was handed and what it did with it
+static void capture_wifi_frame(capture_mode_t mode, const wifi_promiscuous_pkt_t *pkt) {
+    capture_stats_frame(mode);
+    esp_err_t ret =
+        pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
+    capture_stats_result(mode, pkt->rx_ctrl.sig_len, ret);
+}
 
-    // Extract SSID from beacon
-    const uint8_t *payload = ppkt->payload;
-    int len = ppkt->rx_ctrl.sig_len;
+static bool is_blank_ssid(const char *ssid) {
+    for (const char *p = ssid; *p; p++) {
+        if (!isspace((unsigned char)*p))
+            return false;
+    }
+    return true;
+}
 
-    // Skip fixed parameters (24 bytes header + 12 bytes fixed params)
-    int index = 36;
-    if (index + 2 > len)
+void wifi_pineap_detector_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
+    if (!pineap_detection_active || type != WIFI_PKT_MGMT)
         return;
 
-    // Look specifically for SSID element (ID = 0)
-    if (payload[index] != 0)
+    const wifi_promiscuous_pkt_t *ppkt = (wifi_promiscuous_pkt_t *)buf;
+
+    // Only process beacon frames
+    ieee80211_frame_t frame;
+    if (!ieee80211_frame_parse(ppkt->payload, ppkt->rx_ctrl.sig_len, &frame) ||
+        !ieee80211_frame_is_mgmt(&frame, IEEE80211_SUBTYPE_BEACON))
         return;
 
-    uint8_t ie_len = payload[index + 1];
-    if (ie_len > 32 || index + 2 + ie_len > len)
+    // The SSID element must be the first tagged parameter
+    ieee80211_ie_iter_t it;
+    ieee80211_ie_t ie;
+    if (!ieee80211_frame_ie_iter(&frame, &it) || !ieee80211_ie_next(&it, &ie) ||
+        ie.id != IEEE80211_IE_SSID || ie.len > 32)
         return;
 
     // Get SSID
     char ssid[33] = {0};
-    memcpy(ssid, &payload[index + 2], ie_len);
-    ssid[ie_len] = '\0';
+    memcpy(ssid, ie.data, ie.len);
+    ssid[ie.len] = '\0';
     trim_trailing(ssid);
 
-    // Only proceed if this is a valid and unique SSID
-    if (!is_valid_unique_ssid(ssid, network))
+    if (ssid[0] == '\0' || is_blank_ssid(ssid))
         return;
 
-    uint32_t ssid_hash = hash_ssid(ssid);
+    int64_t now = esp_timer_get_time();
+    pineap_network_t *network = find_or_create_network(frame.addr3, now);
+    if (!network)
+        return;
 
-    // If this is a new SSID hash for this BSSID, add it
-    if (!ssid_hash_exists(network, ssid_hash) && network->ssid_count < MAX_SSIDS_PER_BSSID) {
-        network->ssid_hashes[network->ssid_count++] = ssid_hash;
+    network->last_channel = ppkt->rx_ctrl.channel;
+    network->last_rssi = ppkt->rx_ctrl.rssi;
+    network->last_seen_us = now;
 
-        // Add to recent SSIDs circular buffer
-        strncpy(network->recent_ssids[network->recent_ssid_index], ssid, 32);
-        network->recent_ssid_index = (network->recent_ssid_index + 1) % RECENT_SSID_COUNT;
+    uint32_t ssid_hash = hash_ssid(ssid);
 
-        // If we detect multiple SSIDs from same BSSID, mark as potential Pineap
-        if (network->ssid_count >= MIN_SSIDS_FOR_DETECTION &&
-            (!is_blacklisted(hdr->addr3) || should_update_blacklisted(hdr->addr3))) {
+    // Nothing more to do unless this BSSID just advertised a new SSID
+    if (!ssid_set_insert(network, ssid_hash))
+        return;
 
-            network->is_pineap = true;
-            add_to_blacklist(hdr->addr3);
+    if (network->first_ssid_hash == 0)
+        network->first_ssid_hash = ssid_hash;
 
-            // Create new logging task if previous one has completed
-            if (network->log_task_handle == NULL) {
-                pineap_log_data_t *log_data = malloc(sizeof(pineap_log_data_t));
-                if (!log_data)
-                    return;
+    // Add to recent SSIDs circular buffer
+    strncpy(network->recent_ssids[network->recent_ssid_index], ssid, 32);
+    network->recent_ssids[network->recent_ssid_index][32] = '\0';
+    network->recent_ssid_index = (network->recent_ssid_index + 1) % RECENT_SSID_COUNT;
 
-                memcpy(log_data->bssid, network->bssid, 6);
-                log_data->network = network; // Pass network pointer for up-to-date info
+    if (network->ssid_count < MIN_SSIDS_FOR_DETECTION)
+        return;
 
-                BaseType_t result = xTaskCreate(log_pineap_detection, "pineap_log", 4096, log_data,
-                                                1, &network->log_task_handle);
-                if (result != pdPASS) {
-                    free(log_data);
-                    network->log_task_handle = NULL;
-                }
-            }
+    if (!network->is_pineap) {
+        network->is_pineap = true;
+        pineap_stats.detections++;
+    } else if (now - network->last_report_us < PINEAP_REPORT_INTERVAL_MS * 1000LL) {
+        // Already reported recently, only refresh the capture
+        goto capture;
+    }
 
-            // Write to PCAP if capture is active
-            if (pcap_file != NULL) {
-                pcap_write_packet_to_buffer(ppkt->payload, ppkt->rx_ctrl.sig_len,
-                                            PCAP_CAPTURE_WIFI);
-            }
-        }
+    network->last_report_us = now;
+    queue_detection(network, now);
+
+capture:
+    // Write to PCAP if capture is active
+    if (pcap_is_open()) {
+        capture_wifi_frame(CAPTURE_MODE_PINEAP, ppkt);
     }
 }
 
@@ -423,16 +484,6 @@ bool compare_bssid(const uint8_t *bssid1, const uint8_t *bssid2) {
     return true;
 }
 
-bool is_network_duplicate(const char *ssid, const uint8_t *bssid) {
-    for (int i = 0; i < detected_network_count; i++) {
-        if (strcmp(detected_wps_networks[i].ssid, ssid) == 0 &&
-            compare_bssid(detected_wps_networks[i].bssid, bssid)) {
-            return true;
-        }
-    }
-    return false;
-}
-
 void get_frame_type_and_subtype(const wifi_promiscuous_pkt_t *pkt, uint8_t *frame_type,
                                 uint8_t *frame_subtype) {
     if (pkt->rx_ctrl.sig_len < 24) {
@@ -472,33 +523,21 @@ bool is_probe_response(const wifi_promiscuous_pkt_t *pkt) {
 }
 
 bool is_eapol_response(const wifi_promiscuous_pkt_t *pkt) {
-    const uint8_t *frame = pkt->payload;
-
-    if ((frame[30] == 0x88 && frame[31] == 0x8E) || (frame[32] == 0x88 && frame[33] == 0x8E)) {
-        return true;
+    ieee80211_frame_t frame;
+    if (!ieee80211_frame_parse(pkt->payload, pkt->rx_ctrl.sig_len, &frame)) {
+        return false;
     }
-
-    return false;
+    return ieee80211_frame_is_eapol(&frame);
 }
 
 bool is_pwn_response(const wifi_promiscuous_pkt_t *pkt) {
-    const uint8_t *frame = pkt->payload;
-
-    if (frame[0] == 0x80) {
-        return true;
-    }
-
-    return false;
+    return pkt->rx_ctrl.sig_len > 0 && pkt->payload[0] == 0x80;
 }
 
 void wifi_raw_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
     if (pkt->rx_ctrl.sig_len > 0) {
-        esp_err_t ret =
-            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
-        if (ret != ESP_OK) {
-            ESP_LOGE("RAW_SCAN", "Failed to write packet to buffer");
-        }
+        capture_wifi_frame(CAPTURE_MODE_RAW, pkt);
     }
 }
 
@@ -508,56 +547,42 @@ void wardriving_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
     }
 
     const wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
-    const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)pkt->payload;
-    const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;
-
-    const uint8_t *payload = pkt->payload;
-    int len = pkt->rx_ctrl.sig_len;
 
-    uint8_t frame_type = hdr->frame_ctrl & 0xFC;
-    if (frame_type != 0x80 && frame_type != 0x50) {
+    ieee80211_frame_t frame;
+    if (!ieee80211_frame_parse(pkt->payload, pkt->rx_ctrl.sig_len, &frame) ||
+        (!ieee80211_frame_is_mgmt(&frame, IEEE80211_SUBTYPE_BEACON) &&
+         !ieee80211_frame_is_mgmt(&frame, IEEE80211_SUBTYPE_PROBE_RESP))) {
         return;
     }
 
-    int index = 36;
     char ssid[33] = {0};
     uint8_t bssid[6];
-    memcpy(bssid, hdr->addr3, 6);
+    memcpy(bssid, frame.addr3, 6);
 
     int rssi = pkt->rx_ctrl.rssi;
     int channel = pkt->rx_ctrl.channel;
 
-    bool network_found = false;
     char encryption_type[8] = "OPEN";
 
-    while (index + 1 < len) {
-        uint8_t id = payload[index];
-        uint8_t ie_len = payload[index + 1];
-
-        if (index + 2 + ie_len > len) {
-            break;
-        }
-
-        if (id == 0 && ie_len <= 32) {
-            memcpy(ssid, &payload[index + 2], ie_len);
-            ssid[ie_len] = '\0';
+    ieee80211_ie_iter_t it;
+    ieee80211_ie_t ie;
+    if (!ieee80211_frame_ie_iter(&frame, &it)) {
+        return;
+    }
+    while (ieee80211_ie_next(&it, &ie)) {
+        if (ie.id == IEEE80211_IE_SSID && ie.len <= 32) {
+            memcpy(ssid, ie.data, ie.len);
+            ssid[ie.len] = '\0';
             trim_trailing(ssid);
         }
 
-        if (id == 48) {
+        if (ie.id == IEEE80211_IE_RSN) {
             strncpy(encryption_type, "WPA2", sizeof(encryption_type));
-        } else if (id == 221) {
-            uint32_t oui =
-                (payload[index + 2] << 16) | (payload[index + 3] << 8) | payload[index + 4];
-            uint8_t oui_type = payload[index + 5];
-            if (oui == 0x0050f2 && oui_type == 0x01) {
-                strncpy(encryption_type, "WPA", sizeof(encryption_type));
-            } else if (oui == 0x0050f2 && oui_type == 0x02) {
-                strncpy(encryption_type, "WEP", sizeof(encryption_type));
-            }
+        } else if (ieee80211_ie_is_vendor(&ie, IEEE80211_OUI_MICROSOFT, 0x01)) {
+            strncpy(encryption_type, "WPA", sizeof(encryption_type));
+        } else if (ieee80211_ie_is_vendor(&ie, IEEE80211_OUI_MICROSOFT, 0x02)) {
+            strncpy(encryption_type, "WEP", sizeof(encryption_type));
         }
-
-        index += (2 + ie_len);
     }
 
     double latitude = 0;
@@ -590,11 +615,7 @@ void wifi_probe_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
         return;
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
     if (pkt->rx_ctrl.sig_len > 0) {
-        esp_err_t ret =
-            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
-        if (ret != ESP_OK) {
-            ESP_LOGE("PROBE_SCAN", "Failed to write packet to buffer");
-        }
+        capture_wifi_frame(CAPTURE_MODE_PROBE, pkt);
     }
 }
 
@@ -603,11 +624,7 @@ void wifi_beacon_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
         return;
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
     if (pkt->rx_ctrl.sig_len > 0) {
-        esp_err_t ret =
-            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
-        if (ret != ESP_OK) {
-            ESP_LOGE("BEACON_SCAN", "Failed to write packet to buffer");
-        }
+        capture_wifi_frame(CAPTURE_MODE_BEACON, pkt);
     }
 }
 
@@ -616,11 +633,7 @@ void wifi_deauth_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
         return;
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
     if (pkt->rx_ctrl.sig_len > 0) {
-        esp_err_t ret =
-            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
-        if (ret != ESP_OK) {
-            ESP_LOGE("DEAUTH_SCAN", "Failed to write packet to buffer");
-        }
+        capture_wifi_frame(CAPTURE_MODE_DEAUTH, pkt);
     }
 }
 
@@ -629,11 +642,7 @@ void wifi_pwn_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
         return;
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
     if (pkt->rx_ctrl.sig_len > 0) {
-        esp_err_t ret =
-            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
-        if (ret != ESP_OK) {
-            ESP_LOGE("PWN_SCAN", "Failed to write packet to buffer");
-        }
+        capture_wifi_frame(CAPTURE_MODE_PWN, pkt);
     }
 }
 
@@ -642,12 +651,139 @@ void wifi_eapol_scan_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
         return;
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
     if (pkt->rx_ctrl.sig_len > 0) {
-        esp_err_t ret =
-            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI);
-        if (ret != ESP_OK) {
-            ESP_LOGE("EAPOL_SCAN", "Failed to write packet to buffer");
+        capture_wifi_frame(CAPTURE_MODE_EAPOL, pkt);
+    }
+}
+
+// BSSIDs already examined by the WPS detector, so each AP's IEs are only
+// walked until its WPS state is known.
+static wps_seen_entry_t wps_seen[WPS_SEEN_SETS][WPS_SEEN_WAYS];
+static uint32_t wps_seen_evictions = 0;
+
+// Picks the entry to replace in a full set. APs without WPS go first, one
+// coming back only costs another IE walk, reported WPS APs last. Within a
+// state, an entry seen since the last sweep gets a second chance.
+static wps_seen_entry_t *wps_seen_victim(wps_seen_entry_t *set) {
+    for (uint8_t state = WPS_SEEN_NO_WPS; state <= WPS_SEEN_WPS; state++) {
+        for (int sweep = 0; sweep < 2; sweep++) {
+            for (int way = 0; way < WPS_SEEN_WAYS; way++) {
+                if (set[way].state == state && !set[way].referenced)
+                    return &set[way];
+            }
+            for (int way = 0; way < WPS_SEEN_WAYS; way++) {
+                if (set[way].state == state)
+                    set[way].referenced = 0;
+            }
+        }
+    }
+    return &set[0];
+}
+
+static wps_seen_entry_t *wps_seen_lookup(const uint8_t *bssid, bool insert) {
+    wps_seen_entry_t *set = wps_seen[ieee80211_mac_hash(bssid) & (WPS_SEEN_SETS - 1)];
+    wps_seen_entry_t *empty = NULL;
+    for (int way = 0; way < WPS_SEEN_WAYS; way++) {
+        if (set[way].state == WPS_SEEN_EMPTY) {
+            if (empty == NULL)
+                empty = &set[way];
+        } else if (compare_bssid(set[way].bssid, bssid)) {
+            set[way].referenced = 1;
+            return &set[way];
+        }
+    }
+    if (!insert)
+        return NULL;
+
+    if (empty == NULL) {
+        if ((wps_seen_evictions++ & 1023) == 0) {
+            IRAM_PRINTF("WPS detector tracking more than %d APs, %lu entries recycled\n",
+                        WPS_SEEN_SETS * WPS_SEEN_WAYS, (unsigned long)wps_seen_evictions);
+        }
+        empty = wps_seen_victim(set);
+    }
+    memcpy(empty->bssid, bssid, 6);
+    empty->state = WPS_SEEN_EMPTY;
+    empty->referenced = 0;
+    return empty;
+}
+
+void wps_detection_reset(void) {
+    memset(wps_seen, 0, sizeof(wps_seen));
+    wps_seen_evictions = 0;
+    memset(detected_wps_networks, 0, sizeof(detected_wps_networks));
+    detected_network_count = 0;
+}
+
+// Parses the TLV attributes that follow the WPS OUI header
+static bool parse_wps_attributes(const uint8_t *data, size_t len, wps_info_t *info) {
+    size_t pos = 0;
+    bool any = false;
+
+    memset(info, 0, sizeof(*info));
+
+    while (pos + 4 <= len) {
+        uint16_t attr_id = (data[pos] << 8) | data[pos + 1];
+        uint16_t attr_len = (data[pos + 2] << 8) | data[pos + 3];
+        const uint8_t *value = &data[pos + 4];
+
+        if (attr_len > len - (pos + 4))
+            break;
+
+        switch (attr_id) {
+        case WPS_ATTR_VERSION:
+            if (attr_len == 1) {
+                info->version = value[0];
+                any = true;
+            }
+            break;
+        case WPS_ATTR_STATE:
+            if (attr_len == 1) {
+                info->state = value[0];
+                any = true;
+            }
+            break;
+        case WPS_ATTR_AP_SETUP_LOCKED:
+            if (attr_len == 1) {
+                info->ap_setup_locked = value[0] != 0;
+                any = true;
+            }
+            break;
+        case WPS_ATTR_CONFIG_METHODS:
+            if (attr_len == 2) {
+                info->config_methods = (value[0] << 8) | value[1];
+                info->has_config_methods = true;
+                any = true;
+            }
+            break;
+        case WPS_ATTR_SELECTED_REG_CONFIG_METHODS:
+            if (attr_len == 2) {
+                info->selected_reg_config_methods = (value[0] << 8) | value[1];
+                any = true;
+            }
+            break;
+        case WPS_ATTR_SELECTED_REGISTRAR:
+            if (attr_len == 1) {
+                info->selected_registrar = value[0] != 0;
+                any = true;
+            }
+            break;
+        default:
+            break;
         }
+
+        pos += 4 + attr_len;
     }
+
+    return any;
+}
+
+static wps_modes_t wps_mode_from_info(const wps_info_t *info) {
+    uint16_t methods = info->config_methods | info->selected_reg_config_methods;
+    if (methods & WPS_CONF_METHODS_PBC)
+        return WPS_MODE_PBC;
+    if (methods & (WPS_CONF_METHODS_PIN_DISPLAY | WPS_CONF_METHODS_PIN_KEYPAD))
+        return WPS_MODE_PIN;
+    return WPS_MODE_NONE;
 }
 
 void wifi_wps_detection_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
@@ -656,118 +792,107 @@ void wifi_wps_detection_callback(void *buf, wifi_promiscuous_pkt_type_t type) {
     }
 
     const wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
-    const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)pkt->payload;
-    const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;
-
-    const uint8_t *payload = pkt->payload;
-    int len = pkt->rx_ctrl.sig_len;
+    // Only WPS beacons are kept, so frames and written differ by design
+    capture_stats_frame(CAPTURE_MODE_WPS);
+
+    ieee80211_frame_t frame;
+    ieee80211_ie_iter_t it;
+    if (!ieee80211_frame_parse(pkt->payload, pkt->rx_ctrl.sig_len, &frame) ||
+        (!ieee80211_frame_is_mgmt(&frame, IEEE80211_SUBTYPE_BEACON) &&
+         !ieee80211_frame_is_mgmt(&frame, IEEE80211_SUBTYPE_PROBE_RESP)) ||
+        !ieee80211_frame_ie_iter(&frame, &it)) {
+        return;
+    }
 
-    uint8_t frame_type = hdr->frame_ctrl & 0xFC;
-    if (frame_type != 0x80 && frame_type != 0x50) {
+    // One lookup per frame: known APs skip the IE walk entirely. A WPS AP
+    // whose beacon leaves out Config Methods is walked until a frame, most
+    // likely a probe response, carries them.
+    wps_seen_entry_t *seen = wps_seen_lookup(frame.addr3, false);
+    if (seen != NULL && seen->state != WPS_SEEN_WPS_PENDING) {
+        if (seen->state == WPS_SEEN_WPS && should_store_wps == 0) {
+            capture_stats_result(CAPTURE_MODE_WPS, pkt->rx_ctrl.sig_len,
+                                 pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len,
+                                                             PCAP_CAPTURE_WIFI));
+        }
         return;
     }
 
-    int index = 36;
     char ssid[33] = {0};
     bool wps_found = false;
-    uint8_t bssid[6];
-    memcpy(bssid, hdr->addr3, 6);
-
-    while (index + 1 < len) {
-        uint8_t id = payload[index];
-        uint8_t ie_len = payload[index + 1];
+    wps_info_t info = {0};
 
-        if (index + 2 + ie_len > len) {
-            break;
-        }
-
-        if (id == 0 && ie_len <= 32) {
-            memcpy(ssid, &payload[index + 2], ie_len);
-            ssid[ie_len] = '\0';
+    ieee80211_ie_t ie;
+    while (ieee80211_ie_next(&it, &ie)) {
+        if (ie.id == IEEE80211_IE_SSID && ie.len <= 32) {
+            memcpy(ssid, ie.data, ie.len);
+            ssid[ie.len] = '\0';
             trim_trailing(ssid);
+        } else if (!wps_found && ieee80211_ie_is_vendor(&ie, WPS_OUI >> 8, WPS_OUI & 0xFF)) {
+            wps_found = parse_wps_attributes(ie.data + 4, ie.len - 4, &info);
         }
+    }
 
-        if (is_network_duplicate(ssid, bssid)) {
-            return;
-        }
+    if (seen == NULL) {
+        seen = wps_seen_lookup(frame.addr3, true);
+    }
+    if (!wps_found) {
+        // A probe response may leave out the WPS IE its beacon carried
+        if (seen->state != WPS_SEEN_WPS_PENDING)
+            seen->state = WPS_SEEN_NO_WPS;
+    } else if (!info.has_config_methods) {
+        seen->state = WPS_SEEN_WPS_PENDING;
+    } else {
+        // Reported below, later frames only go to the capture
+        seen->state = WPS_SEEN_WPS;
+    }
 
-        if (id == 221 && ie_len >= 4) {
-            uint32_t oui =
-                (payload[index + 2] << 16) | (payload[index + 3] << 8) | payload[index + 4];
-            uint8_t oui_type = payload[index + 5];
-
-            if (oui == 0x0050f2 && oui_type == 0x04) {
-                wps_found = true;
-
-                int attr_index = index + 6;
-                int wps_ie_end = index + 2 + ie_len;
-
-                while (attr_index + 4 <= wps_ie_end) {
-                    uint16_t attr_id = (payload[attr_index] << 8) | payload[attr_index + 1];
-                    uint16_t attr_len = (payload[attr_index + 2] << 8) | payload[attr_index + 3];
-
-                    if (attr_len > (wps_ie_end - (attr_index + 4))) {
-                        break;
-                    }
-
-                    if (attr_id == 0x1008 && attr_len == 2) {
-                        uint16_t config_methods =
-                            (payload[attr_index + 4] << 8) | payload[attr_index + 5];
-
-                        IRAM_PRINTF("Configuration Methods found: 0x%04x\n", config_methods);
-
-                        if (config_methods & WPS_CONF_METHODS_PBC) {
-                            IRAM_PRINTF("WPS Push Button detected:\n%s\n", ssid);
-                            TERMINAL_VIEW_ADD_TEXT("WPS Push Button detected:\n%s\n", ssid);
-                        } else if (config_methods &
-                                   (WPS_CONF_METHODS_PIN_DISPLAY | WPS_CONF_METHODS_PIN_KEYPAD)) {
-                            IRAM_PRINTF("WPS PIN detected:\n%s\n", ssid);
-                            TERMINAL_VIEW_ADD_TEXT("WPS PIN detected:\n%s\n", ssid);
-                        }
-
-                        if (should_store_wps == 1) {
-                            wps_network_t new_network;
-                            strncpy(new_network.ssid, ssid, sizeof(new_network.ssid) - 1);
-                            new_network.ssid[sizeof(new_network.ssid) - 1] =
-                                '\0'; // Ensure null termination
-                            memcpy(new_network.bssid, bssid, sizeof(new_network.bssid));
-                            new_network.wps_enabled = true;
-                            new_network.wps_mode = config_methods & (WPS_CONF_METHODS_PIN_DISPLAY |
-                                                                     WPS_CONF_METHODS_PIN_KEYPAD)
-                                                       ? WPS_MODE_PIN
-                                                       : WPS_MODE_PBC;
-
-                            detected_wps_networks[detected_network_count++] = new_network;
-                        } else {
-                            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len,
-                                                        PCAP_CAPTURE_WIFI);
-                        }
-
-                        if (detected_network_count >= MAX_WPS_NETWORKS) {
-                            IRAM_PRINTF("Maximum number of WPS networks detected\nStopping monitor "
-                                   "mode.\n");
-                            TERMINAL_VIEW_ADD_TEXT(
-                                "Maximum number of WPS networks detected\nStopping "
-                                "monitor mode.\n");
-                            wifi_manager_stop_monitor_mode();
-                        }
-                    }
-
-                    attr_index += (4 + attr_len);
-                }
-            }
-        }
+    if (!wps_found || !info.has_config_methods) {
+        return;
+    }
+
+    wps_modes_t mode = wps_mode_from_info(&info);
+
+    IRAM_PRINTF("Configuration Methods found: 0x%04x\n", info.config_methods);
 
-        index += (2 + ie_len);
+    if (mode == WPS_MODE_PBC) {
+        IRAM_PRINTF("WPS Push Button detected:\n%s\n", ssid);
+        TERMINAL_VIEW_ADD_TEXT("WPS Push Button detected:\n%s\n", ssid);
+    } else if (mode == WPS_MODE_PIN) {
+        IRAM_PRINTF("WPS PIN detected:\n%s\n", ssid);
+        TERMINAL_VIEW_ADD_TEXT("WPS PIN detected:\n%s\n", ssid);
+    }
+
+    if (info.ap_setup_locked) {
+        IRAM_PRINTF("WPS AP setup locked:\n%s\n", ssid);
+        TERMINAL_VIEW_ADD_TEXT("WPS AP setup locked:\n%s\n", ssid);
+    }
+
+    if (should_store_wps == 1) {
+        wps_network_t *new_network = &detected_wps_networks[detected_network_count++];
+        strncpy(new_network->ssid, ssid, sizeof(new_network->ssid) - 1);
+        new_network->ssid[sizeof(new_network->ssid) - 1] = '\0'; // Ensure null termination
+        memcpy(new_network->bssid, frame.addr3, sizeof(new_network->bssid));
+        new_network->wps_enabled = true;
+        new_network->wps_mode = (mode == WPS_MODE_NONE) ? WPS_MODE_PBC : mode;
+        new_network->info = info;
+    } else {
+        capture_stats_result(
+            CAPTURE_MODE_WPS, pkt->rx_ctrl.sig_len,
+            pcap_write_packet_to_buffer(pkt->payload, pkt->rx_ctrl.sig_len, PCAP_CAPTURE_WIFI));
+    }
+
+    if (detected_network_count >= MAX_WPS_NETWORKS) {
+        IRAM_PRINTF("Maximum number of WPS networks detected\nStopping monitor "
+               "mode.\n");
+        TERMINAL_VIEW_ADD_TEXT(
+            "Maximum number of WPS networks detected\nStopping "
+            "monitor mode.\n");
+        wifi_manager_stop_monitor_mode();
     }
 }
 
 #ifndef CONFIG_IDF_TARGET_ESP32S2
-// Forward declare the struct and callback before use
-struct ble_hs_adv_field;
-static int ble_hs_adv_parse_fields_cb(const struct ble_hs_adv_field *field, void *arg);
-
-void ble_wardriving_callback(struct ble_gap_event *event, void *arg) {
+void ble_wardriving_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
     if (!event || event->type != BLE_GAP_EVENT_DISC) {
         return;
     }
@@ -777,16 +902,16 @@ void ble_wardriving_callback(struct ble_gap_event *event, void *arg) {
 
     // Get BLE MAC and RSSI
     snprintf(wardriving_data.ble_data.ble_mac, sizeof(wardriving_data.ble_data.ble_mac),
-             "%02x:%02x:%02x:%02x:%02x:%02x", event->disc.addr.val[0], event->disc.addr.val[1],
-             event->disc.addr.val[2], event->disc.addr.val[3], event->disc.addr.val[4],
-             event->disc.addr.val[5]);
+             "%02x:%02x:%02x:%02x:%02x:%02x", adv->addr[0], adv->addr[1], adv->addr[2],
+             adv->addr[3], adv->addr[4], adv->addr[5]);
 
-    wardriving_data.ble_data.ble_rssi = event->disc.rssi;
+    wardriving_data.ble_data.ble_rssi = adv->rssi;
 
-    // Parse BLE name if available
-    if (event->disc.length_data > 0) {
-        ble_hs_adv_parse(event->disc.data, event->disc.length_data, ble_hs_adv_parse_fields_cb,
-                         &wardriving_data);
+    // BLE name if the advertisement carried one
+    if (adv->name_len > 0) {
+        size_t name_len = MIN(adv->name_len, sizeof(wardriving_data.ble_data.ble_name) - 1);
+        memcpy(wardriving_data.ble_data.ble_name, adv->name, name_len);
+        wardriving_data.ble_data.ble_name[name_len] = '\0';
     }
 
     // Get GPS data from the global handle
@@ -807,121 +932,297 @@ void ble_wardriving_callback(struct ble_gap_event *event, void *arg) {
     }
 }
 
-// Move the callback implementation inside the ESP32S2 guard
-static int ble_hs_adv_parse_fields_cb(const struct ble_hs_adv_field *field, void *arg) {
-    wardriving_data_t *data = (wardriving_data_t *)arg;
-
-    if (field->type == BLE_HS_ADV_TYPE_COMP_NAME) {
-        size_t name_len = MIN(field->length, sizeof(data->ble_data.ble_name) - 1);
-        memcpy(data->ble_data.ble_name, field->value, name_len);
-        data->ble_data.ble_name[name_len] = '\0';
-    }
-
-    return 0;
-}
 #endif
 
 // wrap for esp32s2
 #ifndef CONFIG_IDF_TARGET_ESP32S2
 
 static const int suspicious_names_count = sizeof(suspicious_names) / sizeof(suspicious_names[0]);
-void ble_skimmer_scan_callback(struct ble_gap_event *event, void *arg) {
-    if (!event || event->type != BLE_GAP_EVENT_DISC) {
+
+// Lowercase FNV-1a of each suspicious name, filled once before the callback
+// is registered so a lookup is one hash of the advertised name
+static uint32_t suspicious_name_hashes[sizeof(suspicious_names) / sizeof(suspicious_names[0])];
+static uint8_t suspicious_name_lens[sizeof(suspicious_names) / sizeof(suspicious_names[0])];
+static uint8_t suspicious_name_min_len = 0xFF;
+static uint8_t suspicious_name_max_len = 0;
+
+static QueueHandle_t skimmer_report_queue = NULL;
+static TaskHandle_t skimmer_reporter_handle = NULL;
+static skimmer_candidate_t skimmer_candidates[SKIMMER_MAX_CANDIDATES];
+static skimmer_stats_t skimmer_stats;
+
+static uint32_t hash_lowercase(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)tolower((unsigned char)str[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void skimmer_names_init(void) {
+    if (suspicious_name_max_len != 0)
         return;
+
+    for (int i = 0; i < suspicious_names_count; i++) {
+        size_t len = strlen(suspicious_names[i]);
+        suspicious_name_hashes[i] = hash_lowercase(suspicious_names[i], len);
+        suspicious_name_lens[i] = (uint8_t)len;
+        if (len < suspicious_name_min_len)
+            suspicious_name_min_len = (uint8_t)len;
+        if (len > suspicious_name_max_len)
+            suspicious_name_max_len = (uint8_t)len;
+    }
+}
+
+// Returns the index of the matching suspicious name or -1
+static int match_suspicious_name(const char *name, size_t len) {
+    if (len < suspicious_name_min_len || len > suspicious_name_max_len)
+        return -1;
+
+    uint32_t hash = hash_lowercase(name, len);
+    for (int i = 0; i < suspicious_names_count; i++) {
+        if (suspicious_name_hashes[i] == hash && suspicious_name_lens[i] == len &&
+            strncasecmp(name, suspicious_names[i], len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static const char *skimmer_proximity(int rssi) {
+    if (rssi >= -55)
+        return "Very close";
+    if (rssi >= -70)
+        return "Nearby";
+    if (rssi >= -85)
+        return "In range";
+    return "Far";
+}
+
+static const char *skimmer_trend_name(skimmer_trend_t trend) {
+    switch (trend) {
+    case SKIMMER_TREND_APPROACHING:
+        return "approaching";
+    case SKIMMER_TREND_RECEDING:
+        return "moving away";
+    default:
+        return "steady";
+    }
+}
+
+// Finds the candidate for this address, reusing the least recently seen
+// slot when the table is full. *is_new is set for a fresh sighting.
+static skimmer_candidate_t *skimmer_candidate_update(const skimmer_detection_t *detection,
+                                                     bool *is_new) {
+    skimmer_candidate_t *candidate = NULL;
+    skimmer_candidate_t *oldest = &skimmer_candidates[0];
+
+    for (int i = 0; i < SKIMMER_MAX_CANDIDATES; i++) {
+        skimmer_candidate_t *c = &skimmer_candidates[i];
+        if (c->in_use && memcmp(c->addr, detection->addr, 6) == 0) {
+            candidate = c;
+            break;
+        }
+        if (!c->in_use) {
+            if (oldest->in_use)
+                oldest = c;
+        } else if (oldest->in_use && c->last_seen_us < oldest->last_seen_us) {
+            oldest = c;
+        }
+    }
+
+    int16_t sample = (int16_t)(detection->rssi * 16);
+    *is_new = candidate == NULL ||
+              detection->detected_us - candidate->last_seen_us > SKIMMER_STALE_MS * 1000LL;
+
+    if (*is_new) {
+        if (candidate == NULL) {
+            candidate = oldest;
+            skimmer_stats.candidates++;
+        }
+        memset(candidate, 0, sizeof(*candidate));
+        candidate->in_use = true;
+        memcpy(candidate->addr, detection->addr, 6);
+        candidate->first_seen_us = detection->detected_us;
+        candidate->rssi_fast = sample;
+        candidate->rssi_slow = sample;
+    } else {
+        // alpha 1/2 and 1/8
+        candidate->rssi_fast += (sample - candidate->rssi_fast) / 2;
+        candidate->rssi_slow += (sample - candidate->rssi_slow) / 8;
     }
 
-    struct ble_hs_adv_fields fields;
-    int rc = ble_hs_adv_parse_fields(&fields, event->disc.data, event->disc.length_data);
+    candidate->pattern = detection->pattern;
+    candidate->last_seen_us = detection->detected_us;
+    candidate->samples++;
+
+    int gap = candidate->rssi_fast - candidate->rssi_slow;
+    if (candidate->samples < 4) {
+        candidate->trend = SKIMMER_TREND_STEADY;
+    } else if (gap >= SKIMMER_TREND_DB * 16) {
+        candidate->trend = SKIMMER_TREND_APPROACHING;
+    } else if (gap <= -SKIMMER_TREND_DB * 16) {
+        candidate->trend = SKIMMER_TREND_RECEDING;
+    } else {
+        candidate->trend = SKIMMER_TREND_STEADY;
+    }
+    return candidate;
+}
+
+// Writes the advert as an HCI LE Advertising Report so the capture opens
+// like any other BLE PCAP
+static void skimmer_write_pcap(const skimmer_detection_t *detection) {
+    uint8_t packet[15 + sizeof(detection->data)];
+    size_t len = 0;
+
+    packet[len++] = 0x04; // H4 event
+    packet[len++] = 0x3E; // LE Meta
+    packet[len++] = (uint8_t)(12 + detection->data_len);
+    packet[len++] = 0x02; // Advertising Report
+    packet[len++] = 0x01; // One report
+    packet[len++] = detection->event_type;
+    packet[len++] = detection->addr_type;
+    memcpy(packet + len, detection->addr, 6);
+    len += 6;
+    packet[len++] = detection->data_len;
+    memcpy(packet + len, detection->data, detection->data_len);
+    len += detection->data_len;
+    packet[len++] = (uint8_t)detection->rssi;
+
+    capture_stats_result(CAPTURE_MODE_SKIMMER, len,
+                         pcap_write_packet_to_buffer(packet, len, PCAP_CAPTURE_BLUETOOTH));
+}
 
-    if (rc != 0) {
-        ESP_LOGD(SKIMMER_TAG, "Failed to parse advertisement data");
+static void skimmer_report_detection(const skimmer_detection_t *detection,
+                                     const skimmer_candidate_t *candidate, bool is_new) {
+    char mac_addr[18];
+    snprintf(mac_addr, sizeof(mac_addr), "%02x:%02x:%02x:%02x:%02x:%02x", detection->addr[0],
+             detection->addr[1], detection->addr[2], detection->addr[3], detection->addr[4],
+             detection->addr[5]);
+
+    int rssi = candidate->rssi_fast / 16;
+    const char *proximity = skimmer_proximity(rssi);
+    const char *trend = skimmer_trend_name(candidate->trend);
+
+    if (!is_new) {
+        IRAM_PRINTF("Skimmer %s (%s): %d dBm, %s, %s\n", mac_addr,
+                    suspicious_names[detection->pattern], rssi, proximity, trend);
+        TERMINAL_VIEW_ADD_TEXT("Skimmer %s\n%d dBm, %s, %s\n", mac_addr, rssi, proximity, trend);
         return;
     }
 
-    // Check device name
-    if (fields.name != NULL && fields.name_len > 0) {
-        char device_name[32] = {0};
-        size_t name_len = MIN(fields.name_len, sizeof(device_name) - 1);
-        memcpy(device_name, fields.name, name_len);
-
-        // Check against suspicious names
-        for (int i = 0; i < suspicious_names_count; i++) {
-            if (strcasecmp(device_name, suspicious_names[i]) == 0) {
-                char mac_addr[18];
-                snprintf(mac_addr, sizeof(mac_addr), "%02x:%02x:%02x:%02x:%02x:%02x",
-                         event->disc.addr.val[0], event->disc.addr.val[1], event->disc.addr.val[2],
-                         event->disc.addr.val[3], event->disc.addr.val[4], event->disc.addr.val[5]);
-
-                IRAM_PRINTF("\nPOTENTIAL SKIMMER DETECTED!\n");
-                TERMINAL_VIEW_ADD_TEXT("\nPOTENTIAL SKIMMER DETECTED!\n");
-
-                IRAM_PRINTF("Device Name: %s\n", device_name);
-                TERMINAL_VIEW_ADD_TEXT("Device Name: ");
-                TERMINAL_VIEW_ADD_TEXT(device_name);
-                TERMINAL_VIEW_ADD_TEXT("\n");
-
-                IRAM_PRINTF("MAC Address: %s\n", mac_addr);
-                TERMINAL_VIEW_ADD_TEXT("MAC Address: ");
-                TERMINAL_VIEW_ADD_TEXT(mac_addr);
-                TERMINAL_VIEW_ADD_TEXT("\n");
-
-                IRAM_PRINTF("RSSI: %d dBm\n", event->disc.rssi);
-                TERMINAL_VIEW_ADD_TEXT("RSSI: ");
-                char rssi_str[12];
-                snprintf(rssi_str, sizeof(rssi_str), "%d", event->disc.rssi);
-                TERMINAL_VIEW_ADD_TEXT(rssi_str);
-                TERMINAL_VIEW_ADD_TEXT(" dBm\n");
-
-                IRAM_PRINTF("Reason:\nMatched known skimmer pattern: %s\n", suspicious_names[i]);
-                TERMINAL_VIEW_ADD_TEXT("Reason:\nMatched known skimmer pattern: ");
-                TERMINAL_VIEW_ADD_TEXT(suspicious_names[i]);
-                TERMINAL_VIEW_ADD_TEXT("\n");
-
-                IRAM_PRINTF("Please verify before taking action.\n\n");
-                TERMINAL_VIEW_ADD_TEXT("Please verify before taking action.\n\n");
-
-                // pulse rgb red once when skimmer is detected
-                pulse_once(&rgb_manager, 255, 0, 0);
-
-                // Create enhanced PCAP packet with metadata
-                if (pcap_file != NULL) {
-                    // Format: [Timestamp][MAC][RSSI][Name][Raw Data]
-                    uint8_t enhanced_packet[256] = {0};
-                    size_t packet_len = 0;
-
-                    // Add MAC address
-                    memcpy(enhanced_packet + packet_len, event->disc.addr.val, 6);
-                    packet_len += 6;
-
-                    // Add RSSI
-                    enhanced_packet[packet_len++] = (uint8_t)event->disc.rssi;
-
-                    // Add device name length and name
-                    enhanced_packet[packet_len++] = (uint8_t)name_len;
-                    memcpy(enhanced_packet + packet_len, device_name, name_len);
-                    packet_len += name_len;
-
-                    // Add reason for flagging
-                    const char *reason = suspicious_names[i];
-                    uint8_t reason_len = strlen(reason);
-                    enhanced_packet[packet_len++] = reason_len;
-                    memcpy(enhanced_packet + packet_len, reason, reason_len);
-                    packet_len += reason_len;
-
-                    // Add raw advertisement data
-                    memcpy(enhanced_packet + packet_len, event->disc.data, event->disc.length_data);
-                    packet_len += event->disc.length_data;
-
-                    // Write to PCAP with proper BLE packet format
-                    pcap_write_packet_to_buffer(enhanced_packet, packet_len,
-                                                PCAP_CAPTURE_BLUETOOTH);
-
-                    // Force flush to ensure suspicious device is captured
-                    pcap_flush_buffer_to_file();
-                }
-                break;
-            }
+    // pulse rgb red once when skimmer is detected
+    pulse_once(&rgb_manager, 255, 0, 0);
+
+    IRAM_PRINTF("\nPOTENTIAL SKIMMER DETECTED!\n");
+    IRAM_PRINTF("Device Name: %s\n", suspicious_names[detection->pattern]);
+    IRAM_PRINTF("MAC Address: %s\n", mac_addr);
+    IRAM_PRINTF("RSSI: %d dBm (%s)\n", detection->rssi, proximity);
+    IRAM_PRINTF("Reason:\nMatched known skimmer pattern: %s\n",
+                suspicious_names[detection->pattern]);
+    IRAM_PRINTF("Please verify before taking action.\n\n");
+
+    TERMINAL_VIEW_ADD_TEXT("\nPOTENTIAL SKIMMER DETECTED!\n");
+    TERMINAL_VIEW_ADD_TEXT("Device Name: %s\n", suspicious_names[detection->pattern]);
+    TERMINAL_VIEW_ADD_TEXT("MAC Address: %s\n", mac_addr);
+    TERMINAL_VIEW_ADD_TEXT("RSSI: %d dBm (%s)\n", detection->rssi, proximity);
+    TERMINAL_VIEW_ADD_TEXT("Reason:\nMatched known skimmer pattern: %s\n",
+                           suspicious_names[detection->pattern]);
+    TERMINAL_VIEW_ADD_TEXT("Please verify before taking action.\n\n");
+}
+
+// Owns the candidate table and all output, LED and SD card work, so the
+// NimBLE callback only has to match the name and copy the advert.
+static void skimmer_reporter_task(void *arg) {
+    skimmer_detection_t detection;
+
+    while (1) {
+        if (xQueueReceive(skimmer_report_queue, &detection, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        int64_t now = esp_timer_get_time();
+        uint32_t latency_ms = (uint32_t)((now - detection.detected_us) / 1000);
+        if (latency_ms > skimmer_stats.max_report_latency_ms)
+            skimmer_stats.max_report_latency_ms = latency_ms;
+
+        bool is_new;
+        skimmer_candidate_t *candidate = skimmer_candidate_update(&detection, &is_new);
+
+        skimmer_write_pcap(&detection);
+
+        if (is_new || now - candidate->last_report_us >= SKIMMER_UPDATE_INTERVAL_MS * 1000LL) {
+            candidate->last_report_us = now;
+            skimmer_report_detection(&detection, candidate, is_new);
+        }
+
+        if (is_new) {
+            // Make sure a new suspect reaches the card even if we lose power
+            pcap_flush_buffer_to_file();
         }
     }
 }
+
+void skimmer_detection_start(void) {
+    skimmer_names_init();
+    memset(skimmer_candidates, 0, sizeof(skimmer_candidates));
+    memset(&skimmer_stats, 0, sizeof(skimmer_stats));
+
+    if (skimmer_report_queue == NULL) {
+        skimmer_report_queue = xQueueCreate(SKIMMER_QUEUE_LENGTH, sizeof(skimmer_detection_t));
+    }
+    if (skimmer_report_queue != NULL && skimmer_reporter_handle == NULL) {
+        system_manager_create_task(skimmer_reporter_task, "skimmer_report", 4096, NULL, 1,
+                                   &skimmer_reporter_handle, NULL);
+    }
+}
+
+void skimmer_detection_stop(void) {
+    if (skimmer_stats.matches > 0) {
+        printf("Skimmer: %lu adverts checked, %lu matches from %lu devices "
+               "(max latency %lu ms), %lu dropped\n",
+               (unsigned long)skimmer_stats.adverts_checked, (unsigned long)skimmer_stats.matches,
+               (unsigned long)skimmer_stats.candidates,
+               (unsigned long)skimmer_stats.max_report_latency_ms,
+               (unsigned long)skimmer_stats.dropped_reports);
+    }
+}
+
+void skimmer_get_stats(skimmer_stats_t *stats) {
+    if (stats == NULL)
+        return;
+    *stats = skimmer_stats;
+}
+
+void ble_skimmer_scan_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
+    if (!event || event->type != BLE_GAP_EVENT_DISC || adv->name_len == 0) {
+        return;
+    }
+
+    skimmer_stats.adverts_checked++;
+
+    int pattern = match_suspicious_name(adv->name, adv->name_len);
+    if (pattern < 0 || skimmer_report_queue == NULL) {
+        return;
+    }
+    skimmer_stats.matches++;
+    capture_stats_frame(CAPTURE_MODE_SKIMMER);
+
+    skimmer_detection_t detection;
+    memcpy(detection.addr, adv->addr, 6);
+    detection.addr_type = adv->addr_type;
+    detection.event_type = event->disc.event_type;
+    detection.rssi = adv->rssi;
+    detection.pattern = (uint8_t)pattern;
+    detection.data_len =
+        adv->data_len < sizeof(detection.data) ? adv->data_len : sizeof(detection.data);
+    memcpy(detection.data, adv->data, detection.data_len);
+    detection.detected_us = esp_timer_get_time();
+
+    if (xQueueSend(skimmer_report_queue, &detection, 0) != pdTRUE) {
+        skimmer_stats.dropped_reports++;
+        capture_stats_result(CAPTURE_MODE_SKIMMER, 0, ESP_ERR_NO_MEM);
+    }
+}
 #endif
+
@@ -0,0 +1,345 @@
+// capture_stats.c
+
+#include "core/capture_stats.h"
+#include "core/system_manager.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "managers/views/terminal_screen.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CAPTURE_STATS_REPORT_SAMPLES                                           \
+  (CAPTURE_STATS_REPORT_S * 1000 / CAPTURE_STATS_SAMPLE_MS)
+
+// Bumped from the Wi-Fi and NimBLE callbacks for every frame, so plain
+// relaxed increments: nothing is ordered against them and readers only
+// need each counter to be whole
+typedef struct {
+  atomic_uint frames;
+  atomic_uint written;
+  atomic_uint bytes;
+  atomic_uint dropped;
+  atomic_uint lock_timeouts;
+  atomic_uint flushes;
+  atomic_uint stalls;
+  atomic_uint flush_max_ms;
+} mode_counters_t;
+
+typedef struct {
+  int64_t time_us;
+  capture_rate_t totals;
+} rate_sample_t;
+
+static const char *mode_names[CAPTURE_MODE_COUNT] = {
+    "none", "probe", "deauth", "beacon", "raw",    "eapol",
+    "pwn",  "wps",   "pineap", "ble",    "skimmer"};
+
+static mode_counters_t counters[CAPTURE_MODE_COUNT];
+static atomic_int active_mode = CAPTURE_MODE_NONE;
+static int64_t started_us[CAPTURE_MODE_COUNT];
+static int64_t stopped_us[CAPTURE_MODE_COUNT];
+static bool mode_ran[CAPTURE_MODE_COUNT];
+
+// Totals of the active mode once per sample, the rates are differences
+// across this ring. Guarded because the web server and console read it.
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static rate_sample_t samples[CAPTURE_STATS_WINDOW + 1];
+static int sample_head = 0;
+static int sample_count = 0;
+static TaskHandle_t sampler_handle = NULL;
+
+static inline void bump(atomic_uint *counter, uint32_t n) {
+  atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+static inline uint32_t load(atomic_uint *counter) {
+  return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static bool mode_valid(capture_mode_t mode) {
+  return mode > CAPTURE_MODE_NONE && mode < CAPTURE_MODE_COUNT;
+}
+
+static void read_counters(capture_mode_t mode, capture_counters_t *out) {
+  mode_counters_t *c = &counters[mode];
+  out->frames = load(&c->frames);
+  out->written = load(&c->written);
+  out->bytes = load(&c->bytes);
+  out->dropped = load(&c->dropped);
+  out->lock_timeouts = load(&c->lock_timeouts);
+  out->flushes = load(&c->flushes);
+  out->stalls = load(&c->stalls);
+  out->flush_max_ms = load(&c->flush_max_ms);
+}
+
+static void take_sample(capture_mode_t mode) {
+  capture_counters_t now;
+  read_counters(mode, &now);
+  rate_sample_t sample = {.time_us = esp_timer_get_time(),
+                          .totals = {.frames = now.frames,
+                                     .written = now.written,
+                                     .bytes = now.bytes,
+                                     .dropped = now.dropped}};
+
+  portENTER_CRITICAL(&ring_lock);
+  // The mode may have been restarted while we read its counters
+  if ((capture_mode_t)atomic_load(&active_mode) == mode) {
+    samples[sample_head] = sample;
+    sample_head = (sample_head + 1) % (CAPTURE_STATS_WINDOW + 1);
+    if (sample_count < CAPTURE_STATS_WINDOW + 1) {
+      sample_count++;
+    }
+  }
+  portEXIT_CRITICAL(&ring_lock);
+}
+
+static void rate_between(const rate_sample_t *from, const rate_sample_t *to,
+                         capture_rate_t *rate) {
+  uint32_t span_ms = (uint32_t)((to->time_us - from->time_us) / 1000);
+  if (span_ms == 0) {
+    memset(rate, 0, sizeof(*rate));
+    return;
+  }
+  rate->frames = (uint64_t)(to->totals.frames - from->totals.frames) * 1000 / span_ms;
+  rate->written =
+      (uint64_t)(to->totals.written - from->totals.written) * 1000 / span_ms;
+  rate->bytes = (uint64_t)(to->totals.bytes - from->totals.bytes) * 1000 / span_ms;
+  rate->dropped =
+      (uint64_t)(to->totals.dropped - from->totals.dropped) * 1000 / span_ms;
+}
+
+static void compute_rates(capture_rate_t *rate_1s, capture_rate_t *rate_10s) {
+  const int ring = CAPTURE_STATS_WINDOW + 1;
+
+  memset(rate_1s, 0, sizeof(*rate_1s));
+  memset(rate_10s, 0, sizeof(*rate_10s));
+
+  portENTER_CRITICAL(&ring_lock);
+  if (sample_count >= 2) {
+    const rate_sample_t *newest = &samples[(sample_head + ring - 1) % ring];
+    const rate_sample_t *previous = &samples[(sample_head + ring - 2) % ring];
+    const rate_sample_t *oldest =
+        &samples[(sample_head + ring - sample_count) % ring];
+    rate_between(previous, newest, rate_1s);
+    rate_between(oldest, newest, rate_10s);
+  }
+  portEXIT_CRITICAL(&ring_lock);
+}
+
+static void print_rates(capture_mode_t mode) {
+  capture_stats_summary_t summary;
+  if (!capture_stats_get(mode, &summary)) {
+    return;
+  }
+
+  printf("%s: %lu fps, %lu written/s, %lu B/s, %lu dropped/s "
+         "(10s: %lu fps, %lu B/s, %lu dropped/s)\n",
+         mode_names[mode], (unsigned long)summary.rate_1s.frames,
+         (unsigned long)summary.rate_1s.written,
+         (unsigned long)summary.rate_1s.bytes,
+         (unsigned long)summary.rate_1s.dropped,
+         (unsigned long)summary.rate_10s.frames,
+         (unsigned long)summary.rate_10s.bytes,
+         (unsigned long)summary.rate_10s.dropped);
+  TERMINAL_VIEW_ADD_TEXT("%s: %lu fps\n%lu KB/s, %lu drop/s\n", mode_names[mode],
+                         (unsigned long)summary.rate_10s.frames,
+                         (unsigned long)(summary.rate_10s.bytes / 1024),
+                         (unsigned long)summary.rate_10s.dropped);
+}
+
+static void print_totals(capture_mode_t mode) {
+  capture_stats_summary_t summary;
+  if (!capture_stats_get(mode, &summary)) {
+    return;
+  }
+  const capture_counters_t *c = &summary.counters;
+
+  printf("%s capture%s: %lus, %lu frames, %lu written (%lu bytes), "
+         "%lu dropped (%lu lock timeouts)\n",
+         mode_names[mode], summary.active ? " (running)" : "",
+         (unsigned long)summary.elapsed_s, (unsigned long)c->frames,
+         (unsigned long)c->written, (unsigned long)c->bytes,
+         (unsigned long)c->dropped, (unsigned long)c->lock_timeouts);
+  printf("  %lu flushes, slowest %lu ms, %lu over %d ms\n",
+         (unsigned long)c->flushes, (unsigned long)c->flush_max_ms,
+         (unsigned long)c->stalls, CAPTURE_STATS_STALL_MS);
+  TERMINAL_VIEW_ADD_TEXT("%s: %lu frames\n%lu written, %lu dropped\n",
+                         mode_names[mode], (unsigned long)c->frames,
+                         (unsigned long)c->written, (unsigned long)c->dropped);
+
+  if (c->lock_timeouts > 0 || c->stalls > 0) {
+    printf("  SD card could not keep up, frames were lost while flushing\n");
+    TERMINAL_VIEW_ADD_TEXT("SD card too slow,\nframes were lost\n");
+  }
+}
+
+static void sampler_task(void *arg) {
+  TickType_t last_wake = xTaskGetTickCount();
+  uint32_t ticks = 0;
+
+  while (1) {
+    if (atomic_load(&active_mode) == CAPTURE_MODE_NONE) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      last_wake = xTaskGetTickCount();
+      ticks = 0;
+      continue;
+    }
+
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CAPTURE_STATS_SAMPLE_MS));
+
+    capture_mode_t mode = (capture_mode_t)atomic_load(&active_mode);
+    if (mode == CAPTURE_MODE_NONE) {
+      continue;
+    }
+    take_sample(mode);
+    if (++ticks % CAPTURE_STATS_REPORT_SAMPLES == 0) {
+      print_rates(mode);
+    }
+  }
+}
+
+void capture_stats_start(capture_mode_t mode) {
+  if (!mode_valid(mode)) {
+    return;
+  }
+
+  capture_mode_t previous =
+      (capture_mode_t)atomic_exchange(&active_mode, CAPTURE_MODE_NONE);
+  if (previous != CAPTURE_MODE_NONE) {
+    stopped_us[previous] = esp_timer_get_time();
+  }
+
+  mode_counters_t *c = &counters[mode];
+  atomic_store(&c->frames, 0);
+  atomic_store(&c->written, 0);
+  atomic_store(&c->bytes, 0);
+  atomic_store(&c->dropped, 0);
+  atomic_store(&c->lock_timeouts, 0);
+  atomic_store(&c->flushes, 0);
+  atomic_store(&c->stalls, 0);
+  atomic_store(&c->flush_max_ms, 0);
+
+  portENTER_CRITICAL(&ring_lock);
+  sample_head = 0;
+  sample_count = 0;
+  portEXIT_CRITICAL(&ring_lock);
+
+  started_us[mode] = esp_timer_get_time();
+  stopped_us[mode] = 0;
+  mode_ran[mode] = true;
+  atomic_store(&active_mode, mode);
+  take_sample(mode); // Zero baseline, the first rate is ready after a second
+
+  if (sampler_handle == NULL) {
+    if (!system_manager_create_task(sampler_task, "capture_stats", 3072, NULL,
+                                    1, &sampler_handle, NULL)) {
+      printf("Failed to create capture_stats task\n");
+      sampler_handle = NULL;
+    }
+  } else {
+    xTaskNotifyGive(sampler_handle);
+  }
+}
+
+void capture_stats_stop(void) {
+  capture_mode_t mode =
+      (capture_mode_t)atomic_exchange(&active_mode, CAPTURE_MODE_NONE);
+  if (mode == CAPTURE_MODE_NONE) {
+    return;
+  }
+  stopped_us[mode] = esp_timer_get_time();
+  print_totals(mode);
+}
+
+capture_mode_t capture_stats_active(void) {
+  return (capture_mode_t)atomic_load(&active_mode);
+}
+
+void capture_stats_frame(capture_mode_t mode) {
+  if (mode_valid(mode)) {
+    bump(&counters[mode].frames, 1);
+  }
+}
+
+void capture_stats_result(capture_mode_t mode, size_t bytes, esp_err_t ret) {
+  if (!mode_valid(mode)) {
+    return;
+  }
+  mode_counters_t *c = &counters[mode];
+  if (ret == ESP_OK) {
+    bump(&c->written, 1);
+    bump(&c->bytes, (uint32_t)bytes);
+    return;
+  }
+  bump(&c->dropped, 1);
+  if (ret == ESP_ERR_TIMEOUT) {
+    bump(&c->lock_timeouts, 1);
+  }
+}
+
+void capture_stats_flush(size_t bytes, uint32_t elapsed_us) {
+  (void)bytes;
+  capture_mode_t mode = (capture_mode_t)atomic_load(&active_mode);
+  if (!mode_valid(mode)) {
+    return;
+  }
+  mode_counters_t *c = &counters[mode];
+  uint32_t elapsed_ms = elapsed_us / 1000;
+
+  bump(&c->flushes, 1);
+  if (elapsed_ms > CAPTURE_STATS_STALL_MS) {
+    bump(&c->stalls, 1);
+  }
+  // Flushes are serialized by the PCAP mutex, no compare-and-swap needed
+  if (elapsed_ms > load(&c->flush_max_ms)) {
+    atomic_store_explicit(&c->flush_max_ms, elapsed_ms, memory_order_relaxed);
+  }
+}
+
+bool capture_stats_get(capture_mode_t mode, capture_stats_summary_t *summary) {
+  if (!mode_valid(mode) || !mode_ran[mode]) {
+    return false;
+  }
+
+  memset(summary, 0, sizeof(*summary));
+  summary->mode = mode;
+  summary->active = capture_stats_active() == mode;
+  read_counters(mode, &summary->counters);
+
+  int64_t end_us = summary->active || stopped_us[mode] == 0
+                       ? esp_timer_get_time()
+                       : stopped_us[mode];
+  summary->elapsed_s = (uint32_t)((end_us - started_us[mode]) / 1000000);
+
+  if (summary->active) {
+    compute_rates(&summary->rate_1s, &summary->rate_10s);
+  }
+  return true;
+}
+
+void capture_stats_print(void) {
+  bool any = false;
+  capture_mode_t active = capture_stats_active();
+
+  for (int i = CAPTURE_MODE_NONE + 1; i < CAPTURE_MODE_COUNT; i++) {
+    if (!mode_ran[i]) {
+      continue;
+    }
+    any = true;
+    print_totals((capture_mode_t)i);
+    if (i == active) {
+      print_rates(active);
+    }
+  }
+
+  if (!any) {
+    printf("No capture has run yet\n");
+    TERMINAL_VIEW_ADD_TEXT("No capture has run yet\n");
+  }
+}
+
+const char *capture_stats_mode_name(capture_mode_t mode) {
+  return mode < CAPTURE_MODE_COUNT ? mode_names[mode] : "unknown";
+}
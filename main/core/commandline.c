@@ -2,10 +2,14 @@
 
 #include "core/commandline.h"
 #include "core/callbacks.h"
+#include "core/capture_stats.h"
+#include "core/sys_stats.h"
+#include "core/system_manager.h"
 #include "esp_sntp.h"
 #include "managers/ap_manager.h"
 #include "managers/ble_manager.h"
 #include "managers/dial_manager.h"
+#include "managers/display_manager.h"
 #include "managers/rgb_manager.h"
 #include "managers/settings_manager.h"
 #include "managers/wifi_manager.h"
@@ -265,9 +269,7 @@ void handle_stop_flipper(int argc, char **argv) {
 #ifndef CONFIG_IDF_TARGET_ESP32S2
     ble_stop();
 #endif
-    if (buffer_offset > 0) { // Only flush if there's data in buffer
-        csv_flush_buffer_to_file();
-    }
+    csv_flush_buffer_to_file(); // No-op when the buffer is empty
     csv_file_close();                  // Close any open CSV files
     gps_manager_deinit(&g_gpsManager); // Clean up GPS if active
     wifi_manager_stop_monitor_mode();  // Stop any active monitoring
@@ -289,7 +291,7 @@ void handle_dial_command(int argc, char **argv) {
     if (argc == 2) {
         dial_manager_set_device_name(argv[1]);
     }
-    xTaskCreate(&discover_task, "discover_task", 10240, NULL, 5, NULL);
+    system_manager_create_task(discover_task, "discover_task", 10240, NULL, 5, NULL, NULL);
 }
 
 void handle_wifi_connection(int argc, char **argv) {
@@ -390,9 +392,11 @@ void handle_wifi_connection(int argc, char **argv) {
 
     if (VisualizerHandle == NULL) {
 #ifdef WITH_SCREEN
-        xTaskCreate(screen_music_visualizer_task, "udp_server", 4096, NULL, 5, &VisualizerHandle);
+        system_manager_create_task(screen_music_visualizer_task, "udp_server", 4096, NULL, 5,
+                                   &VisualizerHandle, NULL);
 #else
-        xTaskCreate(animate_led_based_on_amplitude, "udp_server", 4096, NULL, 5, &VisualizerHandle);
+        system_manager_create_task(animate_led_based_on_amplitude, "udp_server", 4096, NULL, 5,
+                                   &VisualizerHandle, NULL);
 #endif
     }
 
@@ -441,6 +445,11 @@ void handle_ble_scan_cmd(int argc, char **argv) {
         return;
     }
 
+    if (argc > 1 && strcmp(argv[1], "-stats") == 0) {
+        ble_print_scan_stats();
+        return;
+    }
+
     printf("Invalid Command Syntax.\n");
     TERMINAL_VIEW_ADD_TEXT("Invalid Command Syntax.\n");
 }
@@ -659,6 +668,7 @@ void handle_capture_scan(int argc, char **argv) {
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_PROBE);
         wifi_manager_start_monitor_mode(wifi_probe_scan_callback);
     }
 
@@ -670,6 +680,7 @@ void handle_capture_scan(int argc, char **argv) {
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_DEAUTH);
         wifi_manager_start_monitor_mode(wifi_deauth_scan_callback);
     }
 
@@ -683,6 +694,7 @@ void handle_capture_scan(int argc, char **argv) {
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_BEACON);
         wifi_manager_start_monitor_mode(wifi_beacon_scan_callback);
     }
 
@@ -696,6 +708,7 @@ void handle_capture_scan(int argc, char **argv) {
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_RAW);
         wifi_manager_start_monitor_mode(wifi_raw_scan_callback);
     }
 
@@ -709,6 +722,7 @@ void handle_capture_scan(int argc, char **argv) {
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_EAPOL);
         wifi_manager_start_monitor_mode(wifi_eapol_scan_callback);
     }
 
@@ -722,6 +736,7 @@ void handle_capture_scan(int argc, char **argv) {
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_PWN);
         wifi_manager_start_monitor_mode(wifi_pwn_scan_callback);
     }
 
@@ -731,15 +746,22 @@ void handle_capture_scan(int argc, char **argv) {
         int err = pcap_file_open("wpsscan", PCAP_CAPTURE_WIFI);
 
         should_store_wps = 0;
+        wps_detection_reset();
 
         if (err != ESP_OK) {
             printf("Error: pcap failed to open\n");
             TERMINAL_VIEW_ADD_TEXT("Error: pcap failed to open\n");
             return;
         }
+        capture_stats_start(CAPTURE_MODE_WPS);
         wifi_manager_start_monitor_mode(wifi_wps_detection_callback);
     }
 
+    if (strcmp(capturetype, "-stats") == 0) {
+        capture_stats_print();
+        return;
+    }
+
     if (strcmp(capturetype, "-stop") == 0) {
         printf("Stopping packet capture...\n");
         TERMINAL_VIEW_ADD_TEXT("Stopping packet capture...\n");
@@ -767,6 +789,7 @@ void handle_capture_scan(int argc, char **argv) {
         } else {
             printf("PCAP capture started\nMonitoring devices\n");
             TERMINAL_VIEW_ADD_TEXT("PCAP capture started\nMonitoring devices\n");
+            capture_stats_start(CAPTURE_MODE_SKIMMER);
         }
         // Start skimmer detection
         ble_start_skimmer_detection();
@@ -1031,6 +1054,7 @@ void handle_help(int argc, char **argv) {
     printf("        -ds  : Start BLE spam detector\n");
     printf("        -a   : Start AirTag scanner\n");
     printf("        -r   : Scan for raw BLE packets\n");
+    printf("        -stats: Show adverts and unique devices per second\n");
     printf("        -s   : Stop BLE scanning\n\n");
     TERMINAL_VIEW_ADD_TEXT("blescan\n");
     TERMINAL_VIEW_ADD_TEXT("    Description: Handle BLE scanning with various modes.\n");
@@ -1040,6 +1064,7 @@ void handle_help(int argc, char **argv) {
     TERMINAL_VIEW_ADD_TEXT("        -ds  : Start BLE spam detector\n");
     TERMINAL_VIEW_ADD_TEXT("        -a   : Start AirTag scanner\n");
     TERMINAL_VIEW_ADD_TEXT("        -r   : Scan for raw BLE packets\n");
+    TERMINAL_VIEW_ADD_TEXT("        -stats: Show scan statistics\n");
     TERMINAL_VIEW_ADD_TEXT("        -s   : Stop BLE scanning\n\n");
 #endif
 
@@ -1053,7 +1078,8 @@ void handle_help(int argc, char **argv) {
     printf("        -raw   :   Start Capturing Raw Packets\n");
     printf("        -wps   :   Start Capturing WPS Packets and there Auth Type");
     printf("        -pwn   :   Start Capturing Pwnagotchi Packets");
-    printf("        -stop   : Stops the active capture\n\n");
+    printf("        -stop   : Stops the active capture\n");
+    printf("        -stats  : Frame rates, drops and SD flush times\n\n");
     TERMINAL_VIEW_ADD_TEXT("capture\n");
     TERMINAL_VIEW_ADD_TEXT("    Description: Start a WiFi Capture (Requires SD Card or Flipper)\n");
     TERMINAL_VIEW_ADD_TEXT("    Usage: capture [OPTION]\n");
@@ -1064,7 +1090,8 @@ void handle_help(int argc, char **argv) {
     TERMINAL_VIEW_ADD_TEXT("        -raw   :   Start Capturing Raw Packets\n");
     TERMINAL_VIEW_ADD_TEXT("        -wps   :   Start Capturing WPS Packets and there Auth Type");
     TERMINAL_VIEW_ADD_TEXT("        -pwn   :   Start Capturing Pwnagotchi Packets");
-    TERMINAL_VIEW_ADD_TEXT("        -stop   : Stops the active capture\n\n");
+    TERMINAL_VIEW_ADD_TEXT("        -stop   : Stops the active capture\n");
+    TERMINAL_VIEW_ADD_TEXT("        -stats  : Frame rates and drops\n\n");
 
     printf("connect\n");
     printf("    Description: Connects to Specific WiFi Network and saves credentials.\n");
@@ -1219,6 +1246,37 @@ void handle_help(int argc, char **argv) {
     TERMINAL_VIEW_ADD_TEXT("    Description: Save current SD pin config to SD card.\n");
     TERMINAL_VIEW_ADD_TEXT("    Usage: sd_save_config\n\n");
 
+    printf("sd_stats\n");
+    printf("    Description: Show SD append cache statistics (hit rate, bytes per write).\n");
+    printf("    Usage: sd_stats [-sync|-reset]\n\n");
+    TERMINAL_VIEW_ADD_TEXT("sd_stats\n");
+    TERMINAL_VIEW_ADD_TEXT("    Description: Show SD append cache stats.\n");
+    TERMINAL_VIEW_ADD_TEXT("    Usage: sd_stats [-sync|-reset]\n\n");
+
+    printf("sysstats\n");
+    printf("    Description: Show heap per capability, task stack high-water marks\n");
+    printf("                 and allocation counts per subsystem.\n");
+    printf("    Usage: sysstats [-sample]\n\n");
+    TERMINAL_VIEW_ADD_TEXT("sysstats\n");
+    TERMINAL_VIEW_ADD_TEXT("    Description: Show heap and stack stats.\n");
+    TERMINAL_VIEW_ADD_TEXT("    Usage: sysstats [-sample]\n\n");
+
+    printf("renderstats\n");
+    printf("    Description: Show frames, invalidated and merged areas and pixels\n");
+    printf("                 rendered per second. -trace prints every area per frame.\n");
+    printf("    Usage: renderstats [-trace|-reset]\n\n");
+    TERMINAL_VIEW_ADD_TEXT("renderstats\n");
+    TERMINAL_VIEW_ADD_TEXT("    Description: Show display render stats.\n");
+    TERMINAL_VIEW_ADD_TEXT("    Usage: renderstats [-trace|-reset]\n\n");
+
+    printf("top\n");
+    printf("    Description: Show CPU use, state and free stack of every task over\n");
+    printf("                 a sliding window. Starts the profiler on first use.\n");
+    printf("    Usage: top [-list|-stop]\n\n");
+    TERMINAL_VIEW_ADD_TEXT("top\n");
+    TERMINAL_VIEW_ADD_TEXT("    Description: Show task CPU use.\n");
+    TERMINAL_VIEW_ADD_TEXT("    Usage: top [-list|-stop]\n\n");
+
     printf("scanall\n");
     printf("    Description: Perform combined AP and Station scan, display results.\n");
     printf("    Usage: scanall [seconds]\n\n");
@@ -1322,7 +1380,8 @@ void handle_gps_info(int argc, char **argv) {
             vTaskDelay(pdMS_TO_TICKS(100));
 
             // Start the info display task
-            xTaskCreate(gps_info_display_task, "gps_info", 4096, NULL, 1, &gps_info_task_handle);
+            system_manager_create_task(gps_info_display_task, "gps_info", 4096, NULL, 1,
+                                       &gps_info_task_handle, NULL);
             printf("GPS info started.\n");
             TERMINAL_VIEW_ADD_TEXT("GPS info started.\n");
         }
@@ -1344,9 +1403,7 @@ void handle_ble_wardriving(int argc, char **argv) {
     if (stop_flag) {
         ble_stop();
         gps_manager_deinit(&g_gpsManager);
-        if (buffer_offset > 0) { // Only flush if there's data in buffer
-            csv_flush_buffer_to_file();
-        }
+        csv_flush_buffer_to_file(); // No-op when the buffer is empty
         csv_file_close();
         printf("BLE wardriving stopped.\n");
         TERMINAL_VIEW_ADD_TEXT("BLE wardriving stopped.\n");
@@ -1363,7 +1420,7 @@ void handle_ble_wardriving(int argc, char **argv) {
         }
 
         ble_register_handler(ble_wardriving_callback);
-        ble_start_scanning();
+        ble_start_scanning_profile(BLE_SCAN_PROFILE_DISCOVERY);
         printf("BLE wardriving started.\n");
         TERMINAL_VIEW_ADD_TEXT("BLE wardriving started.\n");
     }
@@ -1384,6 +1441,8 @@ void handle_pineap_detection(int argc, char **argv) {
     if (err != ESP_OK) {
         printf("Warning: Failed to open PCAP file for logging\n");
         TERMINAL_VIEW_ADD_TEXT("Warning: Failed to open PCAP file for logging\n");
+    } else {
+        capture_stats_start(CAPTURE_MODE_PINEAP);
     }
 
     // Start PineAP detection with channel hopping
@@ -1490,17 +1549,20 @@ void handle_rgb_mode(int argc, char **argv) {
 
     // Check for built-in modes first.
     if (strcasecmp(argv[1], "rainbow") == 0) {
-        xTaskCreate(rainbow_task, "rainbow_effect", 4096, &rgb_manager, 5, &rgb_effect_task_handle);
+        system_manager_create_task(rainbow_task, "rainbow_effect", 4096, &rgb_manager, 5,
+                                   &rgb_effect_task_handle, NULL);
         printf("Rainbow mode activated\n");
         TERMINAL_VIEW_ADD_TEXT("Rainbow mode activated\n");
     } else if (strcasecmp(argv[1], "police") == 0) {
-        xTaskCreate(police_task, "police_effect", 4096, &rgb_manager, 5, &rgb_effect_task_handle);
+        system_manager_create_task(police_task, "police_effect", 4096, &rgb_manager, 5,
+                                   &rgb_effect_task_handle, NULL);
         printf("Police mode activated\n");
         TERMINAL_VIEW_ADD_TEXT("Police mode activated\n");
     } else if (strcasecmp(argv[1], "strobe") == 0) {
         printf("SEIZURE WARNING\nPLEASE EXIT NOW IF\nYOU ARE SENSITIVE\n");
         vTaskDelay(pdMS_TO_TICKS(2000));
-        xTaskCreate(strobe_task, "strobe_effect", 4096, &rgb_manager, 5, &rgb_effect_task_handle);
+        system_manager_create_task(strobe_task, "strobe_effect", 4096, &rgb_manager, 5,
+                                   &rgb_effect_task_handle, NULL);
         printf("Strobe mode activated\n");
         TERMINAL_VIEW_ADD_TEXT("Strobe mode activated\n");
     } else if (strcasecmp(argv[1], "off") == 0) {
@@ -1646,6 +1708,73 @@ void handle_sd_save_config(int argc, char **argv) {
   sd_card_save_config();
 }
 
+void handle_sd_stats(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "-reset") == 0) {
+    sd_card_reset_io_stats();
+    printf("SD append statistics reset.\n");
+    TERMINAL_VIEW_ADD_TEXT("SD append statistics reset.\n");
+    return;
+  }
+  if (argc > 1 && strcmp(argv[1], "-sync") == 0) {
+    sd_card_sync(NULL);
+  }
+
+  sd_io_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  sd_card_get_io_stats(&stats);
+  sd_card_print_io_stats();
+
+  uint32_t lookups = stats.handle_hits + stats.handle_misses;
+  char line[96];
+  snprintf(line, sizeof(line), "SD appends: %lu, hit %lu%%, %lu B/write\n",
+           (unsigned long)stats.append_calls,
+           (unsigned long)(lookups ? (stats.handle_hits * 100) / lookups : 0),
+           (unsigned long)(stats.physical_writes
+                               ? stats.bytes_written / stats.physical_writes
+                               : 0));
+  TERMINAL_VIEW_ADD_TEXT(line);
+}
+
+void handle_sysstats(int argc, char **argv) {
+  // Stats are otherwise up to SYS_STATS_SAMPLE_MS old
+  if (argc > 1 && strcmp(argv[1], "-sample") == 0) {
+    sys_stats_sample();
+  }
+  sys_stats_print();
+}
+
+void handle_renderstats(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "-reset") == 0) {
+    display_manager_reset_render_stats();
+    printf("Render statistics reset.\n");
+    TERMINAL_VIEW_ADD_TEXT("Render statistics reset.\n");
+    return;
+  }
+  if (argc > 1 && strcmp(argv[1], "-trace") == 0) {
+    static bool trace = false;
+    trace = !trace;
+    display_manager_set_render_trace(trace);
+    printf("Render area trace %s.\n", trace ? "on" : "off");
+    TERMINAL_VIEW_ADD_TEXT("Render area trace %s.\n", trace ? "on" : "off");
+    return;
+  }
+  display_manager_print_render_stats();
+}
+
+void handle_top_cmd(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "-stop") == 0) {
+    system_manager_profiler_stop();
+    printf("Task profiler stopped.\n");
+    TERMINAL_VIEW_ADD_TEXT("Task profiler stopped.\n");
+    return;
+  }
+  if (argc > 1 && strcmp(argv[1], "-list") == 0) {
+    system_manager_list_tasks();
+    return;
+  }
+  system_manager_print_top();
+}
+
 void handle_congestion_cmd(int argc, char **argv) {
     wifi_manager_start_scan();
 
@@ -1945,6 +2074,10 @@ void register_commands() {
     register_command("sd_pins_mmc", handle_sd_pins_mmc);
     register_command("sd_pins_spi", handle_sd_pins_spi);
     register_command("sd_save_config", handle_sd_save_config);
+    register_command("sd_stats", handle_sd_stats);
+    register_command("sysstats", handle_sysstats);
+    register_command("renderstats", handle_renderstats);
+    register_command("top", handle_top_cmd);
     register_command("scanall", handle_scanall);
     register_command("timezone", handle_timezone_cmd);
 #ifndef CONFIG_IDF_TARGET_ESP32S2
@@ -5,6 +5,7 @@
  */
 
 #include <inttypes.h>
+#include <strings.h>
 #include <sys/param.h>
 
 #include "esp_check.h"
@@ -13,18 +14,37 @@
 #include "esp_system.h"
 
 #include "core/dns_server.h"
+#include "core/system_manager.h"
 #include "lwip/err.h"
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 
 #define DNS_PORT (53)
-#define DNS_MAX_LEN (256)
+#define DNS_MAX_LEN (512)
+#define DNS_HEADER_LEN (12)
+#define DNS_NAME_MAX (253)
+#define DNS_LABEL_MAX (63)
 
+#define QR_FLAG (0x8000)
 #define OPCODE_MASK (0x7800)
-#define QR_FLAG (1 << 7)
+#define RD_FLAG (0x0100)
+#define RCODE_FORMERR (1)
+#define RCODE_NXDOMAIN (3)
+#define RCODE_NOTIMP (4)
 #define QD_TYPE_A (0x0001)
+#define QD_TYPE_ANY (0x00FF)
+#define QD_CLASS_IN (0x0001)
 #define ANS_TTL_SEC (300)
+// Name pointer to the question, type, class, TTL, length and the address
+#define ANSWER_LEN (16)
+
+// Answers for recently asked names. Names longer than the key are answered
+// without caching. Entries are refreshed after a while since netif
+// addresses can change.
+#define DNS_CACHE_SLOTS (16)
+#define DNS_CACHE_NAME_LEN (64)
+#define DNS_CACHE_MAX_AGE_MS (10000)
 
 static const char *TAG = "dns_redirect_server";
 
@@ -38,154 +58,267 @@ typedef struct __attribute__((__packed__)) {
   uint16_t ar_count;
 } dns_header_t;
 
-// DNS Question Packet
+// A configured entry and its A record, built once at start
 typedef struct {
-  uint16_t type;
-  uint16_t class;
-} dns_question_t;
+  dns_entry_pair_t pair;
+  uint8_t answer[ANSWER_LEN];
+} dns_rule_t;
 
-// DNS Answer Packet
-typedef struct __attribute__((__packed__)) {
-  uint16_t ptr_offset;
+typedef struct {
+  bool used;
+  uint32_t hash;
   uint16_t type;
   uint16_t class;
-  uint32_t ttl;
-  uint16_t addr_len;
-  uint32_t ip_addr;
-} dns_answer_t;
+  TickType_t filled;
+  char name[DNS_CACHE_NAME_LEN];
+  uint8_t rcode;
+  uint8_t an_count;
+  uint8_t answer[ANSWER_LEN];
+} dns_cached_answer_t;
 
 // DNS server handle
 struct dns_server_handle {
   bool started;
   TaskHandle_t task;
+  dns_server_stats_t stats;
+  TickType_t second_start;
+  uint32_t second_queries;
+  dns_cached_answer_t cache[DNS_CACHE_SLOTS];
+  dns_cached_answer_t uncached;
   int num_of_entries;
-  dns_entry_pair_t entry[];
+  dns_rule_t entry[];
 };
 
+static uint16_t read_be16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+
+static void write_be16(uint8_t *p, uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v & 0xFF;
+}
+
 /*
-    Parse the name from the packet from the DNS name format to a regular
-   .-seperated name returns the pointer to the next part of the packet
+    Parse the question name at offset into a lowercase .-separated name of
+   *parsed_len chars. Returns the offset after it, or -1 if the name is
+   malformed or runs past the packet. Queries carry no compression pointers,
+   so they are rejected.
 */
-static char *parse_dns_name(char *raw_name, char *parsed_name,
-                            size_t parsed_name_max_len) {
-
-  char *label = raw_name;
-  char *name_itr = parsed_name;
+static int parse_dns_name(const uint8_t *req, int req_len, int offset,
+                          char *parsed_name, int *parsed_len) {
   int name_len = 0;
 
-  do {
-    int sub_name_len = *label;
-    // (len + 1) since we are adding  a '.'
-    name_len += (sub_name_len + 1);
-    if (name_len > parsed_name_max_len) {
-      return NULL;
+  for (;;) {
+    if (offset >= req_len) {
+      return -1;
+    }
+    int sub_name_len = req[offset++];
+    if (sub_name_len == 0) {
+      break;
+    }
+    if (sub_name_len > DNS_LABEL_MAX || offset + sub_name_len > req_len ||
+        name_len + (name_len > 0) + sub_name_len > DNS_NAME_MAX) {
+      return -1;
+    }
+    if (name_len > 0) {
+      parsed_name[name_len++] = '.';
     }
+    for (int i = 0; i < sub_name_len; i++) {
+      uint8_t c = req[offset + i];
+      parsed_name[name_len++] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    offset += sub_name_len;
+  }
 
-    // Copy the sub name that follows the the label
-    memcpy(name_itr, label + 1, sub_name_len);
-    name_itr[sub_name_len] = '.';
-    name_itr += (sub_name_len + 1);
-    label += sub_name_len + 1;
-  } while (*label != 0);
-
-  // Terminate the final string, replacing the last '.'
-  parsed_name[name_len - 1] = '\0';
-  // Return pointer to first char after the name
-  return label + 1;
+  parsed_name[name_len] = '\0';
+  *parsed_len = name_len;
+  return offset;
 }
 
-// Parses the DNS request and prepares a DNS response with the IP of the softAP
-static int parse_dns_request(char *req, size_t req_len, char *dns_reply,
-                             size_t dns_reply_max_len, dns_server_handle_t h) {
-  if (req_len > dns_reply_max_len) {
-    return -1;
+// "*" matches every name, "*.example.com" any name below example.com
+static bool name_matches(const char *pattern, const char *name) {
+  if (strcmp(pattern, "*") == 0) {
+    return true;
+  }
+  if (strncmp(pattern, "*.", 2) == 0) {
+    const char *suffix = pattern + 1;
+    size_t name_len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return name_len > suffix_len &&
+           strcasecmp(name + name_len - suffix_len, suffix) == 0;
   }
+  return strcasecmp(pattern, name) == 0;
+}
 
-  // Prepare the reply
-  memset(dns_reply, 0, dns_reply_max_len);
-  memcpy(dns_reply, req, req_len);
+static void build_answer_template(dns_rule_t *rule) {
+  uint8_t *answer = rule->answer;
+  write_be16(answer, 0xC000 | DNS_HEADER_LEN);
+  write_be16(answer + 2, QD_TYPE_A);
+  write_be16(answer + 4, QD_CLASS_IN);
+  write_be16(answer + 6, ANS_TTL_SEC >> 16);
+  write_be16(answer + 8, ANS_TTL_SEC & 0xFFFF);
+  write_be16(answer + 10, sizeof(rule->pair.ip.addr));
+  memcpy(answer + 12, &rule->pair.ip.addr, sizeof(rule->pair.ip.addr));
+}
 
-  // Endianess of NW packet different from chip
-  dns_header_t *header = (dns_header_t *)dns_reply;
-  ESP_LOGD(TAG, "DNS query with header id: 0x%X, flags: 0x%X, qd_count: %d",
-           ntohs(header->id), ntohs(header->flags), ntohs(header->qd_count));
+// Answers from the first rule that matches and has an address, NXDOMAIN if
+// none does. Names that match get no records for types other than A.
+static void resolve_name(dns_server_handle_t h, const char *name,
+                         uint16_t qd_type, uint16_t qd_class,
+                         dns_cached_answer_t *out) {
+  out->rcode = RCODE_NXDOMAIN;
+  out->an_count = 0;
+
+  for (int i = 0; i < h->num_of_entries; ++i) {
+    dns_rule_t *rule = &h->entry[i];
+    if (!name_matches(rule->pair.name, name)) {
+      continue;
+    }
+    if (rule->pair.if_key) {
+      esp_netif_ip_info_t ip_info = {0};
+      esp_netif_get_ip_info(
+          esp_netif_get_handle_from_ifkey(rule->pair.if_key), &ip_info);
+      if (ip_info.ip.addr == IPADDR_ANY) {
+        continue;
+      }
+      memcpy(rule->answer + 12, &ip_info.ip.addr, sizeof(ip_info.ip.addr));
+    } else if (rule->pair.ip.addr == IPADDR_ANY) {
+      continue;
+    }
 
-  // Not a standard query
-  if ((header->flags & OPCODE_MASK) != 0) {
-    return 0;
+    out->rcode = 0;
+    if ((qd_type == QD_TYPE_A || qd_type == QD_TYPE_ANY) &&
+        qd_class == QD_CLASS_IN) {
+      memcpy(out->answer, rule->answer, ANSWER_LEN);
+      out->an_count = 1;
+    }
+    return;
   }
+}
 
-  // Set question response flag
-  header->flags |= QR_FLAG;
+static uint32_t cache_hash(const char *name, int name_len, uint16_t qd_type,
+                           uint16_t qd_class) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < name_len; i++) {
+    hash ^= (uint8_t)name[i];
+    hash *= 16777619u;
+  }
+  hash ^= ((uint32_t)qd_type << 16) | qd_class;
+  hash *= 16777619u;
+  return hash;
+}
 
-  uint16_t qd_count = ntohs(header->qd_count);
-  header->an_count = htons(qd_count);
+static const dns_cached_answer_t *lookup_answer(dns_server_handle_t h,
+                                                const char *name, int name_len,
+                                                uint16_t qd_type,
+                                                uint16_t qd_class,
+                                                TickType_t now) {
+  if (name_len >= DNS_CACHE_NAME_LEN) {
+    resolve_name(h, name, qd_type, qd_class, &h->uncached);
+    return &h->uncached;
+  }
 
-  int reply_len = qd_count * sizeof(dns_answer_t) + req_len;
-  if (reply_len > dns_reply_max_len) {
-    return -1;
+  uint32_t hash = cache_hash(name, name_len, qd_type, qd_class);
+  dns_cached_answer_t *slot = &h->cache[hash % DNS_CACHE_SLOTS];
+  if (slot->used && slot->hash == hash && slot->type == qd_type &&
+      slot->class == qd_class &&
+      now - slot->filled < pdMS_TO_TICKS(DNS_CACHE_MAX_AGE_MS) &&
+      memcmp(slot->name, name, name_len + 1) == 0) {
+    h->stats.cache_hits++;
+    return slot;
   }
 
-  // Pointer to current answer and question
-  char *cur_ans_ptr = dns_reply + req_len;
-  char *cur_qd_ptr = dns_reply + sizeof(dns_header_t);
-  char name[128];
+  resolve_name(h, name, qd_type, qd_class, slot);
+  slot->used = true;
+  slot->hash = hash;
+  slot->type = qd_type;
+  slot->class = qd_class;
+  slot->filled = now;
+  memcpy(slot->name, name, name_len + 1);
+  return slot;
+}
 
-  // Respond to all questions based on configured rules
-  for (int qd_i = 0; qd_i < qd_count; qd_i++) {
-    char *name_end_ptr = parse_dns_name(cur_qd_ptr, name, sizeof(name));
-    if (name_end_ptr == NULL) {
-      ESP_LOGE(TAG, "Failed to parse DNS question: %s", cur_qd_ptr);
-      return -1;
-    }
+// Builds the reply to a query received at now, echoing its question.
+// Returns the reply length, or -1 if the packet is not a query and gets no
+// reply.
+static int parse_dns_request(const uint8_t *req, int req_len,
+                             uint8_t *dns_reply, dns_server_handle_t h,
+                             TickType_t now) {
+  if (req_len < DNS_HEADER_LEN || (read_be16(req + 2) & QR_FLAG)) {
+    h->stats.malformed++;
+    return -1;
+  }
 
-    dns_question_t *question = (dns_question_t *)(name_end_ptr);
-    uint16_t qd_type = ntohs(question->type);
-    uint16_t qd_class = ntohs(question->class);
-
-    ESP_LOGD(TAG, "Received type: %d | Class: %d | Question for: %s", qd_type,
-             qd_class, name);
-
-    if (qd_type == QD_TYPE_A) {
-      esp_ip4_addr_t ip = {.addr = IPADDR_ANY};
-      // Check the configured rules to decide whether to answer this question or
-      // not
-      for (int i = 0; i < h->num_of_entries; ++i) {
-        // check if the name either corresponds to the entry, or if we should
-        // answer to all queries ("*")
-        if (strcmp(h->entry[i].name, "*") == 0 ||
-            strcmp(h->entry[i].name, name) == 0) {
-          if (h->entry[i].if_key) {
-            esp_netif_ip_info_t ip_info;
-            esp_netif_get_ip_info(
-                esp_netif_get_handle_from_ifkey(h->entry[i].if_key), &ip_info);
-            ip.addr = ip_info.ip.addr;
-            break;
-          } else if (h->entry->ip.addr != IPADDR_ANY) {
-            ip.addr = h->entry[i].ip.addr;
-            break;
-          }
-        }
-      }
-      if (ip.addr ==
-          IPADDR_ANY) { // no rule applies, continue with another question
-        continue;
+  uint16_t flags = read_be16(req + 2);
+  uint16_t qd_count = read_be16(req + 4);
+  ESP_LOGD(TAG, "DNS query with header id: 0x%X, flags: 0x%X, qd_count: %d",
+           read_be16(req), flags, qd_count);
+
+  int question_len = 0;
+  uint8_t rcode = 0;
+  const dns_cached_answer_t *answer = NULL;
+
+  if ((flags & OPCODE_MASK) != 0) {
+    // Not a standard query
+    rcode = RCODE_NOTIMP;
+  } else {
+    char name[DNS_NAME_MAX + 1];
+    int name_len = 0;
+    int name_end = qd_count == 1 ? parse_dns_name(req, req_len,
+                                                  DNS_HEADER_LEN, name,
+                                                  &name_len)
+                                 : -1;
+    if (name_end < 0 || name_end + 4 > req_len) {
+      h->stats.malformed++;
+      rcode = RCODE_FORMERR;
+    } else {
+      uint16_t qd_type = read_be16(req + name_end);
+      uint16_t qd_class = read_be16(req + name_end + 2);
+      ESP_LOGD(TAG, "Received type: %d | Class: %d | Question for: %s",
+               qd_type, qd_class, name);
+
+      question_len = name_end + 4 - DNS_HEADER_LEN;
+      answer = lookup_answer(h, name, name_len, qd_type, qd_class, now);
+      rcode = answer->rcode;
+      if (answer->an_count > 0) {
+        h->stats.answered++;
+      } else if (rcode == RCODE_NXDOMAIN) {
+        h->stats.not_found++;
       }
-      dns_answer_t *answer = (dns_answer_t *)cur_ans_ptr;
-
-      answer->ptr_offset = htons(0xC000 | (cur_qd_ptr - dns_reply));
-      answer->type = htons(qd_type);
-      answer->class = htons(qd_class);
-      answer->ttl = htonl(ANS_TTL_SEC);
+    }
+  }
 
-      ESP_LOGD(TAG, "Answer with PTR offset: 0x%" PRIX16 " and IP 0x%" PRIX32,
-               ntohs(answer->ptr_offset), ip.addr);
+  dns_header_t *header = (dns_header_t *)dns_reply;
+  memcpy(&header->id, req, sizeof(header->id));
+  header->flags = htons(QR_FLAG | (flags & (OPCODE_MASK | RD_FLAG)) | rcode);
+  header->qd_count = htons(question_len > 0 ? 1 : 0);
+  header->an_count = htons(answer ? answer->an_count : 0);
+  header->ns_count = 0;
+  header->ar_count = 0;
+
+  // The answer's name points back at this copy of the question
+  int reply_len = DNS_HEADER_LEN;
+  memcpy(dns_reply + reply_len, req + DNS_HEADER_LEN, question_len);
+  reply_len += question_len;
+  if (answer && answer->an_count > 0) {
+    memcpy(dns_reply + reply_len, answer->answer, ANSWER_LEN);
+    reply_len += ANSWER_LEN;
+  }
+  return reply_len;
+}
 
-      answer->addr_len = htons(sizeof(ip.addr));
-      answer->ip_addr = ip.addr;
+static void count_query(dns_server_handle_t h, TickType_t now) {
+  TickType_t elapsed = now - h->second_start;
+  if (elapsed >= pdMS_TO_TICKS(1000)) {
+    // A gap of more than a second means the last full one was quiet
+    h->stats.queries_per_sec =
+        elapsed < pdMS_TO_TICKS(2000) ? h->second_queries : 0;
+    if (h->stats.queries_per_sec > h->stats.peak_queries_per_sec) {
+      h->stats.peak_queries_per_sec = h->stats.queries_per_sec;
     }
+    h->second_start = now;
+    h->second_queries = 0;
   }
-  return reply_len;
+  h->second_queries++;
+  h->stats.queries++;
 }
 
 /*
@@ -193,7 +326,8 @@ static int parse_dns_request(char *req, size_t req_len, char *dns_reply,
     replies to all type A queries with the IP of the softAP
 */
 void dns_server_task(void *pvParameters) {
-  char rx_buffer[128];
+  uint8_t rx_buffer[DNS_MAX_LEN];
+  uint8_t reply[DNS_MAX_LEN];
   char addr_str[128];
   int addr_family;
   int ip_protocol;
@@ -223,10 +357,9 @@ void dns_server_task(void *pvParameters) {
     ESP_LOGI(TAG, "Socket bound, port %d", DNS_PORT);
 
     while (handle->started) {
-      ESP_LOGI(TAG, "Waiting for data");
       struct sockaddr_in6 source_addr; // Large enough for both IPv4 or IPv6
       socklen_t socklen = sizeof(source_addr);
-      int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0,
+      int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0,
                          (struct sockaddr *)&source_addr, &socklen);
 
       // Error occurred during receiving
@@ -245,17 +378,14 @@ void dns_server_task(void *pvParameters) {
           inet6_ntoa_r(source_addr.sin6_addr, addr_str, sizeof(addr_str) - 1);
         }
 
-        // Null-terminate whatever we received and treat like a string...
-        rx_buffer[len] = 0;
-
-        char reply[DNS_MAX_LEN];
-        int reply_len =
-            parse_dns_request(rx_buffer, len, reply, DNS_MAX_LEN, handle);
+        TickType_t now = xTaskGetTickCount();
+        count_query(handle, now);
+        int reply_len = parse_dns_request(rx_buffer, len, reply, handle, now);
 
-        ESP_LOGI(TAG, "Received %d bytes from %s | DNS reply with len: %d", len,
+        ESP_LOGD(TAG, "Received %d bytes from %s | DNS reply with len: %d", len,
                  addr_str, reply_len);
         if (reply_len <= 0) {
-          ESP_LOGE(TAG, "Failed to prepare a DNS reply");
+          ESP_LOGD(TAG, "Dropped a packet that is not a query");
         } else {
           int err =
               sendto(sock, reply, reply_len, 0, (struct sockaddr *)&source_addr,
@@ -280,16 +410,20 @@ void dns_server_task(void *pvParameters) {
 dns_server_handle_t start_dns_server(dns_server_config_t *config) {
   dns_server_handle_t handle =
       calloc(1, sizeof(struct dns_server_handle) +
-                    config->num_of_entries * sizeof(dns_entry_pair_t));
+                    config->num_of_entries * sizeof(dns_rule_t));
   ESP_RETURN_ON_FALSE(handle, NULL, TAG,
                       "Failed to allocate dns server handle");
 
   handle->started = true;
+  handle->second_start = xTaskGetTickCount();
   handle->num_of_entries = config->num_of_entries;
-  memcpy(handle->entry, config->item,
-         config->num_of_entries * sizeof(dns_entry_pair_t));
+  for (int i = 0; i < config->num_of_entries; i++) {
+    handle->entry[i].pair = config->item[i];
+    build_answer_template(&handle->entry[i]);
+  }
 
-  xTaskCreate(dns_server_task, "dns_server", 4096, handle, 5, &handle->task);
+  system_manager_create_task(dns_server_task, "dns_server", 4096, handle, 5,
+                             &handle->task, NULL);
   return handle;
 }
 
@@ -299,4 +433,12 @@ void stop_dns_server(dns_server_handle_t handle) {
     vTaskDelete(handle->task);
     free(handle);
   }
-}
\ No newline at end of file
+}
+
+void dns_server_get_stats(dns_server_handle_t handle,
+                          dns_server_stats_t *stats) {
+  *stats = handle->stats;
+  if (xTaskGetTickCount() - handle->second_start >= pdMS_TO_TICKS(2000)) {
+    stats->queries_per_sec = 0;
+  }
+}
@@ -0,0 +1,351 @@
+// file_index.c
+
+#include "core/file_index.h"
+#include "core/system_manager.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "FileIndex"
+#define FILE_INDEX_VERSION 1
+
+typedef struct {
+  char path[FILE_INDEX_DIR_LEN];
+  bool scanned;
+  bool complete; // Every prefix found fit in the table
+} file_index_dir_t;
+
+typedef struct {
+  char prefix[FILE_INDEX_PREFIX_LEN];
+  char ext[FILE_INDEX_EXT_LEN];
+  uint8_t dir;
+  int next;
+  int saved_next; // As loaded from the state file, -1 if not in it
+} file_index_entry_t;
+
+// Listed right after mount, anything else is listed on first use
+static const char *const mount_dirs[] = {"/mnt/ghostesp/pcaps",
+                                         "/mnt/ghostesp/gps"};
+
+static file_index_dir_t dirs[FILE_INDEX_MAX_DIRS];
+static int dir_count = 0;
+static file_index_entry_t entries[FILE_INDEX_MAX_ENTRIES];
+static int entry_count = 0;
+static SemaphoreHandle_t index_mutex = NULL;
+static TaskHandle_t scan_task_handle = NULL;
+static bool index_loaded = false;
+
+static int find_dir(const char *path) {
+  for (int i = 0; i < dir_count; i++) {
+    if (strcmp(dirs[i].path, path) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int add_dir(const char *path) {
+  int d = find_dir(path);
+  if (d >= 0) {
+    return d;
+  }
+  if (dir_count >= FILE_INDEX_MAX_DIRS || strlen(path) >= FILE_INDEX_DIR_LEN) {
+    return -1;
+  }
+  d = dir_count++;
+  memset(&dirs[d], 0, sizeof(dirs[d]));
+  strcpy(dirs[d].path, path);
+  return d;
+}
+
+static file_index_entry_t *find_entry(int d, const char *prefix,
+                                      const char *ext) {
+  for (int i = 0; i < entry_count; i++) {
+    if (entries[i].dir == d && strcmp(entries[i].prefix, prefix) == 0 &&
+        strcmp(entries[i].ext, ext) == 0) {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
+static file_index_entry_t *add_entry(int d, const char *prefix,
+                                     const char *ext, int next) {
+  file_index_entry_t *entry = find_entry(d, prefix, ext);
+  if (entry != NULL) {
+    return entry;
+  }
+  if (entry_count >= FILE_INDEX_MAX_ENTRIES ||
+      strlen(prefix) >= FILE_INDEX_PREFIX_LEN ||
+      strlen(ext) >= FILE_INDEX_EXT_LEN) {
+    return NULL;
+  }
+  entry = &entries[entry_count++];
+  strcpy(entry->prefix, prefix);
+  strcpy(entry->ext, ext);
+  entry->dir = (uint8_t)d;
+  entry->next = next;
+  entry->saved_next = -1;
+  return entry;
+}
+
+// Splits <prefix>_<index>.<ext>, the prefix itself may contain '_'
+static bool parse_name(const char *name, char *prefix, char *ext, int *index) {
+  const char *dot = strrchr(name, '.');
+  if (dot == NULL || strlen(dot + 1) >= FILE_INDEX_EXT_LEN) {
+    return false;
+  }
+  const char *underscore = NULL;
+  for (const char *p = dot - 1; p >= name; p--) {
+    if (*p == '_') {
+      underscore = p;
+      break;
+    }
+    if (!isdigit((unsigned char)*p)) {
+      return false;
+    }
+  }
+  size_t prefix_len = underscore != NULL ? (size_t)(underscore - name) : 0;
+  size_t digits = underscore != NULL ? (size_t)(dot - underscore - 1) : 0;
+  if (prefix_len == 0 || prefix_len >= FILE_INDEX_PREFIX_LEN || digits == 0 ||
+      digits > 9) {
+    return false;
+  }
+
+  memcpy(prefix, name, prefix_len);
+  prefix[prefix_len] = '\0';
+  strcpy(ext, dot + 1);
+  *index = atoi(underscore + 1);
+  return true;
+}
+
+// Listing of one prefix, used when it can't be cached
+static int scan_prefix(const char *path, const char *prefix, const char *ext) {
+  DIR *dir = opendir(path);
+  if (!dir) {
+    ESP_LOGE(TAG, "Failed to open directory %s", path);
+    return -1;
+  }
+
+  int max_index = -1;
+  char name_prefix[FILE_INDEX_PREFIX_LEN];
+  char name_ext[FILE_INDEX_EXT_LEN];
+  int index;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (parse_name(entry->d_name, name_prefix, name_ext, &index) &&
+        strcmp(name_prefix, prefix) == 0 && strcmp(name_ext, ext) == 0 &&
+        index > max_index) {
+      max_index = index;
+    }
+  }
+
+  closedir(dir);
+  return max_index + 1;
+}
+
+// One pass over the directory for every prefix in it. Indexes only move
+// forward, so files deleted since the state was saved don't get reused.
+static bool scan_dir(int d) {
+  DIR *dir = opendir(dirs[d].path);
+  if (!dir) {
+    ESP_LOGE(TAG, "Failed to open directory %s", dirs[d].path);
+    return false;
+  }
+
+  int files = 0;
+  bool complete = true;
+  char prefix[FILE_INDEX_PREFIX_LEN];
+  char ext[FILE_INDEX_EXT_LEN];
+  int index;
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL) {
+    if (!parse_name(dirent->d_name, prefix, ext, &index)) {
+      continue;
+    }
+    files++;
+    file_index_entry_t *entry = add_entry(d, prefix, ext, 0);
+    if (entry == NULL) {
+      complete = false;
+      continue;
+    }
+    if (index >= entry->next) {
+      entry->next = index + 1;
+    }
+  }
+  closedir(dir);
+
+  // Files the saved state missed were written elsewhere, or the state
+  // was lost to a power cut before it was saved
+  int behind = 0;
+  for (int i = 0; i < entry_count; i++) {
+    if (entries[i].dir == d && entries[i].saved_next >= 0 &&
+        entries[i].next > entries[i].saved_next) {
+      behind++;
+    }
+  }
+
+  dirs[d].scanned = true;
+  dirs[d].complete = complete;
+  if (behind > 0) {
+    ESP_LOGW(TAG, "%s: saved index was behind for %d prefixes",
+             dirs[d].path, behind);
+  }
+  ESP_LOGI(TAG, "%s: %d indexed files", dirs[d].path, files);
+  return true;
+}
+
+static void save_state(void) {
+  FILE *f = fopen(FILE_INDEX_STATE_PATH, "w");
+  if (f == NULL) {
+    ESP_LOGW(TAG, "Failed to save %s", FILE_INDEX_STATE_PATH);
+    return;
+  }
+  fprintf(f, "%d\n", FILE_INDEX_VERSION);
+  for (int i = 0; i < entry_count; i++) {
+    fprintf(f, "%s %s %s %d\n", dirs[entries[i].dir].path, entries[i].prefix,
+            entries[i].ext, entries[i].next);
+  }
+  fclose(f);
+}
+
+static void load_state(void) {
+  FILE *f = fopen(FILE_INDEX_STATE_PATH, "r");
+  if (f == NULL) {
+    return; // First mount of this card, the scan builds it
+  }
+
+  char line[96];
+  int version = 0;
+  if (fgets(line, sizeof(line), f) != NULL) {
+    version = atoi(line);
+  }
+  if (version != FILE_INDEX_VERSION) {
+    ESP_LOGW(TAG, "Ignoring %s, unknown version", FILE_INDEX_STATE_PATH);
+    fclose(f);
+    return;
+  }
+
+  char path[FILE_INDEX_DIR_LEN];
+  char prefix[FILE_INDEX_PREFIX_LEN];
+  char ext[FILE_INDEX_EXT_LEN];
+  int next;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%31s %23s %5s %d", path, prefix, ext, &next) != 4 ||
+        next < 0) {
+      continue;
+    }
+    int d = add_dir(path);
+    file_index_entry_t *entry = d >= 0 ? add_entry(d, prefix, ext, next) : NULL;
+    if (entry != NULL) {
+      entry->saved_next = next;
+    }
+  }
+  fclose(f);
+}
+
+static void scan_task(void *arg) {
+  bool changed = false;
+  for (size_t i = 0; i < sizeof(mount_dirs) / sizeof(mount_dirs[0]); i++) {
+    // Held for the whole listing, a capture starting now waits for it
+    xSemaphoreTake(index_mutex, portMAX_DELAY);
+    int d = add_dir(mount_dirs[i]);
+    if (d >= 0 && !dirs[d].scanned) {
+      changed |= scan_dir(d);
+    }
+    xSemaphoreGive(index_mutex);
+  }
+
+  if (changed) {
+    xSemaphoreTake(index_mutex, portMAX_DELAY);
+    save_state();
+    xSemaphoreGive(index_mutex);
+  }
+
+  scan_task_handle = NULL;
+  vTaskDelete(NULL);
+}
+
+void file_index_init(void) {
+  if (index_mutex == NULL) {
+    index_mutex = xSemaphoreCreateMutex();
+    if (index_mutex == NULL) {
+      ESP_LOGE(TAG, "Failed to create mutex");
+      return;
+    }
+  }
+
+  xSemaphoreTake(index_mutex, portMAX_DELAY);
+  if (index_loaded) {
+    xSemaphoreGive(index_mutex); // Already set up for this card
+    return;
+  }
+  dir_count = 0;
+  entry_count = 0;
+  load_state();
+  index_loaded = true;
+  xSemaphoreGive(index_mutex);
+
+  if (scan_task_handle == NULL &&
+      !system_manager_create_task(scan_task, "file_index", 4096, NULL, 1,
+                                  &scan_task_handle, NULL)) {
+    // Directories get listed on first use instead
+    ESP_LOGW(TAG, "Failed to create scan task");
+    scan_task_handle = NULL;
+  }
+}
+
+void file_index_reset(void) {
+  if (index_mutex == NULL) {
+    return;
+  }
+  xSemaphoreTake(index_mutex, portMAX_DELAY);
+  dir_count = 0;
+  entry_count = 0;
+  index_loaded = false;
+  xSemaphoreGive(index_mutex);
+}
+
+int file_index_next(const char *dir, const char *prefix, const char *ext) {
+  if (index_mutex == NULL) {
+    return scan_prefix(dir, prefix, ext); // Card never mounted
+  }
+
+  xSemaphoreTake(index_mutex, portMAX_DELAY);
+  if (!index_loaded) {
+    xSemaphoreGive(index_mutex);
+    return scan_prefix(dir, prefix, ext);
+  }
+
+  int d = add_dir(dir);
+  if (d >= 0 && !dirs[d].scanned && !scan_dir(d)) {
+    xSemaphoreGive(index_mutex);
+    return -1;
+  }
+
+  file_index_entry_t *entry = NULL;
+  if (d >= 0) {
+    entry = find_entry(d, prefix, ext);
+    // A prefix missing from a complete listing has no files yet
+    if (entry == NULL && dirs[d].complete) {
+      entry = add_entry(d, prefix, ext, 0);
+    }
+  }
+
+  int index;
+  if (entry != NULL) {
+    index = entry->next++;
+    save_state();
+  } else {
+    index = scan_prefix(dir, prefix, ext);
+  }
+
+  xSemaphoreGive(index_mutex);
+  return index;
+}
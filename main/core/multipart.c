@@ -0,0 +1,279 @@
+// multipart.c
+
+#include "core/multipart.h"
+#include <string.h>
+#include <strings.h>
+
+bool multipart_get_boundary(const char *content_type, char *out,
+                            size_t out_len) {
+  const char *key = "boundary=";
+  size_t key_len = strlen(key);
+  const char *value = NULL;
+  for (const char *s = content_type; *s; s++) {
+    if (strncasecmp(s, key, key_len) == 0 &&
+        (s == content_type || s[-1] == ';' || s[-1] == ' ')) {
+      value = s + key_len;
+      break;
+    }
+  }
+  if (!value) {
+    return false;
+  }
+
+  const char *end;
+  if (*value == '"') {
+    value++;
+    end = strchr(value, '"');
+    if (!end) {
+      return false;
+    }
+  } else {
+    end = value + strcspn(value, "; \t");
+  }
+  size_t len = end - value;
+  if (len == 0 || len > MULTIPART_BOUNDARY_MAX || len >= out_len) {
+    return false;
+  }
+  memcpy(out, value, len);
+  out[len] = '\0';
+  return true;
+}
+
+bool multipart_init(multipart_parser_t *p, const char *boundary,
+                    const multipart_callbacks_t *cb) {
+  size_t len = strlen(boundary);
+  if (len == 0 || len > MULTIPART_BOUNDARY_MAX ||
+      strpbrk(boundary, "\r\n") != NULL) {
+    return false;
+  }
+  memset(p, 0, sizeof(*p));
+  p->cb = *cb;
+  memcpy(p->delim, "\r\n--", 4);
+  memcpy(p->delim + 4, boundary, len);
+  p->delim_len = len + 4;
+  // The first delimiter may open the body without a CRLF before it
+  p->match = 2;
+  p->state = MULTIPART_PREAMBLE;
+  return true;
+}
+
+bool multipart_complete(const multipart_parser_t *p) {
+  return p->state == MULTIPART_EPILOGUE;
+}
+
+static bool fail(multipart_parser_t *p) {
+  p->state = MULTIPART_ERROR;
+  return false;
+}
+
+// Preamble bytes are dropped, body bytes go to the part
+static bool emit(multipart_parser_t *p, const uint8_t *data, size_t len) {
+  if (len == 0 || p->state != MULTIPART_BODY || !p->cb.on_data) {
+    return true;
+  }
+  return p->cb.on_data(data, len, p->cb.ctx);
+}
+
+// Copies value into out, false if it doesn't fit
+static bool copy_param(const char *value, size_t len, char *out,
+                       size_t out_len) {
+  if (len >= out_len) {
+    return false;
+  }
+  memcpy(out, value, len);
+  out[len] = '\0';
+  return true;
+}
+
+// Picks name and filename out of a Content-Disposition header. Other
+// headers are ignored.
+static bool parse_header_line(multipart_parser_t *p, char *line) {
+  const char *key = "content-disposition:";
+  if (strncasecmp(line, key, strlen(key)) != 0) {
+    return true;
+  }
+
+  // Skip the disposition type, then read each ; separated parameter
+  char *s = strchr(line, ';');
+  while (s && *s) {
+    s++;
+    s += strspn(s, " \t");
+    char *eq = strchr(s, '=');
+    if (!eq) {
+      break;
+    }
+    size_t key_len = eq - s;
+    while (key_len > 0 && (s[key_len - 1] == ' ' || s[key_len - 1] == '\t')) {
+      key_len--;
+    }
+
+    char *value = eq + 1;
+    value += strspn(value, " \t");
+    char *end;
+    if (*value == '"') {
+      value++;
+      end = strchr(value, '"');
+      if (!end) {
+        return false;
+      }
+    } else {
+      end = value + strcspn(value, "; \t");
+    }
+
+    if (key_len == 4 && strncasecmp(s, "name", 4) == 0) {
+      if (!copy_param(value, end - value, p->name, sizeof(p->name))) {
+        return false;
+      }
+    } else if (key_len == 8 && strncasecmp(s, "filename", 8) == 0) {
+      if (!copy_param(value, end - value, p->filename, sizeof(p->filename))) {
+        return false;
+      }
+    }
+    s = strchr(end, ';');
+  }
+  return true;
+}
+
+static bool feed_header_byte(multipart_parser_t *p, uint8_t c) {
+  if (c != '\n' || p->line_len == 0 || p->line[p->line_len - 1] != '\r') {
+    if (p->line_len == sizeof(p->line) - 1) {
+      return fail(p);
+    }
+    p->line[p->line_len++] = (char)c;
+    return true;
+  }
+
+  p->line[p->line_len - 1] = '\0';
+  bool blank = p->line_len == 1;
+  p->line_len = 0;
+  if (!blank) {
+    return parse_header_line(p, p->line) || fail(p);
+  }
+
+  if (p->cb.on_part && !p->cb.on_part(p->name, p->filename, p->cb.ctx)) {
+    return fail(p);
+  }
+  p->state = MULTIPART_BODY;
+  return true;
+}
+
+static bool end_delimiter(multipart_parser_t *p) {
+  if (p->state == MULTIPART_BODY && p->cb.on_part_end &&
+      !p->cb.on_part_end(p->cb.ctx)) {
+    return fail(p);
+  }
+  p->state = MULTIPART_DELIM_TAIL;
+  return true;
+}
+
+// Looks for the delimiter in the preamble or a part body. Returns how many
+// bytes were used, 0 on error with the parser failed.
+static size_t feed_body(multipart_parser_t *p, const uint8_t *data,
+                        size_t len) {
+  size_t pos = 0;
+
+  // A delimiter started in the previous piece
+  if (p->match > 0) {
+    while (pos < len && p->match < p->delim_len &&
+           data[pos] == (uint8_t)p->delim[p->match]) {
+      pos++;
+      p->match++;
+    }
+    if (p->match == p->delim_len) {
+      p->match = 0;
+      return end_delimiter(p) ? pos : 0;
+    }
+    if (pos == len) {
+      return pos;
+    }
+    // Only the first delimiter byte is CR, so no other match can start
+    // inside the held bytes. They were data after all.
+    size_t held = p->match;
+    p->match = 0;
+    if (!emit(p, (const uint8_t *)p->delim, held)) {
+      fail(p);
+      return 0;
+    }
+  }
+
+  size_t start = pos;
+  while (pos < len) {
+    const uint8_t *cr = memchr(data + pos, '\r', len - pos);
+    if (!cr) {
+      break;
+    }
+    size_t at = cr - data;
+    size_t n = len - at < p->delim_len ? len - at : p->delim_len;
+    if (memcmp(cr, p->delim, n) == 0) {
+      if (!emit(p, data + start, at - start)) {
+        fail(p);
+        return 0;
+      }
+      if (n < p->delim_len) {
+        // Might be a delimiter, decided by the next piece
+        p->match = n;
+        return len;
+      }
+      return end_delimiter(p) ? at + n : 0;
+    }
+    pos = at + 1;
+  }
+  if (!emit(p, data + start, len - start)) {
+    fail(p);
+    return 0;
+  }
+  return len;
+}
+
+bool multipart_feed(multipart_parser_t *p, const uint8_t *data, size_t len) {
+  size_t pos = 0;
+  while (pos < len) {
+    switch (p->state) {
+    case MULTIPART_PREAMBLE:
+    case MULTIPART_BODY: {
+      size_t used = feed_body(p, data + pos, len - pos);
+      if (used == 0) {
+        return false;
+      }
+      pos += used;
+      break;
+    }
+    case MULTIPART_DELIM_TAIL: {
+      uint8_t c = data[pos++];
+      if (c == '-') {
+        p->state = MULTIPART_FINAL_DASH;
+      } else if (c == '\r') {
+        p->state = MULTIPART_DELIM_LF;
+      } else if (c != ' ' && c != '\t') {
+        return fail(p);
+      }
+      break;
+    }
+    case MULTIPART_DELIM_LF:
+      if (data[pos++] != '\n') {
+        return fail(p);
+      }
+      p->state = MULTIPART_HEADERS;
+      p->line_len = 0;
+      p->name[0] = '\0';
+      p->filename[0] = '\0';
+      break;
+    case MULTIPART_FINAL_DASH:
+      if (data[pos++] != '-') {
+        return fail(p);
+      }
+      p->state = MULTIPART_EPILOGUE;
+      break;
+    case MULTIPART_HEADERS:
+      if (!feed_header_byte(p, data[pos++])) {
+        return false;
+      }
+      break;
+    case MULTIPART_EPILOGUE:
+      return true;
+    case MULTIPART_ERROR:
+      return false;
+    }
+  }
+  return p->state != MULTIPART_ERROR;
+}
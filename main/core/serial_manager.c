@@ -101,7 +101,8 @@ void serial_manager_init() {
 
   commandQueue = xQueueCreate(10, sizeof(SerialCommand));
 
-  xTaskCreate(serial_task, "SerialTask", 8192, NULL, 2, NULL);
+  system_manager_create_task(serial_task, "SerialTask", 8192, NULL, 2, NULL,
+                             NULL);
   printf("Serial Started...\n");
 }
 
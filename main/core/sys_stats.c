@@ -0,0 +1,308 @@
+// sys_stats.c
+
+#include "core/sys_stats.h"
+#include "core/system_manager.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "managers/views/terminal_screen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYS_STATS_ALLOC_MAGIC 0x5A
+
+// Prepended to counted blocks, keeps the payload 8-byte aligned
+typedef struct {
+  uint32_t size;
+  uint8_t tag;
+  uint8_t magic;
+  uint16_t reserved;
+} sys_stats_block_t;
+
+static const char *tag_names[SYS_STATS_TAG_COUNT] = {
+    "other", "web", "wifi", "ble", "sd", "gps", "display"};
+static const char *heap_names[SYS_STATS_HEAP_COUNT] = {"internal", "dma",
+                                                       "spiram"};
+
+// Counters are bumped from any task and from the failed allocation hook,
+// so all state sits behind one spinlock held only for copies
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static sys_stats_snapshot_t stats;
+static TaskHandle_t sampler_handle = NULL;
+
+static void failed_alloc_hook(size_t size, uint32_t caps,
+                              const char *function_name) {
+  (void)function_name;
+  portENTER_CRITICAL_SAFE(&stats_lock);
+  stats.failed_allocs++;
+  stats.last_failed_size = size;
+  stats.last_failed_caps = caps;
+  portEXIT_CRITICAL_SAFE(&stats_lock);
+}
+
+static uint32_t heap_caps_for(sys_stats_heap_t heap) {
+  switch (heap) {
+  case SYS_STATS_HEAP_DMA:
+    return MALLOC_CAP_DMA;
+  case SYS_STATS_HEAP_SPIRAM:
+#ifdef CONFIG_SPIRAM
+    return MALLOC_CAP_SPIRAM;
+#else
+    return 0;
+#endif
+  default:
+    return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+  }
+}
+
+static void sampler_task(void *arg) {
+  while (1) {
+    sys_stats_sample();
+    vTaskDelay(pdMS_TO_TICKS(SYS_STATS_SAMPLE_MS));
+  }
+}
+
+void sys_stats_init(void) {
+  if (sampler_handle != NULL) {
+    return;
+  }
+
+  heap_caps_register_failed_alloc_callback(failed_alloc_hook);
+
+  if (!system_manager_create_task(sampler_task, "sys_stats", 3072, NULL, 1,
+                                  &sampler_handle, NULL)) {
+    printf("Failed to create sys_stats task\n");
+    sampler_handle = NULL;
+  }
+}
+
+void sys_stats_watch_task(const char *name, uint32_t stack_size) {
+  portENTER_CRITICAL(&stats_lock);
+  for (int i = 0; i < stats.task_count; i++) {
+    if (strcmp(stats.tasks[i].name, name) == 0) {
+      stats.tasks[i].stack_size = stack_size;
+      portEXIT_CRITICAL(&stats_lock);
+      return;
+    }
+  }
+  if (stats.task_count < SYS_STATS_MAX_TASKS) {
+    sys_stats_task_info_t *task = &stats.tasks[stats.task_count++];
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->stack_size = stack_size;
+    task->stack_free_min = UINT32_MAX;
+  }
+  portEXIT_CRITICAL(&stats_lock);
+}
+
+void sys_stats_sample(void) {
+  sys_stats_heap_info_t heap[SYS_STATS_HEAP_COUNT];
+  memset(heap, 0, sizeof(heap));
+
+  // Walking the heaps takes their locks, do it before taking ours
+  for (int i = 0; i < SYS_STATS_HEAP_COUNT; i++) {
+    uint32_t caps = heap_caps_for((sys_stats_heap_t)i);
+    if (caps == 0 || heap_caps_get_total_size(caps) == 0) {
+      continue;
+    }
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    heap[i].present = true;
+    heap[i].free_bytes = info.total_free_bytes;
+    heap[i].min_free_bytes = info.minimum_free_bytes;
+    heap[i].largest_block = info.largest_free_block;
+    heap[i].total_bytes = heap_caps_get_total_size(caps);
+  }
+
+  char names[SYS_STATS_MAX_TASKS][16];
+  uint8_t task_count;
+  portENTER_CRITICAL(&stats_lock);
+  task_count = stats.task_count;
+  for (int i = 0; i < task_count; i++) {
+    memcpy(names[i], stats.tasks[i].name, sizeof(names[i]));
+  }
+  portEXIT_CRITICAL(&stats_lock);
+
+  // Looked up by name so a task that exited is reported as not running
+  // rather than dereferenced through a stale handle
+  uint32_t stack_free[SYS_STATS_MAX_TASKS];
+  bool running[SYS_STATS_MAX_TASKS];
+  for (int i = 0; i < task_count; i++) {
+    TaskHandle_t handle = xTaskGetHandle(names[i]);
+    running[i] = handle != NULL;
+    stack_free[i] = running[i] ? uxTaskGetStackHighWaterMark(handle) : 0;
+  }
+
+  portENTER_CRITICAL(&stats_lock);
+  memcpy(stats.heap, heap, sizeof(heap));
+  for (int i = 0; i < task_count; i++) {
+    sys_stats_task_info_t *task = &stats.tasks[i];
+    task->running = running[i];
+    if (running[i]) {
+      task->stack_free = stack_free[i];
+      if (stack_free[i] < task->stack_free_min) {
+        task->stack_free_min = stack_free[i];
+      }
+    }
+  }
+  stats.samples++;
+  stats.uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+  portEXIT_CRITICAL(&stats_lock);
+}
+
+void sys_stats_get_snapshot(sys_stats_snapshot_t *snapshot) {
+  portENTER_CRITICAL(&stats_lock);
+  *snapshot = stats;
+  portEXIT_CRITICAL(&stats_lock);
+
+  for (int i = 0; i < snapshot->task_count; i++) {
+    if (snapshot->tasks[i].stack_free_min == UINT32_MAX) {
+      snapshot->tasks[i].stack_free_min = 0; // Never sampled
+    }
+  }
+}
+
+bool sys_stats_task_low(const sys_stats_task_info_t *task) {
+  if (task->stack_free_min == 0 || task->stack_size == 0) {
+    return false;
+  }
+  return task->stack_free_min < SYS_STATS_STACK_WARN_BYTES ||
+         task->stack_free_min * 100 < task->stack_size * SYS_STATS_STACK_WARN_PCT;
+}
+
+const char *sys_stats_tag_name(sys_stats_tag_t tag) {
+  return tag < SYS_STATS_TAG_COUNT ? tag_names[tag] : "unknown";
+}
+
+const char *sys_stats_heap_name(sys_stats_heap_t heap) {
+  return heap < SYS_STATS_HEAP_COUNT ? heap_names[heap] : "unknown";
+}
+
+void sys_stats_print(void) {
+  // Too large for most task stacks
+  sys_stats_snapshot_t *snap = malloc(sizeof(*snap));
+  if (snap == NULL) {
+    printf("Not enough memory for stats snapshot\n");
+    return;
+  }
+  sys_stats_get_snapshot(snap);
+
+  printf("System stats (uptime %lus, %lu samples)\n",
+         (unsigned long)snap->uptime_s, (unsigned long)snap->samples);
+  TERMINAL_VIEW_ADD_TEXT("Uptime %lus\n", (unsigned long)snap->uptime_s);
+
+  for (int i = 0; i < SYS_STATS_HEAP_COUNT; i++) {
+    const sys_stats_heap_info_t *h = &snap->heap[i];
+    if (!h->present) {
+      continue;
+    }
+    printf("Heap %-8s free %6lu / %6lu, min %6lu, largest %6lu\n",
+           heap_names[i], (unsigned long)h->free_bytes,
+           (unsigned long)h->total_bytes, (unsigned long)h->min_free_bytes,
+           (unsigned long)h->largest_block);
+    TERMINAL_VIEW_ADD_TEXT("%s: %luK free\nmin %luK, blk %luK\n", heap_names[i],
+                           (unsigned long)(h->free_bytes / 1024),
+                           (unsigned long)(h->min_free_bytes / 1024),
+                           (unsigned long)(h->largest_block / 1024));
+  }
+
+  printf("%-16s %6s %6s %6s\n", "Task", "Stack", "Free", "MinFree");
+  for (int i = 0; i < snap->task_count; i++) {
+    const sys_stats_task_info_t *t = &snap->tasks[i];
+    if (!t->running && t->stack_free_min == 0) {
+      continue; // Never seen running
+    }
+    bool low = sys_stats_task_low(t);
+    printf("%-16s %6lu %6lu %6lu%s%s\n", t->name, (unsigned long)t->stack_size,
+           (unsigned long)t->stack_free, (unsigned long)t->stack_free_min,
+           t->running ? "" : " (exited)", low ? " LOW" : "");
+    TERMINAL_VIEW_ADD_TEXT("%s: %lu/%lu%s\n", t->name,
+                           (unsigned long)t->stack_free_min,
+                           (unsigned long)t->stack_size, low ? " LOW" : "");
+  }
+
+  for (int i = 0; i < SYS_STATS_TAG_COUNT; i++) {
+    const sys_stats_tag_info_t *tag = &snap->tags[i];
+    if (tag->allocs == 0) {
+      continue;
+    }
+    printf("Alloc %-8s %lu allocs, %lu frees, %lu failed, %lu live, %lu peak\n",
+           tag_names[i], (unsigned long)tag->allocs, (unsigned long)tag->frees,
+           (unsigned long)tag->failures, (unsigned long)tag->live_bytes,
+           (unsigned long)tag->peak_bytes);
+  }
+
+  if (snap->failed_allocs > 0) {
+    printf("Failed allocations: %lu (last %lu bytes, caps 0x%lx)\n",
+           (unsigned long)snap->failed_allocs,
+           (unsigned long)snap->last_failed_size,
+           (unsigned long)snap->last_failed_caps);
+    TERMINAL_VIEW_ADD_TEXT("Failed allocs: %lu\n",
+                           (unsigned long)snap->failed_allocs);
+  }
+
+  free(snap);
+}
+
+void *sys_stats_malloc(sys_stats_tag_t tag, size_t size) {
+  if (tag >= SYS_STATS_TAG_COUNT) {
+    tag = SYS_STATS_TAG_OTHER;
+  }
+
+  sys_stats_block_t *block = malloc(sizeof(sys_stats_block_t) + size);
+
+  portENTER_CRITICAL(&stats_lock);
+  sys_stats_tag_info_t *info = &stats.tags[tag];
+  if (block == NULL) {
+    info->failures++;
+  } else {
+    info->allocs++;
+    info->live_bytes += size;
+    if (info->live_bytes > info->peak_bytes) {
+      info->peak_bytes = info->live_bytes;
+    }
+  }
+  portEXIT_CRITICAL(&stats_lock);
+
+  if (block == NULL) {
+    return NULL;
+  }
+  block->size = (uint32_t)size;
+  block->tag = (uint8_t)tag;
+  block->magic = SYS_STATS_ALLOC_MAGIC;
+  return block + 1;
+}
+
+void *sys_stats_calloc(sys_stats_tag_t tag, size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size) {
+    return NULL;
+  }
+  void *ptr = sys_stats_malloc(tag, count * size);
+  if (ptr != NULL) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void sys_stats_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  sys_stats_block_t *block = (sys_stats_block_t *)ptr - 1;
+  if (block->magic != SYS_STATS_ALLOC_MAGIC || block->tag >= SYS_STATS_TAG_COUNT) {
+    printf("sys_stats_free: block %p was not counted\n", ptr);
+    return;
+  }
+
+  portENTER_CRITICAL(&stats_lock);
+  sys_stats_tag_info_t *info = &stats.tags[block->tag];
+  info->frees++;
+  info->live_bytes -= block->size < info->live_bytes ? block->size : info->live_bytes;
+  portEXIT_CRITICAL(&stats_lock);
+
+  block->magic = 0;
+  free(block);
+}
@@ -1,152 +1,597 @@
 // system_manager.c
 
 #include "core/system_manager.h"
+#include "core/sys_stats.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "managers/views/terminal_screen.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Head of the linked list for tasks
-static ManagedTask *task_list_head = NULL;
+#ifndef configRUN_TIME_COUNTER_TYPE
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+#endif
+#ifndef configNUMBER_OF_CORES
+#define configNUMBER_OF_CORES portNUM_PROCESSORS
+#endif
+
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+#define PROFILER_AVAILABLE 1
+#else
+#define PROFILER_AVAILABLE 0
+#endif
+
+// Tasks live in a fixed pool chained from name-hash buckets. Entries are not
+// told when their task returns through vTaskDelete(NULL), so an entry only
+// counts while FreeRTOS still knows a live task under that name and handle.
+static ManagedTask task_pool[SYSTEM_MANAGER_MAX_TASKS];
+static ManagedTask *task_buckets[SYSTEM_MANAGER_BUCKETS];
+static ManagedTask *task_free_list = NULL;
+static SemaphoreHandle_t registry_lock = NULL;
+
+static uint32_t name_bucket(const char *name) {
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash & (SYSTEM_MANAGER_BUCKETS - 1);
+}
+
+static void registry_reset(void) {
+  memset(task_pool, 0, sizeof(task_pool));
+  memset(task_buckets, 0, sizeof(task_buckets));
+  task_free_list = NULL;
+  for (int i = SYSTEM_MANAGER_MAX_TASKS - 1; i >= 0; i--) {
+    task_pool[i].next = task_free_list;
+    task_free_list = &task_pool[i];
+  }
+}
+
+static void registry_take(void) {
+  if (registry_lock == NULL) {
+    system_manager_init();
+  }
+  xSemaphoreTake(registry_lock, portMAX_DELAY);
+}
+
+static void registry_give(void) { xSemaphoreGive(registry_lock); }
 
 // Initialize the System Manager
-void system_manager_init() { task_list_head = NULL; }
+void system_manager_init() {
+  if (registry_lock != NULL) {
+    return;
+  }
+  registry_lock = xSemaphoreCreateMutex();
+  registry_reset();
+}
+
+static ManagedTask *find_entry(const char *task_name) {
+  for (ManagedTask *e = task_buckets[name_bucket(task_name)]; e != NULL;
+       e = e->next) {
+    if (strcmp(e->task_name, task_name) == 0) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+// The handle is only touched once FreeRTOS has returned it for the name,
+// which guarantees the TCB has not been freed yet
+static bool entry_alive(const ManagedTask *e) {
+  TaskHandle_t handle = xTaskGetHandle(e->task_name);
+  return handle != NULL && handle == e->task_handle &&
+         eTaskGetState(handle) != eDeleted;
+}
+
+static void unlink_entry(ManagedTask *e) {
+  ManagedTask **link = &task_buckets[name_bucket(e->task_name)];
+  while (*link != NULL) {
+    if (*link == e) {
+      *link = e->next;
+      break;
+    }
+    link = &(*link)->next;
+  }
+  memset(e, 0, sizeof(*e));
+  e->next = task_free_list;
+  task_free_list = e;
+}
+
+static void prune_entries(void) {
+  for (int i = 0; i < SYSTEM_MANAGER_MAX_TASKS; i++) {
+    if (task_pool[i].in_use && !entry_alive(&task_pool[i])) {
+      unlink_entry(&task_pool[i]);
+    }
+  }
+}
+
+static ManagedTask *insert_entry(TaskHandle_t task_handle, const char *task_name,
+                                 uint32_t stack_size, UBaseType_t priority,
+                                 void (*on_task_complete)(const char *)) {
+  ManagedTask *e = task_free_list;
+  task_free_list = e->next;
+
+  e->in_use = true;
+  e->task_handle = task_handle;
+  strncpy(e->task_name, task_name, sizeof(e->task_name) - 1);
+  e->task_name[sizeof(e->task_name) - 1] = '\0';
+  e->stack_size = stack_size;
+  e->priority = priority;
+  e->on_task_complete = on_task_complete;
+
+  uint32_t b = name_bucket(e->task_name);
+  e->next = task_buckets[b];
+  task_buckets[b] = e;
+  return e;
+}
+
+// Makes room for task_name: fails if a live task holds it, drops a stale
+// entry that does, and prunes exited tasks when the pool is full
+static bool claim_name(const char *task_name, TaskHandle_t allowed) {
+  ManagedTask *existing = find_entry(task_name);
+  if (existing != NULL) {
+    if (existing->task_handle != allowed && entry_alive(existing)) {
+      printf("Task with name %s already exists.\n", task_name);
+      return false;
+    }
+    unlink_entry(existing);
+  }
+  if (task_free_list == NULL) {
+    prune_entries();
+  }
+  if (task_free_list == NULL) {
+    printf("Task registry full, cannot track %s.\n", task_name);
+    return false;
+  }
+  return true;
+}
 
 // Create a new task
 bool system_manager_create_task(void (*task_function)(void *),
                                 const char *task_name, uint32_t stack_size,
-                                UBaseType_t priority,
+                                void *arg, UBaseType_t priority,
+                                TaskHandle_t *handle_out,
                                 void (*on_task_complete)(const char *)) {
-  ManagedTask *current = task_list_head;
-  while (current != NULL) {
-    if (strcmp(current->task_name, task_name) == 0) {
-      printf("Task with name %s already exists.\n", task_name);
-      return false;
-    }
-    current = current->next;
+  TaskHandle_t task_handle = NULL;
+  // FreeRTOS stores the handle before the task can run, callers that keep
+  // it in a global rely on that
+  TaskHandle_t *dest = handle_out != NULL ? handle_out : &task_handle;
+
+  registry_take();
+  if (!claim_name(task_name, NULL)) {
+    registry_give();
+    return false;
   }
 
-  // Create a new task
-  TaskHandle_t task_handle;
-  if (xTaskCreate(task_function, task_name, stack_size, NULL, priority,
-                  &task_handle) != pdPASS) {
+  if (xTaskCreate(task_function, task_name, stack_size, arg, priority, dest) !=
+      pdPASS) {
+    registry_give();
+    *dest = NULL;
     printf("Failed to create task %s.\n", task_name);
     return false;
   }
 
-  // Allocate a new ManagedTask node
-  ManagedTask *new_task = (ManagedTask *)malloc(sizeof(ManagedTask));
-  if (new_task == NULL) {
-    printf("Memory allocation failed for task %s.\n", task_name);
-    vTaskDelete(task_handle); // Clean up the task if we can't store it
+  insert_entry(*dest, task_name, stack_size, priority, on_task_complete);
+  registry_give();
+
+  sys_stats_watch_task(task_name, stack_size);
+  return true;
+}
+
+bool system_manager_register_task(TaskHandle_t task_handle,
+                                  const char *task_name, uint32_t stack_size,
+                                  UBaseType_t priority) {
+  if (task_handle == NULL) {
     return false;
   }
 
-  // Initialize the new task node
-  new_task->task_handle = task_handle;
-  strncpy(new_task->task_name, task_name, sizeof(new_task->task_name) - 1);
-  new_task->task_name[sizeof(new_task->task_name) - 1] = '\0';
-  new_task->priority = priority;
-  new_task->on_task_complete = on_task_complete;
-  new_task->next = NULL;
-
-  // Add the new task to the head of the linked list
-  if (task_list_head == NULL) {
-    task_list_head = new_task;
-  } else {
-    ManagedTask *temp = task_list_head;
-    while (temp->next != NULL) {
-      temp = temp->next;
-    }
-    temp->next = new_task;
+  registry_take();
+  if (!claim_name(task_name, task_handle)) {
+    registry_give();
+    return false;
   }
+  insert_entry(task_handle, task_name, stack_size, priority, NULL);
+  registry_give();
 
-  printf("Task %s created successfully.\n", task_name);
+  sys_stats_watch_task(task_name, stack_size);
   return true;
 }
 
+TaskHandle_t system_manager_get_task(const char *task_name) {
+  TaskHandle_t handle = NULL;
+  registry_take();
+  ManagedTask *e = find_entry(task_name);
+  if (e != NULL && entry_alive(e)) {
+    handle = e->task_handle;
+  }
+  registry_give();
+  return handle;
+}
+
 bool system_manager_remove_task(const char *task_name) {
-  ManagedTask *current = task_list_head;
-  ManagedTask *previous = NULL;
-
-  // Search for the task by name
-  while (current != NULL) {
-    if (strcmp(current->task_name, task_name) == 0) {
-      vTaskDelete(current->task_handle); // Delete the FreeRTOS task
-
-      // Call the task complete callback if available
-      if (current->on_task_complete != NULL) {
-        current->on_task_complete(task_name);
-      }
-
-      // Remove the task from the linked list
-      if (previous == NULL) { // Removing the head
-        task_list_head = current->next;
-      } else {
-        previous->next = current->next;
-      }
-
-      free(current); // Free the task memory
-      printf("Task %s deleted.\n", task_name);
-      return true;
-    }
-    previous = current;
-    current = current->next;
+  registry_take();
+  ManagedTask *e = find_entry(task_name);
+  if (e == NULL) {
+    registry_give();
+    printf("Task %s not found.\n", task_name);
+    return false;
   }
 
-  printf("Task %s not found.\n", task_name);
-  return false;
+  TaskHandle_t handle = entry_alive(e) ? e->task_handle : NULL;
+  void (*on_task_complete)(const char *) = e->on_task_complete;
+  unlink_entry(e);
+  registry_give();
+
+  // Call the task complete callback if available
+  if (on_task_complete != NULL) {
+    on_task_complete(task_name);
+  }
+  printf("Task %s deleted.\n", task_name);
+
+  if (handle != NULL) {
+    vTaskDelete(handle); // Does not return when a task removes itself
+  }
+  return true;
+}
+
+// Looks up a live task and returns its handle with the registry locked
+static ManagedTask *lookup_live(const char *task_name) {
+  registry_take();
+  ManagedTask *e = find_entry(task_name);
+  if (e == NULL || !entry_alive(e)) {
+    registry_give();
+    printf("Task %s not found.\n", task_name);
+    return NULL;
+  }
+  return e;
 }
 
 bool system_manager_suspend_task(const char *task_name) {
-  ManagedTask *current = task_list_head;
-  while (current != NULL) {
-    if (strcmp(current->task_name, task_name) == 0) {
-      vTaskSuspend(current->task_handle); // Suspend the task
-      printf("Task %s suspended.\n", task_name);
-      return true;
-    }
-    current = current->next;
+  ManagedTask *e = lookup_live(task_name);
+  if (e == NULL) {
+    return false;
   }
-  printf("Task %s not found.\n", task_name);
-  return false;
+  vTaskSuspend(e->task_handle); // Suspend the task
+  registry_give();
+  printf("Task %s suspended.\n", task_name);
+  return true;
 }
 
 bool system_manager_resume_task(const char *task_name) {
-  ManagedTask *current = task_list_head;
-  while (current != NULL) {
-    if (strcmp(current->task_name, task_name) == 0) {
-      vTaskResume(current->task_handle); // Resume the task
-      printf("Task %s resumed.\n", task_name);
-      return true;
-    }
-    current = current->next;
+  ManagedTask *e = lookup_live(task_name);
+  if (e == NULL) {
+    return false;
   }
-  printf("Task %s not found.\n", task_name);
-  return false;
+  vTaskResume(e->task_handle); // Resume the task
+  registry_give();
+  printf("Task %s resumed.\n", task_name);
+  return true;
 }
 
 bool system_manager_set_task_priority(const char *task_name,
                                       UBaseType_t new_priority) {
-  ManagedTask *current = task_list_head;
-  while (current != NULL) {
-    if (strcmp(current->task_name, task_name) == 0) {
-      vTaskPrioritySet(current->task_handle, new_priority);
-      current->priority = new_priority;
-      printf("Task %s priority changed to %d.\n", task_name, new_priority);
+  ManagedTask *e = lookup_live(task_name);
+  if (e == NULL) {
+    return false;
+  }
+  vTaskPrioritySet(e->task_handle, new_priority);
+  e->priority = new_priority;
+  registry_give();
+  printf("Task %s priority changed to %d.\n", task_name, new_priority);
+  return true;
+}
+
+static char state_char(eTaskState state) {
+  switch (state) {
+  case eRunning:
+    return 'R';
+  case eReady:
+    return 'r';
+  case eBlocked:
+    return 'B';
+  case eSuspended:
+    return 'S';
+  default:
+    return 'D';
+  }
+}
+
+void system_manager_list_tasks() {
+  registry_take();
+  prune_entries();
+  printf("Currently managed tasks:\n");
+  printf("%-16s %4s %5s %6s %6s\n", "Task", "Prio", "State", "Stack", "Free");
+  for (int i = 0; i < SYSTEM_MANAGER_MAX_TASKS; i++) {
+    const ManagedTask *e = &task_pool[i];
+    if (!e->in_use) {
+      continue;
+    }
+    printf("%-16s %4d %5c %6lu %6lu\n", e->task_name, (int)e->priority,
+           state_char(eTaskGetState(e->task_handle)),
+           (unsigned long)e->stack_size,
+           (unsigned long)uxTaskGetStackHighWaterMark(e->task_handle));
+  }
+  registry_give();
+}
+
+#if PROFILER_AVAILABLE
+
+typedef struct {
+  UBaseType_t number;
+  configRUN_TIME_COUNTER_TYPE runtime;
+} profile_counter_t;
+
+typedef struct {
+  configRUN_TIME_COUNTER_TYPE total;
+  uint32_t time_ms;
+  uint16_t count;
+  profile_counter_t tasks[SYSTEM_PROFILE_MAX_TASKS];
+} profile_sample_t;
+
+typedef struct {
+  TaskStatus_t status[SYSTEM_PROFILE_MAX_TASKS]; // Sampler scratch
+  profile_sample_t scratch;
+  profile_sample_t ring[SYSTEM_PROFILE_WINDOW];
+  uint8_t head; // Next slot to write
+  uint8_t filled;
+} profiler_t;
+
+static profiler_t *profiler = NULL;
+static esp_timer_handle_t profile_timer = NULL;
+static portMUX_TYPE profile_lock = portMUX_INITIALIZER_UNLOCKED;
+// Under profile_lock. esp_timer_stop doesn't wait for a callback already
+// running, so stop sets stopping and waits for busy to clear before the
+// profiler is freed.
+static bool profile_stopping = false;
+static bool profile_busy = false;
+
+static void profile_sample_cb(void *arg) {
+  portENTER_CRITICAL(&profile_lock);
+  bool stopping = profile_stopping;
+  profile_busy = !stopping;
+  portEXIT_CRITICAL(&profile_lock);
+  if (stopping) {
+    return;
+  }
+
+  profile_sample_t *s = &profiler->scratch;
+  configRUN_TIME_COUNTER_TYPE total = 0;
+  UBaseType_t n =
+      uxTaskGetSystemState(profiler->status, SYSTEM_PROFILE_MAX_TASKS, &total);
+
+  s->total = total;
+  s->time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+  s->count = (uint16_t)n;
+  for (UBaseType_t i = 0; i < n; i++) {
+    s->tasks[i].number = profiler->status[i].xTaskNumber;
+    s->tasks[i].runtime = profiler->status[i].ulRunTimeCounter;
+  }
+
+  portENTER_CRITICAL(&profile_lock);
+  profiler->ring[profiler->head] = *s;
+  profiler->head = (profiler->head + 1) % SYSTEM_PROFILE_WINDOW;
+  if (profiler->filled < SYSTEM_PROFILE_WINDOW) {
+    profiler->filled++;
+  }
+  profile_busy = false;
+  portEXIT_CRITICAL(&profile_lock);
+}
+
+static bool sample_runtime(const profile_sample_t *s, UBaseType_t number,
+                           configRUN_TIME_COUNTER_TYPE *runtime) {
+  for (uint16_t i = 0; i < s->count; i++) {
+    if (s->tasks[i].number == number) {
+      *runtime = s->tasks[i].runtime;
       return true;
     }
-    current = current->next;
   }
-  printf("Task %s not found.\n", task_name);
   return false;
 }
 
-void system_manager_list_tasks() {
-  ManagedTask *current = task_list_head;
-  printf("Currently managed tasks:\n");
-  while (current != NULL) {
-    printf("Task Name: %s, Priority: %d\n", current->task_name,
-           current->priority);
-    current = current->next;
+#endif
+
+bool system_manager_profiler_start(void) {
+#if PROFILER_AVAILABLE
+  if (profiler != NULL) {
+    return true;
+  }
+  profiler_t *p = calloc(1, sizeof(profiler_t));
+  if (p == NULL) {
+    printf("Not enough memory for the profiler\n");
+    return false;
+  }
+  profiler = p;
+  profile_stopping = false;
+
+  const esp_timer_create_args_t args = {.callback = profile_sample_cb,
+                                        .name = "task_profile"};
+  if (esp_timer_create(&args, &profile_timer) != ESP_OK) {
+    profiler = NULL;
+    free(p);
+    return false;
+  }
+  profile_sample_cb(NULL);
+  esp_timer_start_periodic(profile_timer, SYSTEM_PROFILE_INTERVAL_MS * 1000);
+  return true;
+#else
+  printf("Task profiler not built in, enable CONFIG_GHOST_TASK_PROFILER.\n");
+  return false;
+#endif
+}
+
+void system_manager_profiler_stop(void) {
+#if PROFILER_AVAILABLE
+  if (profiler == NULL) {
+    return;
+  }
+  if (profile_timer != NULL) {
+    esp_err_t err = esp_timer_stop(profile_timer);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+      printf("Failed to stop the profiler timer: %s\n", esp_err_to_name(err));
+    }
   }
-}
\ No newline at end of file
+
+  // A sample already running in the esp_timer task still writes to the
+  // profiler, later ones return at once
+  bool busy;
+  portENTER_CRITICAL(&profile_lock);
+  profile_stopping = true;
+  busy = profile_busy;
+  portEXIT_CRITICAL(&profile_lock);
+  while (busy) {
+    vTaskDelay(1);
+    portENTER_CRITICAL(&profile_lock);
+    busy = profile_busy;
+    portEXIT_CRITICAL(&profile_lock);
+  }
+
+  if (profile_timer != NULL) {
+    esp_timer_delete(profile_timer);
+    profile_timer = NULL;
+  }
+  free(profiler);
+  profiler = NULL;
+#endif
+}
+
+bool system_manager_profiler_running(void) {
+#if PROFILER_AVAILABLE
+  return profiler != NULL;
+#else
+  return false;
+#endif
+}
+
+int system_manager_profile(system_task_profile_t *out, int max,
+                           uint32_t *window_ms) {
+  *window_ms = 0;
+#if PROFILER_AVAILABLE
+  if (profiler == NULL || max <= 0) {
+    return 0;
+  }
+
+  profile_sample_t *window = malloc(2 * sizeof(profile_sample_t));
+  TaskStatus_t *status = malloc(SYSTEM_PROFILE_MAX_TASKS * sizeof(TaskStatus_t));
+  if (window == NULL || status == NULL) {
+    free(window);
+    free(status);
+    return 0;
+  }
+
+  profile_sample_t *oldest = &window[0];
+  profile_sample_t *newest = &window[1];
+  bool have_window;
+  portENTER_CRITICAL(&profile_lock);
+  have_window = profiler->filled >= 2;
+  if (have_window) {
+    uint8_t first =
+        profiler->filled < SYSTEM_PROFILE_WINDOW ? 0 : profiler->head;
+    uint8_t last =
+        (profiler->head + SYSTEM_PROFILE_WINDOW - 1) % SYSTEM_PROFILE_WINDOW;
+    *oldest = profiler->ring[first];
+    *newest = profiler->ring[last];
+  }
+  portEXIT_CRITICAL(&profile_lock);
+
+  configRUN_TIME_COUNTER_TYPE span = 0;
+  if (have_window) {
+    span = (newest->total - oldest->total) * configNUMBER_OF_CORES;
+    *window_ms = newest->time_ms - oldest->time_ms;
+  }
+
+  UBaseType_t n = uxTaskGetSystemState(status, SYSTEM_PROFILE_MAX_TASKS, NULL);
+  int count = 0;
+
+  registry_take();
+  for (UBaseType_t i = 0; i < n && count < max; i++) {
+    system_task_profile_t *p = &out[count++];
+    memset(p, 0, sizeof(*p));
+    strncpy(p->name, status[i].pcTaskName, sizeof(p->name) - 1);
+    p->state = status[i].eCurrentState;
+    p->priority = status[i].uxCurrentPriority;
+    p->stack_free = status[i].usStackHighWaterMark;
+
+    ManagedTask *e = find_entry(p->name);
+    p->managed = e != NULL && e->task_handle == status[i].xHandle;
+
+    configRUN_TIME_COUNTER_TYPE before = 0, after = 0;
+    if (span > 0 && sample_runtime(newest, status[i].xTaskNumber, &after)) {
+      // A task missing from the oldest sample started inside the window
+      sample_runtime(oldest, status[i].xTaskNumber, &before);
+      uint64_t permille = (uint64_t)(after - before) * 1000 / span;
+      p->cpu_permille = permille > 1000 ? 1000 : (uint16_t)permille;
+    }
+  }
+  registry_give();
+
+  free(window);
+  free(status);
+
+  // Busiest first, the list is short enough for insertion sort
+  for (int i = 1; i < count; i++) {
+    system_task_profile_t tmp = out[i];
+    int j = i - 1;
+    while (j >= 0 && out[j].cpu_permille < tmp.cpu_permille) {
+      out[j + 1] = out[j];
+      j--;
+    }
+    out[j + 1] = tmp;
+  }
+  return count;
+#else
+  (void)out;
+  (void)max;
+  return 0;
+#endif
+}
+
+void system_manager_print_top(void) {
+#if PROFILER_AVAILABLE
+  if (!system_manager_profiler_running()) {
+    if (!system_manager_profiler_start()) {
+      return;
+    }
+    printf("Task profiler started, %d s window.\n",
+           SYSTEM_PROFILE_WINDOW * SYSTEM_PROFILE_INTERVAL_MS / 1000);
+    TERMINAL_VIEW_ADD_TEXT("Task profiler started\n");
+    // Two samples are needed before anything can be reported
+    vTaskDelay(pdMS_TO_TICKS(SYSTEM_PROFILE_INTERVAL_MS + 100));
+  }
+
+  system_task_profile_t *tasks =
+      malloc(SYSTEM_PROFILE_MAX_TASKS * sizeof(system_task_profile_t));
+  if (tasks == NULL) {
+    printf("Not enough memory for task list\n");
+    return;
+  }
+
+  uint32_t window_ms;
+  int count = system_manager_profile(tasks, SYSTEM_PROFILE_MAX_TASKS, &window_ms);
+
+  printf("Tasks: %d, CPU over last %lu ms (* = managed)\n", count,
+         (unsigned long)window_ms);
+  printf("%-17s %5s %4s %6s %6s\n", "Task", "State", "Prio", "CPU%", "Free");
+  for (int i = 0; i < count; i++) {
+    const system_task_profile_t *t = &tasks[i];
+    printf("%c%-16s %5c %4d %3u.%01u %6lu\n", t->managed ? '*' : ' ', t->name,
+           state_char(t->state), (int)t->priority, t->cpu_permille / 10,
+           t->cpu_permille % 10, (unsigned long)t->stack_free);
+  }
+
+  // The terminal view only has room for the busiest few
+  TERMINAL_VIEW_ADD_TEXT("CPU over %lus:\n", (unsigned long)(window_ms / 1000));
+  for (int i = 0; i < count && i < 8; i++) {
+    TERMINAL_VIEW_ADD_TEXT("%-12.12s %3u.%01u%%\n", tasks[i].name,
+                           tasks[i].cpu_permille / 10,
+                           tasks[i].cpu_permille % 10);
+  }
+
+  free(tasks);
+#else
+  printf("Task profiler not built in, enable CONFIG_GHOST_TASK_PROFILER.\n");
+  TERMINAL_VIEW_ADD_TEXT("Task profiler not built in.\n");
+  system_manager_list_tasks();
+#endif
+}
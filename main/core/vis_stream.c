@@ -0,0 +1,184 @@
+// vis_stream.c
+
+#include "core/vis_stream.h"
+#include <string.h>
+
+static uint16_t read_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+// Reads one length-prefixed name at *pos, false if it runs past len
+static bool read_name(const uint8_t *buf, size_t len, size_t *pos, char *out) {
+  if (*pos >= len) {
+    return false;
+  }
+  size_t name_len = buf[(*pos)++];
+  if (name_len > VIS_MAX_NAME || *pos + name_len > len) {
+    return false;
+  }
+  memcpy(out, buf + *pos, name_len);
+  out[name_len] = '\0';
+  *pos += name_len;
+  return true;
+}
+
+bool vis_packet_parse(const uint8_t *buf, size_t len, vis_packet_t *pkt) {
+  if (len < VIS_HEADER_LEN || buf[0] != 'G' || buf[1] != 'V' ||
+      buf[2] != VIS_PROTO_VERSION) {
+    return false;
+  }
+  uint8_t flags = buf[3];
+  uint8_t band_count = buf[6];
+  if (band_count > VIS_MAX_BANDS ||
+      len < (size_t)VIS_HEADER_LEN + band_count) {
+    return false;
+  }
+
+  pkt->seq = read_le16(buf + 4);
+  pkt->ts_ms = read_le32(buf + 8);
+  pkt->band_count = band_count;
+  memcpy(pkt->bands, buf + VIS_HEADER_LEN, band_count);
+
+  // Unknown flags are for later versions and ignored
+  pkt->has_meta = (flags & VIS_FLAG_META) != 0;
+  if (pkt->has_meta) {
+    size_t pos = VIS_HEADER_LEN + band_count;
+    if (!read_name(buf, len, &pos, pkt->track) ||
+        !read_name(buf, len, &pos, pkt->artist)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void jitter_restart(vis_jitter_t *jb, const vis_packet_t *pkt,
+                           uint32_t now_ms) {
+  memset(jb->used, 0, sizeof(jb->used));
+  jb->started = true;
+  jb->next_seq = pkt->seq;
+  jb->highest_seq = pkt->seq;
+  jb->offset_ms = (int32_t)(now_ms - pkt->ts_ms);
+  jb->offset_prev = jb->offset_ms;
+  jb->offset_cur = jb->offset_ms;
+  jb->offset_window_ms = now_ms;
+}
+
+// Keeps the offset at the lowest transit over a sliding window. A minimum
+// kept forever only ever drops, and a sender clock running slow would wear
+// the playout delay away until every packet is late.
+static void track_offset(vis_jitter_t *jb, int32_t offset, uint32_t now_ms) {
+  if (now_ms - jb->offset_window_ms >= VIS_OFFSET_WINDOW_MS) {
+    jb->offset_prev = jb->offset_cur;
+    jb->offset_cur = offset;
+    jb->offset_window_ms = now_ms;
+  } else if (offset < jb->offset_cur) {
+    jb->offset_cur = offset;
+  }
+  jb->offset_ms =
+      jb->offset_cur < jb->offset_prev ? jb->offset_cur : jb->offset_prev;
+}
+
+void vis_jitter_init(vis_jitter_t *jb, uint32_t delay_ms) {
+  memset(jb, 0, sizeof(*jb));
+  jb->delay_ms = delay_ms;
+}
+
+bool vis_jitter_push(vis_jitter_t *jb, const vis_packet_t *pkt,
+                     uint32_t now_ms) {
+  jb->stats.received++;
+
+  int16_t ahead = (int16_t)(pkt->seq - jb->next_seq);
+  if (!jb->started || now_ms - jb->last_rx_ms > VIS_STREAM_TIMEOUT_MS ||
+      ahead > VIS_STREAM_RESYNC || ahead < -VIS_STREAM_RESYNC) {
+    jitter_restart(jb, pkt, now_ms);
+    ahead = 0;
+  }
+  jb->last_rx_ms = now_ms;
+  // Packets are due delay_ms after the fastest recent transit. Late ones
+  // count too, they are what a sender clock running slow produces.
+  track_offset(jb, (int32_t)(now_ms - pkt->ts_ms), now_ms);
+
+  if (ahead < 0) {
+    jb->stats.late++;
+    return false;
+  }
+
+  // The buffer holds next_seq onwards, a packet beyond it means playout
+  // fell behind. Give up on the oldest slots to make room.
+  while (ahead >= VIS_JITTER_SLOTS) {
+    jb->used[jb->next_seq % VIS_JITTER_SLOTS] = false;
+    jb->stats.lost++;
+    jb->next_seq++;
+    ahead--;
+  }
+
+  int slot = pkt->seq % VIS_JITTER_SLOTS;
+  if (jb->used[slot] && jb->slots[slot].seq == pkt->seq) {
+    jb->stats.duplicates++;
+    return false;
+  }
+
+  if ((int16_t)(pkt->seq - jb->highest_seq) < 0) {
+    jb->stats.reordered++;
+  } else {
+    jb->highest_seq = pkt->seq;
+  }
+
+  jb->slots[slot] = *pkt;
+  jb->used[slot] = true;
+  return true;
+}
+
+bool vis_jitter_pop(vis_jitter_t *jb, uint32_t now_ms, vis_packet_t *out) {
+  if (!jb->started) {
+    return false;
+  }
+
+  for (uint16_t skip = 0; skip < VIS_JITTER_SLOTS; skip++) {
+    uint16_t seq = jb->next_seq + skip;
+    int slot = seq % VIS_JITTER_SLOTS;
+    if (!jb->used[slot] || jb->slots[slot].seq != seq) {
+      continue;
+    }
+
+    // The earliest packet held, anything missing before it was due earlier
+    uint32_t due = jb->slots[slot].ts_ms + jb->offset_ms + jb->delay_ms;
+    if ((int32_t)(now_ms - due) < 0) {
+      return false;
+    }
+    *out = jb->slots[slot];
+    jb->used[slot] = false;
+    jb->next_seq = seq + 1;
+    jb->stats.lost += skip;
+    jb->stats.played++;
+    return true;
+  }
+  return false;
+}
+
+void vis_resample_bands(const uint8_t *bands, uint8_t count, uint8_t *out,
+                        uint8_t out_count) {
+  for (int i = 0; i < out_count; i++) {
+    if (count == 0) {
+      out[i] = 0;
+      continue;
+    }
+    int lo = i * count / out_count;
+    int hi = (i + 1) * count / out_count;
+    if (hi <= lo) {
+      hi = lo + 1;
+    }
+    uint8_t level = 0;
+    for (int b = lo; b < hi; b++) {
+      if (bands[b] > level) {
+        level = bands[b];
+      }
+    }
+    out[i] = level;
+  }
+}
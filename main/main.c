@@ -1,12 +1,15 @@
 #include "core/commandline.h"
 #include "core/serial_manager.h"
+#include "core/sys_stats.h"
 #include "core/system_manager.h"
 #include "managers/ap_manager.h"
 #include "managers/display_manager.h"
+#include "managers/printer_manager.h"
 #include "managers/rgb_manager.h"
 #include "managers/sd_card_manager.h"
 #include "managers/settings_manager.h"
 #include "managers/wifi_manager.h"
+#include "vendor/pcap.h"
 #ifndef CONFIG_IDF_TARGET_ESP32S2
 #include "managers/ble_manager.h"
 #endif
@@ -23,8 +26,11 @@
 int ieee80211_raw_frame_sanity_check(int32_t arg, int32_t arg2, int32_t arg3) { return 0; }
 
 void app_main(void) {
+    system_manager_init();
+    sys_stats_init();
     serial_manager_init();
     wifi_manager_init();
+    printer_manager_init();
 #ifndef CONFIG_IDF_TARGET_ESP32S2
     // ble_init();
 #endif
@@ -76,6 +82,11 @@ void app_main(void) {
 #endif
 
     esp_err_t err = sd_card_init();
+    if (err == ESP_OK) {
+        // Captures cut off by a reset or power loss are trimmed before
+        // anything else writes to the card
+        pcap_recover_all();
+    }
 
     // Initialize RGB Manager based on persisted settings or compile-time defaults
     {
@@ -102,8 +113,8 @@ void app_main(void) {
     #endif
         }
         if (settings_get_rgb_mode(&G_Settings) == RGB_MODE_RAINBOW) {
-            xTaskCreate(rainbow_task, "Rainbow Task", 8192, &rgb_manager, 1,
-                        &rgb_effect_task_handle);
+            system_manager_create_task(rainbow_task, "Rainbow Task", 8192, &rgb_manager, 1,
+                                       &rgb_effect_task_handle, NULL);
         }
     }
 
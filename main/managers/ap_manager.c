@@ -1,4 +1,7 @@
 #include "managers/ap_manager.h"
+#include "core/capture_stats.h"
+#include "core/multipart.h"
+#include "core/sys_stats.h"
 #include "managers/ghost_esp_site.h"
 #include "managers/settings_manager.h"
 #include <cJSON.h>
@@ -10,6 +13,7 @@
 #include <esp_http_server.h>
 #include <esp_log.h>
 #include <esp_netif.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
@@ -29,6 +33,7 @@ static esp_err_t api_settings_handler(httpd_req_t *req);
 static esp_err_t api_command_handler(httpd_req_t *req);
 static esp_err_t api_settings_get_handler(httpd_req_t *req);
 static esp_err_t api_logs_handler(httpd_req_t *req);
+static esp_err_t api_stats_handler(httpd_req_t *req);
 
 static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id,
                           void *event_data);
@@ -36,7 +41,6 @@ static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_
 #define MAX_LOG_BUFFER_SIZE (8 * 1024)  // Increase to 32KB
 #define LOG_CHUNK_SIZE (MAX_LOG_BUFFER_SIZE / 4)  // Size to remove when buffer is full
 #define MAX_FILE_SIZE (5 * 1024 * 1024) // 5 MB
-#define BUFFER_SIZE (1024)              // 1 KB buffer size for reading chunks
 #define MIN_(a, b) ((a) < (b) ? (a) : (b))
 #define SERIAL_BUFFER_SIZE 528          // Size of serial buffer
 
@@ -200,7 +204,7 @@ static esp_err_t api_sd_card_post_handler(httpd_req_t *req) {
     size_t file_size = file_stat.st_size;
 
     // Allocate memory for the buffer
-    char *file_buf = malloc(file_size);
+    char *file_buf = sys_stats_malloc(SYS_STATS_TAG_WEB, file_size);
     if (!file_buf) {
         ESP_LOGE(TAG, "Failed to allocate memory for file buffer.");
         fclose(file);
@@ -215,7 +219,7 @@ static esp_err_t api_sd_card_post_handler(httpd_req_t *req) {
 
     if (bytes_read != file_size) {
         ESP_LOGE(TAG, "Failed to read entire file: %s", file_path);
-        free(file_buf);
+        sys_stats_free(file_buf);
         httpd_resp_set_status(req, "500 Internal Server Error");
         httpd_resp_sendstr(req, "{\"error\": \"Failed to read file.\"}");
         return ESP_FAIL;
@@ -228,14 +232,14 @@ static esp_err_t api_sd_card_post_handler(httpd_req_t *req) {
     // Send the file content
     if (httpd_resp_send(req, file_buf, file_size) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to send file.");
-        free(file_buf);
+        sys_stats_free(file_buf);
         return ESP_FAIL;
     }
 
     ESP_LOGI(TAG, "File sent successfully: %s", file_path);
 
     // Free allocated memory
-    free(file_buf);
+    sys_stats_free(file_buf);
     cJSON_Delete(json);
 
     return ESP_OK;
@@ -310,191 +314,248 @@ esp_err_t api_sd_card_delete_file_handler(httpd_req_t *req) {
     return ESP_FAIL;
 }
 
-// Handler for uploading files to SD card
+#define UPLOAD_RECV_SIZE (4 * 1024)
+// Files are written in whole blocks so FATFS gets full sectors at aligned
+// offsets. Smaller blocks are tried when the heap is short.
+#define UPLOAD_BLOCK_SIZE (16 * 1024)
+#define UPLOAD_BLOCK_MIN (4 * 1024)
+#define UPLOAD_PROGRESS_STEP 10 // Percent between progress reports
+#define UPLOAD_RECV_RETRIES 5
+
+typedef struct {
+    const char *dir;
+    char file_path[MAX_PATH_LENGTH + 128];
+    FILE *file;
+    uint8_t *block;
+    size_t block_size;
+    size_t block_len;
+    size_t file_bytes;
+    int files;
+    const char *error; // Why a callback stopped the parser
+} upload_ctx_t;
+
+static bool upload_flush(upload_ctx_t *u) {
+    if (u->block_len > 0 && fwrite(u->block, 1, u->block_len, u->file) != u->block_len) {
+        ESP_LOGE(TAG, "Failed to write file data.");
+        u->error = "Failed to write file data.";
+        return false;
+    }
+    u->block_len = 0;
+    return true;
+}
+
+// Closes the open file, removing it unless it was received whole
+static void upload_close(upload_ctx_t *u, bool keep) {
+    if (!u->file) {
+        return;
+    }
+    fclose(u->file);
+    u->file = NULL;
+    if (!keep) {
+        remove(u->file_path);
+    }
+}
+
+static bool upload_on_part(const char *name, const char *filename, void *ctx) {
+    upload_ctx_t *u = ctx;
+    if (strcmp(name, "file") != 0) {
+        return true;
+    }
+
+    // Some browsers send the client side path, only the name is kept
+    const char *base = filename;
+    for (const char *s = filename; *s; s++) {
+        if (*s == '/' || *s == '\\') {
+            base = s + 1;
+        }
+    }
+    if (*base == '\0' || strcmp(base, ".") == 0 || strcmp(base, "..") == 0) {
+        base = "received_file";
+    }
+    snprintf(u->file_path, sizeof(u->file_path), "%s/%s", u->dir, base);
+
+    u->file = fopen(u->file_path, "wb");
+    if (!u->file) {
+        ESP_LOGE(TAG, "Failed to open file for writing: %s", u->file_path);
+        u->error = "Failed to open file.";
+        return false;
+    }
+    // Writes are whole blocks already, skip the copy through stdio
+    setvbuf(u->file, NULL, _IONBF, 0);
+    u->block_len = 0;
+    u->file_bytes = 0;
+    ESP_LOGI(TAG, "Opened file for writing: %s", u->file_path);
+    return true;
+}
+
+static bool upload_on_data(const uint8_t *data, size_t len, void *ctx) {
+    upload_ctx_t *u = ctx;
+    if (!u->file) {
+        return true;
+    }
+    u->file_bytes += len;
+    while (len > 0) {
+        size_t n = MIN_(u->block_size - u->block_len, len);
+        memcpy(u->block + u->block_len, data, n);
+        u->block_len += n;
+        data += n;
+        len -= n;
+        if (u->block_len == u->block_size && !upload_flush(u)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool upload_on_part_end(void *ctx) {
+    upload_ctx_t *u = ctx;
+    if (!u->file) {
+        return true;
+    }
+    if (!upload_flush(u)) {
+        return false;
+    }
+    upload_close(u, true);
+    u->files++;
+    ESP_LOGI(TAG, "Saved %s: %zu bytes", u->file_path, u->file_bytes);
+    return true;
+}
+
+static esp_err_t upload_send_error(httpd_req_t *req, const char *status, const char *message) {
+    char body[96];
+    snprintf(body, sizeof(body), "{\"error\": \"%s\"}", message);
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, body);
+    return ESP_FAIL;
+}
+
+// Handler for uploading files to SD card. The multipart body is parsed as
+// it arrives and each file part is written through one reusable block.
 static esp_err_t api_sd_card_upload_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "Received file upload request.");
 
-    // 1. Retrieve 'path' query parameter
     char path_param[MAX_PATH_LENGTH] = {0};
     if (get_query_param(req, "path", path_param, sizeof(path_param)) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get 'path' from query parameters.");
-        httpd_resp_set_status(req, "400 Bad Request");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Missing or invalid 'path' query parameter.\"}");
-        return ESP_FAIL;
+        return upload_send_error(req, "400 Bad Request",
+                                 "Missing or invalid 'path' query parameter.");
     }
     ESP_LOGI(TAG, "Upload path: %s", path_param);
 
-    // 2. Retrieve Content-Type header and boundary
     char content_type[128] = {0};
     if (httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type)) !=
         ESP_OK) {
         ESP_LOGE(TAG, "Failed to get Content-Type header.");
-        httpd_resp_set_status(req, "400 Bad Request");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Missing Content-Type header.\"}");
-        return ESP_FAIL;
+        return upload_send_error(req, "400 Bad Request", "Missing Content-Type header.");
     }
 
-    const char *boundary_prefix = "boundary=";
-    char *boundary_start = strstr(content_type, boundary_prefix);
-    if (!boundary_start) {
+    char boundary[MULTIPART_BOUNDARY_MAX + 1];
+    if (!multipart_get_boundary(content_type, boundary, sizeof(boundary))) {
         ESP_LOGE(TAG, "Failed to parse boundary.");
-        httpd_resp_set_status(req, "400 Bad Request");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Boundary missing.\"}");
-        return ESP_FAIL;
-    }
-    boundary_start += strlen(boundary_prefix);
-
-    // Allocate memory for the boundary
-    size_t boundary_len = strlen(boundary_start) + 3; // +3 for "--" and null terminator
-    char *boundary = malloc(boundary_len);
-    if (!boundary) {
-        ESP_LOGE(TAG, "Failed to allocate memory for boundary.");
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Memory allocation failed.\"}");
-        return ESP_FAIL;
+        return upload_send_error(req, "400 Bad Request", "Boundary missing.");
     }
-    snprintf(boundary, boundary_len, "--%s", boundary_start);
     ESP_LOGD(TAG, "Parsed boundary: %s", boundary);
 
-    // Allocate memory for the buffer
-    char *buf = malloc(BUFFER_SIZE + 1); // +1 for null-terminator
-    if (!buf) {
-        ESP_LOGE(TAG, "Failed to allocate memory for request buffer.");
-        free(boundary);
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Memory allocation failed.\"}");
-        return ESP_FAIL;
-    }
-
-    FILE *file = NULL;
-    char *file_path = malloc(MAX_PATH_LENGTH + 128); // Allocate heap memory for file_path
-    if (!file_path) {
-        ESP_LOGE(TAG, "Failed to allocate memory for file path.");
-        free(buf);
-        free(boundary);
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Memory allocation failed.\"}");
-        return ESP_FAIL;
-    }
+    upload_ctx_t *u = sys_stats_malloc(SYS_STATS_TAG_WEB, sizeof(upload_ctx_t));
+    multipart_parser_t *parser = sys_stats_malloc(SYS_STATS_TAG_WEB, sizeof(multipart_parser_t));
+    uint8_t *buf = sys_stats_malloc(SYS_STATS_TAG_WEB, UPLOAD_RECV_SIZE);
+    size_t block_size = UPLOAD_BLOCK_SIZE;
+    uint8_t *block = sys_stats_malloc(SYS_STATS_TAG_WEB, block_size);
+    while (!block && block_size > UPLOAD_BLOCK_MIN) {
+        block_size /= 2;
+        block = sys_stats_malloc(SYS_STATS_TAG_WEB, block_size);
+    }
+    if (!u || !parser || !buf || !block) {
+        ESP_LOGE(TAG, "Failed to allocate upload buffers.");
+        sys_stats_free(u);
+        sys_stats_free(parser);
+        sys_stats_free(buf);
+        sys_stats_free(block);
+        return upload_send_error(req, "500 Internal Server Error", "Memory allocation failed.");
+    }
+
+    memset(u, 0, sizeof(*u));
+    u->dir = path_param;
+    u->block = block;
+    u->block_size = block_size;
+    multipart_callbacks_t callbacks = {
+        .on_part = upload_on_part,
+        .on_data = upload_on_data,
+        .on_part_end = upload_on_part_end,
+        .ctx = u,
+    };
+    multipart_init(parser, boundary, &callbacks);
+
+    size_t total = req->content_len;
+    size_t received = 0;
+    int next_pct = UPLOAD_PROGRESS_STEP;
+    int retries = 0;
+    int64_t start_us = esp_timer_get_time();
+    const char *status = NULL;
+    const char *error = NULL;
+
+    while (received < total) {
+        int n = httpd_req_recv(req, (char *)buf, MIN_(total - received, UPLOAD_RECV_SIZE));
+        if (n == HTTPD_SOCK_ERR_TIMEOUT && ++retries <= UPLOAD_RECV_RETRIES) {
+            continue;
+        }
+        if (n <= 0) {
+            ESP_LOGE(TAG, "Error receiving file data.");
+            status = "500 Internal Server Error";
+            error = "Failed to receive file data.";
+            break;
+        }
+        retries = 0;
+        received += n;
 
-    size_t total_received = 0;
-    int received;
-
-    // 4. Process the multipart form-data
-    while ((received = httpd_req_recv(req, buf, BUFFER_SIZE)) > 0) {
-        buf[received] = '\0'; // Null-terminate for string operations
-
-        char *boundary_ptr = strstr(buf, boundary);
-        if (boundary_ptr) {
-            char *headers_end = strstr(boundary_ptr, "\r\n\r\n");
-            if (!headers_end) {
-                ESP_LOGE(TAG, "Malformed part headers.");
-                free(buf);
-                free(boundary);
-                free(file_path);
-                if (file)
-                    fclose(file);
-                httpd_resp_set_status(req, "400 Bad Request");
-                httpd_resp_set_type(req, "application/json");
-                httpd_resp_sendstr(req, "{\"error\": \"Malformed part headers.\"}");
-                return ESP_FAIL;
+        if (!multipart_feed(parser, buf, n)) {
+            if (u->error) {
+                status = "500 Internal Server Error";
+                error = u->error;
+            } else {
+                ESP_LOGE(TAG, "Malformed multipart body.");
+                status = "400 Bad Request";
+                error = "Malformed multipart body.";
             }
-            headers_end += 4;
-
-            if (strstr(boundary_ptr, "Content-Disposition: form-data; name=\"file\"")) {
-                char *filename_start = strstr(boundary_ptr, "filename=\"");
-                char original_filename[128] = {0};
-                if (filename_start) {
-                    filename_start += strlen("filename=\"");
-                    char *filename_end = strstr(filename_start, "\"");
-                    if (filename_end &&
-                        (filename_end - filename_start) < sizeof(original_filename)) {
-                        strncpy(original_filename, filename_start, filename_end - filename_start);
-                        original_filename[filename_end - filename_start] = '\0';
-                        ESP_LOGI(TAG, "Original filename: %s", original_filename);
-                    }
-                }
-
-                if (strlen(original_filename) > 0) {
-                    snprintf(file_path, MAX_PATH_LENGTH + 128, "%s/%s", path_param,
-                             original_filename);
-                } else {
-                    snprintf(file_path, MAX_PATH_LENGTH + 128, "%s/received_file", path_param);
-                }
+            break;
+        }
 
-                file = fopen(file_path, "wb");
-                if (!file) {
-                    ESP_LOGE(TAG, "Failed to open file for writing: %s", file_path);
-                    free(buf);
-                    free(boundary);
-                    free(file_path);
-                    httpd_resp_set_status(req, "500 Internal Server Error");
-                    httpd_resp_set_type(req, "application/json");
-                    httpd_resp_sendstr(req, "{\"error\": \"Failed to open file.\"}");
-                    return ESP_FAIL;
-                }
-                ESP_LOGI(TAG, "Opened file for writing: %s", file_path);
-
-                size_t data_len = received - (headers_end - buf);
-                if (data_len > 0 && fwrite(headers_end, 1, data_len, file) != data_len) {
-                    ESP_LOGE(TAG, "Failed to write file data.");
-                    fclose(file);
-                    free(buf);
-                    free(boundary);
-                    free(file_path);
-                    httpd_resp_set_status(req, "500 Internal Server Error");
-                    httpd_resp_set_type(req, "application/json");
-                    httpd_resp_sendstr(req, "{\"error\": \"Failed to write file data.\"}");
-                    return ESP_FAIL;
-                }
-                total_received += data_len;
-            }
-        } else if (file) {
-            if (fwrite(buf, 1, received, file) != received) {
-                ESP_LOGE(TAG, "Failed to write file data.");
-                fclose(file);
-                free(buf);
-                free(boundary);
-                free(file_path);
-                httpd_resp_set_status(req, "500 Internal Server Error");
-                httpd_resp_set_type(req, "application/json");
-                httpd_resp_sendstr(req, "{\"error\": \"Failed to write file data.\"}");
-                return ESP_FAIL;
-            }
-            total_received += received;
+        int pct = (int)((uint64_t)received * 100 / total);
+        if (pct >= next_pct) {
+            char progress[64];
+            snprintf(progress, sizeof(progress), "Upload %d%% (%zu/%zu bytes)\n", pct, received,
+                     total);
+            ESP_LOGI(TAG, "Upload %d%% (%zu/%zu bytes)", pct, received, total);
+            ap_manager_add_log(progress);
+            next_pct = pct - pct % UPLOAD_PROGRESS_STEP + UPLOAD_PROGRESS_STEP;
         }
     }
 
-    if (received < 0) {
-        ESP_LOGE(TAG, "Error receiving file data.");
-        free(buf);
-        free(boundary);
-        free(file_path);
-        if (file)
-            fclose(file);
-        httpd_resp_set_status(req, "500 Internal Server Error");
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_sendstr(req, "{\"error\": \"Failed to receive file data.\"}");
-        return ESP_FAIL;
+    if (!error && !multipart_complete(parser)) {
+        ESP_LOGE(TAG, "Upload ended before the closing boundary.");
+        status = "400 Bad Request";
+        error = "Incomplete multipart body.";
     }
 
-    free(buf);
-    free(boundary);
-    free(file_path);
-    if (file)
-        fclose(file);
+    upload_close(u, false);
+    int files = u->files;
+    sys_stats_free(block);
+    sys_stats_free(buf);
+    sys_stats_free(parser);
+    sys_stats_free(u);
+
+    if (error) {
+        return upload_send_error(req, status, error);
+    }
 
+    int64_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+    ESP_LOGI(TAG, "File uploaded successfully: %d file(s), %zu bytes in %lld ms (%lld KB/s).",
+             files, received, (long long)elapsed_ms,
+             elapsed_ms > 0 ? (long long)received / elapsed_ms : 0LL);
     httpd_resp_set_status(req, "200 OK");
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"message\": \"File uploaded successfully.\"}");
-    ESP_LOGI(TAG, "File uploaded successfully: %zu bytes received.", total_received);
-
     return ESP_OK;
 }
 
@@ -709,6 +770,11 @@ esp_err_t ap_manager_init(void) {
                                 .handler = api_logs_handler,
                                 .user_ctx = NULL};
 
+    httpd_uri_t uri_get_stats = {.uri = "/api/stats",
+                                 .method = HTTP_GET,
+                                 .handler = api_stats_handler,
+                                 .user_ctx = NULL};
+
     httpd_uri_t uri_delete_command = {.uri = "/api/sdcard",
                                       .method = HTTP_DELETE,
                                       .handler = api_sd_card_delete_file_handler,
@@ -762,6 +828,12 @@ esp_err_t ap_manager_init(void) {
         printf("Error registering URI\n");
     }
 
+    ret = httpd_register_uri_handler(server, &uri_get_stats);
+
+    if (ret != ESP_OK) {
+        printf("Error registering URI\n");
+    }
+
     printf("HTTP server started\n");
 
     esp_wifi_set_ps(WIFI_PS_NONE);
@@ -921,6 +993,11 @@ esp_err_t ap_manager_start_services() {
                                 .handler = api_logs_handler,
                                 .user_ctx = NULL};
 
+    httpd_uri_t uri_get_stats = {.uri = "/api/stats",
+                                 .method = HTTP_GET,
+                                 .handler = api_stats_handler,
+                                 .user_ctx = NULL};
+
     ret = httpd_register_uri_handler(server, &uri_delete_command);
     if (ret != ESP_OK) {
         printf("Error registering URI\n");
@@ -969,6 +1046,12 @@ esp_err_t ap_manager_start_services() {
         printf("Error registering URI \n");
     }
 
+    ret = httpd_register_uri_handler(server, &uri_get_stats);
+
+    if (ret != ESP_OK) {
+        printf("Error registering URI \n");
+    }
+
     printf("HTTP server started\n");
 
     return ESP_OK;
@@ -1169,6 +1252,106 @@ static esp_err_t api_logs_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// Handler for /api/stats (heap, task stack, allocation and capture counters)
+static esp_err_t api_stats_handler(httpd_req_t *req) {
+    sys_stats_snapshot_t *snap = malloc(sizeof(*snap));
+    if (!snap) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    sys_stats_get_snapshot(snap);
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root) {
+        free(snap);
+        printf("Failed to create JSON object\n");
+        return ESP_FAIL;
+    }
+
+    cJSON_AddNumberToObject(root, "uptime_s", snap->uptime_s);
+    cJSON_AddNumberToObject(root, "samples", snap->samples);
+    cJSON_AddNumberToObject(root, "failed_allocs", snap->failed_allocs);
+    cJSON_AddNumberToObject(root, "last_failed_size", snap->last_failed_size);
+
+    cJSON *heap = cJSON_AddObjectToObject(root, "heap");
+    for (int i = 0; i < SYS_STATS_HEAP_COUNT; i++) {
+        const sys_stats_heap_info_t *h = &snap->heap[i];
+        if (!h->present)
+            continue;
+        cJSON *entry = cJSON_AddObjectToObject(heap, sys_stats_heap_name(i));
+        cJSON_AddNumberToObject(entry, "free", h->free_bytes);
+        cJSON_AddNumberToObject(entry, "min_free", h->min_free_bytes);
+        cJSON_AddNumberToObject(entry, "largest_block", h->largest_block);
+        cJSON_AddNumberToObject(entry, "total", h->total_bytes);
+    }
+
+    cJSON *tasks = cJSON_AddArrayToObject(root, "tasks");
+    for (int i = 0; i < snap->task_count; i++) {
+        const sys_stats_task_info_t *t = &snap->tasks[i];
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "name", t->name);
+        cJSON_AddNumberToObject(entry, "stack_size", t->stack_size);
+        cJSON_AddNumberToObject(entry, "stack_free", t->stack_free);
+        cJSON_AddNumberToObject(entry, "stack_free_min", t->stack_free_min);
+        cJSON_AddBoolToObject(entry, "running", t->running);
+        cJSON_AddBoolToObject(entry, "low", sys_stats_task_low(t));
+        cJSON_AddItemToArray(tasks, entry);
+    }
+
+    cJSON *alloc = cJSON_AddObjectToObject(root, "alloc");
+    for (int i = 0; i < SYS_STATS_TAG_COUNT; i++) {
+        const sys_stats_tag_info_t *tag = &snap->tags[i];
+        cJSON *entry = cJSON_AddObjectToObject(alloc, sys_stats_tag_name(i));
+        cJSON_AddNumberToObject(entry, "allocs", tag->allocs);
+        cJSON_AddNumberToObject(entry, "frees", tag->frees);
+        cJSON_AddNumberToObject(entry, "failures", tag->failures);
+        cJSON_AddNumberToObject(entry, "live_bytes", tag->live_bytes);
+        cJSON_AddNumberToObject(entry, "peak_bytes", tag->peak_bytes);
+    }
+    free(snap);
+
+    // Last run of every capture mode, rates only for the one running
+    cJSON *capture = cJSON_AddObjectToObject(root, "capture");
+    cJSON_AddStringToObject(capture, "active", capture_stats_mode_name(capture_stats_active()));
+    cJSON *modes = cJSON_AddObjectToObject(capture, "modes");
+    for (int i = CAPTURE_MODE_NONE + 1; i < CAPTURE_MODE_COUNT; i++) {
+        capture_stats_summary_t summary;
+        if (!capture_stats_get(i, &summary))
+            continue;
+        const capture_counters_t *c = &summary.counters;
+        cJSON *entry = cJSON_AddObjectToObject(modes, capture_stats_mode_name(i));
+        cJSON_AddBoolToObject(entry, "active", summary.active);
+        cJSON_AddNumberToObject(entry, "elapsed_s", summary.elapsed_s);
+        cJSON_AddNumberToObject(entry, "frames", c->frames);
+        cJSON_AddNumberToObject(entry, "written", c->written);
+        cJSON_AddNumberToObject(entry, "bytes", c->bytes);
+        cJSON_AddNumberToObject(entry, "dropped", c->dropped);
+        cJSON_AddNumberToObject(entry, "lock_timeouts", c->lock_timeouts);
+        cJSON_AddNumberToObject(entry, "flushes", c->flushes);
+        cJSON_AddNumberToObject(entry, "stalls", c->stalls);
+        cJSON_AddNumberToObject(entry, "flush_max_ms", c->flush_max_ms);
+        cJSON_AddNumberToObject(entry, "fps_1s", summary.rate_1s.frames);
+        cJSON_AddNumberToObject(entry, "fps_10s", summary.rate_10s.frames);
+        cJSON_AddNumberToObject(entry, "bytes_per_s_1s", summary.rate_1s.bytes);
+        cJSON_AddNumberToObject(entry, "bytes_per_s_10s", summary.rate_10s.bytes);
+        cJSON_AddNumberToObject(entry, "dropped_per_s_1s", summary.rate_1s.dropped);
+        cJSON_AddNumberToObject(entry, "dropped_per_s_10s", summary.rate_10s.dropped);
+    }
+
+    char *json_response = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json_response) {
+        printf("Failed to print JSON object\n");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json_response);
+    free(json_response);
+
+    return ESP_OK;
+}
+
 // Handler for /api/clear_logs (clears the log buffer)
 static esp_err_t api_clear_logs_handler(httpd_req_t *req) {
     if (!log_mutex) {
@@ -1193,7 +1376,7 @@ static esp_err_t api_settings_handler(httpd_req_t *req) {
     int total_len = req->content_len;
     int cur_len = 0;
     int received = 0;
-    char *buf = malloc(total_len + 1);
+    char *buf = sys_stats_malloc(SYS_STATS_TAG_WEB, total_len + 1);
     if (!buf) {
         printf("Failed to allocate memory for JSON payload\n");
         return ESP_FAIL;
@@ -1202,7 +1385,7 @@ static esp_err_t api_settings_handler(httpd_req_t *req) {
     while (cur_len < total_len) {
         received = httpd_req_recv(req, buf + cur_len, total_len - cur_len);
         if (received <= 0) {
-            free(buf);
+            sys_stats_free(buf);
             printf("Failed to receive JSON payload\n");
             return ESP_FAIL;
         }
@@ -1212,7 +1395,7 @@ static esp_err_t api_settings_handler(httpd_req_t *req) {
 
     // Parse JSON
     cJSON *root = cJSON_Parse(buf);
-    free(buf);
+    sys_stats_free(buf);
     if (!root) {
         printf("Failed to parse JSON\n");
         return ESP_FAIL;
@@ -5,17 +5,22 @@
 #include <string.h>
 #ifndef CONFIG_IDF_TARGET_ESP32S2
 #include "core/callbacks.h"
+#include "core/capture_stats.h"
+#include "core/system_manager.h"
 #include "esp_random.h"
 #include "host/ble_gap.h"
 #include "host/ble_hs.h"
 #include "host/util/util.h"
 #include "managers/ble_manager.h"
+#include "managers/ble_registry.h"
+#include "managers/ble_spam_detector.h"
 #include "managers/views/terminal_screen.h"
 #include "nimble/ble.h"
 #include "nimble/nimble_port.h"
 #include "nimble/nimble_port_freertos.h"
 #include "vendor/pcap.h"
 #include <esp_mac.h>
+#include <math.h>
 #include <managers/rgb_manager.h>
 #include <managers/settings_manager.h>
 
@@ -23,51 +28,189 @@
 #define MAX_HANDLERS 10
 #define MAX_PACKET_SIZE 31
 
-// Flipper tracking definitions
-#define MAX_FLIPPERS 50
-typedef struct {
-    ble_addr_t addr;
-    char name[32];
-    int8_t rssi;
-} FlipperDevice;
-static FlipperDevice discovered_flippers[MAX_FLIPPERS];
-static int discovered_flipper_count = 0;
+// Address bitmaps for the scan statistics
+#define BLE_SCAN_SECOND_BITS 512
+#define BLE_SCAN_UNIQUE_BITS 4096
+
+#define FLIPPER_STALE_MS (10 * 60 * 1000)
+#define AIRTAG_STALE_MS (15 * 60 * 1000)
+
+// Flipper and AirTag registries, indices shown by the list commands are
+// registry slots. A selection also remembers first_seen_ms so a slot that
+// was aged out and reused by another device is not mistaken for it.
+static ble_registry_t flipper_registry;
+static ble_registry_t airtag_registry;
+static bool registries_initialized = false;
 static int selected_flipper_index = -1; // Index of the Flipper selected for tracking
+static uint32_t selected_flipper_first_seen = 0;
 
 static const char *TAG_BLE = "BLE_MANAGER";
 static int airTagCount = 0;
 static bool ble_initialized = false;
-static esp_timer_handle_t flush_timer = NULL;
+#define BLE_PCAP_FLUSH_INTERVAL_MS 1000
+static TaskHandle_t pcap_flush_task_handle = NULL;
+static volatile bool pcap_flush_running = false;
 
 typedef struct {
     ble_data_handler_t handler;
+    ble_adv_filter_t filter;
 } ble_handler_t;
 
-// Structure to store discovered AirTag information
-typedef struct {
-    ble_addr_t addr;
-    uint8_t payload[BLE_HS_ADV_MAX_SZ]; // Store the full payload
-    size_t payload_len;
-    int8_t rssi;
-    bool selected_for_spoofing;
-} AirTagDevice;
-
-#define MAX_AIRTAGS 50 // Maximum number of AirTags to store
-static AirTagDevice discovered_airtags[MAX_AIRTAGS];
-static int discovered_airtag_count = 0;
 static int selected_airtag_index = -1; // Index of the AirTag selected for spoofing
+static uint32_t selected_airtag_first_seen = 0;
 
 static ble_handler_t *handlers = NULL;
 static int handler_count = 0;
-static int spam_counter = 0;
-static uint16_t *last_company_id = NULL;
-static TickType_t last_detection_time = 0;
-static void ble_pcap_callback(struct ble_gap_event *event, size_t len);
+static void ble_pcap_callback(struct ble_gap_event *event, const ble_adv_record_t *adv);
+
+// Legacy scanning only; every shipped config builds NimBLE without
+// extended advertising, so there is no PHY to choose.
+static const ble_scan_profile_t scan_profiles[BLE_SCAN_PROFILE_COUNT] = {
+    [BLE_SCAN_PROFILE_GENERAL] = {"general", BLE_HCI_SCAN_ITVL_DEF, BLE_HCI_SCAN_WINDOW_DEF, false,
+                                  true},
+    // Continuous active scan, scan responses carry most device names
+    [BLE_SCAN_PROFILE_DISCOVERY] = {"discovery", 0x00A0, 0x00A0, false, true},
+    // 75% duty, leaves the radio some room while reporting every advert
+    [BLE_SCAN_PROFILE_TRACKING] = {"tracking", 0x0040, 0x0030, false, false},
+    // Continuous passive scan, we only listen and keep every advert
+    [BLE_SCAN_PROFILE_CAPTURE] = {"capture", 0x0030, 0x0030, true, false},
+    [BLE_SCAN_PROFILE_SPAM] = {"spam", 0x0030, 0x0030, true, false},
+};
+
+static struct {
+    ble_scan_profile_id_t profile;
+    uint32_t start_ms;
+    uint32_t second_start_ms;
+    uint32_t adverts_total;
+    uint32_t adverts_this_sec;
+    uint32_t adverts_last_sec;
+    uint32_t unique_this_sec;
+    uint32_t unique_last_sec;
+    uint32_t peak_unique_per_sec;
+    uint32_t unique_bits_set;
+    uint8_t second_bits[BLE_SCAN_SECOND_BITS / 8];
+    uint8_t unique_bits[BLE_SCAN_UNIQUE_BITS / 8];
+} scan_stats;
+
+static void scan_stats_reset(ble_scan_profile_id_t profile) {
+    memset(&scan_stats, 0, sizeof(scan_stats));
+    scan_stats.profile = profile;
+    scan_stats.start_ms = ble_registry_now_ms();
+    scan_stats.second_start_ms = scan_stats.start_ms;
+}
+
+static void scan_stats_record(const uint8_t *addr) {
+    uint32_t now_ms = ble_registry_now_ms();
+    uint32_t since = now_ms - scan_stats.second_start_ms;
+    if (since >= 1000) {
+        // A silent gap leaves nothing for the last full second
+        bool gap = since >= 2000;
+        scan_stats.adverts_last_sec = gap ? 0 : scan_stats.adverts_this_sec;
+        scan_stats.unique_last_sec = gap ? 0 : scan_stats.unique_this_sec;
+        scan_stats.adverts_this_sec = 0;
+        scan_stats.unique_this_sec = 0;
+        memset(scan_stats.second_bits, 0, sizeof(scan_stats.second_bits));
+        scan_stats.second_start_ms = now_ms;
+    }
+
+    scan_stats.adverts_total++;
+    scan_stats.adverts_this_sec++;
+
+    uint32_t hash = ble_registry_hash(addr, 6, 0);
+    uint32_t bit = hash & (BLE_SCAN_SECOND_BITS - 1);
+    if (!(scan_stats.second_bits[bit >> 3] & (1 << (bit & 7)))) {
+        scan_stats.second_bits[bit >> 3] |= (1 << (bit & 7));
+        scan_stats.unique_this_sec++;
+        if (scan_stats.unique_this_sec > scan_stats.peak_unique_per_sec) {
+            scan_stats.peak_unique_per_sec = scan_stats.unique_this_sec;
+        }
+    }
+
+    bit = (hash >> 9) & (BLE_SCAN_UNIQUE_BITS - 1);
+    if (!(scan_stats.unique_bits[bit >> 3] & (1 << (bit & 7)))) {
+        scan_stats.unique_bits[bit >> 3] |= (1 << (bit & 7));
+        scan_stats.unique_bits_set++;
+    }
+}
+
+static void ensure_registries(void) {
+    if (!registries_initialized) {
+        ble_registry_init(&flipper_registry, FLIPPER_STALE_MS);
+        ble_registry_init(&airtag_registry, AIRTAG_STALE_MS);
+        registries_initialized = true;
+    }
+}
+
+// Resolves a remembered selection, NULL if the device has since aged out.
+// Caller holds the registry lock.
+static ble_registry_entry_t *selected_entry(ble_registry_t *reg, int index,
+                                            uint32_t first_seen) {
+    ble_registry_entry_t *entry = ble_registry_get(reg, index);
+    if (!entry || entry->first_seen_ms != first_seen) {
+        return NULL;
+    }
+    return entry;
+}
+
+static void format_addr(const uint8_t *addr, char *out, size_t out_size) {
+    snprintf(out, out_size, "%02x:%02x:%02x:%02x:%02x:%02x", addr[0], addr[1], addr[2], addr[3],
+             addr[4], addr[5]);
+}
+
+static bool adv_filter_matches(const ble_adv_filter_t *filter, const ble_adv_record_t *adv) {
+    if (filter->match == 0) {
+        return true;
+    }
+
+    if ((filter->match & BLE_FILTER_ADDR_TYPE) &&
+        !(filter->addr_types & (1 << (adv->addr_type & 0x07)))) {
+        return false;
+    }
+
+    if ((filter->match & BLE_FILTER_HAS_MFG) && adv->mfg_data == NULL) {
+        return false;
+    }
+
+    if ((filter->match & BLE_FILTER_COMPANY_ID) &&
+        (!adv->has_company_id || adv->company_id != filter->company_id)) {
+        return false;
+    }
+
+    if ((filter->match & BLE_FILTER_HAS_NAME) && adv->name_len == 0) {
+        return false;
+    }
+
+    if (filter->match & BLE_FILTER_UUID16) {
+        bool found = false;
+        for (int i = 0; i < filter->uuid16_count && !found; i++) {
+            found = ble_adv_has_uuid16(adv, filter->uuid16[i]);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Parses the advertisement once and fans it out to the handlers whose filters
+// match. Runs on the NimBLE host task, so the record can live on its stack.
+static void notify_handlers(struct ble_gap_event *event) {
+    scan_stats_record(event->disc.addr.val);
+
+    if (handler_count == 0) {
+        return;
+    }
+
+    ble_adv_record_t adv;
+    memcpy(adv.addr, event->disc.addr.val, sizeof(adv.addr));
+    adv.addr_type = event->disc.addr.type;
+    adv.rssi = event->disc.rssi;
+    ble_adv_parse(event->disc.data, event->disc.length_data, &adv);
 
-static void notify_handlers(struct ble_gap_event *event, int len) {
     for (int i = 0; i < handler_count; i++) {
-        if (handlers[i].handler) {
-            handlers[i].handler(event, len);
+        if (handlers[i].handler && adv_filter_matches(&handlers[i].filter, &adv)) {
+            handlers[i].handler(event, &adv);
         }
     }
 }
@@ -116,35 +259,13 @@ void stop_ble_stack() {
     ESP_LOGI(TAG_BLE, "NimBLE stack and task deinitialized.");
 }
 
-static bool extract_company_id(const uint8_t *payload, size_t length, uint16_t *company_id) {
-    size_t index = 0;
-
-    while (index < length) {
-        uint8_t field_length = payload[index];
-
-        if (field_length == 0 || index + field_length >= length) {
-            break;
-        }
-
-        uint8_t field_type = payload[index + 1];
-
-        if (field_type == 0xFF && field_length >= 3) {
-            *company_id = payload[index + 2] | (payload[index + 3] << 8);
-            return true;
-        }
-
-        index += field_length + 1;
-    }
-
-    return false;
-}
-
 void ble_stop_skimmer_detection(void) {
     ESP_LOGI("BLE", "Stopping skimmer detection scan...");
     TERMINAL_VIEW_ADD_TEXT("Stopping skimmer detection scan...\n");
 
     // Unregister the skimmer detection callback
     ble_unregister_handler(ble_skimmer_scan_callback);
+    skimmer_detection_stop();
     pcap_flush_buffer_to_file(); // Final flush
     pcap_file_close();           // Close the file after final flush
 
@@ -156,84 +277,10 @@ void ble_stop_skimmer_detection(void) {
     }
 }
 
-static void parse_device_name(const uint8_t *data, uint8_t data_len, char *name, size_t name_size) {
-    int index = 0;
-
-    while (index < data_len) {
-        uint8_t length = data[index];
-        if (length == 0) {
-            break;
-        }
-        uint8_t type = data[index + 1];
-
-        if (type == BLE_HS_ADV_TYPE_COMP_NAME) {
-            int name_len = length - 1;
-            if (name_len > name_size - 1) {
-                name_len = name_size - 1;
-            }
-            strncpy(name, (const char *)&data[index + 2], name_len);
-            name[name_len] = '\0';
-            return;
-        }
-
-        index += length + 1;
-    }
-
-    strncpy(name, "Unknown", name_size);
-}
-
-static void parse_service_uuids(const uint8_t *data, uint8_t data_len, ble_service_uuids_t *uuids) {
-    int index = 0;
-
-    while (index < data_len) {
-        uint8_t length = data[index];
-        if (length == 0) {
-            break;
-        }
-        uint8_t type = data[index + 1];
-
-        // Check for 16-bit UUIDs
-        if ((type == BLE_HS_ADV_TYPE_COMP_UUIDS16 || type == BLE_HS_ADV_TYPE_INCOMP_UUIDS16) &&
-            uuids->uuid16_count < MAX_UUID16) {
-            for (int i = 0; i < length - 1; i += 2) {
-                uint16_t uuid16 = data[index + 2 + i] | (data[index + 3 + i] << 8);
-                uuids->uuid16[uuids->uuid16_count++] = uuid16;
-            }
-        }
-
-        // Check for 32-bit UUIDs
-        else if ((type == BLE_HS_ADV_TYPE_COMP_UUIDS32 || type == BLE_HS_ADV_TYPE_INCOMP_UUIDS32) &&
-                 uuids->uuid32_count < MAX_UUID32) {
-            for (int i = 0; i < length - 1; i += 4) {
-                uint32_t uuid32 = data[index + 2 + i] | (data[index + 3 + i] << 8) |
-                                  (data[index + 4 + i] << 16) | (data[index + 5 + i] << 24);
-                uuids->uuid32[uuids->uuid32_count++] = uuid32;
-            }
-        }
-
-        // Check for 128-bit UUIDs
-        else if ((type == BLE_HS_ADV_TYPE_COMP_UUIDS128 ||
-                  type == BLE_HS_ADV_TYPE_INCOMP_UUIDS128) &&
-                 uuids->uuid128_count < MAX_UUID128) {
-            snprintf(uuids->uuid128[uuids->uuid128_count],
-                     sizeof(uuids->uuid128[uuids->uuid128_count]),
-                     "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%"
-                     "02x%02x",
-                     data[index + 17], data[index + 16], data[index + 15], data[index + 14],
-                     data[index + 13], data[index + 12], data[index + 11], data[index + 10],
-                     data[index + 9], data[index + 8], data[index + 7], data[index + 6],
-                     data[index + 5], data[index + 4], data[index + 3], data[index + 2]);
-            uuids->uuid128_count++;
-        }
-
-        index += length + 1;
-    }
-}
-
 static int ble_gap_event_general(struct ble_gap_event *event, void *arg) {
     switch (event->type) {
     case BLE_GAP_EVENT_DISC:
-        notify_handlers(event, event->disc.length_data);
+        notify_handlers(event);
 
         break;
 
@@ -244,91 +291,99 @@ static int ble_gap_event_general(struct ble_gap_event *event, void *arg) {
     return 0;
 }
 
-void ble_findtheflippers_callback(struct ble_gap_event *event, size_t len) {
-    int advertisementRssi = event->disc.rssi;
+#define FLIPPER_UUID_BLACK 0x3081
+#define FLIPPER_UUID_WHITE 0x3082
+#define FLIPPER_UUID_TRANSPARENT 0x3083
 
-    char advertisementMac[18];
-    snprintf(advertisementMac, sizeof(advertisementMac), "%02x:%02x:%02x:%02x:%02x:%02x",
-             event->disc.addr.val[0], event->disc.addr.val[1], event->disc.addr.val[2],
-             event->disc.addr.val[3], event->disc.addr.val[4], event->disc.addr.val[5]);
+static const ble_adv_filter_t flipper_filter = {
+    .match = BLE_FILTER_UUID16,
+    .uuid16 = {FLIPPER_UUID_BLACK, FLIPPER_UUID_WHITE, FLIPPER_UUID_TRANSPARENT},
+    .uuid16_count = 3,
+};
+
+static const ble_adv_filter_t airtag_filter = {
+    .match = BLE_FILTER_COMPANY_ID,
+    .company_id = BLE_COMPANY_APPLE,
+};
+
+static const ble_adv_filter_t named_device_filter = {
+    .match = BLE_FILTER_HAS_NAME,
+};
 
-    char advertisementName[32];
-    parse_device_name(event->disc.data, event->disc.length_data, advertisementName,
-                      sizeof(advertisementName));
+void ble_findtheflippers_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
+    int advertisementRssi = adv->rssi;
 
-    ble_service_uuids_t uuids = {0};
-    parse_service_uuids(event->disc.data, event->disc.length_data, &uuids);
+    const char *advertisementName = adv->name_len > 0 ? adv->name : "Unknown";
 
-    // Determine Flipper type
+    // Determine Flipper type, the filter guarantees one of the UUIDs is present
     const char *type_str = NULL;
-    for (int i = 0; i < uuids.uuid16_count; i++) {
-        if (uuids.uuid16[i] == 0x3082) { type_str = "White"; break; }
-        if (uuids.uuid16[i] == 0x3081) { type_str = "Black"; break; }
-        if (uuids.uuid16[i] == 0x3083) { type_str = "Transparent"; break; }
-    }
-    if (!type_str) {
-        for (int i = 0; i < uuids.uuid32_count; i++) {
-            if (uuids.uuid32[i] == 0x3082) { type_str = "White"; break; }
-            if (uuids.uuid32[i] == 0x3081) { type_str = "Black"; break; }
-            if (uuids.uuid32[i] == 0x3083) { type_str = "Transparent"; break; }
-        }
-    }
-    if (!type_str) {
-        for (int i = 0; i < uuids.uuid128_count; i++) {
-            if (strstr(uuids.uuid128[i], "3082")) { type_str = "White"; break; }
-            if (strstr(uuids.uuid128[i], "3081")) { type_str = "Black"; break; }
-            if (strstr(uuids.uuid128[i], "3083")) { type_str = "Transparent"; break; }
-        }
+    uint16_t type_uuid = 0;
+    if (ble_adv_has_uuid16(adv, FLIPPER_UUID_WHITE)) {
+        type_str = "White";
+        type_uuid = FLIPPER_UUID_WHITE;
+    } else if (ble_adv_has_uuid16(adv, FLIPPER_UUID_BLACK)) {
+        type_str = "Black";
+        type_uuid = FLIPPER_UUID_BLACK;
+    } else if (ble_adv_has_uuid16(adv, FLIPPER_UUID_TRANSPARENT)) {
+        type_str = "Transparent";
+        type_uuid = FLIPPER_UUID_TRANSPARENT;
     }
     if (!type_str) { return; }
-    // Store or update Flipper device
-    bool already = false;
-    for (int j = 0; j < discovered_flipper_count; j++) {
-        if (memcmp(discovered_flippers[j].addr.val, event->disc.addr.val, 6) == 0) {
-            already = true;
-            discovered_flippers[j].rssi = advertisementRssi;
-            // Check if this is the selected Flipper for tracking
-            if (j == selected_flipper_index) {
-                const char *proximity;
-                if (advertisementRssi >= -40) {
-                    proximity = "Immediate";
-                } else if (advertisementRssi >= -50) {
-                    proximity = "Very Close";
-                } else if (advertisementRssi >= -60) {
-                    proximity = "Close";
-                } else if (advertisementRssi >= -70) {
-                    proximity = "Moderate";
-                } else if (advertisementRssi >= -80) {
-                    proximity = "Far";
-                } else if (advertisementRssi >= -90) {
-                    proximity = "Very Far";
-                } else {
-                    proximity = "Out of Range";
-                }
-                printf("Tracking Flipper %d: RSSI %d dBm (%s)\n", selected_flipper_index, advertisementRssi, proximity);
-                TERMINAL_VIEW_ADD_TEXT("Track [%d]: RSSI %d (%s)\n", selected_flipper_index, advertisementRssi, proximity);
-            }
-            break;
+
+    // Flippers rotate private addresses but keep their name, which lets the
+    // registry follow one device across addresses
+    uint32_t identity = 0;
+    if (adv->name_len > 0) {
+        uint8_t uuid_le[2] = {type_uuid & 0xFF, type_uuid >> 8};
+        identity = ble_registry_hash((const uint8_t *)adv->name, adv->name_len, 0);
+        identity = ble_registry_hash(uuid_le, sizeof(uuid_le), identity);
+    }
+
+    ensure_registries();
+    ble_registry_lock(&flipper_registry);
+    bool is_new = false;
+    ble_registry_entry_t *entry = ble_registry_observe(&flipper_registry, adv, identity, &is_new);
+    int index = ble_registry_index(&flipper_registry, entry);
+    bool is_selected =
+        selected_entry(&flipper_registry, selected_flipper_index, selected_flipper_first_seen) ==
+        entry;
+    entry->kind = (uint8_t)(type_uuid & 0xFF); // 0x81 Black, 0x82 White, 0x83 Transparent
+    ble_registry_unlock(&flipper_registry);
+
+    if (is_selected) {
+        const char *proximity;
+        if (advertisementRssi >= -40) {
+            proximity = "Immediate";
+        } else if (advertisementRssi >= -50) {
+            proximity = "Very Close";
+        } else if (advertisementRssi >= -60) {
+            proximity = "Close";
+        } else if (advertisementRssi >= -70) {
+            proximity = "Moderate";
+        } else if (advertisementRssi >= -80) {
+            proximity = "Far";
+        } else if (advertisementRssi >= -90) {
+            proximity = "Very Far";
+        } else {
+            proximity = "Out of Range";
         }
+        printf("Tracking Flipper %d: RSSI %d dBm (%s)\n", index, advertisementRssi, proximity);
+        TERMINAL_VIEW_ADD_TEXT("Track [%d]: RSSI %d (%s)\n", index, advertisementRssi, proximity);
     }
-    if (!already && discovered_flipper_count < MAX_FLIPPERS) {
-        discovered_flippers[discovered_flipper_count].addr = event->disc.addr;
-        strncpy(discovered_flippers[discovered_flipper_count].name, advertisementName,
-                sizeof(discovered_flippers[discovered_flipper_count].name)-1);
-        discovered_flippers[discovered_flipper_count].rssi = advertisementRssi;
+
+    if (is_new) {
+        char advertisementMac[18];
+        format_addr(adv->addr, advertisementMac, sizeof(advertisementMac));
         // Summary log
         printf("Found %s Flipper (Index: %d): MAC %s, Name %s, RSSI %d\n",
-               type_str, discovered_flipper_count,
-               advertisementMac, advertisementName, advertisementRssi);
+               type_str, index, advertisementMac, advertisementName, advertisementRssi);
         TERMINAL_VIEW_ADD_TEXT("Found %s Flipper (Idx %d): MAC %s, RSSI %d\n",
-                               type_str, discovered_flipper_count,
-                               advertisementMac, advertisementRssi);
+                               type_str, index, advertisementMac, advertisementRssi);
         pulse_once(&rgb_manager, 0, 255, 0);
-        discovered_flipper_count++;
     }
 }
 
-void ble_print_raw_packet_callback(struct ble_gap_event *event, size_t len) {
+void ble_print_raw_packet_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
     int advertisementRssi = event->disc.rssi;
 
     char advertisementMac[18];
@@ -352,117 +407,80 @@ void ble_print_raw_packet_callback(struct ble_gap_event *event, size_t len) {
     // printf("\n");
 }
 
-void detect_ble_spam_callback(struct ble_gap_event *event, size_t length) {
-    if (length < 4) {
+void detect_ble_spam_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
+    ble_spam_verdict_t verdict;
+    if (!ble_spam_detector_observe(adv, ble_registry_now_ms(), &verdict)) {
         return;
     }
 
-    TickType_t current_time = xTaskGetTickCount();
-    TickType_t time_elapsed = current_time - last_detection_time;
-
-    uint16_t current_company_id;
-    if (!extract_company_id(event->disc.data, length, &current_company_id)) {
-        return;
-    }
-
-    if (time_elapsed > pdMS_TO_TICKS(TIME_WINDOW_MS)) {
-        spam_counter = 0;
+    const char *severity = ble_spam_severity_name(verdict.severity);
+    const char *key = verdict.by_layout ? "payload pattern" : "company ID";
+    if (verdict.has_company) {
+        ESP_LOGW(TAG_BLE, "BLE Spam (%s) by %s! Company ID: 0x%04X, %lu adverts from %lu senders",
+                 severity, key, verdict.company_id, (unsigned long)verdict.rate,
+                 (unsigned long)verdict.senders);
+        TERMINAL_VIEW_ADD_TEXT("BLE Spam (%s)! Company ID: 0x%04X\n%lu adv / %lu senders\n",
+                               severity, verdict.company_id, (unsigned long)verdict.rate,
+                               (unsigned long)verdict.senders);
+    } else {
+        ESP_LOGW(TAG_BLE, "BLE Spam (%s) by %s! %lu adverts from %lu senders", severity, key,
+                 (unsigned long)verdict.rate, (unsigned long)verdict.senders);
+        TERMINAL_VIEW_ADD_TEXT("BLE Spam (%s)!\n%lu adv / %lu senders\n", severity,
+                               (unsigned long)verdict.rate, (unsigned long)verdict.senders);
     }
 
-    if (last_company_id != NULL && *last_company_id == current_company_id) {
-        spam_counter++;
-
-        if (spam_counter > MAX_PAYLOADS) {
-            ESP_LOGW(TAG_BLE, "BLE Spam detected! Company ID: 0x%04X", current_company_id);
-            TERMINAL_VIEW_ADD_TEXT("BLE Spam detected! Company ID: 0x%04X\n", current_company_id);
-            // pulse rgb purple once when spam is detected
-            pulse_once(&rgb_manager, 128, 0, 128);
-            spam_counter = 0;
-        }
+    // pulse rgb purple once when spam is detected, red for a heavy flood
+    if (verdict.severity == BLE_SPAM_HIGH) {
+        pulse_once(&rgb_manager, 255, 0, 0);
     } else {
-        if (last_company_id == NULL) {
-            last_company_id = (uint16_t *)malloc(sizeof(uint16_t));
-        }
-
-        if (last_company_id != NULL) {
-            *last_company_id = current_company_id;
-            spam_counter = 1;
-        }
+        pulse_once(&rgb_manager, 128, 0, 128);
     }
-
-    last_detection_time = current_time;
 }
 
-void airtag_scanner_callback(struct ble_gap_event *event, size_t len) {
+void airtag_scanner_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
     if (event->type == BLE_GAP_EVENT_DISC) {
-        if (!event->disc.data || event->disc.length_data < 4) {
-            return;
-        }
-
-        const uint8_t *payload = event->disc.data;
-        size_t payloadLength = event->disc.length_data;
+        const uint8_t *payload = adv->data;
+        size_t payloadLength = adv->data_len;
 
-        bool patternFound = false;
-        for (size_t i = 0; i <= payloadLength - 4; i++) {
-            if ((payload[i] == 0x1E && payload[i + 1] == 0xFF && payload[i + 2] == 0x4C &&
-                 payload[i + 3] == 0x00) || // Pattern 1 (Nearby)
-                (payload[i] == 0x4C && payload[i + 1] == 0x00 && payload[i + 2] == 0x12 &&
-                 payload[i + 3] == 0x19)) { // Pattern 2 (Offline Finding)
-                patternFound = true;
-                break;
-            }
-        }
+        // The filter only lets Apple manufacturer data through; mfg_data
+        // starts at the company ID, the AD length byte is mfg_len + 1.
+        bool patternFound =
+            (adv->mfg_len + 1 == 0x1E) || // Pattern 1 (Nearby)
+            (adv->mfg_len >= 4 && adv->mfg_data[2] == 0x12 &&
+             adv->mfg_data[3] == 0x19); // Pattern 2 (Offline Finding)
 
         if (patternFound) {
-            // Check if this AirTag is already discovered
-            bool already_discovered = false;
-            for (int i = 0; i < discovered_airtag_count; i++) {
-                if (memcmp(discovered_airtags[i].addr.val, event->disc.addr.val, 6) == 0) {
-                    already_discovered = true;
-                    // Update RSSI and maybe payload if needed
-                    discovered_airtags[i].rssi = event->disc.rssi;
-                    // Optionally update payload if it can change
-                    // memcpy(discovered_airtags[i].payload, payload, payloadLength);
-                    // discovered_airtags[i].payload_len = payloadLength;
-                    break;
-                }
-            }
+            ensure_registries();
+            ble_registry_lock(&airtag_registry);
+            bool is_new = false;
+            ble_registry_entry_t *entry = ble_registry_observe(&airtag_registry, adv, 0, &is_new);
+            int index = ble_registry_index(&airtag_registry, entry);
+            ble_registry_unlock(&airtag_registry);
 
-            if (!already_discovered && discovered_airtag_count < MAX_AIRTAGS) {
-                // Add new AirTag
-                AirTagDevice *new_tag = &discovered_airtags[discovered_airtag_count];
-                memcpy(new_tag->addr.val, event->disc.addr.val, 6);
-                new_tag->addr.type = event->disc.addr.type;
-                new_tag->rssi = event->disc.rssi;
-                memcpy(new_tag->payload, payload, payloadLength);
-                new_tag->payload_len = payloadLength;
-                new_tag->selected_for_spoofing = false;
-                discovered_airtag_count++;
-                airTagCount++; // Increment the original counter too, maybe rename it later
+            if (is_new) {
+                airTagCount++;
 
                 // pulse rgb blue once when a *new* air tag is found
-            pulse_once(&rgb_manager, 0, 0, 255);
+                pulse_once(&rgb_manager, 0, 0, 255);
 
-            char macAddress[18];
-            snprintf(macAddress, sizeof(macAddress), "%02x:%02x:%02x:%02x:%02x:%02x",
-                     event->disc.addr.val[0], event->disc.addr.val[1], event->disc.addr.val[2],
-                     event->disc.addr.val[3], event->disc.addr.val[4], event->disc.addr.val[5]);
-            int rssi = event->disc.rssi;
+                char macAddress[18];
+                format_addr(adv->addr, macAddress, sizeof(macAddress));
+                int rssi = adv->rssi;
 
                 printf("New AirTag found! (Total: %d)\n", airTagCount);
-                printf("Index: %d\n", discovered_airtag_count - 1); // Index of the newly added tag
-            printf("MAC Address: %s\n", macAddress);
-            printf("RSSI: %d dBm\n", rssi);
-            printf("Payload Data: ");
-            for (size_t i = 0; i < payloadLength; i++) {
-                printf("%02X ", payload[i]);
-            }
-            printf("\n\n");
+                printf("Index: %d\n", index);
+                printf("MAC Address: %s\n", macAddress);
+                printf("RSSI: %d dBm\n", rssi);
+                printf("Payload Data: ");
+                for (size_t i = 0; i < payloadLength; i++) {
+                    printf("%02X ", payload[i]);
+                }
+                printf("\n\n");
 
                 TERMINAL_VIEW_ADD_TEXT("New AirTag found! (Total: %d)\n", airTagCount);
-                TERMINAL_VIEW_ADD_TEXT("Index: %d\n", discovered_airtag_count - 1);
-            TERMINAL_VIEW_ADD_TEXT("MAC Address: %s\n", macAddress);
-            TERMINAL_VIEW_ADD_TEXT("RSSI: %d dBm\n", rssi);
+                TERMINAL_VIEW_ADD_TEXT("Index: %d\n", index);
+                TERMINAL_VIEW_ADD_TEXT("MAC Address: %s\n", macAddress);
+                TERMINAL_VIEW_ADD_TEXT("RSSI: %d dBm\n", rssi);
                 TERMINAL_VIEW_ADD_TEXT("\n");
             }
         }
@@ -471,40 +489,48 @@ void airtag_scanner_callback(struct ble_gap_event *event, size_t len) {
 
 // Function to list discovered AirTags
 void ble_list_airtags(void) {
-    printf("--- Discovered AirTags (%d) ---\n", discovered_airtag_count);
-    TERMINAL_VIEW_ADD_TEXT("--- Discovered AirTags (%d) ---\n", discovered_airtag_count);
-    if (discovered_airtag_count == 0) {
+    ensure_registries();
+    ble_registry_lock(&airtag_registry);
+    ble_registry_entry_t *selected =
+        selected_entry(&airtag_registry, selected_airtag_index, selected_airtag_first_seen);
+
+    printf("--- Discovered AirTags (%d) ---\n", airtag_registry.count);
+    TERMINAL_VIEW_ADD_TEXT("--- Discovered AirTags (%d) ---\n", airtag_registry.count);
+    if (airtag_registry.count == 0) {
+        ble_registry_unlock(&airtag_registry);
         printf("No AirTags discovered yet.\n");
         TERMINAL_VIEW_ADD_TEXT("No AirTags discovered yet.\n");
         return;
     }
 
-    for (int i = 0; i < discovered_airtag_count; i++) {
+    for (int i = 0; i < BLE_REGISTRY_CAPACITY; i++) {
+        ble_registry_entry_t *entry = ble_registry_get(&airtag_registry, i);
+        if (!entry) {
+            continue;
+        }
         char macAddress[18];
-        snprintf(macAddress, sizeof(macAddress), "%02x:%02x:%02x:%02x:%02x:%02x",
-                 discovered_airtags[i].addr.val[0], discovered_airtags[i].addr.val[1], discovered_airtags[i].addr.val[2],
-                 discovered_airtags[i].addr.val[3], discovered_airtags[i].addr.val[4], discovered_airtags[i].addr.val[5]);
-
-        printf("Index: %d | MAC: %s | RSSI: %d dBm %s\n",
-               i, macAddress, discovered_airtags[i].rssi,
-               (i == selected_airtag_index) ? " (Selected)" : "");
-        TERMINAL_VIEW_ADD_TEXT("Idx: %d MAC: %s RSSI: %d %s\n",
-                               i, macAddress, discovered_airtags[i].rssi,
-                               (i == selected_airtag_index) ? "(Sel)" : "");
-        // Optionally print payload too
-        // printf("  Payload (%zu bytes): ", discovered_airtags[i].payload_len);
-        // for(size_t j = 0; j < discovered_airtags[i].payload_len; j++) {
-        //     printf("%02X ", discovered_airtags[i].payload[j]);
-        // }
-        // printf("\n");
+        format_addr(entry->addr, macAddress, sizeof(macAddress));
+        int8_t rssi = ble_registry_rssi_latest(entry);
+
+        printf("Index: %d | MAC: %s | RSSI: %d dBm (avg %d) | Seen %lus ago%s\n", i, macAddress,
+               rssi, ble_registry_rssi_average(entry),
+               (unsigned long)((ble_registry_now_ms() - entry->last_seen_ms) / 1000),
+               (entry == selected) ? " (Selected)" : "");
+        TERMINAL_VIEW_ADD_TEXT("Idx: %d MAC: %s RSSI: %d %s\n", i, macAddress, rssi,
+                               (entry == selected) ? "(Sel)" : "");
     }
+    ble_registry_unlock(&airtag_registry);
     printf("-----------------------------\n");
     TERMINAL_VIEW_ADD_TEXT("-----------------------------\n");
 }
 
 // Function to select an AirTag by index
 void ble_select_airtag(int index) {
-    if (index < 0 || index >= discovered_airtag_count) {
+    ensure_registries();
+    ble_registry_lock(&airtag_registry);
+    ble_registry_entry_t *entry = ble_registry_get(&airtag_registry, index);
+    if (!entry) {
+        ble_registry_unlock(&airtag_registry);
         printf("Error: Invalid AirTag index %d. Use 'listairtags' to see valid indices.\n", index);
         TERMINAL_VIEW_ADD_TEXT("Error: Invalid AirTag index %d.\nUse 'listairtags'.\n", index);
         selected_airtag_index = -1; // Unselect if index is invalid
@@ -512,17 +538,28 @@ void ble_select_airtag(int index) {
     }
 
     selected_airtag_index = index;
+    selected_airtag_first_seen = entry->first_seen_ms;
     char macAddress[18];
-    snprintf(macAddress, sizeof(macAddress), "%02x:%02x:%02x:%02x:%02x:%02x",
-             discovered_airtags[index].addr.val[0], discovered_airtags[index].addr.val[1], discovered_airtags[index].addr.val[2],
-             discovered_airtags[index].addr.val[3], discovered_airtags[index].addr.val[4], discovered_airtags[index].addr.val[5]);
+    format_addr(entry->addr, macAddress, sizeof(macAddress));
+    ble_registry_unlock(&airtag_registry);
     printf("Selected AirTag at index %d: MAC %s\n", index, macAddress);
     TERMINAL_VIEW_ADD_TEXT("Selected AirTag %d: MAC %s\n", index, macAddress);
 }
 
 // Function to start spoofing the selected AirTag (Basic Implementation)
 void ble_start_spoofing_selected_airtag(void) {
-    if (selected_airtag_index < 0 || selected_airtag_index >= discovered_airtag_count) {
+    ensure_registries();
+    ble_registry_lock(&airtag_registry);
+    ble_registry_entry_t *selected =
+        selected_entry(&airtag_registry, selected_airtag_index, selected_airtag_first_seen);
+    // Work on a copy, the scanner may age the entry out while we advertise
+    ble_registry_entry_t spoof_copy;
+    if (selected) {
+        spoof_copy = *selected;
+    }
+    ble_registry_unlock(&airtag_registry);
+
+    if (!selected) {
         printf("Error: No AirTag selected for spoofing. Use 'selectairtag <index>'.\n");
         TERMINAL_VIEW_ADD_TEXT("Error: No AirTag selected.\nUse 'selectairtag <index>'.\n");
         return;
@@ -532,7 +569,7 @@ void ble_start_spoofing_selected_airtag(void) {
     ble_stop(); // Stop scanning, etc.
     // vTaskDelay(pdMS_TO_TICKS(100)); // Short delay to allow stopping
 
-    AirTagDevice *tag_to_spoof = &discovered_airtags[selected_airtag_index];
+    ble_registry_entry_t *tag_to_spoof = &spoof_copy;
 
     struct ble_gap_adv_params adv_params;
     struct ble_hs_adv_fields fields;
@@ -608,8 +645,8 @@ void ble_start_spoofing_selected_airtag(void) {
     // Note: Spoofing a Public address might be problematic/illegal depending on context.
     // AirTags typically use Random Static addresses.
     // Check the address type. We can usually only spoof Random addresses.
-    if (tag_to_spoof->addr.type == BLE_ADDR_RANDOM) {
-        rc = ble_hs_id_set_rnd(tag_to_spoof->addr.val); // Set the stack's random address
+    if (tag_to_spoof->addr_type == BLE_ADDR_RANDOM) {
+        rc = ble_hs_id_set_rnd(tag_to_spoof->addr); // Set the stack's random address
         if (rc != 0) {
             ESP_LOGE(TAG_BLE, "Failed to set random address for spoofing; rc=%d", rc);
             TERMINAL_VIEW_ADD_TEXT("Error: Failed set spoof rnd addr; rc=%d\n", rc);
@@ -630,8 +667,8 @@ void ble_start_spoofing_selected_airtag(void) {
         }
     } else {
         // We likely cannot spoof Public addresses this way.
-        ESP_LOGW(TAG_BLE, "Cannot spoof non-random address type %d. Using default address.", tag_to_spoof->addr.type);
-        TERMINAL_VIEW_ADD_TEXT("Warn: Cannot spoof addr type %d.\nUsing default address.\n", tag_to_spoof->addr.type);
+        ESP_LOGW(TAG_BLE, "Cannot spoof non-random address type %d. Using default address.", tag_to_spoof->addr_type);
+        TERMINAL_VIEW_ADD_TEXT("Warn: Cannot spoof addr type %d.\nUsing default address.\n", tag_to_spoof->addr_type);
         // Fallback to default address generation
         rc = ble_hs_id_infer_auto(0, &own_addr_type);
         if (rc != 0) {
@@ -650,8 +687,8 @@ void ble_start_spoofing_selected_airtag(void) {
 
     char macAddress[18];
     snprintf(macAddress, sizeof(macAddress), "%02x:%02x:%02x:%02x:%02x:%02x",
-             tag_to_spoof->addr.val[0], tag_to_spoof->addr.val[1], tag_to_spoof->addr.val[2],
-             tag_to_spoof->addr.val[3], tag_to_spoof->addr.val[4], tag_to_spoof->addr.val[5]);
+             tag_to_spoof->addr[0], tag_to_spoof->addr[1], tag_to_spoof->addr[2],
+             tag_to_spoof->addr[3], tag_to_spoof->addr[4], tag_to_spoof->addr[5]);
     printf("Started spoofing AirTag %d (MAC: %s)\n", selected_airtag_index, macAddress);
     TERMINAL_VIEW_ADD_TEXT("Started spoofing AirTag %d\nMAC: %s\n", selected_airtag_index, macAddress);
     // Pulse green maybe?
@@ -702,7 +739,9 @@ static bool wait_for_ble_ready(void) {
     return true;
 }
 
-void ble_start_scanning(void) {
+void ble_start_scanning(void) { ble_start_scanning_profile(BLE_SCAN_PROFILE_GENERAL); }
+
+void ble_start_scanning_profile(ble_scan_profile_id_t profile) {
     if (!ble_initialized) {
         ble_init();
     }
@@ -713,10 +752,18 @@ void ble_start_scanning(void) {
         return;
     }
 
+    if (profile >= BLE_SCAN_PROFILE_COUNT) {
+        profile = BLE_SCAN_PROFILE_GENERAL;
+    }
+    const ble_scan_profile_t *p = &scan_profiles[profile];
+
     struct ble_gap_disc_params disc_params = {0};
-    disc_params.itvl = BLE_HCI_SCAN_ITVL_DEF;
-    disc_params.window = BLE_HCI_SCAN_WINDOW_DEF;
-    disc_params.filter_duplicates = 1;
+    disc_params.itvl = p->itvl;
+    disc_params.window = p->window;
+    disc_params.passive = p->passive;
+    disc_params.filter_duplicates = p->filter_duplicates;
+
+    scan_stats_reset(profile);
 
     // Start a new BLE scan
     int rc = ble_gap_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER, &disc_params, ble_gap_event_general,
@@ -725,12 +772,58 @@ void ble_start_scanning(void) {
         ESP_LOGE(TAG_BLE, "Error starting BLE scan");
         TERMINAL_VIEW_ADD_TEXT("Error starting BLE scan\n");
     } else {
-        ESP_LOGI(TAG_BLE, "Scanning started...");
+        ESP_LOGI(TAG_BLE, "Scanning started (%s profile)...", p->name);
         TERMINAL_VIEW_ADD_TEXT("Scanning started...\n");
     }
 }
 
+void ble_get_scan_stats(ble_scan_stats_t *stats) {
+    const ble_scan_profile_t *p = &scan_profiles[scan_stats.profile];
+    uint32_t now_ms = ble_registry_now_ms();
+
+    stats->profile = p->name;
+    stats->duty_pct = (uint8_t)((uint32_t)p->window * 100 / p->itvl);
+    stats->elapsed_ms = now_ms - scan_stats.start_ms;
+    stats->adverts_total = scan_stats.adverts_total;
+    bool stale = now_ms - scan_stats.second_start_ms >= 2000;
+    stats->adverts_last_sec = stale ? 0 : scan_stats.adverts_last_sec;
+    stats->unique_last_sec = stale ? 0 : scan_stats.unique_last_sec;
+    stats->peak_unique_per_sec = scan_stats.peak_unique_per_sec;
+
+    // Linear counting over the session bitmap
+    uint32_t zeros = BLE_SCAN_UNIQUE_BITS - scan_stats.unique_bits_set;
+    if (zeros == 0) {
+        zeros = 1;
+    }
+    stats->unique_total =
+        (uint32_t)(BLE_SCAN_UNIQUE_BITS * logf((float)BLE_SCAN_UNIQUE_BITS / zeros) + 0.5f);
+}
+
+void ble_print_scan_stats(void) {
+    ble_scan_stats_t stats;
+    ble_get_scan_stats(&stats);
+
+    printf("BLE scan: %s profile, %u%% duty, %lus\n", stats.profile, stats.duty_pct,
+           (unsigned long)(stats.elapsed_ms / 1000));
+    printf("Adverts: %lu total, %lu last second\n", (unsigned long)stats.adverts_total,
+           (unsigned long)stats.adverts_last_sec);
+    printf("Devices: ~%lu unique, %lu last second, peak %lu/s\n",
+           (unsigned long)stats.unique_total, (unsigned long)stats.unique_last_sec,
+           (unsigned long)stats.peak_unique_per_sec);
+    TERMINAL_VIEW_ADD_TEXT("Scan: %s %u%% %lus\n", stats.profile, stats.duty_pct,
+                           (unsigned long)(stats.elapsed_ms / 1000));
+    TERMINAL_VIEW_ADD_TEXT("Adv: %lu (%lu/s)\n", (unsigned long)stats.adverts_total,
+                           (unsigned long)stats.adverts_last_sec);
+    TERMINAL_VIEW_ADD_TEXT("Devices: ~%lu (%lu/s)\n", (unsigned long)stats.unique_total,
+                           (unsigned long)stats.unique_last_sec);
+}
+
 esp_err_t ble_register_handler(ble_data_handler_t handler) {
+    return ble_register_handler_filtered(handler, NULL);
+}
+
+esp_err_t ble_register_handler_filtered(ble_data_handler_t handler,
+                                        const ble_adv_filter_t *filter) {
     if (handler_count < MAX_HANDLERS) {
         ble_handler_t *new_handlers =
             realloc(handlers, (handler_count + 1) * sizeof(ble_handler_t));
@@ -741,6 +834,11 @@ esp_err_t ble_register_handler(ble_data_handler_t handler) {
 
         handlers = new_handlers;
         handlers[handler_count].handler = handler;
+        if (filter) {
+            handlers[handler_count].filter = *filter;
+        } else {
+            memset(&handlers[handler_count].filter, 0, sizeof(ble_adv_filter_t));
+        }
         handler_count++;
         return ESP_OK;
     }
@@ -788,6 +886,8 @@ void ble_init(void) {
             handler_count = 0;
         }
 
+        ensure_registries();
+
         ret = nimble_port_init();
         if (ret != 0) {
             ESP_LOGE(TAG_BLE, "Failed to init nimble port: %d", ret);
@@ -800,9 +900,11 @@ void ble_init(void) {
         static StackType_t host_task_stack[4096];
         static StaticTask_t host_task_buf;
 
-        xTaskCreateStatic(nimble_host_task, "nimble_host",
-                          sizeof(host_task_stack) / sizeof(StackType_t), NULL, 5, host_task_stack,
-                          &host_task_buf);
+        TaskHandle_t host_task =
+            xTaskCreateStatic(nimble_host_task, "nimble_host",
+                              sizeof(host_task_stack) / sizeof(StackType_t), NULL, 5,
+                              host_task_stack, &host_task_buf);
+        system_manager_register_task(host_task, "nimble_host", sizeof(host_task_stack), 5);
 
         ble_initialized = true;
         ESP_LOGI(TAG_BLE, "BLE initialized");
@@ -812,8 +914,8 @@ void ble_init(void) {
 }
 
 void ble_start_find_flippers(void) {
-    ble_register_handler(ble_findtheflippers_callback);
-    ble_start_scanning();
+    ble_register_handler_filtered(ble_findtheflippers_callback, &flipper_filter);
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_DISCOVERY);
 }
 
 void ble_deinit(void) {
@@ -841,23 +943,27 @@ void ble_stop(void) {
         return;
     }
 
-    if (last_company_id != NULL) {
-        free(last_company_id);
-        last_company_id = NULL;
-    }
-
-    // Stop and delete the flush timer if it exists
-    if (flush_timer != NULL) {
-        esp_timer_stop(flush_timer);
-        esp_timer_delete(flush_timer);
-        flush_timer = NULL;
+    // Stop the PCAP capture and its flush task if one was running, the
+    // capture totals are printed when the file closes below
+    ble_unregister_handler(ble_pcap_callback);
+    if (pcap_flush_task_handle != NULL) {
+        pcap_flush_running = false;
+        xTaskNotifyGive(pcap_flush_task_handle);
     }
 
     rgb_manager_set_color(&rgb_manager, 0, 0, 0, 0, false);
     ble_unregister_handler(ble_findtheflippers_callback);
     ble_unregister_handler(airtag_scanner_callback);
     ble_unregister_handler(ble_print_raw_packet_callback);
-    ble_unregister_handler(detect_ble_spam_callback);
+    if (ble_unregister_handler(detect_ble_spam_callback) == ESP_OK) {
+        ble_spam_stats_t spam_stats;
+        ble_spam_detector_get_stats(&spam_stats);
+        printf("Spam detector: %lu adverts, %lu reports, peak severity %s\n",
+               (unsigned long)spam_stats.adverts, (unsigned long)spam_stats.reports,
+               ble_spam_severity_name(spam_stats.peak));
+        TERMINAL_VIEW_ADD_TEXT("Spam: %lu reports, peak %s\n", (unsigned long)spam_stats.reports,
+                               ble_spam_severity_name(spam_stats.peak));
+    }
     pcap_flush_buffer_to_file(); // Final flush
     pcap_file_close();           // Close the file after final flush
 
@@ -894,113 +1000,75 @@ void ble_stop(void) {
 }
 
 void ble_start_blespam_detector(void) {
+    // Every advert is needed, floods without manufacturer data are caught
+    // by their payload layout
+    ble_spam_detector_reset();
     ble_register_handler(detect_ble_spam_callback);
-    ble_start_scanning();
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_SPAM);
 }
 
 void ble_start_raw_ble_packetscan(void) {
     ble_register_handler(ble_print_raw_packet_callback);
-    ble_start_scanning();
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_CAPTURE);
 }
 
 void ble_start_airtag_scanner(void) {
-    ble_register_handler(airtag_scanner_callback);
-    ble_start_scanning();
+    ble_register_handler_filtered(airtag_scanner_callback, &airtag_filter);
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_DISCOVERY);
     // Reset discovered count when starting a new scan session? Or keep appending?
-    // Let's keep appending for now. Add a command to clear if needed later.
-    // discovered_airtag_count = 0;
-    // airTagCount = 0;
-    // selected_airtag_index = -1;
+    // Let's keep appending for now, stale tags age out of the registry.
 }
 
-static void ble_pcap_callback(struct ble_gap_event *event, size_t len) {
-    if (!event || len == 0)
+// Writes the advert as an HCI LE Advertising Report event straight into the
+// capture buffer: DLT 201 direction word, H4 packet type, event header,
+// one report. Runs for every advert, so no allocation and no logging.
+static void ble_pcap_callback(struct ble_gap_event *event, const ble_adv_record_t *adv) {
+    if (!event || event->type != BLE_GAP_EVENT_DISC)
         return;
 
-    uint8_t hci_buffer[258]; // Max HCI packet size
-    size_t hci_len = 0;
-
-    if (event->type == BLE_GAP_EVENT_DISC) {
-        // [1] HCI packet type (0x04 for HCI Event)
-        hci_buffer[0] = 0x04;
-
-        // [2] HCI Event Code (0x3E for LE Meta Event)
-        hci_buffer[1] = 0x3E;
-
-        // [3] Calculate total parameter length
-        uint8_t param_len = 10 + event->disc.length_data; // 1 (subevent) + 1 (num reports) + 1
-                                                          // (event type) + 1 (addr type) + 6 (addr)
-        hci_buffer[2] = param_len;
-
-        // [4] LE Meta Subevent (0x02 for LE Advertising Report)
-        hci_buffer[3] = 0x02;
-
-        // [5] Number of reports
-        hci_buffer[4] = 0x01;
-
-        // [6] Event type (ADV_IND = 0x00)
-        hci_buffer[5] = 0x00;
-
-        // [7] Address type
-        hci_buffer[6] = event->disc.addr.type;
+    size_t data_len = adv->data_len;
+    // 1 (H4 type) + 2 (event code, param len) + 12 (report fields) + data
+    size_t hci_len = 15 + data_len;
+    capture_stats_frame(CAPTURE_MODE_BLE);
+    uint8_t *rec = pcap_begin_record(PCAP_BT_PHDR_LEN + hci_len);
+    if (rec == NULL) {
+        // Almost always the lock held by a flush in progress
+        capture_stats_result(CAPTURE_MODE_BLE, 0, ESP_ERR_TIMEOUT);
+        return;
+    }
 
-        // [8] Address (6 bytes)
-        memcpy(&hci_buffer[7], event->disc.addr.val, 6);
+    pcap_write_bt_phdr(rec, PCAP_BT_DIR_RECEIVED);
+    uint8_t *hci = rec + PCAP_BT_PHDR_LEN;
+
+    hci[0] = 0x04;                   // HCI Event packet
+    hci[1] = 0x3E;                   // LE Meta Event
+    hci[2] = (uint8_t)(hci_len - 3); // Parameter length
+    hci[3] = 0x02;                   // LE Advertising Report
+    hci[4] = 0x01;                   // Number of reports
+    hci[5] = event->disc.event_type; // ADV_IND, ADV_NONCONN_IND, SCAN_RSP, ...
+    hci[6] = adv->addr_type;
+    memcpy(&hci[7], adv->addr, 6);
+    hci[13] = (uint8_t)data_len;
+    if (data_len > 0) {
+        memcpy(&hci[14], adv->data, data_len);
+    }
+    hci[14 + data_len] = (uint8_t)adv->rssi;
 
-        // [9] Data length
-        hci_buffer[13] = event->disc.length_data;
+    pcap_commit_record();
+    capture_stats_result(CAPTURE_MODE_BLE, PCAP_BT_PHDR_LEN + hci_len, ESP_OK);
+}
 
-        // [10] Data
-        if (event->disc.length_data > 0) {
-            memcpy(&hci_buffer[14], event->disc.data, event->disc.length_data);
+static void ble_pcap_flush_task(void *arg) {
+    while (pcap_flush_running) {
+        // ble_stop notifies us so shutdown does not wait out a full period
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BLE_PCAP_FLUSH_INTERVAL_MS));
+        if (pcap_flush_running) {
+            pcap_flush_buffer_to_file();
         }
-
-        // [11] RSSI
-        hci_buffer[14 + event->disc.length_data] = (uint8_t)event->disc.rssi;
-
-        hci_len = 15 + event->disc.length_data; // Total length
-
-        // packet logging (don't print to display terminal to prevent overwhelming)
-        printf("BLE Packet Received:\nType: 0x04 (HCI Event)\nMeta: 0x3E "
-               "(LE)\nLength: %d\n",
-               hci_len);
-
-        pcap_write_packet_to_buffer(hci_buffer, hci_len, PCAP_CAPTURE_BLUETOOTH);
     }
 
-    pcap_flush_buffer_to_file(); // Final flush
-    pcap_file_close();           // Close the file after final flush
-
-    // Stop spoofing if it was active
-    ble_stop_spoofing();
-
-    int rc = ble_gap_disc_cancel();
-
-    switch (rc) {
-    case 0:
-        printf("BLE scan stopped successfully.\n");
-        TERMINAL_VIEW_ADD_TEXT("BLE scan stopped successfully.\n");
-        break;
-    case BLE_HS_EBUSY:
-        printf("BLE scan is busy\n");
-        TERMINAL_VIEW_ADD_TEXT("BLE scan is busy\n");
-        break;
-    case BLE_HS_ETIMEOUT:
-        printf("BLE operation timed out.\n");
-        TERMINAL_VIEW_ADD_TEXT("BLE operation timed out.\n");
-        break;
-    case BLE_HS_ENOTCONN:
-        printf("BLE not connected.\n");
-        TERMINAL_VIEW_ADD_TEXT("BLE not connected.\n");
-        break;
-    case BLE_HS_EINVAL:
-        printf("BLE invalid parameter.\n");
-        TERMINAL_VIEW_ADD_TEXT("BLE invalid parameter.\n");
-        break;
-    default:
-        printf("Error stopping BLE scan: %d\n", rc);
-        TERMINAL_VIEW_ADD_TEXT("Error stopping BLE scan: %d\n", rc);
-    }
+    pcap_flush_task_handle = NULL;
+    vTaskDelete(NULL);
 }
 
 void ble_start_capture(void) {
@@ -1012,74 +1080,89 @@ void ble_start_capture(void) {
     }
 
     // Register BLE handler only after file is open
+    capture_stats_start(CAPTURE_MODE_BLE);
     ble_register_handler(ble_pcap_callback);
 
-    // Create a timer to flush the buffer periodically
-    esp_timer_create_args_t timer_args = {.callback = (esp_timer_cb_t)pcap_flush_buffer_to_file,
-                                          .name = "pcap_flush"};
-
-    if (esp_timer_create(&timer_args, &flush_timer) == ESP_OK) {
-        esp_timer_start_periodic(flush_timer, 1000000); // Flush every second
+    // Flush periodically from a task, SD writes don't belong in a timer callback
+    if (pcap_flush_task_handle == NULL) {
+        pcap_flush_running = true;
+        if (!system_manager_create_task(ble_pcap_flush_task, "ble_pcap_flush", 3072, NULL, 2,
+                                        &pcap_flush_task_handle, NULL)) {
+            pcap_flush_running = false;
+            pcap_flush_task_handle = NULL;
+            ESP_LOGW("BLE_PCAP", "Flush task not started, flushing only when the buffer fills");
+        }
     }
 
-    ble_start_scanning();
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_CAPTURE);
 }
 
 void ble_start_skimmer_detection(void) {
+    // Reporter task and name hashes must exist before adverts arrive
+    skimmer_detection_start();
+
     // Register the skimmer detection callback
-    esp_err_t err = ble_register_handler(ble_skimmer_scan_callback);
+    esp_err_t err = ble_register_handler_filtered(ble_skimmer_scan_callback, &named_device_filter);
     if (err != ESP_OK) {
         ESP_LOGE("BLE", "Failed to register skimmer detection callback");
         return;
     }
 
-    // Start BLE scanning
-    ble_start_scanning();
+    // Start BLE scanning, skimmers are judged on repeated RSSI samples
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_TRACKING);
 }
 
 // Function to list discovered Flippers
 void ble_list_flippers(void) {
-    printf("--- Discovered Flippers (%d) ---\n", discovered_flipper_count);
-    TERMINAL_VIEW_ADD_TEXT("--- Discovered Flippers (%d) ---\n", discovered_flipper_count);
-    if (discovered_flipper_count == 0) {
+    ensure_registries();
+    ble_registry_lock(&flipper_registry);
+    ble_registry_entry_t *selected =
+        selected_entry(&flipper_registry, selected_flipper_index, selected_flipper_first_seen);
+
+    printf("--- Discovered Flippers (%d) ---\n", flipper_registry.count);
+    TERMINAL_VIEW_ADD_TEXT("--- Discovered Flippers (%d) ---\n", flipper_registry.count);
+    if (flipper_registry.count == 0) {
+        ble_registry_unlock(&flipper_registry);
         printf("No Flippers discovered yet.\n");
         TERMINAL_VIEW_ADD_TEXT("No Flippers discovered yet.\n");
         return;
     }
-    for (int i = 0; i < discovered_flipper_count; i++) {
+    for (int i = 0; i < BLE_REGISTRY_CAPACITY; i++) {
+        ble_registry_entry_t *entry = ble_registry_get(&flipper_registry, i);
+        if (!entry) {
+            continue;
+        }
         char mac[18];
-        snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x",
-                 discovered_flippers[i].addr.val[0], discovered_flippers[i].addr.val[1],
-                 discovered_flippers[i].addr.val[2], discovered_flippers[i].addr.val[3],
-                 discovered_flippers[i].addr.val[4], discovered_flippers[i].addr.val[5]);
-        printf("Index: %d | MAC: %s | RSSI: %d dBm%s\n",
-               i, mac, discovered_flippers[i].rssi,
-               (i == selected_flipper_index) ? " (Selected)" : "");
-        TERMINAL_VIEW_ADD_TEXT("Idx: %d MAC: %s RSSI: %d %s\n",
-                               i, mac, discovered_flippers[i].rssi,
-                               (i == selected_flipper_index) ? "(Sel)" : "");
+        format_addr(entry->addr, mac, sizeof(mac));
+        int8_t rssi = ble_registry_rssi_latest(entry);
+        const char *type_str = entry->kind == (FLIPPER_UUID_WHITE & 0xFF)   ? "White"
+                               : entry->kind == (FLIPPER_UUID_BLACK & 0xFF) ? "Black"
+                                                                           : "Transparent";
+        printf("Index: %d | %s | MAC: %s | Name: %s | RSSI: %d dBm (avg %d)%s%s\n", i, type_str,
+               mac, entry->name[0] ? entry->name : "Unknown", rssi, ble_registry_rssi_average(entry),
+               entry->rotations ? " | Rotated" : "", (entry == selected) ? " (Selected)" : "");
+        TERMINAL_VIEW_ADD_TEXT("Idx: %d MAC: %s RSSI: %d %s\n", i, mac, rssi,
+                               (entry == selected) ? "(Sel)" : "");
     }
+    ble_registry_unlock(&flipper_registry);
 }
 void ble_start_tracking_selected_flipper(void) {
     // Stop any ongoing scan
     ble_gap_disc_cancel();
     // Re-register callback (ensuring no duplicates)
     ble_unregister_handler(ble_findtheflippers_callback);
-    ble_register_handler(ble_findtheflippers_callback);
-    struct ble_gap_disc_params params = {0};
-    params.itvl = BLE_HCI_SCAN_ITVL_DEF;
-    params.window = BLE_HCI_SCAN_WINDOW_DEF;
-    params.filter_duplicates = 0; // receive all advertisement updates
-    int rc = ble_gap_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER, &params, ble_gap_event_general, NULL);
-    if (rc != 0) {
-        ESP_LOGE(TAG_BLE, "Error starting tracking scan; rc=%d", rc);
-        TERMINAL_VIEW_ADD_TEXT("Error starting tracker; rc=%d\n", rc);
-    }
+    ble_register_handler_filtered(ble_findtheflippers_callback, &flipper_filter);
+    // Tracking profile disables duplicate filtering to receive all advertisement updates
+    ble_start_scanning_profile(BLE_SCAN_PROFILE_TRACKING);
 }
 
 // Function to select a Flipper by index
 void ble_select_flipper(int index) {
-    if (index < 0 || index >= discovered_flipper_count) {
+    ensure_registries();
+    ble_registry_lock(&flipper_registry);
+    ble_registry_entry_t *entry = ble_registry_get(&flipper_registry, index);
+    if (!entry) {
+        ble_registry_unlock(&flipper_registry);
         printf("Error: Invalid Flipper index %d. Use 'listflippers' to see valid indices.\n", index);
         TERMINAL_VIEW_ADD_TEXT("Error: Invalid Flipper index %d.\nUse 'listflippers'.\n", index);
         selected_flipper_index = -1;
@@ -1087,11 +1170,10 @@ void ble_select_flipper(int index) {
     }
 
     selected_flipper_index = index;
+    selected_flipper_first_seen = entry->first_seen_ms;
     char mac[18];
-    snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x",
-             discovered_flippers[index].addr.val[0], discovered_flippers[index].addr.val[1],
-             discovered_flippers[index].addr.val[2], discovered_flippers[index].addr.val[3],
-             discovered_flippers[index].addr.val[4], discovered_flippers[index].addr.val[5]);
+    format_addr(entry->addr, mac, sizeof(mac));
+    ble_registry_unlock(&flipper_registry);
     printf("Selected Flipper at index %d: MAC %s\n", index, mac);
     TERMINAL_VIEW_ADD_TEXT("Selected Flipper %d: MAC %s\n", index, mac);
     // Start continuous tracking scan without duplicate filtering
@@ -0,0 +1,287 @@
+#include "managers/ble_registry.h"
+#include "esp_timer.h"
+#include <string.h>
+
+#ifndef CONFIG_IDF_TARGET_ESP32S2
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+// Seed 0 starts a new hash, passing a previous result continues it
+uint32_t ble_registry_hash(const uint8_t *data, size_t len, uint32_t seed) {
+    uint32_t hash = seed ? seed : FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint32_t ble_registry_now_ms(void) { return (uint32_t)(esp_timer_get_time() / 1000); }
+
+static inline uint32_t addr_bucket(const uint8_t *addr) {
+    return ble_registry_hash(addr, 6, 0) & (BLE_REGISTRY_BUCKETS - 1);
+}
+
+static inline uint32_t identity_bucket(uint32_t identity_hash) {
+    return (identity_hash ^ (identity_hash >> 16)) & (BLE_REGISTRY_BUCKETS - 1);
+}
+
+// Random address with the top bits 01, stored little-endian by NimBLE
+static inline bool addr_is_rpa(uint8_t addr_type, const uint8_t *addr) {
+    return addr_type == BLE_ADV_ADDR_RANDOM && (addr[5] & 0xC0) == 0x40;
+}
+
+static void reset_pool(ble_registry_t *reg) {
+    memset(reg->entries, 0, sizeof(reg->entries));
+    for (int i = 0; i < BLE_REGISTRY_BUCKETS; i++) {
+        reg->buckets[i] = -1;
+        reg->id_buckets[i] = -1;
+    }
+    for (int i = 0; i < BLE_REGISTRY_CAPACITY; i++) {
+        reg->entries[i].next = (i + 1 < BLE_REGISTRY_CAPACITY) ? i + 1 : -1;
+        reg->entries[i].id_next = -1;
+    }
+    reg->free_head = 0;
+    reg->count = 0;
+}
+
+void ble_registry_init(ble_registry_t *reg, uint32_t stale_ms) {
+    if (reg->lock == NULL) {
+        reg->lock = xSemaphoreCreateMutex();
+    }
+    reg->stale_ms = stale_ms;
+    reg->last_age_ms = 0;
+    memset(&reg->stats, 0, sizeof(reg->stats));
+    reset_pool(reg);
+}
+
+void ble_registry_clear(ble_registry_t *reg) {
+    ble_registry_lock(reg);
+    reset_pool(reg);
+    ble_registry_unlock(reg);
+}
+
+void ble_registry_lock(ble_registry_t *reg) {
+    if (reg->lock) {
+        xSemaphoreTake(reg->lock, portMAX_DELAY);
+    }
+}
+
+void ble_registry_unlock(ble_registry_t *reg) {
+    if (reg->lock) {
+        xSemaphoreGive(reg->lock);
+    }
+}
+
+static void unlink_chain(int16_t *head, ble_registry_entry_t *entries, int16_t idx, bool id_chain) {
+    int16_t *link = head;
+    while (*link != -1) {
+        if (*link == idx) {
+            *link = id_chain ? entries[idx].id_next : entries[idx].next;
+            return;
+        }
+        link = id_chain ? &entries[*link].id_next : &entries[*link].next;
+    }
+}
+
+static void remove_entry(ble_registry_t *reg, int16_t idx) {
+    ble_registry_entry_t *e = &reg->entries[idx];
+    unlink_chain(&reg->buckets[addr_bucket(e->addr)], reg->entries, idx, false);
+    if (e->identity_hash) {
+        unlink_chain(&reg->id_buckets[identity_bucket(e->identity_hash)], reg->entries, idx,
+                     true);
+    }
+    memset(e, 0, sizeof(*e));
+    e->id_next = -1;
+    e->next = reg->free_head;
+    reg->free_head = idx;
+    reg->count--;
+}
+
+static int16_t find_index(ble_registry_t *reg, const uint8_t *addr) {
+    reg->stats.lookups++;
+    for (int16_t i = reg->buckets[addr_bucket(addr)]; i != -1; i = reg->entries[i].next) {
+        reg->stats.probes++;
+        if (memcmp(reg->entries[i].addr, addr, 6) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// An entry whose private address went quiet and that carries the same
+// identity is taken to be the same device under its next address.
+static int16_t find_rotated(ble_registry_t *reg, uint32_t identity_hash, uint32_t now_ms) {
+    for (int16_t i = reg->id_buckets[identity_bucket(identity_hash)]; i != -1;
+         i = reg->entries[i].id_next) {
+        ble_registry_entry_t *e = &reg->entries[i];
+        if (e->identity_hash == identity_hash && addr_is_rpa(e->addr_type, e->addr) &&
+            now_ms - e->last_seen_ms >= BLE_REGISTRY_ROTATION_QUIET_MS) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+size_t ble_registry_age(ble_registry_t *reg, uint32_t now_ms) {
+    size_t removed = 0;
+    reg->last_age_ms = now_ms;
+    if (reg->stale_ms == 0) {
+        return 0;
+    }
+    for (int16_t i = 0; i < BLE_REGISTRY_CAPACITY; i++) {
+        if (reg->entries[i].in_use && now_ms - reg->entries[i].last_seen_ms > reg->stale_ms) {
+            remove_entry(reg, i);
+            removed++;
+        }
+    }
+    reg->stats.aged_out += removed;
+    return removed;
+}
+
+static int16_t alloc_entry(ble_registry_t *reg, uint32_t now_ms) {
+    if (reg->free_head == -1) {
+        ble_registry_age(reg, now_ms);
+    }
+    if (reg->free_head == -1) {
+        // Still full, drop the device we have not heard from the longest
+        int16_t oldest = 0;
+        for (int16_t i = 1; i < BLE_REGISTRY_CAPACITY; i++) {
+            if (now_ms - reg->entries[i].last_seen_ms >
+                now_ms - reg->entries[oldest].last_seen_ms) {
+                oldest = i;
+            }
+        }
+        remove_entry(reg, oldest);
+        reg->stats.evicted++;
+    }
+
+    int16_t idx = reg->free_head;
+    reg->free_head = reg->entries[idx].next;
+    reg->count++;
+    return idx;
+}
+
+ble_registry_entry_t *ble_registry_observe(ble_registry_t *reg, const ble_adv_record_t *adv,
+                                           uint32_t identity_hash, bool *is_new) {
+    uint32_t now_ms = ble_registry_now_ms();
+    bool created = false;
+
+    if (now_ms - reg->last_age_ms >= BLE_REGISTRY_AGE_INTERVAL_MS) {
+        ble_registry_age(reg, now_ms);
+    }
+
+    int16_t idx = find_index(reg, adv->addr);
+    if (idx == -1 && identity_hash && addr_is_rpa(adv->addr_type, adv->addr)) {
+        idx = find_rotated(reg, identity_hash, now_ms);
+        if (idx != -1) {
+            ble_registry_entry_t *e = &reg->entries[idx];
+            unlink_chain(&reg->buckets[addr_bucket(e->addr)], reg->entries, idx, false);
+            memcpy(e->addr, adv->addr, 6);
+            uint32_t b = addr_bucket(e->addr);
+            e->next = reg->buckets[b];
+            reg->buckets[b] = idx;
+            e->rotations++;
+            reg->stats.rotations++;
+        }
+    }
+
+    if (idx == -1) {
+        idx = alloc_entry(reg, now_ms);
+        ble_registry_entry_t *e = &reg->entries[idx];
+        memset(e, 0, sizeof(*e));
+        e->in_use = true;
+        memcpy(e->addr, adv->addr, 6);
+        e->first_seen_ms = now_ms;
+
+        uint32_t b = addr_bucket(e->addr);
+        e->next = reg->buckets[b];
+        reg->buckets[b] = idx;
+        e->id_next = -1;
+        reg->stats.inserts++;
+        created = true;
+    }
+
+    ble_registry_entry_t *e = &reg->entries[idx];
+    e->addr_type = adv->addr_type;
+    e->last_seen_ms = now_ms;
+
+    e->rssi_history[e->rssi_head] = adv->rssi;
+    e->rssi_head = (e->rssi_head + 1) % BLE_REGISTRY_RSSI_HISTORY;
+    if (e->rssi_count < BLE_REGISTRY_RSSI_HISTORY) {
+        e->rssi_count++;
+    }
+
+    uint32_t payload_hash = ble_registry_hash(adv->data, adv->data_len, 0);
+    if (created || payload_hash != e->payload_hash) {
+        e->payload_hash = payload_hash;
+        e->payload_len = adv->data_len < BLE_REGISTRY_MAX_PAYLOAD ? adv->data_len
+                                                                  : BLE_REGISTRY_MAX_PAYLOAD;
+        memcpy(e->payload, adv->data, e->payload_len);
+
+        e->uuid16_count = 0;
+        for (int i = 0; i < adv->uuid16_count && e->uuid16_count < BLE_REGISTRY_MAX_UUIDS; i++) {
+            e->uuid16[e->uuid16_count++] = adv->uuid16[i];
+        }
+        if (adv->name_len > 0) {
+            memcpy(e->name, adv->name, adv->name_len + 1);
+        }
+    }
+
+    if (identity_hash != e->identity_hash) {
+        if (e->identity_hash) {
+            unlink_chain(&reg->id_buckets[identity_bucket(e->identity_hash)], reg->entries, idx,
+                         true);
+        }
+        e->identity_hash = identity_hash;
+        e->id_next = -1;
+        if (identity_hash) {
+            uint32_t b = identity_bucket(identity_hash);
+            e->id_next = reg->id_buckets[b];
+            reg->id_buckets[b] = idx;
+        }
+    }
+
+    if (is_new) {
+        *is_new = created;
+    }
+    return e;
+}
+
+ble_registry_entry_t *ble_registry_find(ble_registry_t *reg, const uint8_t *addr) {
+    int16_t idx = find_index(reg, addr);
+    return idx == -1 ? NULL : &reg->entries[idx];
+}
+
+ble_registry_entry_t *ble_registry_get(ble_registry_t *reg, int index) {
+    if (index < 0 || index >= BLE_REGISTRY_CAPACITY || !reg->entries[index].in_use) {
+        return NULL;
+    }
+    return &reg->entries[index];
+}
+
+int ble_registry_index(const ble_registry_t *reg, const ble_registry_entry_t *entry) {
+    return (int)(entry - reg->entries);
+}
+
+int8_t ble_registry_rssi_latest(const ble_registry_entry_t *entry) {
+    if (entry->rssi_count == 0) {
+        return 0;
+    }
+    uint8_t last = (entry->rssi_head + BLE_REGISTRY_RSSI_HISTORY - 1) % BLE_REGISTRY_RSSI_HISTORY;
+    return entry->rssi_history[last];
+}
+
+int8_t ble_registry_rssi_average(const ble_registry_entry_t *entry) {
+    if (entry->rssi_count == 0) {
+        return 0;
+    }
+    int sum = 0;
+    for (uint8_t i = 0; i < entry->rssi_count; i++) {
+        sum += entry->rssi_history[i];
+    }
+    return (int8_t)(sum / entry->rssi_count);
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include "managers/ble_spam_detector.h"
+#include <string.h>
+
+#ifndef CONFIG_IDF_TARGET_ESP32S2
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+// Keys are tagged so a company ID and a layout hash never share a counter
+#define KEY_TAG_COMPANY 0xC0
+#define KEY_TAG_LAYOUT 0x1A
+
+// Sender counters are fixed point so a new sender can count for more than
+// one. The weight is capped for a filter that is nearly full.
+#define SENDER_SCALE 16
+#define SENDER_MAX_WEIGHT (SENDER_SCALE * 32)
+
+typedef struct {
+    uint16_t adverts[BLE_SPAM_SKETCH_DEPTH][BLE_SPAM_SKETCH_WIDTH];
+    uint16_t senders[BLE_SPAM_SKETCH_DEPTH][BLE_SPAM_SKETCH_WIDTH];
+    uint8_t seen[BLE_SPAM_SEEN_BITS / 8];
+    uint16_t seen_set; // Bits set in seen, never set in another slot too
+} spam_slot_t;
+
+typedef struct {
+    bool in_use;
+    uint32_t key;
+    ble_spam_severity_t severity;
+    uint32_t last_report_ms;
+} spam_alert_t;
+
+static spam_slot_t slots[BLE_SPAM_SLOTS];
+static uint32_t current_epoch = 0;
+static bool window_started = false;
+static spam_alert_t alerts[BLE_SPAM_MAX_ALERTS];
+static ble_spam_stats_t spam_stats;
+
+static uint32_t fnv_bytes(uint32_t hash, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t make_key(uint8_t tag, uint32_t value) {
+    uint8_t buf[5] = {tag, value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24};
+    return fnv_bytes(FNV_OFFSET_BASIS, buf, sizeof(buf));
+}
+
+// Double hashing gives the per-row columns from one key hash
+static inline uint32_t sketch_col(uint32_t key, int row) {
+    uint32_t h2 = (key >> 16) | 1;
+    return (key + (uint32_t)row * h2) & (BLE_SPAM_SKETCH_WIDTH - 1);
+}
+
+static void advance_window(uint32_t now_ms) {
+    uint32_t epoch = now_ms / BLE_SPAM_SLOT_MS;
+    if (!window_started || epoch - current_epoch >= BLE_SPAM_SLOTS) {
+        memset(slots, 0, sizeof(slots));
+        current_epoch = epoch;
+        window_started = true;
+        return;
+    }
+    while (current_epoch != epoch) {
+        current_epoch++;
+        memset(&slots[current_epoch % BLE_SPAM_SLOTS], 0, sizeof(spam_slot_t));
+    }
+}
+
+static uint32_t sketch_query(uint32_t key, bool senders) {
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < BLE_SPAM_SKETCH_DEPTH; row++) {
+        uint32_t col = sketch_col(key, row);
+        uint32_t sum = 0;
+        for (int s = 0; s < BLE_SPAM_SLOTS; s++) {
+            sum += senders ? slots[s].senders[row][col] : slots[s].adverts[row][col];
+        }
+        if (sum < estimate) {
+            estimate = sum;
+        }
+    }
+    return estimate;
+}
+
+static void sketch_add(uint16_t table[BLE_SPAM_SKETCH_DEPTH][BLE_SPAM_SKETCH_WIDTH],
+                       uint32_t key, uint32_t amount) {
+    for (int row = 0; row < BLE_SPAM_SKETCH_DEPTH; row++) {
+        uint16_t *cell = &table[row][sketch_col(key, row)];
+        *cell = *cell + amount > UINT16_MAX ? UINT16_MAX : *cell + amount;
+    }
+}
+
+// A new sender is missed when its bit is already set in any slot, which
+// happens with the window's fill ratio. Each one that gets through stands
+// in for 1 / (1 - fill) senders, so the expected count stays exact.
+static uint32_t sender_weight(void) {
+    uint32_t free_bits = BLE_SPAM_SEEN_BITS;
+    for (int s = 0; s < BLE_SPAM_SLOTS; s++) {
+        free_bits -= slots[s].seen_set;
+    }
+    if (free_bits * SENDER_MAX_WEIGHT <= SENDER_SCALE * BLE_SPAM_SEEN_BITS) {
+        return SENDER_MAX_WEIGHT;
+    }
+    return SENDER_SCALE * BLE_SPAM_SEEN_BITS / free_bits;
+}
+
+// Counts the advert against key and, the first time this address is seen
+// for the key within the window, against its sender count as well
+static void record_key(uint32_t key, const uint8_t *addr) {
+    spam_slot_t *slot = &slots[current_epoch % BLE_SPAM_SLOTS];
+    sketch_add(slot->adverts, key, 1);
+
+    uint32_t pair = fnv_bytes(key, addr, 6);
+    uint32_t bit = pair & (BLE_SPAM_SEEN_BITS - 1);
+    for (int s = 0; s < BLE_SPAM_SLOTS; s++) {
+        if (slots[s].seen[bit >> 3] & (1 << (bit & 7))) {
+            return;
+        }
+    }
+    // Weighted by the fill before this bit, as the senders missed so far were
+    sketch_add(slot->senders, key, sender_weight());
+    slot->seen[bit >> 3] |= (1 << (bit & 7));
+    slot->seen_set++;
+}
+
+static ble_spam_severity_t classify(uint32_t rate, uint32_t senders) {
+    if (rate == 0 || senders * 100 < rate * BLE_SPAM_MIN_CHURN_PCT) {
+        return BLE_SPAM_NONE;
+    }
+    if (senders >= BLE_SPAM_HIGH_SENDERS) {
+        return BLE_SPAM_HIGH;
+    }
+    if (senders >= BLE_SPAM_MEDIUM_SENDERS) {
+        return BLE_SPAM_MEDIUM;
+    }
+    if (senders >= BLE_SPAM_LOW_SENDERS) {
+        return BLE_SPAM_LOW;
+    }
+    return BLE_SPAM_NONE;
+}
+
+static bool alert_due(uint32_t key, ble_spam_severity_t severity, uint32_t now_ms) {
+    spam_alert_t *slot = NULL;
+    spam_alert_t *oldest = &alerts[0];
+    for (int i = 0; i < BLE_SPAM_MAX_ALERTS; i++) {
+        if (alerts[i].in_use && alerts[i].key == key) {
+            slot = &alerts[i];
+            break;
+        }
+        if (!alerts[i].in_use) {
+            oldest = &alerts[i];
+        } else if (oldest->in_use && now_ms - alerts[i].last_report_ms >
+                                         now_ms - oldest->last_report_ms) {
+            oldest = &alerts[i];
+        }
+    }
+
+    if (slot && severity <= slot->severity &&
+        now_ms - slot->last_report_ms < BLE_SPAM_REPORT_INTERVAL_MS) {
+        return false;
+    }
+
+    if (!slot) {
+        slot = oldest;
+        slot->in_use = true;
+        slot->key = key;
+    }
+    slot->severity = severity;
+    slot->last_report_ms = now_ms;
+    return true;
+}
+
+void ble_spam_detector_reset(void) {
+    memset(slots, 0, sizeof(slots));
+    memset(alerts, 0, sizeof(alerts));
+    memset(&spam_stats, 0, sizeof(spam_stats));
+    window_started = false;
+}
+
+bool ble_spam_detector_observe(const ble_adv_record_t *adv, uint32_t now_ms,
+                               ble_spam_verdict_t *verdict) {
+    advance_window(now_ms);
+    spam_stats.adverts++;
+
+    uint32_t company_key = adv->has_company_id ? make_key(KEY_TAG_COMPANY, adv->company_id) : 0;
+    uint32_t layout_key = make_key(KEY_TAG_LAYOUT, adv->layout_hash ^ adv->company_id);
+
+    if (adv->has_company_id) {
+        record_key(company_key, adv->addr);
+    }
+    record_key(layout_key, adv->addr);
+
+    ble_spam_verdict_t best = {0};
+    uint32_t best_key = 0;
+
+    if (adv->has_company_id) {
+        uint32_t rate = sketch_query(company_key, false);
+        uint32_t senders = sketch_query(company_key, true) / SENDER_SCALE;
+        best.severity = classify(rate, senders);
+        best.rate = rate;
+        best.senders = senders;
+        best_key = company_key;
+    }
+
+    uint32_t rate = sketch_query(layout_key, false);
+    uint32_t senders = sketch_query(layout_key, true) / SENDER_SCALE;
+    ble_spam_severity_t layout_severity = classify(rate, senders);
+    if (layout_severity > best.severity) {
+        best.severity = layout_severity;
+        best.by_layout = true;
+        best.rate = rate;
+        best.senders = senders;
+        best_key = layout_key;
+    }
+
+    if (best.severity == BLE_SPAM_NONE) {
+        return false;
+    }
+
+    best.has_company = adv->has_company_id;
+    best.company_id = adv->company_id;
+    if (best.severity > spam_stats.peak) {
+        spam_stats.peak = best.severity;
+    }
+
+    if (!alert_due(best_key, best.severity, now_ms)) {
+        return false;
+    }
+
+    spam_stats.reports++;
+    if (verdict) {
+        *verdict = best;
+    }
+    return true;
+}
+
+void ble_spam_detector_get_stats(ble_spam_stats_t *stats) { *stats = spam_stats; }
+
+const char *ble_spam_severity_name(ble_spam_severity_t severity) {
+    switch (severity) {
+    case BLE_SPAM_LOW:
+        return "Low";
+    case BLE_SPAM_MEDIUM:
+        return "Medium";
+    case BLE_SPAM_HIGH:
+        return "High";
+    default:
+        return "None";
+    }
+}
+
+#endif
@@ -3,9 +3,12 @@
 
 #include "managers/dial_manager.h"
 #include "cJSON.h"
+#include "core/system_manager.h"
 #include "esp_crt_bundle.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -130,6 +133,94 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
 #define SERVER_PORT 443
 #define MAX_APP_URL_LENGTH 500
 
+#define YOUTUBE_BIND_URL "https://www.youtube.com/api/lounge/bc/bind"
+#define YOUTUBE_TOKEN_URL                                                      \
+  "https://www.youtube.com/api/lounge/pairing/get_lounge_token_batch"
+#define YOUTUBE_TIMEOUT_MS 10000
+#define YOUTUBE_BUFFER_SIZE 1524
+
+// The lounge calls share one TLS connection to www.youtube.com and one
+// response buffer, kept until explore_network is done
+static esp_http_client_handle_t youtube_client = NULL;
+static response_buffer_t youtube_resp = {0};
+static int youtube_requests = 0; // Answered on the open connection
+
+static void youtube_close(void) {
+  if (youtube_client) {
+    esp_http_client_cleanup(youtube_client);
+    youtube_client = NULL;
+  }
+  free(youtube_resp.buffer);
+  youtube_resp = (response_buffer_t){0};
+  youtube_requests = 0;
+}
+
+// POSTs body to url on the shared connection. Returns the response body,
+// valid until the next call, or NULL if the request failed.
+static const char *youtube_post(const char *url, const char *content_type,
+                                const char *body, bool origin, int *status) {
+  if (!youtube_resp.buffer) {
+    youtube_resp.buffer = malloc(YOUTUBE_BUFFER_SIZE);
+    if (!youtube_resp.buffer) {
+      ESP_LOGE(TAG, "Failed to allocate memory for response buffer");
+      return NULL;
+    }
+    youtube_resp.buffer_size = YOUTUBE_BUFFER_SIZE;
+  }
+
+  if (!youtube_client) {
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = YOUTUBE_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .transport_type = HTTP_TRANSPORT_OVER_SSL,
+        .event_handler = _http_event_handler,
+        .user_data = &youtube_resp,
+    };
+    youtube_client = esp_http_client_init(&config);
+    if (!youtube_client) {
+      ESP_LOGE(TAG, "Failed to initialize HTTP client.");
+      return NULL;
+    }
+  } else {
+    esp_http_client_set_url(youtube_client, url);
+  }
+
+  esp_http_client_set_method(youtube_client, HTTP_METHOD_POST);
+  esp_http_client_set_header(youtube_client, "Content-Type", content_type);
+  if (origin) {
+    esp_http_client_set_header(youtube_client, "Origin",
+                               "https://www.youtube.com");
+  } else {
+    esp_http_client_delete_header(youtube_client, "Origin");
+  }
+  esp_http_client_set_post_field(youtube_client, body, strlen(body));
+
+  youtube_resp.buffer_len = 0;
+  esp_err_t err = esp_http_client_perform(youtube_client);
+  if (err != ESP_OK && youtube_requests > 0) {
+    // The server may have closed the idle connection, retry on a new one
+    esp_http_client_close(youtube_client);
+    youtube_requests = 0;
+    youtube_resp.buffer_len = 0;
+    err = esp_http_client_perform(youtube_client);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+    esp_http_client_close(youtube_client);
+    youtube_requests = 0;
+    return NULL;
+  }
+  youtube_requests++;
+
+  // The event handler always leaves room for the terminator
+  youtube_resp.buffer[youtube_resp.buffer_len] = '\0';
+  if (status) {
+    *status = esp_http_client_get_status_code(youtube_client);
+  }
+  return youtube_resp.buffer;
+}
+
 BindSession_Params_t parse_response(const char *response_body) {
   BindSession_Params_t result;
 
@@ -192,15 +283,6 @@ char *generate_zx() {
   return zx;
 }
 
-char *extract_path_from_url(const char *url) {
-  // Find the first slash after the host and port (i.e., after "://host:port/")
-  const char *path_start = strchr(url + 7, '/'); // +7 to skip over "http://"
-  if (path_start) {
-    return strdup(path_start); // Duplicate and return the path
-  }
-  return strdup("/"); // Default to "/" if no path is found
-}
-
 char *extract_application_url(const char *headers) {
   const char *app_url_header = strstr(headers, "Application-Url");
   if (!app_url_header) {
@@ -233,6 +315,11 @@ esp_err_t send_command(const char *command, const char *video_id,
     return ESP_ERR_INVALID_ARG;
   }
 
+  esp_err_t result = ESP_FAIL;
+  char *url_params = NULL;
+  char *body_params = NULL;
+  char *full_url = NULL;
+
   // URL-encode parameters
   char *encoded_loungeIdToken = url_encode(device->YoutubeToken);
   char *encoded_SID = url_encode(device->SID);
@@ -251,7 +338,7 @@ esp_err_t send_command(const char *command, const char *video_id,
   size_t url_params_len = snprintf(NULL, 0,
            "CVER=1&RID=1&SID=%s&VER=8&gsessionid=%s&loungeIdToken=%s",
            encoded_SID, encoded_gsession, encoded_loungeIdToken) + 1;
-  char *url_params = malloc(url_params_len);
+  url_params = malloc(url_params_len);
   if (!url_params) {
     ESP_LOGE(TAG, "Failed to allocate memory for URL parameters");
     goto cleanup;
@@ -262,7 +349,6 @@ esp_err_t send_command(const char *command, const char *video_id,
   ESP_LOGI(TAG, "Query Parameters: %s", url_params);
 
   size_t body_params_len = 0;
-  char *body_params = NULL;
   if (strcmp(command, "setVideo") == 0) {
     body_params_len = snprintf(NULL, 0,
              "count=1&req0__sc=%s&req0_videoId=%s&req0_currentTime=0&req0_currentIndex=0&req0_videoIds=%s",
@@ -270,7 +356,6 @@ esp_err_t send_command(const char *command, const char *video_id,
     body_params = malloc(body_params_len);
     if (!body_params) {
       ESP_LOGE(TAG, "Failed to allocate memory for body parameters");
-      free(url_params);
       goto cleanup;
     }
     snprintf(body_params, body_params_len,
@@ -283,7 +368,6 @@ esp_err_t send_command(const char *command, const char *video_id,
     body_params = malloc(body_params_len);
     if (!body_params) {
       ESP_LOGE(TAG, "Failed to allocate memory for body parameters");
-      free(url_params);
       goto cleanup;
     }
     snprintf(body_params, body_params_len,
@@ -295,67 +379,35 @@ esp_err_t send_command(const char *command, const char *video_id,
     body_params = malloc(body_params_len);
     if (!body_params) {
       ESP_LOGE(TAG, "Failed to allocate memory for body parameters");
-      free(url_params);
       goto cleanup;
     }
     snprintf(body_params, body_params_len, "count=1&req0__sc=%s",
              encoded_command);
   } else {
     ESP_LOGE(TAG, "Unsupported command: %s", command);
-    free(url_params);
     goto cleanup;
   }
   ESP_LOGI(TAG, "Body Parameters: %s", body_params);
 
-  response_buffer_t resp_buf = {
-      .buffer = malloc(1524), .buffer_len = 0, .buffer_size = 1524};
-  if (!resp_buf.buffer) {
-    ESP_LOGE(TAG, "Failed to allocate memory for response buffer.");
-    goto cleanup;
-  }
-
-  // Configure HTTP client
-  esp_http_client_config_t config = {
-      .url = "https://www.youtube.com/api/lounge/bc/bind",
-      .timeout_ms = 5000,
-      .crt_bundle_attach = esp_crt_bundle_attach,
-      .transport_type = HTTP_TRANSPORT_OVER_SSL,
-      .event_handler = _http_event_handler,
-      .user_data = &resp_buf,
-  };
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-
-  // Set the request body
-  esp_http_client_set_post_field(client, body_params, strlen(body_params));
-
-  // Dynamically allocate buffer for full_url
-  size_t full_url_len = strlen(config.url) + 1 + strlen(url_params) + 1; // base + '?' + params + '\0'
-  char *full_url = malloc(full_url_len);
+  size_t full_url_len = strlen(YOUTUBE_BIND_URL) + 1 + strlen(url_params) + 1; // base + '?' + params + '\0'
+  full_url = malloc(full_url_len);
   if (full_url == NULL) {
     ESP_LOGE(TAG, "Failed to allocate memory for full_url");
-    esp_http_client_cleanup(client);
-    return ESP_FAIL;
+    goto cleanup;
   }
-  snprintf(full_url, full_url_len, "%s?%s", config.url, url_params);
-  esp_http_client_set_url(client, full_url);
+  snprintf(full_url, full_url_len, "%s?%s", YOUTUBE_BIND_URL, url_params);
 
   ESP_LOGI(TAG, "Full URL: %s", full_url);
   ESP_LOGI(TAG, "POST Body: %s", body_params);
 
-  // Set HTTP method, headers, and post data
-  esp_http_client_set_method(client, HTTP_METHOD_POST);
-  esp_http_client_set_header(client, "Content-Type",
-                             "application/x-www-form-urlencoded");
-  esp_http_client_set_header(client, "Origin", "https://www.youtube.com");
-
-  // Perform the HTTP request
-  esp_err_t err = esp_http_client_perform(client);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+  const char *response = youtube_post(
+      full_url, "application/x-www-form-urlencoded", body_params, true, NULL);
+  if (!response) {
     goto cleanup;
   }
 
-  ESP_LOGI(TAG, "Response: %s", resp_buf.buffer);
+  ESP_LOGI(TAG, "Response: %s", response);
+  result = ESP_OK;
 
 cleanup:
   // Free allocated memory
@@ -363,18 +415,12 @@ cleanup:
   free(encoded_SID);
   free(encoded_gsession);
   free(encoded_command);
-  if (encoded_video_id) {
-    free(encoded_video_id);
-  }
-  if (resp_buf.buffer) {
-    free(resp_buf.buffer);
-  }
+  free(encoded_video_id);
   free(url_params);
   free(body_params);
-  esp_http_client_cleanup(client);
-  free(full_url); // Free allocated memory
+  free(full_url);
 
-  return ESP_OK;
+  return result;
 }
 
 esp_err_t bind_session_id(Device *device) {
@@ -426,112 +472,54 @@ esp_err_t bind_session_id(Device *device) {
       "device=REMOTE_CONTROL&mdx-version=3&ui=1&v=2&name=%s"
       "&app=youtube-desktop&loungeIdToken=%s&id=%s&VER=8&CVER=1&zx=%s&RID=%i",
       encoded_name, encoded_loungeIdToken, encoded_UUID, encoded_zx, 1);
-  ESP_LOGI(TAG, "Constructed URL: %s?%s", "https://www.youtube.com/api/lounge/bc/bind", url_params);
+  ESP_LOGI(TAG, "Constructed URL: %s?%s", YOUTUBE_BIND_URL, url_params);
 
-  response_buffer_t resp_buf = {
-      .buffer = malloc(1524), .buffer_len = 0, .buffer_size = 1524};
-  if (resp_buf.buffer == NULL) {
-    ESP_LOGE(TAG, "Failed to allocate memory for response buffer");
-    return ESP_FAIL;
-  }
-
-  esp_http_client_config_t config = {
-      .url = "https://www.youtube.com/api/lounge/bc/bind",
-      .timeout_ms = 5000,
-      .crt_bundle_attach = esp_crt_bundle_attach,
-      .transport_type = HTTP_TRANSPORT_OVER_SSL,
-      .event_handler = _http_event_handler,
-      .user_data = &resp_buf,
-  };
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-
-  if (!client) {
-    ESP_LOGE(TAG, "Failed to initialize HTTP client.");
-    free(resp_buf.buffer);
-    return ESP_FAIL;
-  }
-
-  esp_http_client_set_method(client, HTTP_METHOD_POST);
-  esp_http_client_set_header(client, "Content-Type", "application/json");
-  esp_http_client_set_header(client, "Origin", "https://www.youtube.com");
-
-  size_t full_url_len = strlen(config.url) + 1 + strlen(url_params) + 1;
+  esp_err_t result = ESP_FAIL;
+  size_t full_url_len = strlen(YOUTUBE_BIND_URL) + 1 + strlen(url_params) + 1;
   char *full_url = malloc(full_url_len);
   if (!full_url) {
     ESP_LOGE(TAG, "Failed to allocate memory for full URL");
-    free(url_params);
-    esp_http_client_cleanup(client);
-    free(resp_buf.buffer);
-    free(encoded_loungeIdToken);
-    free(encoded_UUID);
-    free(encoded_zx);
-    free(encoded_name);
-    free(zx);
-    return ESP_ERR_NO_MEM;
+    result = ESP_ERR_NO_MEM;
+    goto cleanup;
   }
-  snprintf(full_url, full_url_len, "%s?%s", config.url, url_params);
-  esp_http_client_set_url(client, full_url);
+  snprintf(full_url, full_url_len, "%s?%s", YOUTUBE_BIND_URL, url_params);
 
   const char *json_data = "{\"count\": 0}";
-  esp_http_client_set_post_field(client, json_data, strlen(json_data));
-
   ESP_LOGI(TAG, "Request Body: %s", json_data);
 
-  esp_err_t err = esp_http_client_perform(client);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-    esp_http_client_cleanup(client);
-    free(resp_buf.buffer);
-    return err;
-  }
-
-  if (resp_buf.buffer_len < resp_buf.buffer_size) {
-    resp_buf.buffer[resp_buf.buffer_len] = '\0';
-  } else {
-    char *new_buffer = realloc(resp_buf.buffer, resp_buf.buffer_size + 1);
-    if (new_buffer == NULL) {
-      ESP_LOGE(TAG, "Failed to allocate memory for null terminator");
-      esp_http_client_cleanup(client);
-      free(resp_buf.buffer);
-      return ESP_FAIL;
-    }
-    resp_buf.buffer = new_buffer;
-    resp_buf.buffer[resp_buf.buffer_len] = '\0';
+  const char *response =
+      youtube_post(full_url, "application/json", json_data, true, NULL);
+  if (!response) {
+    goto cleanup;
   }
 
-  printf("Response: %s", resp_buf.buffer);
-
-  BindSession_Params_t result = parse_response(resp_buf.buffer);
+  printf("Response: %s", response);
 
-  char *gsession_item = result.gsessionid;
-  char *sid_item = result.sid;
-  char *lid_item = result.listId;
-
-  if (gsession_item && sid_item) {
-    strcpy(device->gsession, gsession_item);
-    strcpy(device->SID, sid_item);
-    if (lid_item && lid_item) {
-      strcpy(device->listID, lid_item);
+  BindSession_Params_t params = parse_response(response);
+  if (params.gsessionid && params.sid) {
+    strncpy(device->gsession, params.gsessionid, sizeof(device->gsession) - 1);
+    strncpy(device->SID, params.sid, sizeof(device->SID) - 1);
+    if (params.listId) {
+      strncpy(device->listID, params.listId, sizeof(device->listID) - 1);
     }
     ESP_LOGI(TAG, "Session bound successfully.");
+    result = ESP_OK;
   } else {
     ESP_LOGE(TAG, "Failed to bind session ID.");
-    esp_http_client_cleanup(client);
-    free(resp_buf.buffer);
-    return ESP_FAIL;
   }
+  free(params.gsessionid);
+  free(params.sid);
+  free(params.listId);
 
-  // Clean up
+cleanup:
   free(encoded_loungeIdToken);
   free(encoded_UUID);
   free(encoded_zx);
   free(encoded_name);
   free(zx);
-  esp_http_client_cleanup(client);
-  free(resp_buf.buffer);
   free(url_params);
   free(full_url);
-  return ESP_OK;
+  return result;
 }
 
 char *extract_token_from_json(const char *json_response) {
@@ -568,95 +556,36 @@ char *extract_token_from_json(const char *json_response) {
 }
 
 char *get_youtube_token(const char *screen_id) {
-  response_buffer_t resp_buf = {
-      .buffer = malloc(1024), .buffer_len = 0, .buffer_size = 1024};
-  if (resp_buf.buffer == NULL) {
-    ESP_LOGE(TAG, "Failed to allocate memory for response buffer");
-    return NULL;
-  }
-
-  // Configure HTTP client
-  esp_http_client_config_t config = {
-      .url =
-          "https://www.youtube.com/api/lounge/pairing/get_lounge_token_batch",
-      .crt_bundle_attach = esp_crt_bundle_attach,
-      .timeout_ms = 10000,
-      .method = HTTP_METHOD_POST,
-      .transport_type = HTTP_TRANSPORT_OVER_SSL,
-      .event_handler = _http_event_handler,
-      .user_data = &resp_buf,
-  };
-
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-  if (!client) {
-    ESP_LOGE(TAG, "Failed to initialize HTTP client.");
-    free(resp_buf.buffer);
-    return NULL;
-  }
-
   // Prepare POST data
   char post_data[128];
   snprintf(post_data, sizeof(post_data), "screen_ids=%s", screen_id);
 
-  // Set the POST data
-  esp_http_client_set_post_field(client, post_data, strlen(post_data));
-
-  // Set headers
-  esp_http_client_set_header(client, "Content-Type",
-                             "application/x-www-form-urlencoded");
-
-  // Perform the HTTP request
-  esp_err_t err = esp_http_client_perform(client);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-    esp_http_client_cleanup(client);
-    free(resp_buf.buffer);
+  int status_code = 0;
+  const char *response =
+      youtube_post(YOUTUBE_TOKEN_URL, "application/x-www-form-urlencoded",
+                   post_data, false, &status_code);
+  if (!response) {
     return NULL;
   }
 
-  // Get the HTTP status code
-  int status_code = esp_http_client_get_status_code(client);
   ESP_LOGI(TAG, "HTTP Response Code: %d", status_code);
   if (status_code != 200) {
     ESP_LOGE(TAG, "Failed to retrieve token. HTTP Response Code: %d",
              status_code);
-    esp_http_client_cleanup(client);
-    free(resp_buf.buffer);
     return NULL;
   }
 
-  if (resp_buf.buffer_len < resp_buf.buffer_size) {
-    resp_buf.buffer[resp_buf.buffer_len] = '\0';
-  } else {
-    // Reallocate buffer to add null terminator
-    char *new_buffer = realloc(resp_buf.buffer, resp_buf.buffer_size + 1);
-    if (new_buffer == NULL) {
-      ESP_LOGE(TAG, "Failed to allocate memory for null terminator");
-      esp_http_client_cleanup(client);
-      free(resp_buf.buffer);
-      return NULL;
-    }
-    resp_buf.buffer = new_buffer;
-    resp_buf.buffer[resp_buf.buffer_len] = '\0';
-  }
-
   // Log the raw API response
-  ESP_LOGI(TAG, "YouTube API raw response: %s", resp_buf.buffer);
+  ESP_LOGI(TAG, "YouTube API raw response: %s", response);
 
   // Extract the lounge token from the JSON response
-  char *lounge_token = extract_token_from_json(resp_buf.buffer);
+  char *lounge_token = extract_token_from_json(response);
   if (lounge_token) {
     ESP_LOGI(TAG, "Successfully retrieved loungeToken: %s", lounge_token);
   } else {
     ESP_LOGE(TAG, "Failed to parse JSON or retrieve loungeToken.");
   }
 
-  // Free the allocated memory
-  free(resp_buf.buffer);
-
-  // Clean up the HTTP client
-  esp_http_client_cleanup(client);
-
   // Return the lounge token (or NULL if extraction failed)
   return lounge_token;
 }
@@ -702,16 +631,209 @@ esp_err_t dial_manager_init(DIALManager *manager, DIALClient *client) {
   return ESP_OK;
 }
 
-bool fetch_screen_id_with_retries(const char *applicationUrl, Device *device,
-                                  DIALManager *manager) {
+#define DIAL_PROBE_WORKERS 3
+#define DIAL_PROBE_STACK 4096
+#define DIAL_HTTP_TIMEOUT_MS 5000
+#define DIAL_HTTP_BUFFER_SIZE 1524
+#define DIAL_APP_URL_LENGTH 256
+
+// A reusable client for the plain HTTP DIAL requests. Requests to the same
+// device share its connection.
+typedef struct {
+  esp_http_client_handle_t client;
+  char buffer[DIAL_HTTP_BUFFER_SIZE]; // Response body, cut to fit
+  int buffer_len;
+  char app_url[DIAL_APP_URL_LENGTH]; // Application-Url header, if any
+} dial_http_slot_t;
+
+static esp_err_t dial_slot_event_handler(esp_http_client_event_t *evt) {
+  dial_http_slot_t *slot = evt->user_data;
+  switch (evt->event_id) {
+  case HTTP_EVENT_ON_HEADER:
+    if (strcasecmp(evt->header_key, "Application-Url") == 0 &&
+        evt->header_value != NULL) {
+      strncpy(slot->app_url, evt->header_value, sizeof(slot->app_url) - 1);
+      slot->app_url[sizeof(slot->app_url) - 1] = '\0';
+    }
+    break;
+  case HTTP_EVENT_ON_DATA: {
+    int room = (int)sizeof(slot->buffer) - 1 - slot->buffer_len;
+    int len = evt->data_len < room ? evt->data_len : room;
+    memcpy(slot->buffer + slot->buffer_len, evt->data, len);
+    slot->buffer_len += len;
+    slot->buffer[slot->buffer_len] = '\0';
+    break;
+  }
+  default:
+    break;
+  }
+  return ESP_OK;
+}
+
+// Runs one request on the slot's client, created on first use
+static esp_err_t dial_slot_request(dial_http_slot_t *slot, const char *url,
+                                   esp_http_client_method_t method,
+                                   int *status_code) {
+  slot->buffer_len = 0;
+  slot->buffer[0] = '\0';
+  slot->app_url[0] = '\0';
+
+  if (!slot->client) {
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = DIAL_HTTP_TIMEOUT_MS,
+        .event_handler = dial_slot_event_handler,
+        .user_data = slot,
+    };
+    slot->client = esp_http_client_init(&config);
+    if (!slot->client) {
+      ESP_LOGE(TAG, "Failed to initialize HTTP client");
+      return ESP_ERR_NO_MEM;
+    }
+    esp_http_client_set_header(slot->client, "Origin",
+                               "https://www.youtube.com");
+    esp_http_client_set_header(
+        slot->client, "User-Agent",
+        "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, "
+        "like Gecko) Chrome/96.0.4664.45 Safari/537.36");
+  } else if (esp_http_client_set_url(slot->client, url) != ESP_OK) {
+    ESP_LOGE(TAG, "Invalid URL %s", url);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_http_client_set_method(slot->client, method);
+  esp_err_t err = esp_http_client_perform(slot->client);
+  if (err != ESP_OK) {
+    esp_http_client_close(slot->client);
+    return err;
+  }
+  *status_code = esp_http_client_get_status_code(slot->client);
+  return ESP_OK;
+}
+
+// Drops the connection before the slot moves on to another device
+static void dial_slot_close(dial_http_slot_t *slot) {
+  if (slot->client) {
+    esp_http_client_close(slot->client);
+  }
+}
+
+static void dial_slot_cleanup(dial_http_slot_t *slot) {
+  if (slot->client) {
+    esp_http_client_cleanup(slot->client);
+    slot->client = NULL;
+  }
+}
+
+// Fetches the device description, leaving its Application-Url in
+// slot->app_url
+static bool dial_fetch_application_url(dial_http_slot_t *slot,
+                                       const char *location_url) {
+  ESP_LOGI(TAG, "Fetching device description: %s", location_url);
+
+  int status_code = 0;
+  esp_err_t err =
+      dial_slot_request(slot, location_url, HTTP_METHOD_GET, &status_code);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+    return false;
+  }
+
+  ESP_LOGI(TAG, "HTTP Status Code: %d", status_code);
+  if (status_code != 200) {
+    ESP_LOGE(TAG, "Failed to fetch device description. HTTP Status Code: %d",
+             status_code);
+    return false;
+  }
+
+  if (slot->app_url[0] == '\0') {
+    ESP_LOGE(TAG, "Couldn't find 'Application-Url' in the headers.");
+    return false;
+  }
+  ESP_LOGI(TAG, "Application-Url: %s", slot->app_url);
+  return true;
+}
+
+static esp_err_t dial_check_app_status(dial_http_slot_t *slot,
+                                       DIALAppType app, const char *appUrl,
+                                       Device *device) {
+  char url[DIAL_APP_URL_LENGTH + 16];
+  snprintf(url, sizeof(url), "%s%s", appUrl, get_app_path(app));
+  ESP_LOGI(TAG, "Checking app status: %s", url);
+
+  int status_code = 0;
+  esp_err_t err = dial_slot_request(slot, url, HTTP_METHOD_GET, &status_code);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  ESP_LOGI(TAG, "HTTP status code: %d", status_code);
+  if (status_code != 200) {
+    ESP_LOGE("DIALManager", "Unexpected HTTP status code: %d", status_code);
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(TAG, "Response Body:\n%s", slot->buffer);
+
+  // Check if app is running
+  if (!strstr(slot->buffer, "<state>running</state>")) {
+    ESP_LOGW("DIALManager", "%s app is not running",
+             (app == APP_YOUTUBE) ? "YouTube" : "Netflix");
+    return ESP_ERR_NOT_FOUND;
+  }
+  ESP_LOGI("DIALManager", "%s app is running",
+           (app == APP_YOUTUBE) ? "YouTube" : "Netflix");
+
+  // Extract screenId from the response
+  char *screen_id = extract_screen_id(slot->buffer);
+  if (!screen_id) {
+    return ESP_FAIL;
+  }
+  strncpy(device->screenID, screen_id, sizeof(device->screenID) - 1);
+  device->screenID[sizeof(device->screenID) - 1] = '\0';
+  free(screen_id);
+  return ESP_OK;
+}
+
+static bool dial_launch_app(dial_http_slot_t *slot, DIALAppType app,
+                            const char *appUrl) {
+  char url[DIAL_APP_URL_LENGTH + 16];
+  snprintf(url, sizeof(url), "%s%s", appUrl, get_app_path(app));
+
+  ESP_LOGI(TAG, "Launching app: %s at %s",
+           (app == APP_YOUTUBE) ? "YouTube" : "Netflix", url);
+
+  int status_code = 0;
+  esp_err_t err = dial_slot_request(slot, url, HTTP_METHOD_POST, &status_code);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to send the launch request. Error: %s",
+             esp_err_to_name(err));
+    return false;
+  }
+  if (status_code != 201 && status_code != 200) {
+    ESP_LOGE(TAG, "Failed to launch the app. HTTP Response Code: %d",
+             status_code);
+    return false;
+  }
+  ESP_LOGI(TAG, "Successfully launched the app: %s",
+           (app == APP_YOUTUBE) ? "YouTube" : "Netflix");
+  return true;
+}
+
+static bool fetch_screen_id_with_retries(dial_http_slot_t *slot,
+                                         const char *applicationUrl,
+                                         Device *device) {
   const int max_retries = 5;       // Max retries (approx. 15 seconds total)
   const int retry_delay_ms = 3000; // 3 seconds delay between retries
 
   for (int i = 0; i < max_retries; i++) {
+    // The probe already has it when the app was running
+    if (device->screenID[0] == '\0') {
+      dial_check_app_status(slot, APP_YOUTUBE, applicationUrl, device);
+    }
 
-    if (check_app_status(manager, APP_YOUTUBE, applicationUrl, device) ==
-            ESP_OK &&
-        strlen(device->screenID) > 0) {
+    if (device->screenID[0] != '\0') {
       ESP_LOGI(TAG, "Fetched Screen ID: %s", device->screenID);
 
       char *youtube_token = get_youtube_token(device->screenID);
@@ -744,89 +866,18 @@ bool fetch_screen_id_with_retries(const char *applicationUrl, Device *device,
   return false;
 }
 
-char *g_app_url = NULL;
-
-esp_err_t _http_event_header_handler(esp_http_client_event_t *evt) {
-  switch (evt->event_id) {
-  case HTTP_EVENT_ON_HEADER:
-    ESP_LOGI(TAG, "Header: %s: %s", evt->header_key, evt->header_value);
-    if (strcasecmp(evt->header_key, "Application-Url") == 0) {
-      if (evt->header_value != NULL) {
-        g_app_url = strdup(evt->header_value);
-      }
-    }
-    break;
-  default:
-    break;
-  }
-  return ESP_OK;
-}
-
 char *get_dial_application_url(const char *location_url) {
-  char ip[64];
-  uint16_t port = 0;
-
-  if (extract_ip_and_port(location_url, ip, &port) != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to extract IP and port from URL");
-    return NULL;
-  }
-
-  char *path = extract_path_from_url(location_url);
-  if (!path) {
-    ESP_LOGE(TAG, "Failed to extract path from URL");
-    return NULL;
-  }
-
-  ESP_LOGI(TAG, "Connecting to IP: %s, Port: %u, Path: %s", ip, port, path);
-
-  esp_http_client_config_t config = {
-      .host = ip,
-      .port = port,
-      .path = path,
-      .timeout_ms = 5000,
-      .event_handler = _http_event_header_handler, // Set the event handler
-  };
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-
-  if (!client) {
-    ESP_LOGE(TAG, "Failed to initialize HTTP client");
-    free(path);
-    return NULL;
-  }
-
-  esp_err_t err = esp_http_client_perform(client);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
-    esp_http_client_cleanup(client);
-    free(path);
-    return NULL;
-  }
-
-  int status_code = esp_http_client_get_status_code(client);
-  ESP_LOGI(TAG, "HTTP Status Code: %d", status_code);
-  if (status_code != 200) {
-    ESP_LOGE(TAG, "Failed to fetch device description. HTTP Status Code: %d",
-             status_code);
-    esp_http_client_cleanup(client);
-    free(path);
+  dial_http_slot_t *slot = calloc(1, sizeof(*slot));
+  if (!slot) {
+    ESP_LOGE(TAG, "Failed to allocate HTTP client buffers");
     return NULL;
   }
-
-  if (g_app_url != NULL) {
-    ESP_LOGI(TAG, "Application-Url: %s", g_app_url);
-    char *app_url_copy = strdup(g_app_url);
-    free(g_app_url);
-    g_app_url = NULL;
-    esp_http_client_cleanup(client);
-    free(path);
-    return app_url_copy;
-  } else {
-    ESP_LOGE(TAG, "Couldn't find 'Application-Url' in the headers.");
-  }
-
-  esp_http_client_cleanup(client);
-  free(path);
-  return NULL;
+  char *app_url = dial_fetch_application_url(slot, location_url)
+                      ? strdup(slot->app_url)
+                      : NULL;
+  dial_slot_cleanup(slot);
+  free(slot);
+  return app_url;
 }
 
 // Helper to extract IP and port from URL
@@ -866,21 +917,6 @@ const char *get_app_path(DIALAppType app) {
   }
 }
 
-char *remove_ip_and_port(const char *url) {
-  const char *path_start = strchr(url, '/');
-  if (path_start) {
-    if (strncmp(path_start, "//", 2) == 0) {
-      path_start = strchr(path_start + 2, '/');
-    }
-  }
-
-  if (path_start) {
-    return strdup(path_start);
-  }
-
-  return NULL;
-}
-
 // Check the app status by communicating with the device
 esp_err_t check_app_status(DIALManager *manager, DIALAppType app,
                            const char *appUrl, Device *device) {
@@ -888,99 +924,14 @@ esp_err_t check_app_status(DIALManager *manager, DIALAppType app,
     return ESP_ERR_INVALID_ARG;
   }
 
-  char ip[64];
-  uint16_t port = 0;
-  if (extract_ip_and_port(appUrl, ip, &port) != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to extract IP and port from URL");
-    return ESP_ERR_INVALID_ARG;
-  }
-
-  const char *app_path = get_app_path(app);
-  char full_path[256];
-  snprintf(full_path, sizeof(full_path), "%s%s", appUrl, app_path);
-
-  ESP_LOGI(TAG, "Connecting to IP: %s, Port: %u, Path: %s", ip, port, app_path);
-
-  char *path = remove_ip_and_port(full_path);
-
-  esp_http_client_config_t config = {
-      .host = ip, .port = port, .path = path, .timeout_ms = 5000};
-  esp_http_client_handle_t http_client = esp_http_client_init(&config);
-  if (http_client == NULL) {
-    ESP_LOGE(TAG, "Failed to initialize HTTP client");
+  dial_http_slot_t *slot = calloc(1, sizeof(*slot));
+  if (!slot) {
     return ESP_ERR_NO_MEM;
   }
-
-  esp_http_client_set_header(http_client, "Origin", "https://www.youtube.com");
-  esp_http_client_set_header(
-      http_client, "User-Agent",
-      "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, "
-      "like Gecko) Chrome/96.0.4664.45 Safari/537.36");
-  esp_http_client_set_header(http_client, "Content-Type",
-                             "application/x-www-form-urlencoded");
-
-  // Open the connection manually
-  esp_err_t err =
-      esp_http_client_open(http_client, 0); // 0 means no request body
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-    esp_http_client_cleanup(http_client);
-    return err;
-  }
-
-  // Check if we got any headers back
-  int status_code = esp_http_client_fetch_headers(http_client);
-  if (status_code < 0) {
-    ESP_LOGE(TAG, "Failed to fetch HTTP headers");
-    esp_http_client_cleanup(http_client);
-    return ESP_FAIL;
-  }
-
-  // Log HTTP status code
-  status_code = esp_http_client_get_status_code(http_client);
-  ESP_LOGI(TAG, "HTTP status code: %d", status_code);
-
-  if (status_code == 200) {
-    char response_body[1024];
-    int content_len = esp_http_client_read(http_client, response_body,
-                                           sizeof(response_body) - 1);
-    if (content_len >= 0) {
-      response_body[content_len] = '\0'; // Null-terminate the response body
-
-      ESP_LOGI(TAG, "Response Body:\n%s", response_body);
-
-      // Check if app is running
-      if (strstr(response_body, "<state>running</state>")) {
-        ESP_LOGI("DIALManager", "%s app is running",
-                 (app == APP_YOUTUBE) ? "YouTube" : "Netflix");
-
-        // Extract screenId from the response
-        char *screen_id = extract_screen_id(response_body);
-        if (screen_id) {
-          strncpy(device->screenID, screen_id,
-                  sizeof(device->screenID) - 1); // Store in device
-          free(screen_id);                       // Free allocated memory
-          esp_http_client_cleanup(http_client);
-          return ESP_OK;
-        }
-        esp_http_client_cleanup(http_client);
-        return ESP_FAIL;
-      } else {
-        ESP_LOGW("DIALManager", "%s app is not running",
-                 (app == APP_YOUTUBE) ? "YouTube" : "Netflix");
-        esp_http_client_cleanup(http_client);
-        return ESP_ERR_NOT_FOUND;
-      }
-    } else {
-      ESP_LOGE(TAG, "Failed to read HTTP response body");
-      esp_http_client_cleanup(http_client);
-      return ESP_FAIL;
-    }
-  } else {
-    ESP_LOGE("DIALManager", "Unexpected HTTP status code: %d", status_code);
-    esp_http_client_cleanup(http_client);
-    return ESP_FAIL;
-  }
+  esp_err_t err = dial_check_app_status(slot, app, appUrl, device);
+  dial_slot_cleanup(slot);
+  free(slot);
+  return err;
 }
 
 bool launch_app(DIALManager *manager, DIALAppType app, const char *appUrl) {
@@ -988,52 +939,14 @@ bool launch_app(DIALManager *manager, DIALAppType app, const char *appUrl) {
     return false;
   }
 
-  char ip[64];
-  uint16_t port = 0;
-  if (extract_ip_and_port(appUrl, ip, &port) != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to extract IP and port from URL");
+  dial_http_slot_t *slot = calloc(1, sizeof(*slot));
+  if (!slot) {
     return false;
   }
-
-  const char *app_path = get_app_path(app);
-  char full_path[256];
-  snprintf(full_path, sizeof(full_path), "%s%s", appUrl, app_path);
-
-  ESP_LOGI(TAG, "Launching app: %s at IP: %s, Port: %u, Path: %s",
-           (app == APP_YOUTUBE) ? "YouTube" : "Netflix", ip, port, full_path);
-
-  char *path = remove_ip_and_port(full_path);
-
-  esp_http_client_config_t config = {
-      .host = ip,
-      .port = port,
-      .path = path,
-      .method = HTTP_METHOD_POST,
-      .timeout_ms = 5000,
-  };
-  esp_http_client_handle_t http_client = esp_http_client_init(&config);
-
-  esp_http_client_set_header(http_client, "Origin", "https://www.youtube.com");
-
-  esp_err_t err = esp_http_client_perform(http_client);
-  if (err == ESP_OK) {
-    int status_code = esp_http_client_get_status_code(http_client);
-    if (status_code == 201 || status_code == 200) {
-      ESP_LOGI(TAG, "Successfully launched the app: %s",
-               (app == APP_YOUTUBE) ? "YouTube" : "Netflix");
-      esp_http_client_cleanup(http_client);
-      return true;
-    } else {
-      ESP_LOGE(TAG, "Failed to launch the app. HTTP Response Code: %d",
-               status_code);
-    }
-  } else {
-    ESP_LOGE(TAG, "Failed to send the launch request. Error: %s",
-             esp_err_to_name(err));
-  }
-
-  esp_http_client_cleanup(http_client);
-  return false;
+  bool launched = dial_launch_app(slot, app, appUrl);
+  dial_slot_cleanup(slot);
+  free(slot);
+  return launched;
 }
 
 const char *pick_random_yt_video() {
@@ -1054,78 +967,194 @@ const char *pick_random_yt_video() {
   return yt_urls[random_index];
 }
 
-void explore_network(DIALManager *manager) {
-  printf("\n[*] Starting network exploration...\n");
-
-  for (int attempt = 0; attempt < 5; ++attempt) {
-    Device *devices = (Device *)malloc(sizeof(Device) * 10);
-    size_t device_count = 0;
+typedef enum {
+  PROBE_NO_APP_URL,
+  PROBE_APP_RUNNING,
+  PROBE_APP_LAUNCHED,
+  PROBE_LAUNCH_FAILED,
+} dial_probe_state_t;
 
-    printf("\n[+] Scan attempt %d/5\n", attempt + 1);
-    printf("    Discovering DIAL-enabled devices...\n");
+typedef struct dial_probe_job dial_probe_job_t;
 
-    ESP_LOGI(TAG, "Discovering devices... (Attempt %d/%d)", attempt + 1, 5);
-    if (dial_client_discover_devices(manager->client, devices, 10,
-                                     &device_count) != ESP_OK ||
-        device_count == 0) {
-      ESP_LOGW(TAG, "No devices discovered. Retrying...");
-      printf("    [-] No devices found. Retrying...\n");
-      vTaskDelay(500 / portTICK_PERIOD_MS);
-      continue;
+typedef struct {
+  dial_probe_job_t *job;
+  dial_http_slot_t slot;
+} dial_probe_worker_t;
+
+// Devices found by one explore_network run and the workers probing them
+struct dial_probe_job {
+  Device devices[DIAL_MAX_DEVICES];
+  size_t device_count;
+  char app_urls[DIAL_MAX_DEVICES][DIAL_APP_URL_LENGTH];
+  dial_probe_state_t states[DIAL_MAX_DEVICES];
+  dial_probe_worker_t workers[DIAL_PROBE_WORKERS];
+  size_t next_device; // Next one to probe, under lock
+  SemaphoreHandle_t lock;
+  SemaphoreHandle_t done; // Given by each worker task as it exits
+};
+
+// Reads the description and YouTube state of one device, launching the app
+// when it is not running
+static void probe_device(dial_probe_worker_t *worker, size_t index) {
+  dial_probe_job_t *job = worker->job;
+  Device *device = &job->devices[index];
+  dial_http_slot_t *slot = &worker->slot;
+
+  ESP_LOGI(TAG, "Probing device: %s (Location: %s)", device->uniqueServiceName,
+           device->location);
+  if (!dial_fetch_application_url(slot, device->location)) {
+    job->states[index] = PROBE_NO_APP_URL;
+  } else {
+    strcpy(job->app_urls[index], slot->app_url);
+    if (dial_check_app_status(slot, APP_YOUTUBE, job->app_urls[index],
+                              device) == ESP_OK) {
+      job->states[index] = PROBE_APP_RUNNING;
+    } else if (dial_launch_app(slot, APP_YOUTUBE, job->app_urls[index])) {
+      job->states[index] = PROBE_APP_LAUNCHED;
+    } else {
+      job->states[index] = PROBE_LAUNCH_FAILED;
     }
+  }
+  dial_slot_close(slot);
+}
 
-    printf("    [+] Found %d device(s)!\n", device_count);
+static void probe_worker_run(dial_probe_worker_t *worker) {
+  dial_probe_job_t *job = worker->job;
+  for (;;) {
+    xSemaphoreTake(job->lock, portMAX_DELAY);
+    size_t index = job->next_device++;
+    xSemaphoreGive(job->lock);
+    if (index >= job->device_count) {
+      return;
+    }
+    probe_device(worker, index);
+  }
+}
 
-    for (size_t i = 0; i < device_count; ++i) {
-      Device *device = &devices[i];
-      ESP_LOGI(TAG, "Discovered Device: %s (Location: %s)",
-               device->uniqueServiceName, device->location);
+static void probe_worker_task(void *arg) {
+  dial_probe_worker_t *worker = arg;
+  probe_worker_run(worker);
+  xSemaphoreGive(worker->job->done);
+  vTaskDelete(NULL);
+}
 
-      char *appUrl = get_dial_application_url(device->location);
-      if (appUrl == NULL) {
-        printf("    [-] Failed to get application URL\n");
-        continue;
-      }
-      printf("    [+] Got application URL\n");
-
-      if (check_app_status(manager, APP_YOUTUBE, appUrl, device) != ESP_OK) {
-        printf("    [*] YouTube app not running, attempting launch...\n");
-        ESP_LOGI(TAG, "YouTube app is not running. Launching the app...");
-        if (!launch_app(manager, APP_YOUTUBE, appUrl)) {
-          ESP_LOGE(TAG, "Failed to launch YouTube app.");
-          printf("    [-] Failed to launch YouTube app\n");
-          continue;
-        }
-        printf("    [+] YouTube app launched successfully\n");
-      } else {
-        printf("    [+] YouTube app already running\n");
+// Probes all devices at once, the calling task being one of the workers.
+// Falls back to fewer workers when tasks can't be created.
+static void probe_devices(dial_probe_job_t *job) {
+  int started = 0;
+  job->next_device = 0;
+  job->lock = xSemaphoreCreateMutex();
+  job->done = xSemaphoreCreateCounting(DIAL_PROBE_WORKERS, 0);
+  for (int i = 0; i < DIAL_PROBE_WORKERS; i++) {
+    job->workers[i].job = job;
+  }
+
+  if (job->lock && job->done) {
+    for (int i = 1; i < DIAL_PROBE_WORKERS && (size_t)i < job->device_count;
+         i++) {
+      char name[16];
+      snprintf(name, sizeof(name), "dial_probe%d", i);
+      if (!system_manager_create_task(probe_worker_task, name,
+                                      DIAL_PROBE_STACK, &job->workers[i], 5,
+                                      NULL, NULL)) {
+        break;
       }
+      started++;
+    }
+    probe_worker_run(&job->workers[0]);
+    for (int i = 0; i < started; i++) {
+      xSemaphoreTake(job->done, portMAX_DELAY);
+    }
+  } else {
+    for (size_t i = 0; i < job->device_count; i++) {
+      probe_device(&job->workers[0], i);
+    }
+  }
 
-      printf("    [*] Fetching screen ID...\n");
-      if (!fetch_screen_id_with_retries(appUrl, device, manager)) {
-        ESP_LOGE(TAG, "Failed to fetch Screen ID.");
-        printf("    [-] Failed to fetch screen ID\n");
-        continue;
-      }
-      printf("    [+] Got screen ID: %s\n", device->screenID);
+  if (job->lock) {
+    vSemaphoreDelete(job->lock);
+  }
+  if (job->done) {
+    vSemaphoreDelete(job->done);
+  }
+}
 
-      const char *yt_url = pick_random_yt_video();
-      printf("    [*] Selected video ID: %s\n", yt_url);
+void explore_network(DIALManager *manager) {
+  printf("\n[*] Starting network exploration...\n");
+  printf("    Discovering DIAL-enabled devices...\n");
+
+  dial_probe_job_t *job = calloc(1, sizeof(*job));
+  if (!job) {
+    ESP_LOGE(TAG, "Failed to allocate memory for devices");
+    printf("    [-] Out of memory\n");
+    return;
+  }
+
+  if (dial_client_discover_devices(manager->client, job->devices,
+                                   DIAL_MAX_DEVICES,
+                                   &job->device_count) != ESP_OK) {
+    ESP_LOGW(TAG, "No devices discovered.");
+    printf("    [-] No devices found.\n");
+    free(job);
+    return;
+  }
+
+  printf("    [+] Found %d device(s)!\n", (int)job->device_count);
+  printf("    [*] Probing devices...\n");
+  probe_devices(job);
+
+  // The lounge calls take a TLS session each, so they stay one at a time
+  dial_http_slot_t *slot = &job->workers[0].slot;
+  for (size_t i = 0; i < job->device_count; ++i) {
+    Device *device = &job->devices[i];
+    const char *appUrl = job->app_urls[i];
+    printf("\n    Device: %s\n", device->location);
+
+    switch (job->states[i]) {
+    case PROBE_NO_APP_URL:
+      printf("    [-] Failed to get application URL\n");
+      continue;
+    case PROBE_LAUNCH_FAILED:
+      ESP_LOGE(TAG, "Failed to launch YouTube app.");
+      printf("    [-] Failed to launch YouTube app\n");
+      continue;
+    case PROBE_APP_LAUNCHED:
+      printf("    [+] YouTube app launched successfully\n");
+      break;
+    case PROBE_APP_RUNNING:
+      printf("    [+] YouTube app already running\n");
+      break;
+    }
 
-      printf("    [*] Sending video command...\n");
-      if (send_command("setVideo", yt_url, device) == ESP_OK) {
-        ESP_LOGI(TAG, "YouTube video command sent successfully.");
-        printf("    [+] Video command sent successfully!\n");
-      } else {
-        ESP_LOGE(TAG, "Failed to send YouTube command.");
-        printf("    [-] Failed to send video command\n");
-      }
+    printf("    [*] Fetching screen ID...\n");
+    if (!fetch_screen_id_with_retries(slot, appUrl, device)) {
+      ESP_LOGE(TAG, "Failed to fetch Screen ID.");
+      printf("    [-] Failed to fetch screen ID\n");
+      dial_slot_close(slot);
+      continue;
     }
+    dial_slot_close(slot);
+    printf("    [+] Got screen ID: %s\n", device->screenID);
 
-    free(devices);
-    printf("\n[+] Network exploration complete!\n\n");
-    break;
+    const char *yt_url = pick_random_yt_video();
+    printf("    [*] Selected video ID: %s\n", yt_url);
+
+    printf("    [*] Sending video command...\n");
+    if (send_command("setVideo", yt_url, device) == ESP_OK) {
+      ESP_LOGI(TAG, "YouTube video command sent successfully.");
+      printf("    [+] Video command sent successfully!\n");
+    } else {
+      ESP_LOGE(TAG, "Failed to send YouTube command.");
+      printf("    [-] Failed to send video command\n");
+    }
+  }
+
+  youtube_close();
+  for (int i = 0; i < DIAL_PROBE_WORKERS; i++) {
+    dial_slot_cleanup(&job->workers[i].slot);
   }
+  free(job);
+  printf("\n[+] Network exploration complete!\n\n");
 }
 
 #pragma GCC diagnostic pop
@@ -1,4 +1,5 @@
 #include "managers/display_manager.h"
+#include "core/system_manager.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
@@ -13,6 +14,7 @@
 #include "managers/views/terminal_screen.h"
 #include "managers/views/clock_screen.h"
 #include <stdlib.h>
+#include <string.h>
 #include "esp_wifi.h"
 #include "esp_pm.h"
 
@@ -371,6 +373,190 @@ void display_manager_add_status_bar(const char *CurrentMenuName) {
   }
 }
 
+// Render instrumentation. Every invalidation passes through the driver's
+// rounder, which keeps the dirty area list from overflowing, and the refresh
+// timer is routed through render_refr_timer_cb, which joins the areas left
+// before LVGL renders them.
+static display_render_stats_t render_stats;
+static bool render_trace = false;
+static lv_disp_t *render_disp = NULL;
+
+static void render_monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px) {
+  render_stats.frames++;
+  render_stats.px_rendered += px;
+  render_stats.render_ms += time;
+}
+
+// LVGL only joins areas that overlap, so widgets updated side by side (the
+// visualizer bars, a label next to its icon) are flushed one by one. Join
+// any two whose bounding box wastes at most DISPLAY_MERGE_SLACK_PX pixels.
+static uint32_t render_merge_areas(lv_disp_t *disp) {
+  uint32_t merged = 0;
+  bool joined = true;
+  while (joined) {
+    joined = false;
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+      if (disp->inv_area_joined[i]) {
+        continue;
+      }
+      for (uint16_t j = i + 1; j < disp->inv_p; j++) {
+        if (disp->inv_area_joined[j]) {
+          continue;
+        }
+        lv_area_t box;
+        _lv_area_join(&box, &disp->inv_areas[i], &disp->inv_areas[j]);
+        if (lv_area_get_size(&box) <=
+            lv_area_get_size(&disp->inv_areas[i]) +
+                lv_area_get_size(&disp->inv_areas[j]) +
+                DISPLAY_MERGE_SLACK_PX) {
+          disp->inv_areas[i] = box;
+          disp->inv_area_joined[j] = 1;
+          merged++;
+          joined = true;
+        }
+      }
+    }
+  }
+  return merged;
+}
+
+// Drops the joined areas so new ones can be queued
+static void render_compact_areas(lv_disp_t *disp) {
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < disp->inv_p; i++) {
+    if (!disp->inv_area_joined[i]) {
+      disp->inv_areas[n++] = disp->inv_areas[i];
+    }
+  }
+  memset(disp->inv_area_joined, 0, sizeof(disp->inv_area_joined));
+  disp->inv_p = n;
+}
+
+// LVGL repaints the whole screen once more than LV_INV_BUF_SIZE areas are
+// queued, which the visualizer does on most frames. Called for every new
+// area, it makes room first by joining what is already queued, cheapest
+// pair first if the slack join is not enough.
+static void render_rounder_cb(lv_disp_drv_t *drv, lv_area_t *area) {
+  lv_disp_t *disp = render_disp;
+  // Also called while rendering to size the draw buffer, leave the list be
+  if (disp == NULL || disp->rendering_in_progress) {
+    return;
+  }
+  render_stats.areas++;
+  if (disp->inv_p < LV_INV_BUF_SIZE - 1) {
+    return;
+  }
+
+  render_stats.merged += render_merge_areas(disp);
+  render_compact_areas(disp);
+  while (disp->inv_p >= LV_INV_BUF_SIZE - 1) {
+    uint16_t best_i = 0;
+    uint16_t best_j = 1;
+    int32_t best_waste = INT32_MAX;
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+      for (uint16_t j = i + 1; j < disp->inv_p; j++) {
+        lv_area_t box;
+        _lv_area_join(&box, &disp->inv_areas[i], &disp->inv_areas[j]);
+        int32_t waste = (int32_t)lv_area_get_size(&box) -
+                        (int32_t)lv_area_get_size(&disp->inv_areas[i]) -
+                        (int32_t)lv_area_get_size(&disp->inv_areas[j]);
+        if (waste < best_waste) {
+          best_waste = waste;
+          best_i = i;
+          best_j = j;
+        }
+      }
+    }
+    _lv_area_join(&disp->inv_areas[best_i], &disp->inv_areas[best_i],
+                  &disp->inv_areas[best_j]);
+    disp->inv_area_joined[best_j] = 1;
+    render_compact_areas(disp);
+    render_stats.merged++;
+  }
+}
+
+static void render_refr_timer_cb(lv_timer_t *timer) {
+  lv_disp_t *disp = timer->user_data;
+
+  // Layout changes invalidate too, settle them before looking at the areas
+  if (disp->act_scr != NULL) {
+    lv_obj_update_layout(disp->act_scr);
+    if (disp->prev_scr) {
+      lv_obj_update_layout(disp->prev_scr);
+    }
+    lv_obj_update_layout(disp->top_layer);
+    lv_obj_update_layout(disp->sys_layer);
+
+    render_stats.merged += render_merge_areas(disp);
+    if (render_trace && disp->inv_p > 0) {
+      // Serial only, adding to the terminal view would invalidate it again
+      printf("frame %lu:", (unsigned long)render_stats.frames);
+      for (uint16_t i = 0; i < disp->inv_p; i++) {
+        const lv_area_t *a = &disp->inv_areas[i];
+        if (!disp->inv_area_joined[i]) {
+          printf(" %d,%d %dx%d", a->x1, a->y1, lv_area_get_width(a),
+                 lv_area_get_height(a));
+        }
+      }
+      printf("\n");
+    }
+  }
+
+  _lv_disp_refr_timer(timer);
+}
+
+static void render_hook_init(void) {
+  lv_disp_t *disp = lv_disp_get_default();
+  if (disp == NULL || disp->refr_timer == NULL) {
+    ESP_LOGW(TAG, "No display to instrument");
+    return;
+  }
+  render_disp = disp;
+  if (disp->driver->monitor_cb == NULL) {
+    disp->driver->monitor_cb = render_monitor_cb;
+  }
+  // Full refresh drivers redraw everything anyway
+  if (disp->driver->rounder_cb == NULL && !disp->driver->full_refresh) {
+    disp->driver->rounder_cb = render_rounder_cb;
+  }
+  disp->refr_timer->timer_cb = render_refr_timer_cb;
+  display_manager_reset_render_stats();
+}
+
+void display_manager_get_render_stats(display_render_stats_t *stats) {
+  *stats = render_stats;
+}
+
+void display_manager_reset_render_stats(void) {
+  memset(&render_stats, 0, sizeof(render_stats));
+  render_stats.since_ms = lv_tick_get();
+}
+
+void display_manager_set_render_trace(bool enabled) { render_trace = enabled; }
+
+void display_manager_print_render_stats(void) {
+  display_render_stats_t stats = render_stats;
+  uint32_t elapsed_ms = lv_tick_elaps(stats.since_ms);
+  uint32_t secs = elapsed_ms / 1000 ? elapsed_ms / 1000 : 1;
+  char line[96];
+
+  snprintf(line, sizeof(line), "Render: %lu frames in %lu s, %lu ms drawing\n",
+           (unsigned long)stats.frames, (unsigned long)(elapsed_ms / 1000),
+           (unsigned long)stats.render_ms);
+  printf("%s", line);
+  TERMINAL_VIEW_ADD_TEXT(line);
+  snprintf(line, sizeof(line), "Areas: %lu invalidated, %lu merged\n",
+           (unsigned long)stats.areas, (unsigned long)stats.merged);
+  printf("%s", line);
+  TERMINAL_VIEW_ADD_TEXT(line);
+  snprintf(line, sizeof(line), "Pixels: %lu/s, %lu/frame\n",
+           (unsigned long)(stats.px_rendered / secs),
+           (unsigned long)(stats.frames ? stats.px_rendered / stats.frames
+                                        : 0));
+  printf("%s", line);
+  TERMINAL_VIEW_ADD_TEXT(line);
+}
+
 void display_manager_init(void) {
   esp_pm_config_esp32_t pm_cfg = {
       .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
@@ -469,14 +655,23 @@ void display_manager_init(void) {
 #endif
 #endif
 
+#ifdef CONFIG_JC3248W535EN_LCD
+  bsp_display_lock(0);
+  render_hook_init();
+  bsp_display_unlock();
+#else
+  render_hook_init();
+#endif
+
   display_manager_init_success = true;
 
 #ifndef CONFIG_JC3248W535EN_LCD // JC3248W535EN has its own lvgl task
-xTaskCreate(lvgl_tick_task, "LVGL Tick Task", 4096, NULL,
-            RENDERING_TASK_PRIORITY, &lvgl_task_handle);
+system_manager_create_task(lvgl_tick_task, "LVGL Tick Task", 4096, NULL,
+                           RENDERING_TASK_PRIORITY, &lvgl_task_handle, NULL);
 #endif
-if (xTaskCreate(hardware_input_task, "RawInput", 2048, NULL,
-                HARDWARE_INPUT_TASK_PRIORITY, &input_task_handle) != pdPASS) {
+if (!system_manager_create_task(hardware_input_task, "RawInput", 2048, NULL,
+                                HARDWARE_INPUT_TASK_PRIORITY, &input_task_handle,
+                                NULL)) {
     printf("Failed to create RawInput task\n");
 }
 }
@@ -545,12 +740,17 @@ void display_manager_destroy_current_view(void) {
 View *display_manager_get_current_view(void) { return dm.current_view; }
 
 void display_manager_fill_screen(lv_color_t color) {
-  static lv_style_t style;
-  lv_style_init(&style);
-  lv_style_set_bg_color(&style, color);
-  lv_style_set_bg_opa(&style, LV_OPA_COVER);
-  lv_obj_set_scrollbar_mode(lv_scr_act(), LV_SCROLLBAR_MODE_OFF);
-  lv_obj_add_style(lv_scr_act(), &style, LV_PART_MAIN | LV_STATE_DEFAULT);
+  lv_obj_t *scr = lv_scr_act();
+  lv_obj_set_scrollbar_mode(scr, LV_SCROLLBAR_MODE_OFF);
+  // Every view sets this on create, and each style change repaints the
+  // whole screen. Only touch it when the background actually changes.
+  if (lv_obj_get_style_bg_opa(scr, LV_PART_MAIN) == LV_OPA_COVER &&
+      lv_color_to32(lv_obj_get_style_bg_color(scr, LV_PART_MAIN)) ==
+          lv_color_to32(color)) {
+    return;
+  }
+  lv_obj_set_style_bg_color(scr, color, LV_PART_MAIN);
+  lv_obj_set_style_bg_opa(scr, LV_OPA_COVER, LV_PART_MAIN);
 }
 
 void set_backlight_brightness(uint8_t percentage) {
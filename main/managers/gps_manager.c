@@ -1,5 +1,6 @@
 #include "managers/gps_manager.h"
 #include "core/callbacks.h"
+#include "core/system_manager.h"
 #include "driver/periph_ctrl.h"
 #include "driver/uart.h"
 #include "esp_log.h"
@@ -93,7 +94,8 @@ void gps_manager_init(GPSManager *manager) {
     nmea_hdl = nmea_parser_init(&config);
     nmea_parser_add_handler(nmea_hdl, gps_event_handler, NULL);
     manager->isinitilized = true;
-    xTaskCreate(check_gps_connection_task, "gps_check", 2048, NULL, 1, &gps_check_task_handle);
+    system_manager_create_task(check_gps_connection_task, "gps_check", 2048, NULL, 1,
+                               &gps_check_task_handle, NULL);
 }
 
 static void check_gps_connection_task(void *pvParameters) {
@@ -0,0 +1,341 @@
+// printer_manager.c
+
+#include "managers/printer_manager.h"
+#include "core/system_manager.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+#include "managers/views/terminal_screen.h"
+#include "vendor/printer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "PrinterManager";
+
+static SemaphoreHandle_t submit_mutex = NULL;
+static QueueHandle_t job_queue = NULL;
+static printer_job_cb_t job_cb = NULL;
+static void *job_cb_ctx = NULL;
+static uint32_t next_job_id = 1;
+static printer_manager_stats_t stats;
+
+// Owned by the printer task
+static int printer_sock = -1;
+static char printer_ip[16];
+static printer_job_t batch[PRINTER_BATCH_MAX];
+static char stream[PRINTER_STREAM_LEN];
+static size_t stream_len;
+static uint32_t stream_flushes;
+static bool stream_sent; // Some byte of this attempt reached the printer
+
+const char *printer_job_status_name(printer_job_status_t status) {
+  switch (status) {
+  case PRINTER_JOB_SENT:
+    return "sent";
+  case PRINTER_JOB_CONNECT_FAILED:
+    return "connect failed";
+  case PRINTER_JOB_SEND_FAILED:
+    return "send failed";
+  }
+  return "unknown";
+}
+
+static void report_job(const printer_job_t *job, printer_job_status_t status) {
+  if (status == PRINTER_JOB_SENT) {
+    stats.sent++;
+  } else {
+    stats.failed++;
+  }
+  printf("Print job %lu to %s: %s\n", (unsigned long)job->id, job->ip,
+         printer_job_status_name(status));
+  TERMINAL_VIEW_ADD_TEXT("Print job %lu to %s: %s\n", (unsigned long)job->id,
+                         job->ip, printer_job_status_name(status));
+  if (job_cb) {
+    job_cb(job, status, job_cb_ctx);
+  }
+}
+
+static void printer_disconnect(void) {
+  if (printer_sock >= 0) {
+    close(printer_sock);
+    printer_sock = -1;
+    ESP_LOGI(TAG, "Connection to %s closed", printer_ip);
+  }
+}
+
+// Connects without blocking past PRINTER_CONNECT_TIMEOUT_MS
+static int printer_open(const char *ip) {
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PRINTER_PORT);
+  if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+    ESP_LOGE(TAG, "Invalid printer IP %s", ip);
+    return -1;
+  }
+
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) {
+    ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+    return -1;
+  }
+
+  int flags = fcntl(sock, F_GETFL, 0);
+  fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+  int err = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+  if (err < 0 && errno == EINPROGRESS) {
+    struct timeval timeout = {
+        .tv_sec = PRINTER_CONNECT_TIMEOUT_MS / 1000,
+        .tv_usec = (PRINTER_CONNECT_TIMEOUT_MS % 1000) * 1000,
+    };
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(sock, &fdset);
+    err = -1;
+    if (select(sock + 1, NULL, &fdset, NULL, &timeout) > 0) {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) == 0 &&
+          error == 0) {
+        err = 0;
+      }
+    }
+  }
+  if (err != 0) {
+    ESP_LOGE(TAG, "Unable to connect to %s: errno %d", ip, errno);
+    close(sock);
+    return -1;
+  }
+  fcntl(sock, F_SETFL, flags);
+
+  struct timeval send_timeout = {
+      .tv_sec = PRINTER_SEND_TIMEOUT_MS / 1000,
+      .tv_usec = (PRINTER_SEND_TIMEOUT_MS % 1000) * 1000,
+  };
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &send_timeout,
+             sizeof(send_timeout));
+  int keep_alive = 1;
+  setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keep_alive, sizeof(keep_alive));
+  return sock;
+}
+
+// False if the printer closed the connection while it was idle. Anything
+// the printer sent back (PJL status) is left for the stack to drop.
+static bool printer_connection_alive(void) {
+  char c;
+  int r = recv(printer_sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return r > 0 || (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+// Reuses the open connection when it goes to the same printer. Sets
+// *reused so a failure on a stale connection can be retried.
+static bool printer_connect(const char *ip, bool *reused) {
+  *reused = false;
+  if (printer_sock >= 0) {
+    if (strcmp(printer_ip, ip) == 0 && printer_connection_alive()) {
+      *reused = true;
+      return true;
+    }
+    printer_disconnect();
+  }
+
+  printer_sock = printer_open(ip);
+  if (printer_sock < 0) {
+    return false;
+  }
+  strncpy(printer_ip, ip, sizeof(printer_ip) - 1);
+  printer_ip[sizeof(printer_ip) - 1] = '\0';
+  stats.connects++;
+  ESP_LOGI(TAG, "Connected to printer at %s:%d", ip, PRINTER_PORT);
+  return true;
+}
+
+static bool stream_flush(void) {
+  size_t sent = 0;
+  while (sent < stream_len) {
+    int n = send(printer_sock, stream + sent, stream_len - sent, 0);
+    if (n < 0) {
+      ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+      printer_disconnect();
+      return false;
+    }
+    if (n > 0) {
+      stream_sent = true;
+    }
+    sent += n;
+  }
+  stats.bytes += stream_len;
+  stream_len = 0;
+  stream_flushes++;
+  return true;
+}
+
+// Appends to the stream, sending it whenever the buffer fills
+static bool stream_write(const char *data, size_t len) {
+  while (len > 0) {
+    if (stream_len == sizeof(stream) && !stream_flush()) {
+      return false;
+    }
+    size_t n = sizeof(stream) - stream_len;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(stream + stream_len, data, n);
+    stream_len += n;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool stream_write_job(const printer_job_t *job) {
+  if (job->type == PRINTER_JOB_EJECT) {
+    for (int i = 0; i < job->pages; i++) {
+      if (!stream_write("\f", 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  char pcl[PRINTER_MAX_JOB_LEN];
+  size_t len = printer_format_text(pcl, sizeof(pcl), job->text, job->font_px,
+                                   job->alignment);
+  return stream_write(pcl, len);
+}
+
+// Writes jobs as one stream and reports each one whose bytes all went out.
+// Returns how many were reported.
+static int printer_send_jobs(const printer_job_t *jobs, int count) {
+  int reported = 0;
+  stream_len = 0;
+  stream_sent = false;
+  for (int i = 0; i < count; i++) {
+    // Any flush inside this job's write carried every job before it
+    uint32_t flushes = stream_flushes;
+    if (!stream_write_job(&jobs[i])) {
+      return reported;
+    }
+    if (stream_flushes != flushes) {
+      for (; reported < i; reported++) {
+        report_job(&jobs[reported], PRINTER_JOB_SENT);
+      }
+    }
+  }
+  if (!stream_flush()) {
+    return reported;
+  }
+  for (; reported < count; reported++) {
+    report_job(&jobs[reported], PRINTER_JOB_SENT);
+  }
+  return reported;
+}
+
+static void printer_run_batch(const printer_job_t *jobs, int count) {
+  printer_job_status_t failure = PRINTER_JOB_CONNECT_FAILED;
+  int done = 0;
+  bool reused = true;
+  // A kept-alive connection can die unnoticed, retry once on a new one.
+  // Only when nothing was sent yet, part of a job would print twice.
+  while (done < count && reused) {
+    if (!printer_connect(jobs[0].ip, &reused)) {
+      failure = PRINTER_JOB_CONNECT_FAILED;
+      break;
+    }
+    stats.batches++;
+    done += printer_send_jobs(jobs + done, count - done);
+    failure = PRINTER_JOB_SEND_FAILED;
+    if (stream_sent) {
+      break;
+    }
+  }
+  for (int i = done; i < count; i++) {
+    report_job(&jobs[i], failure);
+  }
+}
+
+static void printer_task(void *arg) {
+  printer_job_t next;
+  bool have_next = false;
+  for (;;) {
+    if (!have_next) {
+      TickType_t wait = printer_sock >= 0 ? pdMS_TO_TICKS(PRINTER_IDLE_CLOSE_MS)
+                                          : portMAX_DELAY;
+      if (xQueueReceive(job_queue, &next, wait) != pdTRUE) {
+        printer_disconnect();
+        continue;
+      }
+    }
+
+    batch[0] = next;
+    int count = 1;
+    have_next = false;
+    while (count < PRINTER_BATCH_MAX &&
+           xQueueReceive(job_queue, &next, 0) == pdTRUE) {
+      if (strcmp(next.ip, batch[0].ip) != 0) {
+        have_next = true;
+        break;
+      }
+      batch[count++] = next;
+    }
+    printer_run_batch(batch, count);
+  }
+}
+
+// The queue and task are created by the first submit, under submit_mutex
+static bool printer_manager_start(void) {
+  if (job_queue != NULL) {
+    return true;
+  }
+  job_queue = xQueueCreate(PRINTER_QUEUE_LENGTH, sizeof(printer_job_t));
+  if (job_queue == NULL) {
+    ESP_LOGE(TAG, "Failed to create job queue");
+    return false;
+  }
+  if (!system_manager_create_task(printer_task, "printer", 4096, NULL, 3, NULL,
+                                  NULL)) {
+    vQueueDelete(job_queue);
+    job_queue = NULL;
+    return false;
+  }
+  return true;
+}
+
+void printer_manager_init(void) {
+  if (submit_mutex == NULL) {
+    submit_mutex = xSemaphoreCreateMutex();
+  }
+}
+
+uint32_t printer_manager_submit(const printer_job_t *job) {
+  if (submit_mutex == NULL ||
+      xSemaphoreTake(submit_mutex, portMAX_DELAY) != pdTRUE) {
+    return 0;
+  }
+  uint32_t id = 0;
+  if (printer_manager_start()) {
+    printer_job_t queued = *job;
+    queued.id = next_job_id;
+    if (xQueueSend(job_queue, &queued, 0) == pdTRUE) {
+      id = queued.id;
+      stats.queued++;
+      next_job_id++;
+      if (next_job_id == 0) {
+        next_job_id = 1;
+      }
+    }
+  }
+  xSemaphoreGive(submit_mutex);
+  return id;
+}
+
+void printer_manager_set_callback(printer_job_cb_t cb, void *ctx) {
+  job_cb = cb;
+  job_cb_ctx = ctx;
+}
+
+void printer_manager_get_stats(printer_manager_stats_t *out) { *out = stats; }
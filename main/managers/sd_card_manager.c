@@ -1,5 +1,8 @@
 #include "managers/sd_card_manager.h"
+#include "core/file_index.h"
 #include "core/utils.h"
+#include "core/sys_stats.h"
+#include "core/system_manager.h"
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "driver/sdmmc_defs.h"
@@ -7,11 +10,16 @@
 #include "driver/sdmmc_types.h"
 #include "esp_heap_trace.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "vendor/drivers/CH422G.h"
 #include "vendor/pcap.h"
 #include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/unistd.h>
@@ -21,6 +29,9 @@
 static const char *SD_TAG = "SD_Card_Manager";
 static const char *NVS_NAMESPACE = "sd_config";
 
+static void sd_io_init(void);
+static void sd_io_start(void);
+
 sd_card_manager_t sd_card_manager = { // Change this based on board config
     .card = NULL,
     .is_initialized = false,
@@ -109,6 +120,8 @@ static void sdmmc_card_print_info(const sdmmc_card_t *card) {
 esp_err_t sd_card_init(void) {
   esp_err_t ret = ESP_FAIL;
 
+  sd_io_init();
+
   // Load configuration from NVS first
   sd_card_load_config();
   sd_card_print_config(); // Print loaded/default config
@@ -138,7 +151,7 @@ esp_err_t sd_card_init(void) {
 
   esp_vfs_fat_sdmmc_mount_config_t mount_config = {
       .format_if_mount_failed = false,
-      .max_files = 5,
+      .max_files = SD_CARD_MAX_OPEN_FILES,
       .allocation_unit_size = 16 * 1024};
 
   ret = esp_vfs_fat_sdmmc_mount("/mnt", &host, &slot_config, &mount_config,
@@ -189,7 +202,7 @@ esp_err_t sd_card_init(void) {
 
   esp_vfs_fat_sdmmc_mount_config_t mount_config = {
       .format_if_mount_failed = false,
-      .max_files = 5,
+      .max_files = SD_CARD_MAX_OPEN_FILES,
       .allocation_unit_size = 16 * 1024};
 
   ret = esp_vfs_fat_sdmmc_mount("/mnt", &host, &slot_config, &mount_config,
@@ -324,7 +337,7 @@ esp_err_t sd_card_init(void) {
 
   esp_vfs_fat_sdmmc_mount_config_t mount_config = {
       .format_if_mount_failed = false,
-      .max_files = 5,
+      .max_files = SD_CARD_MAX_OPEN_FILES,
       .allocation_unit_size = 16 * 1024};
 
   sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
@@ -365,11 +378,17 @@ esp_err_t sd_card_init(void) {
   printf("SD card initialized successfully\n");
 
   sd_card_setup_directory_structure();
+  sd_io_start();
 
   return ESP_OK;
 }
 
 void sd_card_unmount(void) {
+  if (sd_card_manager.is_initialized) {
+    sd_card_close_cached(NULL);
+    file_index_reset();
+  }
+
 #if SOC_SDMMC_HOST_SUPPORTED && SOC_SDMMC_USE_GPIO_MATRIX
   if (sd_card_manager.is_initialized) {
     esp_vfs_fat_sdmmc_unmount();
@@ -385,21 +404,342 @@ void sd_card_unmount(void) {
 #endif
 }
 
+// Append cache: a few files stay open and small appends are coalesced in a
+// per-file buffer so the FAT is only touched once per buffer instead of once
+// per call. Buffers are flushed when full, when they get old, on explicit
+// sync, or when the slot is evicted for another path.
+typedef struct {
+  char path[SD_IO_MAX_PATH_LEN];
+  FILE *file;
+  uint8_t *buffer;
+  size_t length;
+  int64_t first_pending_us;
+  int64_t last_used_us;
+  bool unsynced; // Written since the last fsync
+  bool in_use;
+} sd_io_handle_t;
+
+static sd_io_handle_t sd_io_handles[SD_IO_MAX_HANDLES];
+static sd_io_stats_t sd_io_stats;
+static SemaphoreHandle_t sd_io_mutex = NULL;
+static TaskHandle_t sd_io_flush_task_handle = NULL;
+
+static esp_err_t sd_io_flush_handle(sd_io_handle_t *handle) {
+  if (handle->length == 0) {
+    return ESP_OK;
+  }
+
+  size_t written = fwrite(handle->buffer, 1, handle->length, handle->file);
+  sd_io_stats.physical_writes++;
+  sd_io_stats.bytes_written += written;
+  if (written > 0) {
+    handle->unsynced = true;
+  }
+  // Whatever didn't make it stays buffered for the next flush to retry
+  handle->length -= written;
+  memmove(handle->buffer, handle->buffer + written, handle->length);
+  if (handle->length > 0 || fflush(handle->file) != 0) {
+    printf("Failed to flush %u bytes to %s\n",
+           (unsigned)(handle->length + written), handle->path);
+    sd_io_stats.write_errors++;
+    clearerr(handle->file);
+    return ESP_FAIL;
+  }
+
+  handle->first_pending_us = 0;
+  return ESP_OK;
+}
+
+// fflush only gets the data to f_write. The file size and FAT chain reach
+// the card with f_sync, without it a power cut loses the appends.
+static esp_err_t sd_io_commit_handle(sd_io_handle_t *handle) {
+  esp_err_t ret = sd_io_flush_handle(handle);
+  if (ret != ESP_OK || !handle->unsynced) {
+    return ret;
+  }
+  if (fsync(fileno(handle->file)) != 0) {
+    printf("Failed to sync %s\n", handle->path);
+    sd_io_stats.write_errors++;
+    return ESP_FAIL;
+  }
+  handle->unsynced = false;
+  return ESP_OK;
+}
+
+static esp_err_t sd_io_close_handle(sd_io_handle_t *handle) {
+  if (!handle->in_use) {
+    return ESP_OK;
+  }
+
+  esp_err_t ret = sd_io_flush_handle(handle);
+  fclose(handle->file);
+  sys_stats_free(handle->buffer);
+  memset(handle, 0, sizeof(*handle));
+  return ret;
+}
+
+static sd_io_handle_t *sd_io_find_handle(const char *path) {
+  for (int i = 0; i < SD_IO_MAX_HANDLES; i++) {
+    if (sd_io_handles[i].in_use &&
+        strcmp(sd_io_handles[i].path, path) == 0) {
+      return &sd_io_handles[i];
+    }
+  }
+  return NULL;
+}
+
+static sd_io_handle_t *sd_io_open_handle(const char *path) {
+  sd_io_handle_t *slot = NULL;
+
+  if (strlen(path) >= SD_IO_MAX_PATH_LEN) {
+    printf("Path too long for append cache: %s\n", path);
+    return NULL;
+  }
+
+  // Prefer a free slot, otherwise evict the least recently used one
+  for (int i = 0; i < SD_IO_MAX_HANDLES; i++) {
+    if (!sd_io_handles[i].in_use) {
+      slot = &sd_io_handles[i];
+      break;
+    }
+    if (slot == NULL ||
+        sd_io_handles[i].last_used_us < slot->last_used_us) {
+      slot = &sd_io_handles[i];
+    }
+  }
+
+  if (slot->in_use) {
+    sd_io_close_handle(slot);
+    sd_io_stats.evictions++;
+  }
+
+  slot->buffer = sys_stats_malloc(SYS_STATS_TAG_SD, SD_IO_BUFFER_SIZE);
+  if (slot->buffer == NULL) {
+    printf("Failed to allocate append buffer for %s\n", path);
+    return NULL;
+  }
+
+  slot->file = fopen(path, "ab");
+  if (slot->file == NULL) {
+    printf("Failed to open file for appending\n");
+    sys_stats_free(slot->buffer);
+    slot->buffer = NULL;
+    return NULL;
+  }
+
+  strcpy(slot->path, path);
+  slot->length = 0;
+  slot->first_pending_us = 0;
+  slot->unsynced = false;
+  slot->in_use = true;
+  return slot;
+}
+
+// Called from sd_card_init, before the flush task or any append can run
+static void sd_io_init(void) {
+  if (sd_io_mutex == NULL) {
+    sd_io_mutex = xSemaphoreCreateMutex();
+  }
+}
+
+// False before sd_card_init, nothing is cached then
+static bool sd_io_lock(void) {
+  return sd_io_mutex != NULL &&
+         xSemaphoreTake(sd_io_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+static void sd_io_unlock(void) { xSemaphoreGive(sd_io_mutex); }
+
+static void sd_io_flush_task(void *pvParameters) {
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(SD_IO_FLUSH_INTERVAL_MS));
+
+    if (!sd_card_manager.is_initialized || !sd_io_lock()) {
+      continue;
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < SD_IO_MAX_HANDLES; i++) {
+      sd_io_handle_t *handle = &sd_io_handles[i];
+      if (!handle->in_use) {
+        continue;
+      }
+      if (handle->length > 0 &&
+          now - handle->first_pending_us >= SD_IO_FLUSH_AGE_MS * 1000LL) {
+        sd_io_flush_handle(handle);
+        sd_io_stats.age_flushes++;
+      }
+      // Release handles nobody has written to for a while, unless a failed
+      // flush is still waiting to be retried
+      if (handle->length == 0 &&
+          now - handle->last_used_us >= SD_IO_IDLE_CLOSE_MS * 1000LL) {
+        sd_io_close_handle(handle);
+      }
+    }
+
+    sd_io_unlock();
+  }
+}
+
 esp_err_t sd_card_append_file(const char *path, const void *data, size_t size) {
   if (!sd_card_manager.is_initialized) {
     printf("SD card is not initialized. Cannot append to file.\n");
     return ESP_FAIL;
   }
 
-  FILE *f = fopen(path, "ab");
-  if (f == NULL) {
-    printf("Failed to open file for appending\n");
-    return ESP_FAIL;
+  if (path == NULL || (data == NULL && size > 0)) {
+    return ESP_ERR_INVALID_ARG;
   }
-  fwrite(data, 1, size, f);
-  fclose(f);
-  printf("Data appended to file: %s\n", path);
-  return ESP_OK;
+
+  if (!sd_io_lock()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  esp_err_t ret = ESP_OK;
+  sd_io_stats.append_calls++;
+  sd_io_stats.bytes_appended += size;
+
+  sd_io_handle_t *handle = sd_io_find_handle(path);
+  if (handle != NULL) {
+    sd_io_stats.handle_hits++;
+  } else {
+    sd_io_stats.handle_misses++;
+    handle = sd_io_open_handle(path);
+    if (handle == NULL) {
+      sd_io_unlock();
+      return ESP_FAIL;
+    }
+  }
+
+  int64_t now = esp_timer_get_time();
+  handle->last_used_us = now;
+
+  if (handle->length + size > SD_IO_BUFFER_SIZE) {
+    ret = sd_io_flush_handle(handle);
+    sd_io_stats.size_flushes++;
+    if (ret != ESP_OK) {
+      // The buffer still holds the failed flush, this append would land
+      // out of order after it
+      sd_io_unlock();
+      return ret;
+    }
+  }
+
+  if (size >= SD_IO_BUFFER_SIZE) {
+    // Large writes go straight through, there is nothing to coalesce
+    size_t written = fwrite(data, 1, size, handle->file);
+    sd_io_stats.physical_writes++;
+    sd_io_stats.bytes_written += written;
+    handle->unsynced = true;
+    if (written != size) {
+      sd_io_stats.write_errors++;
+      ret = ESP_FAIL;
+    }
+  } else if (size > 0) {
+    if (handle->length == 0) {
+      handle->first_pending_us = now;
+    }
+    memcpy(handle->buffer + handle->length, data, size);
+    handle->length += size;
+  }
+
+  sd_io_unlock();
+  return ret;
+}
+
+esp_err_t sd_card_sync(const char *path) {
+  if (!sd_io_lock()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  esp_err_t ret = ESP_OK;
+  for (int i = 0; i < SD_IO_MAX_HANDLES; i++) {
+    sd_io_handle_t *handle = &sd_io_handles[i];
+    if (!handle->in_use) {
+      continue;
+    }
+    if (path == NULL || strcmp(handle->path, path) == 0) {
+      if (handle->length > 0) {
+        sd_io_stats.sync_flushes++;
+      }
+      if (sd_io_commit_handle(handle) != ESP_OK) {
+        ret = ESP_FAIL;
+      }
+    }
+  }
+
+  sd_io_unlock();
+  return ret;
+}
+
+esp_err_t sd_card_close_cached(const char *path) {
+  if (!sd_io_lock()) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  esp_err_t ret = ESP_OK;
+  for (int i = 0; i < SD_IO_MAX_HANDLES; i++) {
+    sd_io_handle_t *handle = &sd_io_handles[i];
+    if (handle->in_use && (path == NULL || strcmp(handle->path, path) == 0)) {
+      if (sd_io_close_handle(handle) != ESP_OK) {
+        ret = ESP_FAIL;
+      }
+    }
+  }
+
+  sd_io_unlock();
+  return ret;
+}
+
+void sd_card_get_io_stats(sd_io_stats_t *stats) {
+  if (stats == NULL || !sd_io_lock()) {
+    return;
+  }
+  *stats = sd_io_stats;
+  sd_io_unlock();
+}
+
+void sd_card_reset_io_stats(void) {
+  if (!sd_io_lock()) {
+    return;
+  }
+  memset(&sd_io_stats, 0, sizeof(sd_io_stats));
+  sd_io_unlock();
+}
+
+void sd_card_print_io_stats(void) {
+  sd_io_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  sd_card_get_io_stats(&stats);
+
+  uint32_t lookups = stats.handle_hits + stats.handle_misses;
+  uint32_t hit_rate = lookups ? (stats.handle_hits * 100) / lookups : 0;
+  uint32_t bytes_per_write =
+      stats.physical_writes
+          ? (uint32_t)(stats.bytes_written / stats.physical_writes)
+          : 0;
+
+  printf("SD Append Cache Statistics:\n");
+  printf("  Append calls:    %lu\n", (unsigned long)stats.append_calls);
+  printf("  Handle hits:     %lu (%lu%%)\n", (unsigned long)stats.handle_hits,
+         (unsigned long)hit_rate);
+  printf("  Handle misses:   %lu\n", (unsigned long)stats.handle_misses);
+  printf("  Evictions:       %lu\n", (unsigned long)stats.evictions);
+  printf("  Bytes appended:  %llu\n", (unsigned long long)stats.bytes_appended);
+  printf("  Physical writes: %lu (%lu bytes/write)\n",
+         (unsigned long)stats.physical_writes, (unsigned long)bytes_per_write);
+  printf("  Flushes:         size %lu, age %lu, sync %lu\n",
+         (unsigned long)stats.size_flushes, (unsigned long)stats.age_flushes,
+         (unsigned long)stats.sync_flushes);
+  printf("  Write errors:    %lu\n", (unsigned long)stats.write_errors);
+}
+
+static void sd_io_start(void) {
+  if (sd_io_flush_task_handle != NULL) {
+    return;
+  }
+  system_manager_create_task(sd_io_flush_task, "sd_io_flush", 3072, NULL, 1,
+                             &sd_io_flush_task_handle, NULL);
 }
 
 esp_err_t sd_card_write_file(const char *path, const void *data, size_t size) {
@@ -408,6 +748,8 @@ esp_err_t sd_card_write_file(const char *path, const void *data, size_t size) {
     return ESP_FAIL;
   }
 
+  sd_card_close_cached(path);
+
   FILE *f = fopen(path, "wb");
   if (f == NULL) {
     printf("Failed to open file for writing\n");
@@ -425,6 +767,8 @@ esp_err_t sd_card_read_file(const char *path) {
     return ESP_FAIL;
   }
 
+  sd_card_sync(path);
+
   FILE *f = fopen(path, "r");
   if (f == NULL) {
     printf("Failed to open file for reading\n");
@@ -597,6 +941,7 @@ esp_err_t sd_card_setup_directory_structure() {
   }
 
   printf("Directory structure successfully set up.\n");
+  file_index_init();
   return ESP_OK;
 }
 
@@ -1,4 +1,5 @@
 #include "managers/settings_manager.h"
+#include "core/system_manager.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "lvgl.h"
@@ -556,8 +557,8 @@ void settings_save(const FSettings *settings) {
     rgb_manager_set_color(&rgb_manager, 0, 0, 0, 0, false);
   } else {
     if (rgb_effect_task_handle == NULL) {
-      xTaskCreate(rainbow_task, "Rainbow Task", 8192, &rgb_manager, 1,
-                  &rgb_effect_task_handle);
+      system_manager_create_task(rainbow_task, "Rainbow Task", 8192, &rgb_manager, 1,
+                                 &rgb_effect_task_handle, NULL);
     }
   }
 
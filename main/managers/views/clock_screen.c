@@ -2,6 +2,7 @@
 #include "managers/views/main_menu_screen.h"
 #include "managers/display_manager.h"
 #include "lvgl.h"
+#include <string.h>
 #include <time.h>
 #include "managers/settings_manager.h"
 
@@ -18,9 +19,13 @@ static void digital_clock_cb(lv_timer_t *timer) {
     char buf[16];
     strftime(buf, sizeof(buf), "%H:%M:%S", &timeinfo);
     lv_label_set_text(time_label, buf);
-    char buf_date[16];
+    // Setting the same text still invalidates the label, the date changes
+    // once a day
+    char buf_date[32];
     strftime(buf_date, sizeof(buf_date), "%A, %b %d", &timeinfo);
-    lv_label_set_text(date_label, buf_date);
+    if (strcmp(lv_label_get_text(date_label), buf_date) != 0) {
+        lv_label_set_text(date_label, buf_date);
+    }
 }
 
 static void clock_event_handler(InputEvent *event) {
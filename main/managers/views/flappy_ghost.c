@@ -4,17 +4,37 @@
 #include "esp_crt_bundle.h"
 #include "esp_http_client.h" // For HTTP requests
 #include "esp_log.h"
+#include "esp_random.h"
 #include "esp_wifi.h" // For internet connectivity check
 #include "lvgl.h"
 #include "managers/settings_manager.h"
 #include "managers/views/flappy_ghost_screen.h"
 #include "managers/views/main_menu_screen.h"
+#include "src/draw/sw/lv_draw_sw.h" // lv_draw_sw_transform
 #include <stdlib.h>
 #include <string.h>
 
 #define MAX_PIPE_SETS 2
 
-#define GAME_LOOP_INTERVAL_MS LV_VER_RES > 320 ? 10 : 25
+// The game advances in fixed steps of this length whatever the frame rate,
+// so it plays at the same speed when rendering is slow
+#define GAME_STEP_MS (LV_VER_RES > 320 ? 10 : 25)
+// Steps run per frame at most, after a longer stall the game slows down
+// rather than jumping ahead
+#define GAME_MAX_STEPS_PER_FRAME 5
+
+// Bird position and velocity are fixed point with this many fraction bits
+#define FIXED_SHIFT 8
+#define TO_FIXED(v) ((int32_t)((v) * (1 << FIXED_SHIFT)))
+#define FROM_FIXED(v) ((v) >> FIXED_SHIFT)
+
+// Flaps waiting for the step they happened in
+#define FLAP_QUEUE_LEN 4
+
+// The ghost tilts with its velocity, drawn from frames rotated once at start
+#define GHOST_MAX_ANGLE 45
+#define GHOST_ANGLE_STEP 15
+#define GHOST_FRAMES (2 * GHOST_MAX_ANGLE / GHOST_ANGLE_STEP + 1)
 
 typedef enum {
   SCREEN_SIZE_SMALL,
@@ -23,9 +43,9 @@ typedef enum {
 } screen_size_t;
 
 typedef struct {
-  int pipe_speed;        // Speed at which pipes move left
+  int pipe_speed;        // Pixels pipes move left per step
   int pipe_width;        // Width of each pipe
-  float gravity;         // Gravity affecting the bird
+  float gravity;         // Velocity gained per step
   float flap_strength;   // Upward velocity when the bird flaps
   float pipe_gap_ratio;  // Ratio of the screen height used as pipe gap
   int bird_size;         // Size of the bird (width and height)
@@ -48,7 +68,6 @@ void flappy_bird_view_destroy(void);
 void flappy_bird_view_hardwareinput_callback(InputEvent *event);
 void flappy_bird_view_get_hardwareinput_callback(void **callback);
 void flappy_bird_game_loop(lv_timer_t *timer);
-int flappy_bird_check_collision(lv_obj_t *bird, lv_obj_t *pipe);
 void flappy_bird_game_over();
 void flappy_bird_restart();
 bool check_internet_connectivity();
@@ -59,27 +78,58 @@ lv_obj_t *name_text_area = NULL;
 lv_obj_t *keyboard = NULL;
 bool internet_connected = false;
 
-// Define a structure for a single pipe
+// A pipe rising from the ground, the gap is above it
 typedef struct {
-  lv_obj_t *pipe;
+  int x;
   int gap_center_y;
+  int drawn_x; // Where the pipe is on screen
+  int drawn_gap_center_y;
 } pipe_set_t;
 
+// Game state, only changed by game_step so a game replays exactly from the
+// same seed and flaps
+typedef struct {
+  int32_t bird_y;        // Fixed point
+  int32_t bird_velocity; // Fixed point, per step
+  pipe_set_t pipes[MAX_PIPE_SETS];
+  uint32_t rng;
+  uint32_t steps;
+  int score;
+  bool over;
+} game_state_t;
+
 // Global Game Objects
-lv_obj_t *flappy_bird_canvas = NULL;
+static lv_obj_t *pipes_obj = NULL; // Draws every pipe
 lv_obj_t *bird = NULL;
-pipe_set_t pipes[MAX_PIPE_SETS];
 lv_obj_t *score_label = NULL;
 
 lv_timer_t *game_loop_timer = NULL;
-int bird_y_position = 0;
-float bird_velocity = 0;
-int pipe_gap; // Gap size between pipe and top of the screen
+static game_state_t game;
+static uint32_t game_tick; // Tick the game has been stepped up to
+int pipe_gap;       // Gap size between pipe and top of the screen
 int pipe_min_gap_y;
 int pipe_max_gap_y;
-int score = 0;
 bool is_game_over = false;
 
+// Screen geometry and physics in game units, set at create
+static int screen_width;
+static int screen_height;
+static int bird_x;
+static int collision_padding;
+static int32_t gravity_fixed;
+static int32_t flap_fixed;
+
+// Written by the input task, read by the game loop
+static volatile uint32_t flap_ticks[FLAP_QUEUE_LEN];
+static volatile uint8_t flap_head;
+static volatile uint8_t flap_tail;
+
+static const lv_img_dsc_t *ghost_frames[GHOST_FRAMES];
+static lv_img_dsc_t ghost_rotated[GHOST_FRAMES];
+static uint8_t *ghost_frame_data;
+static int shown_frame = -1;
+static int shown_score = -1;
+
 // Define Web Hook URL if not defined
 #ifndef FLAPPY_GHOST_WEB_HOOK
 #define FLAPPY_GHOST_WEB_HOOK ""
@@ -256,6 +306,237 @@ void submit_score_to_api(const char *name, int score) {
   esp_log_level_set("esp_http_client", ESP_LOG_INFO);
 }
 
+// xorshift32, so the pipes only depend on the seed
+static uint32_t game_random(void) {
+  uint32_t x = game.rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  game.rng = x;
+  return x;
+}
+
+static int random_gap_center_y(void) {
+  return game_random() % (pipe_max_gap_y - pipe_min_gap_y + 1) +
+         pipe_min_gap_y;
+}
+
+// Area of a pipe in the root's coordinates
+static void pipe_get_area(int x, int gap_center_y, lv_area_t *area) {
+  area->x1 = x;
+  area->x2 = x + settings.pipe_width - 1;
+  area->y1 = gap_center_y + pipe_gap;
+  area->y2 = area->y1 + screen_height - gap_center_y - settings.ground_height -
+             1;
+}
+
+static void game_reset(void) {
+  game.bird_y = TO_FIXED(screen_height <= 128 ? 3 : screen_height / 2);
+  game.bird_velocity = 0;
+  game.score = 0;
+  game.steps = 0;
+  game.over = false;
+  for (int i = 0; i < MAX_PIPE_SETS; i++) {
+    game.pipes[i].x = screen_width + i * (screen_width / MAX_PIPE_SETS);
+    game.pipes[i].gap_center_y = random_gap_center_y();
+  }
+}
+
+static bool game_check_collision(const pipe_set_t *pipe) {
+  lv_area_t bird_area;
+  bird_area.x1 = bird_x - collision_padding;
+  bird_area.y1 = FROM_FIXED(game.bird_y) - collision_padding;
+  bird_area.x2 = bird_x + settings.bird_size - 1 + collision_padding;
+  bird_area.y2 = FROM_FIXED(game.bird_y) + settings.bird_size - 1 +
+                 collision_padding;
+
+  lv_area_t pipe_area;
+  pipe_get_area(pipe->x, pipe->gap_center_y, &pipe_area);
+  return _lv_area_is_on(&bird_area, &pipe_area);
+}
+
+// Advances the game by one GAME_STEP_MS
+static void game_step(bool flap) {
+  if (flap) {
+    game.bird_velocity = flap_fixed;
+  }
+  game.bird_velocity += gravity_fixed;
+  game.bird_y += game.bird_velocity;
+  game.steps++;
+
+  // Check collision with ground or ceiling
+  int bird_y = FROM_FIXED(game.bird_y);
+  if (bird_y + settings.bird_size >=
+          screen_height - settings.ground_height + settings.buffer_bottom ||
+      bird_y <= -settings.buffer_top) {
+    game.over = true;
+  }
+
+  for (int i = 0; i < MAX_PIPE_SETS; i++) {
+    pipe_set_t *pipe = &game.pipes[i];
+    pipe->x -= settings.pipe_speed;
+    if (pipe->x < -settings.pipe_width) {
+      pipe->x = screen_width;
+      pipe->gap_center_y = random_gap_center_y();
+      game.score++;
+    }
+
+    if (game_check_collision(pipe)) {
+      game.over = true;
+    }
+  }
+}
+
+// True if a flap happened before the step ending at step_end
+static bool take_flap(uint32_t step_end) {
+  bool flap = false;
+  while (flap_tail != flap_head &&
+         (int32_t)(flap_ticks[flap_tail % FLAP_QUEUE_LEN] - step_end) < 0) {
+    flap_tail++;
+    flap = true;
+  }
+  return flap;
+}
+
+static void queue_flap(void) {
+  if ((uint8_t)(flap_head - flap_tail) >= FLAP_QUEUE_LEN) {
+    return;
+  }
+  flap_ticks[flap_head % FLAP_QUEUE_LEN] = lv_tick_get();
+  flap_head++;
+}
+
+static void pipes_draw_cb(lv_event_t *e) {
+  lv_obj_t *obj = lv_event_get_target(e);
+  lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+  lv_area_t coords;
+  lv_obj_get_coords(obj, &coords);
+
+  lv_draw_rect_dsc_t pipe_dsc;
+  lv_draw_rect_dsc_init(&pipe_dsc);
+  pipe_dsc.bg_color = lv_color_hex(0x00FF00);
+
+  for (int i = 0; i < MAX_PIPE_SETS; i++) {
+    lv_area_t area;
+    pipe_get_area(game.pipes[i].drawn_x, game.pipes[i].drawn_gap_center_y,
+                  &area);
+    lv_area_move(&area, coords.x1, coords.y1);
+    lv_draw_rect(draw_ctx, &pipe_dsc, &area);
+  }
+}
+
+static void pipes_invalidate(const lv_area_t *area) {
+  lv_area_t coords;
+  lv_obj_get_coords(pipes_obj, &coords);
+  lv_area_t abs_area = *area;
+  lv_area_move(&abs_area, coords.x1, coords.y1);
+  lv_obj_invalidate_area(pipes_obj, &abs_area);
+}
+
+// Invalidates what changed since the pipe was last drawn. A pipe sliding
+// left only changes at its two edges.
+static void pipe_invalidate_moved(pipe_set_t *pipe) {
+  if (pipe->x == pipe->drawn_x &&
+      pipe->gap_center_y == pipe->drawn_gap_center_y) {
+    return;
+  }
+
+  lv_area_t old_area, new_area;
+  pipe_get_area(pipe->drawn_x, pipe->drawn_gap_center_y, &old_area);
+  pipe_get_area(pipe->x, pipe->gap_center_y, &new_area);
+  int moved = old_area.x1 - new_area.x1;
+  if (pipe->gap_center_y != pipe->drawn_gap_center_y || moved < 0 ||
+      moved >= settings.pipe_width) {
+    pipes_invalidate(&old_area);
+    pipes_invalidate(&new_area);
+  } else {
+    lv_area_t edge = new_area;
+    edge.x2 = old_area.x1 - 1;
+    pipes_invalidate(&edge);
+    edge = old_area;
+    edge.x1 = new_area.x2 + 1;
+    pipes_invalidate(&edge);
+  }
+
+  pipe->drawn_x = pipe->x;
+  pipe->drawn_gap_center_y = pipe->gap_center_y;
+}
+
+static int ghost_frame_for_velocity(int32_t velocity) {
+  int angle = velocity * 5 / (1 << FIXED_SHIFT);
+  if (angle > GHOST_MAX_ANGLE)
+    angle = GHOST_MAX_ANGLE;
+  if (angle < -GHOST_MAX_ANGLE)
+    angle = -GHOST_MAX_ANGLE;
+  return (angle + GHOST_MAX_ANGLE + GHOST_ANGLE_STEP / 2) / GHOST_ANGLE_STEP;
+}
+
+// Moves the objects to the game state, LVGL redraws only what moved
+static void game_render(void) {
+  lv_obj_set_pos(bird, bird_x, FROM_FIXED(game.bird_y));
+
+  int frame = ghost_frame_for_velocity(game.bird_velocity);
+  if (frame != shown_frame) {
+    lv_img_set_src(bird, ghost_frames[frame]);
+    shown_frame = frame;
+  }
+
+  for (int i = 0; i < MAX_PIPE_SETS; i++) {
+    pipe_invalidate_moved(&game.pipes[i]);
+  }
+
+  if (game.score != shown_score) {
+    lv_label_set_text_fmt(score_label, "Score: %d", game.score);
+    shown_score = game.score;
+  }
+}
+
+// Rotates the sprite about its centre into a buffer of the same size and
+// format. Only the tips of the tail reach past the box's inscribed circle and
+// get clipped when tilted.
+static void ghost_rotate(const lv_img_dsc_t *src, int angle, uint8_t *out) {
+  lv_coord_t w = src->header.w;
+  lv_coord_t h = src->header.h;
+
+  lv_draw_img_dsc_t dsc;
+  lv_draw_img_dsc_init(&dsc);
+  dsc.angle = angle * 10;
+  dsc.pivot.x = w / 2;
+  dsc.pivot.y = h / 2;
+  dsc.antialias = 1;
+
+  lv_area_t dest_area = {0, 0, w - 1, h - 1};
+  lv_draw_sw_transform(NULL, &dest_area, src->data, w, h, w, &dsc,
+                       src->header.cf, (lv_color_t *)out,
+                       out + w * h * sizeof(lv_color_t));
+}
+
+static void ghost_frames_create(void) {
+  ghost_frame_data = malloc(ghost.data_size * (GHOST_FRAMES - 1));
+  if (ghost_frame_data == NULL) {
+    ESP_LOGW("FlappyGhost", "No memory for rotated sprites, not tilting");
+  }
+
+  uint8_t *data = ghost_frame_data;
+  for (int i = 0; i < GHOST_FRAMES; i++) {
+    int angle = i * GHOST_ANGLE_STEP - GHOST_MAX_ANGLE;
+    if (angle == 0 || ghost_frame_data == NULL) {
+      ghost_frames[i] = &ghost;
+      continue;
+    }
+    ghost_rotate(&ghost, angle, data);
+    ghost_rotated[i] = ghost;
+    ghost_rotated[i].data = data;
+    ghost_frames[i] = &ghost_rotated[i];
+    data += ghost.data_size;
+  }
+}
+
+static void ghost_frames_destroy(void) {
+  free(ghost_frame_data);
+  ghost_frame_data = NULL;
+}
+
 // Function to create the Flappy Bird view
 void flappy_bird_view_create(void) {
   if (flappy_bird_view.root != NULL) {
@@ -263,18 +544,25 @@ void flappy_bird_view_create(void) {
   }
 
   // Determine screen height
-  int screen_height = LV_VER_RES;
+  screen_height = LV_VER_RES;
+  screen_width = LV_HOR_RES;
   set_game_settings(screen_height);
 
   // Initialize variables based on the screen dimensions
   pipe_gap = (int)(screen_height * settings.pipe_gap_ratio);
   pipe_min_gap_y = (int)(screen_height * 0.05f); // 5% of screen height
   pipe_max_gap_y = screen_height - pipe_gap - settings.ground_height;
-  bird_y_position = screen_height <= 128 ? 3 : screen_height / 2;
+  bird_x = screen_width / 4;
+  collision_padding = (int)(screen_height * 0.02f); // 2% of screen height
+  gravity_fixed = TO_FIXED(settings.gravity);
+  flap_fixed = TO_FIXED(settings.flap_strength);
+
+  game.rng = esp_random() | 1;
+  game_reset();
 
   // Create root object
   flappy_bird_view.root = lv_obj_create(lv_scr_act());
-  lv_obj_set_size(flappy_bird_view.root, LV_HOR_RES, screen_height);
+  lv_obj_set_size(flappy_bird_view.root, screen_width, screen_height);
   lv_obj_set_style_bg_color(flappy_bird_view.root, lv_color_black(), 0);
   lv_obj_clear_flag(flappy_bird_view.root, LV_OBJ_FLAG_SCROLLABLE);
 
@@ -284,45 +572,30 @@ void flappy_bird_view_create(void) {
       (screen_height <= 135) ? lv_color_hex(0x0D0D40) : lv_color_hex(0x87CEEB),
       (screen_height <= 135) ? lv_color_hex(0x0A0A30) : lv_color_hex(0xFFA500));
 
-  // Create canvas for pipes
-  flappy_bird_canvas = lv_canvas_create(flappy_bird_view.root);
-  lv_obj_set_size(flappy_bird_canvas, LV_HOR_RES, screen_height);
-  lv_obj_set_scrollbar_mode(flappy_bird_canvas, LV_SCROLLBAR_MODE_OFF);
-  lv_obj_clear_flag(flappy_bird_canvas, LV_OBJ_FLAG_SCROLLABLE);
+  // One object draws every pipe as a rectangle
+  pipes_obj = lv_obj_create(flappy_bird_view.root);
+  lv_obj_remove_style_all(pipes_obj);
+  lv_obj_clear_flag(pipes_obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+  lv_obj_set_size(pipes_obj, screen_width, screen_height);
+  lv_obj_add_event_cb(pipes_obj, pipes_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+  for (int i = 0; i < MAX_PIPE_SETS; i++) {
+    game.pipes[i].drawn_x = game.pipes[i].x;
+    game.pipes[i].drawn_gap_center_y = game.pipes[i].gap_center_y;
+  }
 
   // Create bird
+  ghost_frames_create();
   bird = lv_img_create(flappy_bird_view.root);
-
-  bool use_ghost_image = rand() % 2 == 0;
-
-  lv_img_set_src(bird, &ghost);
-
+  shown_frame = ghost_frame_for_velocity(game.bird_velocity);
+  lv_img_set_src(bird, ghost_frames[shown_frame]);
   lv_obj_set_size(bird, settings.bird_size, settings.bird_size);
-  lv_obj_set_pos(bird, LV_HOR_RES / 4, bird_y_position);
+  lv_obj_set_pos(bird, bird_x, FROM_FIXED(game.bird_y));
   lv_obj_clear_flag(bird, LV_OBJ_FLAG_SCROLLABLE);
 
-  // Create pipe sets
-  for (int i = 0; i < MAX_PIPE_SETS; i++) {
-    // Initialize gap center position
-    pipes[i].gap_center_y =
-        rand() % (pipe_max_gap_y - pipe_min_gap_y + 1) + pipe_min_gap_y;
-
-    // Create pipe
-    pipes[i].pipe = lv_obj_create(flappy_bird_canvas);
-    lv_obj_set_size(pipes[i].pipe, settings.pipe_width,
-                    screen_height - pipes[i].gap_center_y -
-                        settings.ground_height);
-    lv_obj_set_style_bg_color(pipes[i].pipe, lv_color_hex(0x00FF00), 0);
-    lv_obj_set_style_radius(pipes[i].pipe, 0, 0); // Ensure sharp edges
-    lv_obj_set_pos(pipes[i].pipe, LV_HOR_RES + i * (LV_HOR_RES / MAX_PIPE_SETS),
-                   pipes[i].gap_center_y + pipe_gap);
-    lv_obj_set_scrollbar_mode(pipes[i].pipe, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_clear_flag(pipes[i].pipe, LV_OBJ_FLAG_SCROLLABLE);
-  }
-
   // Create score label
   score_label = lv_label_create(flappy_bird_view.root);
-  lv_label_set_text_fmt(score_label, "Score: %d", score);
+  shown_score = game.score;
+  lv_label_set_text_fmt(score_label, "Score: %d", game.score);
   lv_obj_align(score_label, LV_ALIGN_TOP_LEFT, 10, 10);
   lv_obj_set_style_text_color(score_label, lv_color_white(), 0);
   lv_obj_set_style_text_font(score_label, settings.score_font, 0);
@@ -333,17 +606,16 @@ void flappy_bird_view_create(void) {
                                                          : "Flap");
 
   // Create game loop timer
+  flap_tail = flap_head;
+  game_tick = lv_tick_get();
   game_loop_timer =
-      lv_timer_create(flappy_bird_game_loop, GAME_LOOP_INTERVAL_MS, NULL);
+      lv_timer_create(flappy_bird_game_loop, GAME_STEP_MS, NULL);
 }
 
 // Function to destroy the Flappy Bird view
 void flappy_bird_view_destroy(void) {
   if (flappy_bird_view.root != NULL) {
     is_game_over = false;
-    bird_y_position = LV_VER_RES / 2;
-    bird_velocity = 0;
-    score = 0;
 
     if (game_loop_timer != NULL) {
       lv_timer_del(game_loop_timer);
@@ -352,12 +624,10 @@ void flappy_bird_view_destroy(void) {
 
     lv_obj_del(flappy_bird_view.root);
     flappy_bird_view.root = NULL;
-    flappy_bird_canvas = NULL;
+    pipes_obj = NULL;
     bird = NULL;
-    for (int i = 0; i < MAX_PIPE_SETS; i++) {
-      pipes[i].pipe = NULL;
-    }
     score_label = NULL;
+    ghost_frames_destroy();
   }
 }
 
@@ -395,13 +665,14 @@ void flappy_bird_view_hardwareinput_callback(InputEvent *event) {
     return;
   }
 
+  // The flap is applied in the game step it happened in
   if (event->type == INPUT_TYPE_JOYSTICK) {
     int button = event->data.joystick_index;
     if (button == 1) {
-      bird_velocity = settings.flap_strength;
+      queue_flap();
     }
   } else if (event->type == INPUT_TYPE_TOUCH) {
-    bird_velocity = settings.flap_strength;
+    queue_flap();
   }
 }
 
@@ -412,88 +683,31 @@ void flappy_bird_view_get_hardwareinput_callback(void **callback) {
   }
 }
 
-// Game Loop Function
+// Game Loop Function, runs the game steps due since the last frame and
+// then draws the result once
 void flappy_bird_game_loop(lv_timer_t *timer) {
   if (is_game_over) {
     return;
   }
 
-  // Update bird's physics
-  bird_velocity += settings.gravity;
-  bird_y_position += (int)bird_velocity;
-  lv_obj_set_pos(bird, LV_HOR_RES / 4, bird_y_position);
-
-  // Update bird's angle based on velocity
-  int angle = (int)(bird_velocity * 5);
-  if (angle > 45)
-    angle = 45;
-  if (angle < -45)
-    angle = -45;
-  lv_img_set_angle(bird, angle * 10);
-
-  // Check collision with ground or ceiling
-  if ((bird_y_position + lv_obj_get_height(bird)) >=
-          (LV_VER_RES - settings.ground_height + settings.buffer_bottom) ||
-      (bird_y_position <= -settings.buffer_top)) {
-    flappy_bird_game_over();
-  }
-
-  // Update each pipe set
-  for (int i = 0; i < MAX_PIPE_SETS; i++) {
-    // Move pipe left
-    int pipe_x = lv_obj_get_x(pipes[i].pipe);
-    pipe_x -= settings.pipe_speed;
-
-    if (pipe_x < -settings.pipe_width) {
-      pipe_x = LV_HOR_RES;
-
-      // Update gap center position
-      pipes[i].gap_center_y =
-          rand() % (pipe_max_gap_y - pipe_min_gap_y + 1) + pipe_min_gap_y;
-
-      // Resize and reposition pipe
-      lv_obj_set_size(pipes[i].pipe, settings.pipe_width,
-                      LV_VER_RES - pipes[i].gap_center_y -
-                          settings.ground_height);
-      lv_obj_set_pos(pipes[i].pipe, pipe_x, pipes[i].gap_center_y + pipe_gap);
-
-      // Update score
-      score++;
-      lv_label_set_text_fmt(score_label, "Score: %d", score);
-    } else {
-      // Update pipe position
-      lv_obj_set_x(pipes[i].pipe, pipe_x);
-    }
-
-    // Check collision with pipe
-    if (flappy_bird_check_collision(bird, pipes[i].pipe)) {
-      flappy_bird_game_over();
+  uint32_t now = lv_tick_get();
+  int steps = 0;
+  while (!game.over && (int32_t)(now - game_tick) >= GAME_STEP_MS) {
+    if (steps == GAME_MAX_STEPS_PER_FRAME) {
+      game_tick = now;
+      break;
     }
+    game_tick += GAME_STEP_MS;
+    game_step(take_flap(game_tick));
+    steps++;
   }
-}
-
-// Collision Detection Function
-int flappy_bird_check_collision(lv_obj_t *bird, lv_obj_t *pipe) {
-  float padding_ratio = 0.02f; // 2% of screen height
-  int padding = (int)(LV_VER_RES * padding_ratio);
-
-  // Get bird's absolute coordinates
-  lv_area_t bird_area;
-  lv_obj_get_coords(bird, &bird_area);
-
-  // Get pipe's absolute coordinates
-  lv_area_t pipe_area;
-  lv_obj_get_coords(pipe, &pipe_area);
-
-  // Check for overlap with padding
-  bool overlap_x = (bird_area.x2 + padding) >= pipe_area.x1 &&
-                   (bird_area.x1 - padding) <= pipe_area.x2;
-  bool overlap_y = (bird_area.y2 + padding) >= pipe_area.y1 &&
-                   (bird_area.y1 - padding) <= pipe_area.y2;
 
-  bool collision = overlap_x && overlap_y;
-
-  return collision ? 1 : 0;
+  if (steps > 0) {
+    game_render();
+  }
+  if (game.over) {
+    flappy_bird_game_over();
+  }
 }
 
 // Game Over Handling Function
@@ -536,36 +750,20 @@ void flappy_bird_game_over() {
   internet_connected = check_internet_connectivity();
 
   if (internet_connected) {
-    submit_score_to_api(settings_get_flappy_ghost_name(&G_Settings), score);
+    submit_score_to_api(settings_get_flappy_ghost_name(&G_Settings),
+                        game.score);
   }
 }
 
 // Restart Game Function
 void flappy_bird_restart() {
   is_game_over = false;
-  bird_y_position = (LV_VER_RES <= 128) ? 3 : (LV_VER_RES / 2);
-  bird_velocity = 0;
-  score = 0;
-  lv_label_set_text_fmt(score_label, "Score: %d", score);
-
-  // Reset bird position
-  lv_obj_set_pos(bird, LV_HOR_RES / 4, bird_y_position);
-
-  // Reset pipe positions and sizes
-  for (int i = 0; i < MAX_PIPE_SETS; i++) {
-    // Reposition pipe off-screen
-    lv_obj_set_pos(pipes[i].pipe, LV_HOR_RES + i * (LV_HOR_RES / MAX_PIPE_SETS),
-                   pipes[i].gap_center_y + pipe_gap);
+  game_reset();
+  game_render();
 
-    // Update gap center position
-    pipes[i].gap_center_y =
-        rand() % (pipe_max_gap_y - pipe_min_gap_y + 1) + pipe_min_gap_y;
-
-    // Reset pipe size based on new gap center
-    lv_obj_set_size(pipes[i].pipe, settings.pipe_width,
-                    LV_VER_RES - pipes[i].gap_center_y -
-                        settings.ground_height);
-  }
+  // The tap that restarted is not a flap
+  flap_tail = flap_head;
+  game_tick = lv_tick_get();
 
   // Remove the game over overlay if it exists
   lv_obj_t *game_over_container = lv_obj_get_child(flappy_bird_view.root, -1);
@@ -576,6 +774,6 @@ void flappy_bird_restart() {
   // Restart game loop timer if necessary
   if (game_loop_timer == NULL) {
     game_loop_timer =
-        lv_timer_create(flappy_bird_game_loop, GAME_LOOP_INTERVAL_MS, NULL);
+        lv_timer_create(flappy_bird_game_loop, GAME_STEP_MS, NULL);
   }
-}
\ No newline at end of file
+}
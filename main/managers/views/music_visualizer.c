@@ -2,12 +2,23 @@
 #include "managers/views/main_menu_screen.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <limits.h>
 #include <lvgl.h>
 #include <math.h>
 
 #define NUM_PARTICLES 5
 #define ANIMATION_INTERVAL_MS 5 // Approximately 30 FPS
 
+// Bar levels are kept in 24.8 fixed point and advanced every animation tick.
+// A bar jumps up to a new amplitude and falls back by BAR_DECAY per tick, its
+// peak marker holds for PEAK_HOLD_TICKS and then drops with gravity.
+#define BAR_FRAC_BITS 8
+#define BAR_ONE (1 << BAR_FRAC_BITS)
+#define BAR_DECAY (BAR_ONE * 3 / 4)
+#define PEAK_HOLD_TICKS 80
+#define PEAK_GRAVITY (BAR_ONE / 32)
+#define PEAK_HEIGHT 2
+
 lv_timer_t *animation_timer = NULL;
 
 typedef struct {
@@ -21,6 +32,21 @@ typedef struct {
   int bars[NUM_BARS]; // Amplitude data for each bar
 } AmplitudeData;
 
+typedef struct {
+  int32_t target; // Latest amplitude
+  int32_t level;
+  int32_t peak;
+  int32_t peak_velocity;
+  uint16_t hold;
+  int16_t drawn_level; // Pixel heights on screen
+  int16_t drawn_peak;
+} BarState;
+
+static BarState bar_state[NUM_BARS];
+static int bar_width;
+static int bar_spacing;
+static int bar_max_height;
+
 Particle particles[NUM_PARTICLES];
 MusicVisualizerView view;
 lv_obj_t *root;
@@ -54,6 +80,95 @@ View music_visualizer_view = {
 
 void animation_timer_callback(lv_timer_t *timer);
 
+// All bars are drawn by one object, so a frame costs no style or layout
+// work per bar and only the rows a bar moved through are invalidated
+static void bars_draw_cb(lv_event_t *e) {
+  lv_obj_t *obj = lv_event_get_target(e);
+  lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+  lv_area_t coords;
+  lv_obj_get_coords(obj, &coords);
+
+  lv_draw_rect_dsc_t bar_dsc;
+  lv_draw_rect_dsc_init(&bar_dsc);
+  bar_dsc.bg_color = lv_color_make(147, 112, 219);
+  lv_draw_rect_dsc_t peak_dsc;
+  lv_draw_rect_dsc_init(&peak_dsc);
+  peak_dsc.bg_color = lv_color_white();
+
+  for (int i = 0; i < NUM_BARS; i++) {
+    lv_area_t area;
+    area.x1 = coords.x1 + bar_spacing * i;
+    area.x2 = area.x1 + bar_width - 1;
+    if (bar_state[i].drawn_level > 0) {
+      area.y2 = coords.y2;
+      area.y1 = coords.y2 - bar_state[i].drawn_level + 1;
+      lv_draw_rect(draw_ctx, &bar_dsc, &area);
+    }
+    if (bar_state[i].drawn_peak > 0) {
+      area.y2 = coords.y2 - bar_state[i].drawn_peak;
+      area.y1 = area.y2 - PEAK_HEIGHT + 1;
+      lv_draw_rect(draw_ctx, &peak_dsc, &area);
+    }
+  }
+}
+
+// Invalidates the rows of bar i between heights lo and hi above its bottom
+static void bars_invalidate_rows(int i, int lo, int hi) {
+  lv_area_t coords;
+  lv_obj_get_coords(view.bars, &coords);
+  lv_area_t area;
+  area.x1 = coords.x1 + bar_spacing * i;
+  area.x2 = area.x1 + bar_width - 1;
+  area.y1 = coords.y2 - hi + 1;
+  area.y2 = coords.y2 - lo;
+  lv_obj_invalidate_area(view.bars, &area);
+}
+
+static void bars_set_targets(const int *amplitudes) {
+  for (int i = 0; i < NUM_BARS; i++) {
+    int amplitude = LV_CLAMP(0, amplitudes[i], bar_max_height);
+    bar_state[i].target = amplitude << BAR_FRAC_BITS;
+  }
+}
+
+static void bars_tick(void) {
+  for (int i = 0; i < NUM_BARS; i++) {
+    BarState *bar = &bar_state[i];
+
+    bar->level = LV_MAX(bar->target, bar->level - BAR_DECAY);
+    if (bar->level >= bar->peak) {
+      bar->peak = bar->level;
+      bar->peak_velocity = 0;
+      bar->hold = PEAK_HOLD_TICKS;
+    } else if (bar->hold > 0) {
+      bar->hold--;
+    } else {
+      bar->peak_velocity += PEAK_GRAVITY;
+      bar->peak = LV_MAX(bar->level, bar->peak - bar->peak_velocity);
+    }
+
+    // One area per bar covering the rows the top and the peak marker
+    // moved through, the marker sits PEAK_HEIGHT rows above its height
+    int level = bar->level >> BAR_FRAC_BITS;
+    int peak = bar->peak >> BAR_FRAC_BITS;
+    int lo = INT_MAX;
+    int hi = INT_MIN;
+    if (level != bar->drawn_level) {
+      lo = LV_MIN(level, bar->drawn_level);
+      hi = LV_MAX(level, bar->drawn_level);
+    }
+    if (peak != bar->drawn_peak) {
+      lo = LV_MIN(lo, LV_MIN(peak, bar->drawn_peak));
+      hi = LV_MAX(hi, LV_MAX(peak, bar->drawn_peak) + PEAK_HEIGHT);
+    }
+    if (lo < hi) {
+      bars_invalidate_rows(i, lo, hi);
+      bar->drawn_level = level;
+      bar->drawn_peak = peak;
+    }
+  }
+}
+
 void music_visualizer_view_create() {
   display_manager_fill_screen(lv_color_black());
 
@@ -85,9 +200,11 @@ void music_visualizer_view_create() {
 
   int label_x_offset = LV_HOR_RES / 12;
   int label_y_offset = LV_VER_RES / 8;
-  int bar_width = LV_HOR_RES / (NUM_BARS * 2);
-  int bar_spacing = LV_HOR_RES / (NUM_BARS + 2);
   int bar_y_offset = LV_VER_RES / 4;
+  bar_width = LV_HOR_RES / (NUM_BARS * 2);
+  bar_spacing = LV_HOR_RES / (NUM_BARS + 2);
+  // Amplitudes are pixels, keep the tallest bar and its peak on screen
+  bar_max_height = LV_MIN(255, LV_VER_RES - bar_y_offset - PEAK_HEIGHT);
 
   view.track_label = lv_label_create(music_visualizer_view.root);
   lv_label_set_text(view.track_label, "Ghost ESP");
@@ -105,20 +222,15 @@ void music_visualizer_view_create() {
   lv_obj_align_to(view.artist_label, view.track_label, LV_ALIGN_OUT_BOTTOM_LEFT,
                   0, lv_font_get_line_height(track_label_font) / 4);
 
-  for (int i = 0; i < NUM_BARS; i++) {
-    view.bars[i] = lv_obj_create(music_visualizer_view.root);
-    lv_obj_set_size(view.bars[i], bar_width, 1);
-    lv_obj_align(view.bars[i], LV_ALIGN_BOTTOM_LEFT,
-                 label_x_offset + (bar_spacing * i), -bar_y_offset);
-
-    lv_obj_set_style_radius(view.bars[i], 0, LV_PART_MAIN);
-    lv_obj_set_style_bg_opa(view.bars[i], LV_OPA_COVER, LV_PART_MAIN);
-    lv_obj_set_style_bg_color(view.bars[i], lv_color_make(147, 112, 219),
-                              LV_PART_MAIN);
-    lv_obj_set_style_bg_grad_color(view.bars[i], lv_color_make(147, 112, 219),
-                                   LV_PART_MAIN);
-    lv_obj_set_style_bg_grad_dir(view.bars[i], LV_GRAD_DIR_VER, LV_PART_MAIN);
-  }
+  memset(bar_state, 0, sizeof(bar_state));
+  view.bars = lv_obj_create(music_visualizer_view.root);
+  lv_obj_remove_style_all(view.bars);
+  lv_obj_clear_flag(view.bars, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+  lv_obj_set_size(view.bars, bar_spacing * (NUM_BARS - 1) + bar_width,
+                  bar_max_height + PEAK_HEIGHT);
+  lv_obj_align(view.bars, LV_ALIGN_BOTTOM_LEFT, label_x_offset,
+               -bar_y_offset);
+  lv_obj_add_event_cb(view.bars, bars_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
 
   for (int i = 0; i < NUM_PARTICLES; i++) {
     particles[i].obj = lv_obj_create(music_visualizer_view.root);
@@ -145,10 +257,9 @@ void animation_timer_callback(lv_timer_t *timer) {
       xQueueReceive(amplitudeQueue, &amplitudeData, 0) == pdTRUE;
 
   if (dataAvailable) {
-    for (int i = 0; i < NUM_BARS; i++) {
-      lv_obj_set_height(view.bars[i], amplitudeData.bars[i]);
-    }
+    bars_set_targets(amplitudeData.bars);
   }
+  bars_tick();
 
   for (int i = 0; i < NUM_PARTICLES; i++) {
     particles[i].x += particles[i].velocity;
@@ -1,6 +1,9 @@
 // wifi_manager.c
 
 #include "managers/wifi_manager.h"
+#include "core/ieee80211_parse.h"
+#include "core/system_manager.h"
+#include "core/vis_stream.h"
 #include "esp_crt_bundle.h"
 #include "esp_event.h"
 #include "esp_heap_caps.h" // Add include for heap stats
@@ -414,8 +417,12 @@ void wifi_stations_sniffer_callback(void *buf, wifi_promiscuous_pkt_type_t type)
     }
 
     const wifi_promiscuous_pkt_t *packet = (wifi_promiscuous_pkt_t *)buf;
-    const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)packet->payload;
-    const wifi_ieee80211_hdr_t *hdr = &ipkt->hdr;
+    ieee80211_frame_t frame;
+    if (!ieee80211_frame_parse(packet->payload, packet->rx_ctrl.sig_len, &frame) ||
+        frame.addr3 == NULL) {
+        return;
+    }
+    const wifi_ieee80211_hdr_t *hdr = (const wifi_ieee80211_hdr_t *)frame.data;
 
     // --- DEBUG: Print raw addresses from MGMT frame ---
     // printf("DEBUG MGMT Frame: Addr1=%02X:%02X:%02X:%02X:%02X:%02X, Addr2=%02X:%02X:%02X:%02X:%02X:%02X, Addr3=%02X:%02X:%02X:%02X:%02X:%02X\n",
@@ -784,11 +791,7 @@ esp_err_t get_log_handler(httpd_req_t *req) {
 
         // Save to SD card if available and filename is set
         if (sd_card_manager.is_initialized && current_keystrokes_filename[0] != '\0') {
-            FILE* f = fopen(current_keystrokes_filename, "a");
-            if (f) {
-                fprintf(f, "%s", body); // Append the chunk
-                fclose(f);
-            } else {
+            if (sd_card_append_file(current_keystrokes_filename, body, received) != ESP_OK) {
                 printf("Failed to open %s for appending\n", current_keystrokes_filename);
             }
         }
@@ -823,12 +826,15 @@ esp_err_t get_info_handler(httpd_req_t *req) {
 
         // Save credentials to SD card if available and filename is set
         if (sd_card_manager.is_initialized && current_creds_filename[0] != '\0') {
-            FILE* f = fopen(current_creds_filename, "a");
-            if (f) {
-                // Optionally add a timestamp or delimiter here
-                fprintf(f, "Email: %s, Password: %s\n", decoded_email, decoded_password);
-                fclose(f);
-            } else {
+            char line[160];
+            int line_len = snprintf(line, sizeof(line), "Email: %s, Password: %s\n",
+                                    decoded_email, decoded_password);
+            if (line_len > (int)sizeof(line) - 1) {
+                line_len = sizeof(line) - 1;
+            }
+            // Credentials are rare and valuable, push them to the card right away
+            if (sd_card_append_file(current_creds_filename, line, line_len) != ESP_OK ||
+                sd_card_sync(current_creds_filename) != ESP_OK) {
                 printf("Failed to open %s for appending\n", current_creds_filename);
             }
         }
@@ -1044,6 +1050,12 @@ void wifi_manager_stop_evil_portal() {
     current_keystrokes_filename[0] = '\0';
 
     if (dns_handle != NULL) {
+        dns_server_stats_t dns_stats;
+        dns_server_get_stats(dns_handle, &dns_stats);
+        printf("DNS server answered %lu of %lu queries (peak %lu/s, %lu malformed)\n",
+               (unsigned long)dns_stats.answered, (unsigned long)dns_stats.queries,
+               (unsigned long)dns_stats.peak_queries_per_sec,
+               (unsigned long)dns_stats.malformed);
         stop_dns_server(dns_handle);
         dns_handle = NULL;
     }
@@ -1504,7 +1516,8 @@ void wifi_manager_start_deauth() {
         ap_manager_stop_services();
         esp_wifi_start();
         printf("Restarting Wi-Fi\n");
-        xTaskCreate(wifi_deauth_task, "deauth_task", 4096, NULL, 5, &deauth_task_handle);
+        system_manager_create_task(wifi_deauth_task, "deauth_task", 4096, NULL, 5,
+                                   &deauth_task_handle, NULL);
         beacon_task_running = true;
         rgb_manager_set_color(&rgb_manager, -1, 255, 0, 0, false);
     } else {
@@ -1614,7 +1627,8 @@ void wifi_manager_deauth_station(void) {
     TERMINAL_VIEW_ADD_TEXT("Deauthing station %02X:%02X:%02X:%02X:%02X:%02X from AP %02X:%02X:%02X:%02X:%02X:%02X, starting background task...\n",
            selected_station.station_mac[0], selected_station.station_mac[1], selected_station.station_mac[2], selected_station.station_mac[3], selected_station.station_mac[4], selected_station.station_mac[5],
            selected_station.ap_bssid[0], selected_station.ap_bssid[1], selected_station.ap_bssid[2], selected_station.ap_bssid[3], selected_station.ap_bssid[4], selected_station.ap_bssid[5]);
-    xTaskCreate(wifi_deauth_station_task, "deauth_station", 4096, NULL, 5, &deauth_station_task_handle);
+    system_manager_create_task(wifi_deauth_station_task, "deauth_station", 4096, NULL, 5,
+                               &deauth_station_task_handle, NULL);
     station_selected = false;
 }
 
@@ -1647,12 +1661,13 @@ static void wifi_deauth_station_task(void *param) {
 #define ARTIST_NAME_LEN 32
 #define NUM_BARS 15
 
-void screen_music_visualizer_task(void *pvParameters) {
-    char rx_buffer[128];
-    char track_name[TRACK_NAME_LEN + 1];
-    char artist_name[ARTIST_NAME_LEN + 1];
-    uint8_t amplitudes[NUM_BARS];
+#define VIS_POLL_MS 10 // Receive timeout, the jitter buffer plays out between packets
+
+static uint32_t vis_now_ms(void) {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
 
+static int vis_open_socket(void) {
     struct sockaddr_in dest_addr;
     dest_addr.sin_family = AF_INET;
     dest_addr.sin_port = htons(UDP_PORT);
@@ -1661,88 +1676,109 @@ void screen_music_visualizer_task(void *pvParameters) {
     int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (sock < 0) {
         printf("Unable to create socket: errno %d\n", errno);
-        vTaskDelete(NULL);
-        return;
+        return -1;
     }
-
     printf("Socket created\n");
 
-    int err = bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-    if (err < 0) {
+    if (bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) < 0) {
         printf("Socket unable to bind: errno %d\n", errno);
         close(sock);
-        vTaskDelete(NULL);
-        return;
+        return -1;
     }
 
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = VIS_POLL_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
     printf("Socket bound, port %d\n", UDP_PORT);
+    return sock;
+}
 
-    while (1) {
-        printf("Waiting for data...\n");
+static void vis_print_stats(const vis_jitter_t *jb) {
+    printf("Visualizer: %" PRIu32 " received, %" PRIu32 " played, %" PRIu32
+           " reordered, %" PRIu32 " late, %" PRIu32 " lost, %" PRIu32 " invalid\n",
+           jb->stats.received, jb->stats.played, jb->stats.reordered, jb->stats.late,
+           jb->stats.lost, jb->stats.invalid);
+}
+
+void screen_music_visualizer_task(void *pvParameters) {
+    uint8_t rx_buffer[128];
+    char track_name[TRACK_NAME_LEN + 1] = "";
+    char artist_name[ARTIST_NAME_LEN + 1] = "";
+    uint8_t amplitudes[NUM_BARS];
+    static vis_jitter_t jitter; // Too large for the task stack
+    vis_packet_t pkt;
 
-        struct sockaddr_in6 source_addr;
-        socklen_t socklen = sizeof(source_addr);
+    int sock = vis_open_socket();
+    if (sock < 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+    vis_jitter_init(&jitter, VIS_JITTER_DELAY_MS);
 
-        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0,
-                           (struct sockaddr *)&source_addr, &socklen);
-        if (len < 0) {
+    while (1) {
+        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0, NULL, NULL);
+        if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
             printf("recvfrom failed: errno %d\n", errno);
             break;
         }
 
-        rx_buffer[len] = '\0';
-
-        if (len >= TRACK_NAME_LEN + ARTIST_NAME_LEN + NUM_BARS) {
-
-            memcpy(track_name, rx_buffer, TRACK_NAME_LEN);
-            track_name[TRACK_NAME_LEN] = '\0';
-
-            memcpy(artist_name, rx_buffer + TRACK_NAME_LEN, ARTIST_NAME_LEN);
-            artist_name[ARTIST_NAME_LEN] = '\0';
-
-            memcpy(amplitudes, rx_buffer + TRACK_NAME_LEN + ARTIST_NAME_LEN, NUM_BARS);
+        if (len > 0) {
+            bool started = jitter.started;
+            if (vis_packet_parse(rx_buffer, len, &pkt)) {
+                vis_jitter_push(&jitter, &pkt, vis_now_ms());
+                if (!started) {
+                    printf("Visualizer stream started\n");
+                }
+            } else if (len >= TRACK_NAME_LEN + ARTIST_NAME_LEN + NUM_BARS) {
+                // Fixed 32 byte names and 15 bars from older scripts,
+                // shown as they come
+                memcpy(track_name, rx_buffer, TRACK_NAME_LEN);
+                track_name[TRACK_NAME_LEN] = '\0';
+                memcpy(artist_name, rx_buffer + TRACK_NAME_LEN, ARTIST_NAME_LEN);
+                artist_name[ARTIST_NAME_LEN] = '\0';
+                memcpy(amplitudes, rx_buffer + TRACK_NAME_LEN + ARTIST_NAME_LEN, NUM_BARS);
+#ifdef WITH_SCREEN
+                music_visualizer_view_update(amplitudes, track_name, artist_name);
+#endif
+            } else {
+                jitter.stats.invalid++;
+            }
+        }
 
+        while (vis_jitter_pop(&jitter, vis_now_ms(), &pkt)) {
+            if (pkt.has_meta) {
+                snprintf(track_name, sizeof(track_name), "%s", pkt.track);
+                snprintf(artist_name, sizeof(artist_name), "%s", pkt.artist);
+            }
+            vis_resample_bands(pkt.bands, pkt.band_count, amplitudes, NUM_BARS);
 #ifdef WITH_SCREEN
             music_visualizer_view_update(amplitudes, track_name, artist_name);
 #endif
-        } else {
-            printf("Received packet of unexpected size\n");
         }
-    }
 
-    if (sock != -1) {
-        printf("Shutting down socket and restarting...\n");
-        shutdown(sock, 0);
-        close(sock);
+        if (jitter.started && vis_now_ms() - jitter.last_rx_ms > VIS_STREAM_TIMEOUT_MS) {
+            printf("Visualizer stream stopped\n");
+            vis_print_stats(&jitter);
+            vis_jitter_init(&jitter, VIS_JITTER_DELAY_MS);
+        }
     }
 
+    printf("Shutting down socket and restarting...\n");
+    shutdown(sock, 0);
+    close(sock);
     vTaskDelete(NULL);
 }
 
 void animate_led_based_on_amplitude(void *pvParameters) {
-    char rx_buffer[128];
-    char addr_str[128];
-    int addr_family = AF_INET;
-    int ip_protocol = IPPROTO_IP;
-    struct sockaddr_in dest_addr;
-
-    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    dest_addr.sin_family = addr_family;
-    dest_addr.sin_port = htons(UDP_PORT);
+    uint8_t rx_buffer[128];
+    static vis_jitter_t jitter; // Too large for the task stack
+    vis_packet_t pkt;
 
-    int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
+    int sock = vis_open_socket();
     if (sock < 0) {
-        printf("Unable to create socket: errno %d\n", errno);
-        return;
-    }
-    printf("Socket created\n");
-
-    if (bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) < 0) {
-        printf("Socket unable to bind: errno %d\n", errno);
-        close(sock);
+        vTaskDelete(NULL);
         return;
     }
-    printf("Socket bound, port %d\n", UDP_PORT);
+    vis_jitter_init(&jitter, VIS_JITTER_DELAY_MS);
 
     float amplitude = 0.0f;
     float last_amplitude = 0.0f;
@@ -1750,18 +1786,31 @@ void animate_led_based_on_amplitude(void *pvParameters) {
     int hue = 0;
 
     while (1) {
-        struct sockaddr_in source_addr;
-        socklen_t socklen = sizeof(source_addr);
-        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, MSG_DONTWAIT,
-                           (struct sockaddr *)&source_addr, &socklen);
+        bool have_sample = false;
+        float sample = 0.0f;
 
+        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, MSG_DONTWAIT, NULL, NULL);
         if (len > 0) {
-            rx_buffer[len] = '\0';
-            inet_ntoa_r(source_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
-            printf("Received %d bytes from %s: %s\n", len, addr_str, rx_buffer);
+            if (vis_packet_parse(rx_buffer, len, &pkt)) {
+                vis_jitter_push(&jitter, &pkt, vis_now_ms());
+            } else {
+                // Text amplitude from older scripts
+                rx_buffer[len] = '\0';
+                sample = atof((const char *)rx_buffer);
+                have_sample = true;
+            }
+        }
+
+        // The loudest band drives the LEDs
+        while (vis_jitter_pop(&jitter, vis_now_ms(), &pkt)) {
+            uint8_t level = 0;
+            vis_resample_bands(pkt.bands, pkt.band_count, &level, 1);
+            sample = level / 255.0f;
+            have_sample = true;
+        }
 
-            amplitude = atof(rx_buffer);
-            amplitude = fmaxf(0.0f, fminf(amplitude, 1.0f)); // Clamp between 0.0 and 1.0
+        if (have_sample) {
+            amplitude = fmaxf(0.0f, fminf(sample, 1.0f)); // Clamp between 0.0 and 1.0
 
             // Smooth amplitude to avoid sudden changes (optional)
             amplitude =
@@ -2805,7 +2854,8 @@ void wifi_manager_start_beacon(const char *ssid) {
         TERMINAL_VIEW_ADD_TEXT("Starting beacon transmission...\n");
         configure_hidden_ap();
         esp_wifi_start();
-        xTaskCreate(wifi_beacon_task, "beacon_task", 2048, (void *)ssid, 5, &beacon_task_handle);
+        system_manager_create_task(wifi_beacon_task, "beacon_task", 2048, (void *)ssid, 5,
+                                   &beacon_task_handle, NULL);
         beacon_task_running = true;
         rgb_manager_set_color(&rgb_manager, 0, 255, 0, 0, false);
     } else {
@@ -3201,7 +3251,8 @@ void wifi_manager_start_beacon_list(void) {
     printf("Starting beacon spam list (%d SSIDs)...\n", g_beacon_list_count);
     TERMINAL_VIEW_ADD_TEXT("Starting beacon spam list (%d SSIDs)...\n", g_beacon_list_count);
     // Launch the beacon list task
-    xTaskCreate(wifi_beacon_list_task, "beacon_list", 2048, NULL, 5, &beacon_task_handle);
+    system_manager_create_task(wifi_beacon_list_task, "beacon_list", 2048, NULL, 5,
+                               &beacon_task_handle, NULL);
     beacon_task_running = 1;
     rgb_manager_set_color(&rgb_manager, 0, 255, 0, 0, false);
 }
@@ -3288,8 +3339,10 @@ void wifi_manager_start_dhcpstarve(int threads) {
     }
     dhcp_starve_running = true;
     dhcp_starve_packets_sent = 0;
-    xTaskCreate(dhcp_starve_task, "dhcp_starve", 4096, NULL, 5, &dhcp_starve_task_handle);
-    xTaskCreate(dhcp_starve_display_task, "dhcp_disp", 2048, NULL, 5, &dhcp_starve_display_task_handle);
+    system_manager_create_task(dhcp_starve_task, "dhcp_starve", 4096, NULL, 5,
+                               &dhcp_starve_task_handle, NULL);
+    system_manager_create_task(dhcp_starve_display_task, "dhcp_disp", 2048, NULL, 5,
+                               &dhcp_starve_display_task_handle, NULL);
 }
 
 void wifi_manager_stop_dhcpstarve(void) {
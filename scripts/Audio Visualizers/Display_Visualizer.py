@@ -1,6 +1,8 @@
 import pyaudio
 import numpy as np
+import random
 import socket
+import struct
 import time
 
 # Audio settings
@@ -13,6 +15,12 @@ CHANNELS = 1             # Mono audio
 UDP_PORT = 6677          # Port number
 BROADCAST_IP = '192.168.1.255'  # Broadcast address
 
+# Packet format, see include/core/vis_stream.h in the firmware
+PROTO_VERSION = 1
+FLAG_META = 0x01
+MAX_NAME = 32
+META_INTERVAL = 1.0  # Seconds between track info repeats
+
 # Track info
 TRACK_NAME = input("Enter Track Name ")
 ARTIST_NAME = input("Enter Artist Name ")
@@ -33,6 +41,24 @@ band_edges = np.array([20, 60, 150, 300, 600, 1200, 2500, 5000, 8000, 12000, 160
 # Prepare frequency bins
 freq_bins = np.fft.rfftfreq(CHUNK, d=1./RATE)
 
+def encode_name(name):
+    # Truncate to MAX_NAME bytes without splitting a UTF-8 character
+    data = name.encode('utf-8')[:MAX_NAME].decode('utf-8', 'ignore').encode('utf-8')
+    return bytes([len(data)]) + data
+
+def build_packet(seq, bands, meta):
+    flags = FLAG_META if meta else 0
+    ts_ms = int(time.monotonic() * 1000) & 0xFFFFFFFF
+    packet = struct.pack('<2sBBHBBI', b'GV', PROTO_VERSION, flags, seq, len(bands), 0, ts_ms)
+    packet += bytes(bands)
+    if meta:
+        packet += encode_name(TRACK_NAME) + encode_name(ARTIST_NAME)
+    return packet
+
+# A random start lets the device tell a restarted sender from late packets
+seq = random.randrange(0x10000)
+last_meta = 0.0
+
 # Initialize variables for normalization, smoothing, and decay
 previous_amplitudes = np.zeros(num_bands)
 decay_factor = 0.9  # Adjust between 0 (no decay) and 1 (fast decay)
@@ -90,14 +116,15 @@ try:
         # Convert previous amplitudes to integer for sending
         final_amplitudes = [int(amp) for amp in previous_amplitudes]
 
-        # Create a message including the track info and normalized amplitudes
-        message = TRACK_NAME.encode('utf-8')[:32].ljust(32, b'\0')  # 32 bytes for track name
-        message += ARTIST_NAME.encode('utf-8')[:32].ljust(32, b'\0')  # 32 bytes for artist name
-        message += bytes(final_amplitudes)  # Include all 15 amplitude values
+        # Track info rides along every META_INTERVAL seconds
+        now = time.monotonic()
+        meta = now - last_meta >= META_INTERVAL
+        if meta:
+            last_meta = now
 
-        # Ensure the message length is 79 bytes
-        if len(message) != 79:
-            print(f"Message length is {len(message)}, expected 79 bytes")
+        final_amplitudes = [min(255, amp) for amp in final_amplitudes]
+        message = build_packet(seq, final_amplitudes, meta)
+        seq = (seq + 1) & 0xFFFF
 
         # Send the message over UDP to the broadcast address
         sock.sendto(message, (BROADCAST_IP, UDP_PORT))
@@ -1,6 +1,9 @@
 import pyaudio
 import numpy as np
+import random
 import socket
+import struct
+import time
 import logging
 
 # Replace with the IP address and port of your ESP32
@@ -25,12 +28,23 @@ NOISE_THRESHOLD = 0.2  # Amplitude below which is considered noise and set to ze
 # Configure logging
 logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
 
+# Packet format, see include/core/vis_stream.h in the firmware
+PROTO_VERSION = 1
+
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+# A random start lets the device tell a restarted sender from late packets
+seq = random.randrange(0x10000)
+
 def send_amplitude(amplitude):
+    global seq
     try:
-        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-        message = f"{amplitude}".encode('utf-8')
+        # One band, the amplitude scaled to 0-255
+        level = int(min(max(amplitude, 0.0), 1.0) * 255)
+        ts_ms = int(time.monotonic() * 1000) & 0xFFFFFFFF
+        message = struct.pack('<2sBBHBBIB', b'GV', PROTO_VERSION, 0, seq, 1, 0, ts_ms, level)
+        seq = (seq + 1) & 0xFFFF
         sock.sendto(message, (UDP_IP, UDP_PORT))
-        sock.close()
         logging.debug(f"Sent amplitude: {amplitude} to {UDP_IP}:{UDP_PORT}")
     except Exception as e:
         logging.error(f"Failed to send data: {e}")
@@ -136,6 +150,7 @@ def main():
             stream.stop_stream()
             stream.close()
         p.terminate()
+        sock.close()
         logging.info("Audio stream closed and resources released.")
 
 if __name__ == "__main__":